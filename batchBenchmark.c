@@ -0,0 +1,118 @@
+// scans two fields of a twenty-field record, as an array of structs and as a columnar record batch
+
+#include "lambda_batch.h"
+#include <math.h>
+#include <time.h>
+
+#ifndef RECORDS
+#define RECORDS (2u * 1024u * 1024u)
+#endif
+
+static int close_enough(double a, double b) {
+    return fabs(a - b) <= 1e-9 * fabs(b);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    int64_t id;
+    double price;
+    int32_t quantity;
+    int32_t region;
+    double cost, discount, tax, weight, volume, rating;
+    int64_t customer, product, warehouse, created, shipped, updated;
+    double lat, lon;
+    int64_t status, channel;
+} order_t;
+
+static const batch_field_t order_fields[] = {
+    BATCH_FIELD(order_t, id, BATCH_INT64),         BATCH_FIELD(order_t, price, BATCH_DOUBLE),
+    BATCH_FIELD(order_t, quantity, BATCH_INT32),   BATCH_FIELD(order_t, region, BATCH_INT32),
+    BATCH_FIELD(order_t, cost, BATCH_DOUBLE),      BATCH_FIELD(order_t, discount, BATCH_DOUBLE),
+    BATCH_FIELD(order_t, tax, BATCH_DOUBLE),       BATCH_FIELD(order_t, weight, BATCH_DOUBLE),
+    BATCH_FIELD(order_t, volume, BATCH_DOUBLE),    BATCH_FIELD(order_t, rating, BATCH_DOUBLE),
+    BATCH_FIELD(order_t, customer, BATCH_INT64),   BATCH_FIELD(order_t, product, BATCH_INT64),
+    BATCH_FIELD(order_t, warehouse, BATCH_INT64),  BATCH_FIELD(order_t, created, BATCH_INT64),
+    BATCH_FIELD(order_t, shipped, BATCH_INT64),    BATCH_FIELD(order_t, updated, BATCH_INT64),
+    BATCH_FIELD(order_t, lat, BATCH_DOUBLE),       BATCH_FIELD(order_t, lon, BATCH_DOUBLE),
+    BATCH_FIELD(order_t, status, BATCH_INT64),     BATCH_FIELD(order_t, channel, BATCH_INT64),
+};
+
+/* The analytics lambda: revenue of orders with more than 10 items. */
+Lambda(chunk_revenue, arg,
+    batch_chunk_t* chunk = (batch_chunk_t*)arg;
+    const double* price = (const double*)chunk->columns[0];
+    const int32_t* quantity = (const int32_t*)chunk->columns[1];
+    double sum = 0;
+    for (size_t i = 0; i < chunk->count; i++) {
+        sum += quantity[i] > 10 ? price[i] * quantity[i] : 0.0;
+    }
+    *(double*)chunk->ctx += sum;
+    return NULL;
+);
+
+int main() {
+    DYNAMIC_ARRAY(order_t) orders;
+    orders.array = SAFE_MALLOC(RECORDS * sizeof(order_t));
+    orders.size = orders.capacity = RECORDS;
+    uint64_t seed = 42;
+    for (size_t i = 0; i < RECORDS; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        memset(&orders.array[i], 0, sizeof(order_t));
+        orders.array[i].id = (int64_t)i;
+        orders.array[i].price = (double)((seed >> 33) % 10000) / 100.0;
+        orders.array[i].quantity = (int32_t)((seed >> 20) % 20);
+    }
+    printf("records: %u, record size: %zu bytes, fields read: 2 of %zu\n", RECORDS, sizeof(order_t),
+           sizeof(order_fields) / sizeof(order_fields[0]));
+
+    double start = now_seconds();
+    record_batch_t* batch = BATCH_FROM_DYNAMIC_ARRAY(orders, order_fields);
+    printf("AoS -> batch:      %.3f s\n", now_seconds() - start);
+    int price = batch_find_column(batch, "price");
+    int quantity = batch_find_column(batch, "quantity");
+
+    for (int round = 0; round < 2; round++) {
+        start = now_seconds();
+        double expected = 0;
+        for (size_t i = 0; i < orders.size; i++) {
+            expected += orders.array[i].quantity > 10 ? orders.array[i].price * orders.array[i].quantity : 0.0;
+        }
+        double baseline = now_seconds() - start;
+
+        start = now_seconds();
+        double revenue = 0;
+        int columns[] = { price, quantity };
+        batch_for_each_chunk(batch, columns, 2, 0, chunk_revenue, &revenue);
+        double chunked = now_seconds() - start;
+
+        start = now_seconds();
+        int total = batch_find_column(batch, "total");
+        if (total < 0) {
+            total = batch_add_column(batch, "total", BATCH_DOUBLE);
+        }
+        BATCH_MAP2(batch, total, double, price, double, p, quantity, int32_t, q, q > 10 ? p * q : 0.0);
+        double mapped_sum = BATCH_REDUCE(batch, total, double, acc, 0.0, x, acc + x);
+        double mapped = now_seconds() - start;
+
+        if (round == 1) {
+            printf("AoS loop:          %.3f s  (%.1f MB touched)\n", baseline, RECORDS * sizeof(order_t) / 1e6);
+            printf("chunk lambda:      %.3f s  %5.1fx  %s\n", chunked, baseline / chunked,
+                   close_enough(revenue, expected) ? "ok" : "MISMATCH");
+            printf("BATCH_MAP2+REDUCE: %.3f s  %5.1fx  %s\n", mapped, baseline / mapped,
+                   close_enough(mapped_sum, expected) ? "ok" : "MISMATCH");
+        }
+    }
+
+    batch_set_null(batch, price, 0);
+    BATCH_TO_DYNAMIC_ARRAY(batch, orders, order_fields);
+    printf("batch -> AoS:      %zu records, null price written as %.1f\n", orders.size, orders.array[0].price);
+
+    batch_destroy(batch);
+    FREE_DYNAMIC_ARRAY(orders);
+    return 0;
+}
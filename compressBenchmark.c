@@ -0,0 +1,139 @@
+// compresses synthetic pipeline output (log lines) through the streaming stage and decompresses it again
+
+#include "lambda_compress.h"
+#include <time.h>
+
+#ifndef BYTES
+#define BYTES (128u << 20)
+#endif
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} buffer_t;
+
+/* Sink lambda: appends each chunk to a buffer_t, as a file writer would append to disk. */
+Lambda(append_chunk, arg,
+    compress_chunk_t* chunk = (compress_chunk_t*)arg;
+    buffer_t* out = (buffer_t*)chunk->ctx;
+    if (out->size + chunk->size > out->capacity) {
+        return arg;
+    }
+    memcpy(out->data + out->size, chunk->data, chunk->size);
+    out->size += chunk->size;
+    return NULL;
+);
+
+static size_t make_log(uint8_t* data, size_t size) {
+    static const char* const methods[] = { "GET", "POST", "PUT", "DELETE" };
+    static const char* const paths[] = { "/api/v1/orders", "/api/v1/users", "/static/app.js", "/health", "/login" };
+    static const int statuses[] = { 200, 200, 200, 201, 204, 301, 404, 500 };
+    uint64_t seed = 7;
+    size_t used = 0;
+    char line[256];
+    while (used < size) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        int n = snprintf(line, sizeof(line),
+                         "2024-05-%02u 12:%02u:%02u.%03u host-%03u %s %s?id=%u status=%d bytes=%u latency_ms=%u\n",
+                         (unsigned)(seed >> 59) % 28 + 1, (unsigned)(seed >> 40) % 60, (unsigned)(seed >> 34) % 60,
+                         (unsigned)(seed >> 24) % 1000, (unsigned)(seed >> 16) % 200, methods[(seed >> 12) % 4],
+                         paths[(seed >> 8) % 5], (unsigned)(seed >> 44) % 100000, statuses[(seed >> 5) % 8],
+                         (unsigned)(seed >> 30) % 65536, (unsigned)(seed >> 50) % 900);
+        size_t take = used + (size_t)n > size ? size - used : (size_t)n;
+        memcpy(data + used, line, take);
+        used += take;
+    }
+    return used;
+}
+
+static int run(const char* label, const uint8_t* data, size_t size, compress_config_t* config) {
+    buffer_t packed = { SAFE_MALLOC(compress_bound(size) + 4096), 0, compress_bound(size) + 4096 };
+    buffer_t unpacked = { SAFE_MALLOC(size), 0, size };
+
+    double start = now_seconds();
+    compress_stream_t* z = compress_stream_create(config, append_chunk, &packed);
+    for (size_t off = 0; off < size; off += 64 * 1024) {
+        compress_stream_write(z, data + off, size - off < 64 * 1024 ? size - off : 64 * 1024);
+    }
+    int ok = compress_stream_finish(z) == 0;
+    compress_stream_destroy(z);
+    double packing = now_seconds() - start;
+
+    start = now_seconds();
+    decompress_stream_t* u = decompress_stream_create(config, append_chunk, &unpacked);
+    for (size_t off = 0; off < packed.size; off += 64 * 1024) {
+        decompress_stream_write(u, packed.data + off, packed.size - off < 64 * 1024 ? packed.size - off : 64 * 1024);
+    }
+    ok = ok && decompress_stream_finish(u) == 0;
+    decompress_stream_destroy(u);
+    double unpacking = now_seconds() - start;
+
+    ok = ok && unpacked.size == size && memcmp(unpacked.data, data, size) == 0;
+    printf("%-22s ratio %5.2f  compress %6.0f MB/s  decompress %6.0f MB/s  %s\n", label,
+           (double)size / packed.size, size / packing / 1e6, size / unpacking / 1e6, ok ? "ok" : "MISMATCH");
+    free(packed.data);
+    free(unpacked.data);
+    return ok;
+}
+
+int main() {
+    uint8_t* data = SAFE_MALLOC(BYTES);
+    size_t size = make_log(data, BYTES);
+    printf("input: %zu MB of log lines\n", size >> 20);
+
+    /* What appending the raw bytes would cost, for comparison with the sinks below. */
+    uint8_t* copy = SAFE_MALLOC(size);
+    memset(copy, 0, size);
+    double start = now_seconds();
+    memcpy(copy, data, size);
+    double copying = now_seconds() - start;
+    printf("%-22s %46.0f MB/s  (%d)\n", "memcpy", size / copying / 1e6, copy[size / 2] != 0);
+    free(copy);
+
+    /* The codec alone: every block compressed into, and decoded from, one cache-resident buffer. */
+    size_t block = COMPRESS_BLOCK_SIZE;
+    compress_tables_t* tables = SAFE_MALLOC(sizeof(compress_tables_t));
+    uint8_t* packed = SAFE_MALLOC(compress_bound(block));
+    uint8_t* unpacked = SAFE_MALLOC(block);
+    double packing = 0, unpacking = 0;
+    size_t packed_total = 0;
+    int codec_ok = 1;
+    for (size_t off = 0; off + block <= size; off += block) {
+        start = now_seconds();
+        size_t n = compress_block_with(tables, data + off, block, packed, compress_bound(block), 1);
+        packing += now_seconds() - start;
+        start = now_seconds();
+        codec_ok &= decompress_block(packed, n, unpacked, block) == 0;
+        unpacking += now_seconds() - start;
+        codec_ok &= memcmp(unpacked, data + off, block) == 0;
+        packed_total += n;
+    }
+    printf("%-22s ratio %5.2f  compress %6.0f MB/s  decompress %6.0f MB/s  %s\n", "block codec, level 1",
+           (double)(size / block * block) / packed_total, size / block * block / packing / 1e6,
+           size / block * block / unpacking / 1e6, codec_ok ? "ok" : "MISMATCH");
+    free(tables);
+    free(packed);
+    free(unpacked);
+
+    compress_config_t fast = { .level = 1 };
+    compress_config_t strong = { .level = 6 };
+    run("level 1, 1 thread", data, size, &fast);
+    run("level 6, 1 thread", data, size, &strong);
+
+    numa_pool_t* pool = numa_pool_create(0);
+    compress_config_t parallel = { .level = 1, .pool = pool };
+    char label[64];
+    snprintf(label, sizeof(label), "level 1, %zu workers", pool->worker_count);
+    run(label, data, size, &parallel);
+    numa_pool_destroy(pool);
+
+    free(data);
+    return 0;
+}
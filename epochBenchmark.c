@@ -0,0 +1,140 @@
+// reads a shared configuration that a writer keeps replacing, under a reader-writer lock and with epoch reclamation
+
+#include "lambda_epoch.h"
+
+#ifndef READERS
+#define READERS 4
+#endif
+#ifndef READS
+#define READS (4u * 1000u * 1000u)
+#endif
+
+/* The writer publishes a new configuration every UPDATE_EVERY_US microseconds. */
+#define UPDATE_EVERY_US 100
+#define CHECK_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    uint64_t version;
+    uint64_t check;
+} config_t;
+
+static config_t* config_new(uint64_t version) {
+    config_t* config = SAFE_MALLOC(sizeof(config_t));
+    config->version = version;
+    config->check = version * CHECK_MULTIPLIER;
+    return config;
+}
+
+static _Atomic(config_t*) shared;
+static atomic_int writer_done;
+static atomic_ullong torn_reads;
+static atomic_ullong updates;
+
+/********************* Baseline: reader-writer lock ***************************/
+
+static pthread_rwlock_t shared_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void* rwlock_reader(void* arg) {
+    (void)arg;
+    uint64_t torn = 0;
+    for (uint32_t i = 0; i < READS; i++) {
+        pthread_rwlock_rdlock(&shared_lock);
+        config_t* config = atomic_load_explicit(&shared, memory_order_relaxed);
+        torn += config->check != config->version * CHECK_MULTIPLIER;
+        pthread_rwlock_unlock(&shared_lock);
+    }
+    atomic_fetch_add(&torn_reads, torn);
+    return NULL;
+}
+
+static void* rwlock_writer(void* arg) {
+    (void)arg;
+    uint64_t version = 1;
+    while (!atomic_load(&writer_done)) {
+        config_t* next = config_new(++version);
+        pthread_rwlock_wrlock(&shared_lock);
+        config_t* old = atomic_exchange_explicit(&shared, next, memory_order_relaxed);
+        pthread_rwlock_unlock(&shared_lock);
+        free(old);
+        atomic_fetch_add(&updates, 1);
+        usleep(UPDATE_EVERY_US);
+    }
+    return NULL;
+}
+
+/********************* Epoch reclamation ***************************/
+
+static epoch_domain_t* domain;
+
+static void* epoch_reader(void* arg) {
+    (void)arg;
+    epoch_record_t* rec = epoch_register(domain);
+    uint64_t torn = 0;
+    for (uint32_t i = 0; i < READS; i++) {
+        epoch_enter(rec);
+        config_t* config = atomic_load_explicit(&shared, memory_order_acquire);
+        torn += config->check != config->version * CHECK_MULTIPLIER;
+        epoch_exit(rec);
+    }
+    epoch_unregister(rec);
+    atomic_fetch_add(&torn_reads, torn);
+    return NULL;
+}
+
+static void* epoch_writer(void* arg) {
+    (void)arg;
+    epoch_record_t* rec = epoch_register(domain);
+    uint64_t version = 1;
+    while (!atomic_load(&writer_done)) {
+        config_t* old = atomic_exchange_explicit(&shared, config_new(++version), memory_order_acq_rel);
+        EPOCH_SAFE_FREE(rec, old);
+        atomic_fetch_add(&updates, 1);
+        usleep(UPDATE_EVERY_US);
+    }
+    epoch_unregister(rec);
+    return NULL;
+}
+
+/********************* Driver ***************************/
+
+static void run(const char* name, void* (*reader)(void*), void* (*writer)(void*)) {
+    pthread_t readers[READERS];
+    pthread_t writer_thread;
+    atomic_store(&shared, config_new(1));
+    atomic_store(&writer_done, 0);
+    atomic_store(&torn_reads, 0);
+    atomic_store(&updates, 0);
+
+    double start = now_seconds();
+    pthread_create(&writer_thread, NULL, writer, NULL);
+    for (int i = 0; i < READERS; i++) {
+        pthread_create(&readers[i], NULL, reader, NULL);
+    }
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    atomic_store(&writer_done, 1);
+    pthread_join(writer_thread, NULL);
+
+    uint64_t torn = atomic_load(&torn_reads);
+    printf("%-14s %d readers: %6.1f ns per read, %6llu updates, %s\n", name, READERS,
+           elapsed * 1e9 / ((double)READS * READERS), (unsigned long long)atomic_load(&updates),
+           torn ? "MISMATCH" : "ok");
+    free(atomic_exchange(&shared, NULL));
+}
+
+int main() {
+    run("rwlock:", rwlock_reader, rwlock_writer);
+
+    domain = epoch_domain_create(1, 64);
+    run("epoch:", epoch_reader, epoch_writer);
+    epoch_domain_destroy(domain);
+    return 0;
+}
@@ -0,0 +1,134 @@
+// shows use case of lambdas as event loop callbacks (unix socket echo server with a timer)
+
+#include "lambda_event.h"
+
+#define SOCKET_PATH "/tmp/lambda_event_demo.sock"
+
+// Per-connection echo state: bytes read but not yet written back
+typedef struct {
+    char buf[4096];
+    size_t offset;
+    size_t length;
+} echo_conn_t;
+
+Lambda(echo_accept, h,
+    event_handler_t* handler = (event_handler_t*)h;
+    echo_conn_t* conn = SAFE_MALLOC(sizeof(echo_conn_t));
+    conn->offset = conn->length = 0;
+    handler->arg = conn;
+    return NULL;
+);
+
+static void echo_close(event_handler_t* handler) {
+    free(handler->arg);
+    handler->arg = NULL;
+    event_loop_remove(handler->loop, handler, 1);
+}
+
+// Writes what is pending: 1 when all of it went out, 0 when the socket is full, -1 on error
+static int echo_flush(event_handler_t* handler) {
+    echo_conn_t* conn = (echo_conn_t*)handler->arg;
+    while (conn->offset < conn->length) {
+        ssize_t n = write(handler->fd, conn->buf + conn->offset, conn->length - conn->offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN ? 0 : -1;
+        }
+        conn->offset += (size_t)n;
+    }
+    conn->offset = conn->length = 0;
+    return 1;
+}
+
+// Echo everything a client sends until it hangs up; a short write parks the rest until EPOLLOUT
+Lambda(echo_read, h,
+    event_handler_t* handler = (event_handler_t*)h;
+    echo_conn_t* conn = (echo_conn_t*)handler->arg;
+    if (conn->length) {
+        return NULL;
+    }
+    ssize_t n;
+    while ((n = read(handler->fd, conn->buf, sizeof(conn->buf))) > 0) {
+        conn->length = (size_t)n;
+        int flushed = echo_flush(handler);
+        if (flushed < 0) {
+            echo_close(handler);
+            return NULL;
+        }
+        if (flushed == 0) {
+            event_loop_modify(handler->loop, handler, EVENT_READ | EVENT_WRITE);
+            return NULL;
+        }
+    }
+    if (n == 0 || (n < 0 && errno != EAGAIN)) {
+        echo_close(handler);
+    }
+    return NULL;
+);
+
+// The socket drained: send the parked bytes, then go back to reading
+Lambda(echo_write, h,
+    event_handler_t* handler = (event_handler_t*)h;
+    int flushed = echo_flush(handler);
+    if (flushed < 0) {
+        echo_close(handler);
+    } else if (flushed > 0) {
+        event_loop_modify(handler->loop, handler, EVENT_READ);
+        echo_read(handler);
+    }
+    return NULL;
+);
+
+// Print the echoed reply
+Lambda(client_read, h,
+    event_handler_t* handler = (event_handler_t*)h;
+    char buf[64];
+    ssize_t n = read(handler->fd, buf, sizeof(buf) - 1);
+    if (n > 0) {
+        buf[n] = '\0';
+        printf("echoed: %s\n", buf);
+    }
+    return NULL;
+);
+
+// Periodic timer, stops the loop on its third tick
+Lambda(tick, h,
+    event_handler_t* handler = (event_handler_t*)h;
+    if (++*(int*)handler->arg == 3) {
+        event_loop_stop(handler->loop);
+    }
+    return NULL;
+);
+
+int main() {
+    event_loop_t* loop = event_loop_create();
+
+    int listen_fd = event_listen_unix(SOCKET_PATH);
+    HANDLE_NETWORK_STATUS(listen_fd, "Failed to listen on unix socket");
+    event_loop_add_listener(loop, listen_fd, echo_read, echo_write, echo_accept, NULL);
+
+    int ticks = 0;
+    event_loop_add_timer(loop, 10, 10, tick, &ticks);
+
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH);
+    HANDLE_NETWORK_STATUS(connect(client, (struct sockaddr*)&addr, sizeof(addr)), "Failed to connect");
+    HANDLE_NETWORK_STATUS(write(client, "Hello Lambda", 12), "Failed to send");
+    event_handler_t* client_handler = event_loop_add(loop, client, EVENT_READ, client_read, NULL, NULL);
+
+    event_loop_run(loop);
+    printf("timer ticks: %d\n", ticks);
+
+    // Hang up and let the server side see it and release its connection
+    event_loop_remove(loop, client_handler, 1);
+    event_loop_run_once(loop, 100);
+
+    event_loop_destroy(loop);
+    unlink(SOCKET_PATH);
+    return 0;
+}
@@ -0,0 +1,82 @@
+// stores the hostname of every log event as a fresh strdup copy and as an interned ID, then filters by host
+
+#include "lambda_intern.h"
+#include <malloc.h>
+#include <time.h>
+
+#ifndef EVENTS
+#define EVENTS (10u * 1000u * 1000u)
+#endif
+
+#define HOSTS 4000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The string-producing lambda of the pipeline: formats the host of an event. */
+Lambda(host_of, arg,
+    uint32_t event = *(uint32_t*)arg;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "node-%04u.cluster.example.com", (event * 2654435761u) % HOSTS);
+    return SAFE_STRDUP(buf);
+);
+
+int main() {
+    printf("events: %u, distinct hosts: %u\n", EVENTS, HOSTS);
+    const char* wanted = "node-0042.cluster.example.com";
+
+    /* Baseline: keep every lambda result. */
+    double start = now_seconds();
+    char** copies = SAFE_MALLOC(EVENTS * sizeof(char*));
+    size_t copy_bytes = EVENTS * sizeof(char*);
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        copies[i] = host_of(&i);
+        copy_bytes += malloc_usable_size(copies[i]);
+    }
+    double copy_build = now_seconds() - start;
+    start = now_seconds();
+    size_t copy_hits = 0;
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        copy_hits += strcmp(copies[i], wanted) == 0;
+    }
+    double copy_filter = now_seconds() - start;
+
+    /* Interned: the same lambda results, reduced to an ID each. */
+    start = now_seconds();
+    intern_table_t* hosts = intern_create(HOSTS);
+    uint32_t* ids = SAFE_MALLOC(EVENTS * sizeof(uint32_t));
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        ids[i] = intern_take(hosts, host_of(&i)).id;
+    }
+    double intern_build = now_seconds() - start;
+    start = now_seconds();
+    uint32_t wanted_id = intern_find(hosts, wanted, strlen(wanted)).id;
+    size_t intern_hits = 0;
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        intern_hits += ids[i] == wanted_id;
+    }
+    double intern_filter = now_seconds() - start;
+
+    intern_stats_t stats;
+    intern_stats(hosts, &stats);
+    size_t intern_bytes_used = stats.total_bytes + EVENTS * sizeof(uint32_t);
+    printf("strdup per event: build %.3f s, filter %.3f s, %.1f MB\n", copy_build, copy_filter, copy_bytes / 1e6);
+    printf("interned:         build %.3f s, filter %.3f s, %.1f MB (%.1f MB of it the ID column)  %s\n",
+           intern_build, intern_filter, intern_bytes_used / 1e6, EVENTS * sizeof(uint32_t) / 1e6,
+           intern_hits == copy_hits ? "ok" : "MISMATCH");
+    printf("string storage:   %zu bytes vs %zu bytes, %.0fx less; filter %.1fx faster\n",
+           stats.total_bytes, copy_bytes - EVENTS * sizeof(char*),
+           (double)(copy_bytes - EVENTS * sizeof(char*)) / stats.total_bytes, copy_filter / intern_filter);
+    intern_stats_print(hosts, stdout);
+
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        free(copies[i]);
+    }
+    free(copies);
+    free(ids);
+    intern_destroy(hosts);
+    return 0;
+}
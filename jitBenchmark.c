@@ -0,0 +1,56 @@
+// compares a compiled Lambda, the JIT tier and the bytecode VM on the same filter expression
+
+#include "lambda_jit.h"
+#include <time.h>
+
+#define ELEMENTS (16u * 1024u * 1024u)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Lambda(in_range, x, return (void*)(intptr_t)((intptr_t)x > 10 && (intptr_t)x < 500 ? (intptr_t)x * 3 : 0););
+
+int main() {
+    const char* expr = "x > 10 && x < 500 ? x * 3 : 0";
+    intptr_t* values = SAFE_MALLOC(ELEMENTS * sizeof(intptr_t));
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        values[i] = (intptr_t)(i % 1000);
+    }
+
+    double start = now_seconds();
+    jit_function_t* jf = jit_compile_expr(expr, "x", VM_INT);
+    double compile = now_seconds() - start;
+    if (!jf) {
+        LOG_ERROR(vm_last_error());
+        return 1;
+    }
+    printf("tier: %s, compile: %.1f us\n", jf->native ? "native" : "vm fallback", compile * 1e6);
+
+    intptr_t sums[3] = { 0, 0, 0 };
+    double times[3];
+    lambda_t fns[2] = { in_range, jf->fn };
+    for (int f = 0; f < 2; f++) {
+        start = now_seconds();
+        for (size_t i = 0; i < ELEMENTS; i++) {
+            sums[f] += (intptr_t)fns[f]((void*)values[i]);
+        }
+        times[f] = now_seconds() - start;
+    }
+    start = now_seconds();
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        sums[2] += (intptr_t)vm_eval_int(jf->prog, values[i]);
+    }
+    times[2] = now_seconds() - start;
+
+    printf("checksum: %s\n", sums[0] == sums[1] && sums[1] == sums[2] ? "ok" : "MISMATCH");
+    printf("compiled Lambda: %.2f ns/call\n", times[0] / ELEMENTS * 1e9);
+    printf("jit lambda_t:    %.2f ns/call\n", times[1] / ELEMENTS * 1e9);
+    printf("bytecode vm:     %.2f ns/call\n", times[2] / ELEMENTS * 1e9);
+
+    jit_free(jf);
+    free(values);
+    return 0;
+}
@@ -1,6 +1,10 @@
 #ifndef LAMBDA_H
 #define LAMBDA_H
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -104,6 +108,31 @@
  * HANDLE_INVALID_ARGUMENT(arg, msg): Handles invalid argument errors with a message.
  */
 
+/**
+ * Companion Headers:
+ *
+ * lambda_epoch.h: Epoch-based reclamation for lambda results shared across threads.
+ * lambda_lock.h: Adaptive, ticket and reader-writer locks with contention profiling.
+ * lambda_numa.h: NUMA-aware worker pool and node-local arrays for parallel lambda execution.
+ * lambda_event.h: epoll event loop dispatching lambdas on socket and timer readiness.
+ * lambda_timer.h: Hierarchical timer wheel for delayed and periodic lambdas.
+ * lambda_vm.h: Bytecode compiler and threaded VM for runtime lambda expressions (link with -lm).
+ * lambda_jit.h: x86-64 JIT tier turning runtime lambda expressions into native lambda_t functions (link with -lm).
+ * lambda_pipeline.h: Multi-stage threaded pipelines of lambdas over bounded SPSC/MPMC rings.
+ * lambda_sort.h: Comparator-specialized introsort, merge, radix and parallel sample sorts.
+ * lambda_isa.h: CPU feature detection and per-module SIMD kernel selection shared by lambda_text.h and lambda_select.h.
+ * lambda_text.h: SIMD text scanning kernels (find, count, split, lines, memmem) calling lambdas per token.
+ * lambda_batch.h: Columnar record batches with aligned per-field buffers, validity bitmaps and AoS conversion.
+ * lambda_groupby.h: Hash-partitioned parallel group-by aggregation with lambda extract/combine and disk spill.
+ * lambda_sketch.h: Mergeable, serializable HyperLogLog, Count-Min top-k and KLL quantile sketches as lambda accumulators.
+ * lambda_select.h: Packed selection bitsets for filter predicates, with SIMD AND/OR/NOT, popcount and in-place map/reduce.
+ * lambda_intern.h: Thread-safe string interning with arena storage, dense IDs and lock-free lookups.
+ * lambda_compress.h: LZ block compressor with checksummed frames, streamed through sink lambdas, optionally block-parallel.
+ * lambda_output.h: Buffered per-thread output writers flushed in the background with writev, plus printf-free number formatting.
+ * lambda_shard.h: Forked worker processes fed through shared-memory SPSC rings, sharded by key, with crash restart.
+ * lambda_snapshot.h: Versioned, checksummed mmap snapshots of DYNAMIC_ARRAY and string tables with copy-on-write promotion.
+ */
+
 
 
 
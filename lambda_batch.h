@@ -0,0 +1,643 @@
+#ifndef LAMBDA_BATCH_H
+#define LAMBDA_BATCH_H
+
+#include "lambda.h"
+#include <stddef.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_batch.h
+
+/**
+ * Record Batches:
+ *
+ * batch_create(capacity): Creates an empty batch with room for capacity rows.
+ * batch_add_column(batch, name, type): Adds a column and returns its index.
+ * batch_find_column(batch, name): Returns the index of a named column, or -1.
+ * batch_reserve(batch, capacity): Grows every column to hold at least capacity rows.
+ * batch_resize(batch, rows): Sets the row count; new rows are zero and valid.
+ * batch_append_rows(batch, count): Adds count rows and returns the index of the first.
+ * batch_destroy(batch): Frees the batch and all of its columns.
+ * BATCH_COLUMN(batch, index, type): Typed, 64-byte-aligned pointer to a column's values.
+ */
+
+/**
+ * Validity:
+ *
+ * batch_is_valid(batch, column, row): Returns 0 when the value is null.
+ * batch_set_null(batch, column, row) / batch_set_valid(batch, column, row): Changes a value's validity.
+ * batch_null_count(batch, column): Number of null values in a column.
+ */
+
+/**
+ * Evaluation:
+ *
+ * batch_for_each_chunk(batch, columns, column_count, chunk_rows, fn, ctx): Calls fn per chunk of the selected columns.
+ * BATCH_MAP(batch, out, out_type, in, in_type, x, expr): out[i] = expr for x = in[i].
+ * BATCH_MAP2(batch, out, out_type, in1, type1, x, in2, type2, y, expr): out[i] = expr for x = in1[i], y = in2[i].
+ * BATCH_REDUCE(batch, in, in_type, acc, init, x, expr): Folds the valid values of a column.
+ */
+
+/**
+ * Array-of-Structs Conversion:
+ *
+ * BATCH_FIELD(struct_type, field, type): Describes one struct field for conversion.
+ * batch_from_aos(records, count, stride, fields, field_count): Builds a batch from an array of structs.
+ * batch_to_aos(batch, records, stride, fields, field_count): Writes a batch back into an array of structs.
+ * BATCH_FROM_DYNAMIC_ARRAY(arr, fields): batch_from_aos over a DYNAMIC_ARRAY and a fields array.
+ * BATCH_TO_DYNAMIC_ARRAY(batch, arr, fields): Resizes a DYNAMIC_ARRAY and fills it from a batch.
+ */
+
+
+/**
+ * @file lambda_batch.h
+ * @brief Columnar (struct-of-arrays) record batches for field-wise lambda evaluation.
+ *
+ * A record_batch_t keeps each field in its own contiguous, 64-byte-aligned
+ * buffer, so a lambda that reads two fields of a twenty-field record only
+ * pulls those two fields through the cache. Nulls live in a per-column
+ * validity bitmap (bit set = valid, as in Arrow). The bitmap is only
+ * allocated once the column gets its first null, so columns without nulls
+ * cost nothing extra.
+ *
+ * Capacity is kept a multiple of 64 rows, so each chunk starts on a bitmap
+ * word and vector loops can run to the end of the last chunk without a
+ * scalar tail.
+ *
+ * ```
+ * typedef struct { int id; double price; int quantity; } order_t;
+ * static const batch_field_t order_fields[] = {
+ *     BATCH_FIELD(order_t, id, BATCH_INT32),
+ *     BATCH_FIELD(order_t, price, BATCH_DOUBLE),
+ *     BATCH_FIELD(order_t, quantity, BATCH_INT32),
+ * };
+ * record_batch_t* batch = BATCH_FROM_DYNAMIC_ARRAY(orders, order_fields);
+ * double revenue = BATCH_REDUCE(batch, 1, double, acc, 0.0, x, acc + x);
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+/** Alignment of column buffers and bitmaps; one cache line and a multiple of every vector width. */
+#define BATCH_ALIGNMENT 64
+
+/** Maximum number of columns handed to one batch_for_each_chunk lambda. */
+#define BATCH_MAX_CHUNK_COLUMNS 16
+
+/** Rows converted per block in AoS conversion, so a block of records stays cached across all fields. */
+#define BATCH_CONVERT_ROWS 256
+
+/** Default rows per chunk: a few KB per column, small enough to stay in L1/L2 across a lambda. */
+#define BATCH_DEFAULT_CHUNK_ROWS 1024
+
+typedef enum {
+    BATCH_INT8,
+    BATCH_INT16,
+    BATCH_INT32,
+    BATCH_INT64,
+    BATCH_FLOAT,
+    BATCH_DOUBLE,
+    BATCH_PTR
+} batch_type_t;
+
+static const size_t batch_type_width[] = { 1, 2, 4, 8, sizeof(float), sizeof(double), sizeof(void*) };
+
+typedef struct {
+    char* name;
+    batch_type_t type;
+    size_t width;
+    void* data;
+    uint64_t* validity;
+    size_t null_count;
+} batch_column_t;
+
+typedef struct {
+    batch_column_t* columns;
+    size_t column_count;
+    size_t column_capacity;
+    size_t rows;
+    size_t capacity;
+} record_batch_t;
+
+/**
+ * @brief The slice of a batch passed to a batch_for_each_chunk lambda.
+ *
+ * columns[k] points at row begin of the k-th selected column. validity[k] is
+ * the bitmap word holding that row, or NULL when the column has no nulls.
+ */
+typedef struct {
+    size_t begin;
+    size_t count;
+    size_t column_count;
+    void* columns[BATCH_MAX_CHUNK_COLUMNS];
+    const uint64_t* validity[BATCH_MAX_CHUNK_COLUMNS];
+    void* ctx;
+} batch_chunk_t;
+
+typedef struct {
+    const char* name;
+    batch_type_t type;
+    size_t offset;
+} batch_field_t;
+
+/********************* Allocation ***************************/
+
+static inline size_t batch_round_rows(size_t rows) {
+    return (rows + 63) & ~(size_t)63;
+}
+
+static inline void* batch_aligned_alloc(size_t size) {
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, BATCH_ALIGNMENT, size ? size : BATCH_ALIGNMENT) != 0) {
+        HANDLE_MEMORY_ERROR("Column allocation failed");
+    }
+    return ptr;
+}
+
+/* Moves used bytes into a new aligned buffer of new_size and fills the rest with fill. */
+static inline void* batch_aligned_grow(void* old, size_t used, size_t new_size, int fill) {
+    void* ptr = batch_aligned_alloc(new_size);
+    if (old) {
+        memcpy(ptr, old, used);
+        free(old);
+    }
+    memset((char*)ptr + used, fill, new_size - used);
+    return ptr;
+}
+
+/**
+ * @brief Creates an empty record batch with room for capacity rows.
+ *
+ * Example usage:
+ * ```
+ * record_batch_t* batch = batch_create(1 << 20);
+ * ```
+ */
+static inline record_batch_t* batch_create(size_t capacity) {
+    record_batch_t* batch = SAFE_MALLOC(sizeof(record_batch_t));
+    batch->columns = NULL;
+    batch->column_count = 0;
+    batch->column_capacity = 0;
+    batch->rows = 0;
+    batch->capacity = batch_round_rows(capacity ? capacity : 64);
+    return batch;
+}
+
+/**
+ * @brief Adds a column and returns its index. Values of existing rows are zero.
+ *
+ * Example usage:
+ * ```
+ * int price = batch_add_column(batch, "price", BATCH_DOUBLE);
+ * ```
+ */
+static inline int batch_add_column(record_batch_t* batch, const char* name, batch_type_t type) {
+    if (batch->column_count == batch->column_capacity) {
+        size_t capacity = batch->column_capacity ? batch->column_capacity * 2 : 8;
+        batch_column_t* columns = realloc(batch->columns, capacity * sizeof(batch_column_t));
+        if (!columns) {
+            HANDLE_MEMORY_ERROR("Column table allocation failed");
+        }
+        batch->columns = columns;
+        batch->column_capacity = capacity;
+    }
+    batch_column_t* column = &batch->columns[batch->column_count];
+    column->name = SAFE_STRDUP(name);
+    column->type = type;
+    column->width = batch_type_width[type];
+    column->data = batch_aligned_grow(NULL, 0, batch->capacity * column->width, 0);
+    column->validity = NULL;
+    column->null_count = 0;
+    return (int)batch->column_count++;
+}
+
+static inline int batch_find_column(const record_batch_t* batch, const char* name) {
+    for (size_t i = 0; i < batch->column_count; i++) {
+        if (strcmp(batch->columns[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Grows every column (and bitmap) to hold at least capacity rows.
+ */
+static inline void batch_reserve(record_batch_t* batch, size_t capacity) {
+    if (capacity <= batch->capacity) {
+        return;
+    }
+    size_t new_capacity = batch->capacity * 2;
+    if (new_capacity < capacity) {
+        new_capacity = batch_round_rows(capacity);
+    }
+    for (size_t i = 0; i < batch->column_count; i++) {
+        batch_column_t* column = &batch->columns[i];
+        column->data = batch_aligned_grow(column->data, batch->capacity * column->width,
+                                          new_capacity * column->width, 0);
+        if (column->validity) {
+            column->validity = batch_aligned_grow(column->validity, batch->capacity / 8, new_capacity / 8, 0xff);
+        }
+    }
+    batch->capacity = new_capacity;
+}
+
+/**
+ * @brief Sets the number of rows. Rows past the old count read as zero and valid.
+ *
+ * Example usage:
+ * ```
+ * batch_resize(batch, 0);   // reuse the buffers for the next batch
+ * ```
+ */
+static inline void batch_resize(record_batch_t* batch, size_t rows) {
+    batch_reserve(batch, rows);
+    for (size_t i = 0; i < batch->column_count; i++) {
+        batch_column_t* column = &batch->columns[i];
+        if (rows < batch->rows) {
+            memset((char*)column->data + rows * column->width, 0, (batch->rows - rows) * column->width);
+        }
+        if (column->validity) {
+            for (size_t row = rows; row < batch->rows; row++) {
+                uint64_t bit = 1ull << (row & 63);
+                if (!(column->validity[row >> 6] & bit)) {
+                    column->validity[row >> 6] |= bit;
+                    column->null_count--;
+                }
+            }
+        }
+    }
+    batch->rows = rows;
+}
+
+static inline size_t batch_append_rows(record_batch_t* batch, size_t count) {
+    size_t first = batch->rows;
+    batch_resize(batch, first + count);
+    return first;
+}
+
+static inline void batch_destroy(record_batch_t* batch) {
+    if (!batch) {
+        return;
+    }
+    for (size_t i = 0; i < batch->column_count; i++) {
+        SAFE_FREE(batch->columns[i].name);
+        SAFE_FREE(batch->columns[i].data);
+        SAFE_FREE(batch->columns[i].validity);
+    }
+    SAFE_FREE(batch->columns);
+    free(batch);
+}
+
+/**
+ * @brief Typed pointer to the values of column index, with its alignment known to the compiler.
+ *
+ * Example usage:
+ * ```
+ * double* price = BATCH_COLUMN(batch, price_col, double);
+ * ```
+ */
+#define BATCH_COLUMN(batch, index, type) \
+    ((type*)__builtin_assume_aligned((batch)->columns[(index)].data, BATCH_ALIGNMENT))
+
+/********************* Validity ***************************/
+
+static inline int batch_is_valid(const record_batch_t* batch, int column, size_t row) {
+    const uint64_t* validity = batch->columns[column].validity;
+    return !validity || ((validity[row >> 6] >> (row & 63)) & 1);
+}
+
+/**
+ * @brief Marks a value as null, allocating the column's bitmap on first use.
+ *
+ * Example usage:
+ * ```
+ * batch_set_null(batch, price_col, 42);
+ * ```
+ */
+static inline void batch_set_null(record_batch_t* batch, int column, size_t row) {
+    batch_column_t* col = &batch->columns[column];
+    if (!col->validity) {
+        col->validity = batch_aligned_grow(NULL, 0, batch->capacity / 8, 0xff);
+    }
+    uint64_t bit = 1ull << (row & 63);
+    if (col->validity[row >> 6] & bit) {
+        col->validity[row >> 6] &= ~bit;
+        col->null_count++;
+    }
+}
+
+static inline void batch_set_valid(record_batch_t* batch, int column, size_t row) {
+    batch_column_t* col = &batch->columns[column];
+    uint64_t bit = 1ull << (row & 63);
+    if (col->validity && !(col->validity[row >> 6] & bit)) {
+        col->validity[row >> 6] |= bit;
+        col->null_count--;
+    }
+}
+
+static inline size_t batch_null_count(const record_batch_t* batch, int column) {
+    return batch->columns[column].null_count;
+}
+
+/* Makes out's validity the AND of the inputs' (in2 may be -1). Columns with no nulls stay bitmap-free. */
+static inline void batch_propagate_validity(record_batch_t* batch, int out, int in1, int in2) {
+    batch_column_t* dst = &batch->columns[out];
+    const uint64_t* a = batch->columns[in1].validity;
+    const uint64_t* b = in2 >= 0 ? batch->columns[in2].validity : NULL;
+    if (!a && !b) {
+        SAFE_FREE(dst->validity);
+        dst->null_count = 0;
+        return;
+    }
+    if (!a) {
+        a = b;
+        b = NULL;
+    }
+    if (!dst->validity) {
+        dst->validity = batch_aligned_alloc(batch->capacity / 8);
+    }
+    size_t words = batch->capacity / 64;
+    size_t nulls = 0;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = b ? (a[w] & b[w]) : a[w];
+        dst->validity[w] = bits;
+        nulls += 64 - (size_t)__builtin_popcountll(bits);
+    }
+    /* Bits past rows are kept set, so they never count as nulls. */
+    dst->null_count = nulls;
+}
+
+/********************* Evaluation ***************************/
+
+/**
+ * @brief Calls fn with a batch_chunk_t for consecutive chunks of the selected columns.
+ *
+ * chunk_rows is rounded up to a multiple of 64 (0 selects
+ * BATCH_DEFAULT_CHUNK_ROWS). Only the selected columns are touched, which
+ * is where the columnar layout saves its memory traffic. A non-NULL return
+ * from fn stops the scan. Returns the number of rows visited.
+ *
+ * Example usage:
+ * ```
+ * Lambda(sum_revenue, arg,
+ *     batch_chunk_t* chunk = (batch_chunk_t*)arg;
+ *     const double* price = chunk->columns[0];
+ *     const int* quantity = chunk->columns[1];
+ *     double sum = 0;
+ *     for (size_t i = 0; i < chunk->count; i++) sum += price[i] * quantity[i];
+ *     *(double*)chunk->ctx += sum;
+ *     return NULL;
+ * );
+ * int cols[] = { price_col, quantity_col };
+ * double revenue = 0;
+ * batch_for_each_chunk(batch, cols, 2, 0, sum_revenue, &revenue);
+ * ```
+ */
+static inline size_t batch_for_each_chunk(const record_batch_t* batch, const int* columns, size_t column_count,
+                                          size_t chunk_rows, lambda_t fn, void* ctx) {
+    if (column_count > BATCH_MAX_CHUNK_COLUMNS) {
+        HANDLE_INVALID_ARGUMENT(column_count <= BATCH_MAX_CHUNK_COLUMNS, "Too many columns for one chunk");
+        return 0;
+    }
+    batch_chunk_t chunk;
+    chunk.column_count = column_count;
+    chunk.ctx = ctx;
+    chunk_rows = batch_round_rows(chunk_rows ? chunk_rows : BATCH_DEFAULT_CHUNK_ROWS);
+    for (size_t begin = 0; begin < batch->rows; begin += chunk_rows) {
+        chunk.begin = begin;
+        chunk.count = batch->rows - begin < chunk_rows ? batch->rows - begin : chunk_rows;
+        for (size_t k = 0; k < column_count; k++) {
+            const batch_column_t* column = &batch->columns[columns[k]];
+            chunk.columns[k] = (char*)column->data + begin * column->width;
+            chunk.validity[k] = column->validity ? column->validity + (begin >> 6) : NULL;
+        }
+        if (fn(&chunk)) {
+            return begin + chunk.count;
+        }
+    }
+    return batch->rows;
+}
+
+/**
+ * @brief Fills column out with expr evaluated for x = each value of column in.
+ *
+ * The loop is a plain indexed loop over two aligned arrays, so the compiler
+ * can vectorize it. expr is also evaluated on null slots, whose values are
+ * unspecified (batch_set_null() leaves the old value in place), so expr
+ * must be safe for any value of its type. The output has the same nulls
+ * as the input.
+ *
+ * Example usage:
+ * ```
+ * BATCH_MAP(batch, tax_col, double, price_col, double, x, x * 0.2);
+ * ```
+ */
+#define BATCH_MAP(batch, out, out_type, in, in_type, x, expr) \
+    do { \
+        record_batch_t* batch_map_ = (batch); \
+        out_type* batch_dst_ = BATCH_COLUMN(batch_map_, (out), out_type); \
+        const in_type* batch_src_ = BATCH_COLUMN(batch_map_, (in), in_type); \
+        size_t batch_rows_ = batch_map_->rows; \
+        for (size_t batch_i_ = 0; batch_i_ < batch_rows_; batch_i_++) { \
+            in_type x = batch_src_[batch_i_]; \
+            batch_dst_[batch_i_] = (out_type)(expr); \
+        } \
+        batch_propagate_validity(batch_map_, (out), (in), -1); \
+    } while (0)
+
+/**
+ * @brief Fills column out with expr of x and y taken from two input columns. A row is null if either input is.
+ *
+ * Example usage:
+ * ```
+ * BATCH_MAP2(batch, total_col, double, price_col, double, p, quantity_col, int, q, p * q);
+ * ```
+ */
+#define BATCH_MAP2(batch, out, out_type, in1, type1, x, in2, type2, y, expr) \
+    do { \
+        record_batch_t* batch_map_ = (batch); \
+        out_type* batch_dst_ = BATCH_COLUMN(batch_map_, (out), out_type); \
+        const type1* batch_src1_ = BATCH_COLUMN(batch_map_, (in1), type1); \
+        const type2* batch_src2_ = BATCH_COLUMN(batch_map_, (in2), type2); \
+        size_t batch_rows_ = batch_map_->rows; \
+        for (size_t batch_i_ = 0; batch_i_ < batch_rows_; batch_i_++) { \
+            type1 x = batch_src1_[batch_i_]; \
+            type2 y = batch_src2_[batch_i_]; \
+            batch_dst_[batch_i_] = (out_type)(expr); \
+        } \
+        batch_propagate_validity(batch_map_, (out), (in1), (in2)); \
+    } while (0)
+
+/**
+ * @brief Folds the valid values of column in: acc starts at init and becomes expr for each x.
+ *
+ * The type of init sets the type of acc. Without nulls the loop reads only
+ * the value array; with nulls it also reads one bitmap word per 64 rows.
+ *
+ * Example usage:
+ * ```
+ * double total = BATCH_REDUCE(batch, price_col, double, acc, 0.0, x, acc + x);
+ * int64_t big = BATCH_REDUCE(batch, quantity_col, int, n, (int64_t)0, q, n + (q > 100));
+ * ```
+ */
+#define BATCH_REDUCE(batch, in, in_type, acc, init, x, expr) \
+    ({ \
+        const record_batch_t* batch_red_ = (batch); \
+        const in_type* batch_src_ = BATCH_COLUMN(batch_red_, (in), in_type); \
+        const uint64_t* batch_valid_ = batch_red_->columns[(in)].validity; \
+        size_t batch_rows_ = batch_red_->rows; \
+        __typeof__(init) acc = (init); \
+        if (!batch_valid_) { \
+            for (size_t batch_i_ = 0; batch_i_ < batch_rows_; batch_i_++) { \
+                in_type x = batch_src_[batch_i_]; \
+                acc = (expr); \
+            } \
+        } else { \
+            for (size_t batch_i_ = 0; batch_i_ < batch_rows_; batch_i_++) { \
+                if ((batch_valid_[batch_i_ >> 6] >> (batch_i_ & 63)) & 1) { \
+                    in_type x = batch_src_[batch_i_]; \
+                    acc = (expr); \
+                } \
+            } \
+        } \
+        acc; \
+    })
+
+/********************* Array-of-Structs Conversion ***************************/
+
+/**
+ * @brief Describes a struct field by name, column type and offset.
+ *
+ * Example usage:
+ * ```
+ * static const batch_field_t order_fields[] = {
+ *     BATCH_FIELD(order_t, price, BATCH_DOUBLE),
+ *     BATCH_FIELD(order_t, quantity, BATCH_INT32),
+ * };
+ * ```
+ */
+#define BATCH_FIELD(struct_type, field, type) \
+    { #field, (type), offsetof(struct_type, field) }
+
+/* Strided copy specialised by width so each element is one load and one store. */
+static inline void batch_strided_copy(char* dst, size_t dst_stride, const char* src, size_t src_stride,
+                                      size_t count, size_t width) {
+#define BATCH_STRIDED_COPY(type) \
+    for (size_t i = 0; i < count; i++) { \
+        type v; \
+        memcpy(&v, src + i * src_stride, sizeof(type)); \
+        memcpy(dst + i * dst_stride, &v, sizeof(type)); \
+    }
+    switch (width) {
+    case 1: BATCH_STRIDED_COPY(uint8_t) break;
+    case 2: BATCH_STRIDED_COPY(uint16_t) break;
+    case 4: BATCH_STRIDED_COPY(uint32_t) break;
+    case 8: BATCH_STRIDED_COPY(uint64_t) break;
+    default:
+        for (size_t i = 0; i < count; i++) {
+            memcpy(dst + i * dst_stride, src + i * src_stride, width);
+        }
+    }
+#undef BATCH_STRIDED_COPY
+}
+
+/**
+ * @brief Builds a batch with one column per field from count structs of size stride.
+ *
+ * Rows are converted in blocks of BATCH_CONVERT_ROWS, so each record is
+ * read from memory once rather than once per field.
+ *
+ * Example usage:
+ * ```
+ * record_batch_t* batch = batch_from_aos(orders, count, sizeof(order_t), order_fields, 2);
+ * ```
+ */
+static inline record_batch_t* batch_from_aos(const void* records, size_t count, size_t stride,
+                                             const batch_field_t* fields, size_t field_count) {
+    record_batch_t* batch = batch_create(count);
+    for (size_t f = 0; f < field_count; f++) {
+        batch_add_column(batch, fields[f].name, fields[f].type);
+    }
+    batch->rows = count;
+    for (size_t begin = 0; begin < count; begin += BATCH_CONVERT_ROWS) {
+        size_t rows = count - begin < BATCH_CONVERT_ROWS ? count - begin : BATCH_CONVERT_ROWS;
+        const char* src = (const char*)records + begin * stride;
+        for (size_t f = 0; f < field_count; f++) {
+            batch_column_t* column = &batch->columns[f];
+            batch_strided_copy((char*)column->data + begin * column->width, column->width, src + fields[f].offset,
+                               stride, rows, column->width);
+        }
+    }
+    return batch;
+}
+
+/**
+ * @brief Writes the batch's rows into records, matching fields to columns by name.
+ *
+ * Null values are written as zero. Fields with no matching column are left untouched.
+ *
+ * Example usage:
+ * ```
+ * batch_to_aos(batch, orders, sizeof(order_t), order_fields, 2);
+ * ```
+ */
+static inline void batch_to_aos(const record_batch_t* batch, void* records, size_t stride,
+                                const batch_field_t* fields, size_t field_count) {
+    int* indexes = SAFE_MALLOC((field_count ? field_count : 1) * sizeof(int));
+    for (size_t f = 0; f < field_count; f++) {
+        indexes[f] = batch_find_column(batch, fields[f].name);
+        if (indexes[f] < 0) {
+            LOG_WARNING("Field has no matching column");
+        }
+    }
+    for (size_t begin = 0; begin < batch->rows; begin += BATCH_CONVERT_ROWS) {
+        size_t rows = batch->rows - begin < BATCH_CONVERT_ROWS ? batch->rows - begin : BATCH_CONVERT_ROWS;
+        char* dst = (char*)records + begin * stride;
+        for (size_t f = 0; f < field_count; f++) {
+            if (indexes[f] < 0) {
+                continue;
+            }
+            const batch_column_t* column = &batch->columns[indexes[f]];
+            batch_strided_copy(dst + fields[f].offset, stride, (const char*)column->data + begin * column->width,
+                               column->width, rows, column->width);
+            if (column->validity) {
+                for (size_t row = begin; row < begin + rows; row++) {
+                    if (!batch_is_valid(batch, indexes[f], row)) {
+                        memset((char*)records + row * stride + fields[f].offset, 0, column->width);
+                    }
+                }
+            }
+        }
+    }
+    SAFE_FREE(indexes);
+}
+
+/**
+ * @brief Converts between a DYNAMIC_ARRAY of structs and a record batch, given a static fields array.
+ *
+ * Example usage:
+ * ```
+ * record_batch_t* batch = BATCH_FROM_DYNAMIC_ARRAY(orders, order_fields);
+ * BATCH_TO_DYNAMIC_ARRAY(batch, orders, order_fields);
+ * ```
+ */
+#define BATCH_FROM_DYNAMIC_ARRAY(arr, fields) \
+    batch_from_aos((arr).array, (arr).size, sizeof((arr).array[0]), (fields), sizeof(fields) / sizeof((fields)[0]))
+
+#define BATCH_TO_DYNAMIC_ARRAY(batch, arr, fields) \
+    do { \
+        const record_batch_t* batch_src_ = (batch); \
+        if ((arr).capacity < batch_src_->rows) { \
+            void* batch_grown_ = realloc((arr).array, batch_src_->rows * sizeof((arr).array[0])); \
+            if (!batch_grown_) { \
+                HANDLE_MEMORY_ERROR("Dynamic array allocation failed"); \
+            } \
+            (arr).array = batch_grown_; \
+            (arr).capacity = batch_src_->rows; \
+        } \
+        (arr).size = batch_src_->rows; \
+        batch_to_aos(batch_src_, (arr).array, sizeof((arr).array[0]), (fields), sizeof(fields) / sizeof((fields)[0])); \
+    } while (0)
+
+
+#endif /* LAMBDA_BATCH_H */
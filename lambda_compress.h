@@ -0,0 +1,1006 @@
+#ifndef LAMBDA_COMPRESS_H
+#define LAMBDA_COMPRESS_H
+
+#include "lambda.h"
+#include "lambda_numa.h"
+
+
+// summarized list of all of the macros and functions defined in the lambda_compress.h
+
+/**
+ * Block Codec:
+ *
+ * compress_bound(len): Worst-case compressed size of len bytes.
+ * compress_block(src, len, dst, cap, level): Compresses one block; returns the size, or 0 if it does not fit.
+ * decompress_block(src, len, dst, raw_len): Decodes one block of exactly raw_len bytes; returns 0 or -1.
+ * compress_checksum(data, len, seed): 32-bit checksum used by the frame format.
+ */
+
+/**
+ * Streaming Frames:
+ *
+ * compress_stream_create(config, sink, ctx): Compressor that hands framed output chunks to sink.
+ * compress_stream_write(stream, data, len): Compresses input as full blocks become available.
+ * compress_stream_finish(stream): Flushes the last block and writes the frame trailer.
+ * compress_stream_destroy(stream): Frees the compressor.
+ * decompress_stream_create(config, sink, ctx): Decompressor that hands decoded chunks to sink.
+ * decompress_stream_write(stream, data, len): Accepts compressed bytes in chunks of any size.
+ * decompress_stream_finish(stream): Checks that a complete frame was received.
+ * decompress_stream_destroy(stream): Frees the decompressor.
+ */
+
+
+/**
+ * @file lambda_compress.h
+ * @brief Dependency-free LZ block compression as a streaming stage between lambdas.
+ *
+ * The codec is in the LZ4 family. A sequence is a token byte holding two
+ * 4-bit lengths, then the literals, then a 16-bit match offset, with
+ * longer lengths continued in 255-valued bytes. Level 1 hashes 5 bytes
+ * into a small table of the latest position per hash. Levels 2 to 9
+ * hash 4 bytes into a larger table and follow a chain of earlier
+ * positions, 2^(level - 1) deep, trading speed for ratio. Literals and
+ * matches are copied in 16-byte chunks where there is room, so the
+ * copies become unaligned vector moves rather than byte loops.
+ *
+ * Streams cut their input into blocks of config.block_size bytes. Each
+ * block is framed with its sizes and a checksum of the raw bytes, and a
+ * block that does not shrink is stored verbatim. The frame ends with the
+ * total length and a checksum over all blocks. Output goes to a sink
+ * lambda one block at a time; a sink returning non-NULL aborts the
+ * stream. When config.pool is set, up to two blocks per worker are
+ * compressed or decompressed in parallel and still emitted in order.
+ *
+ * ```
+ * Lambda(to_file, arg,
+ *     compress_chunk_t* chunk = (compress_chunk_t*)arg;
+ *     return fwrite(chunk->data, 1, chunk->size, (FILE*)chunk->ctx) == chunk->size ? NULL : arg;
+ * );
+ * compress_stream_t* z = compress_stream_create(NULL, to_file, out);
+ * compress_stream_write(z, records, bytes);
+ * compress_stream_finish(z);
+ * compress_stream_destroy(z);
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+#define COMPRESS_MAGIC 0x504d434cu  /* "LCMP" */
+#define COMPRESS_VERSION 1
+#define COMPRESS_BLOCK_SIZE (1u << 20)
+#define COMPRESS_MIN_BLOCK_LOG 12
+#define COMPRESS_MAX_BLOCK_LOG 26
+
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_LAST_LITERALS 5
+#define COMPRESS_MATCH_LIMIT 12
+#define COMPRESS_MAX_OFFSET 65535
+#define COMPRESS_HASH_LOG 16
+#define COMPRESS_FAST_HASH_LOG 14
+#define COMPRESS_CHAIN_SIZE 65536
+
+/** Frame flag: blocks carry no checksum and the trailer no content checksum. */
+#define COMPRESS_NO_CHECKSUM 0x1
+
+/** Block header bit marking a block stored without compression. */
+#define COMPRESS_STORED 0x80000000u
+
+typedef struct {
+    int level;
+    size_t block_size;
+    int flags;
+    numa_pool_t* pool;
+} compress_config_t;
+
+/**
+ * @brief Argument of a sink lambda: one chunk of output, valid only during the call.
+ */
+typedef struct {
+    const void* data;
+    size_t size;
+    void* ctx;
+} compress_chunk_t;
+
+/**
+ * @brief Match finder tables: latest position per hash and the distance to the previous one per position.
+ */
+typedef struct {
+    uint32_t head[1u << COMPRESS_HASH_LOG];
+    uint16_t chain[COMPRESS_CHAIN_SIZE];
+} compress_tables_t;
+
+/**
+ * @brief One block in flight. src points either at the caller's data or at stage.
+ */
+typedef struct {
+    const uint8_t* src;
+    size_t src_len;
+    uint8_t* stage;
+    size_t staged;
+    uint8_t* out;
+    size_t out_len;
+    size_t raw_len;
+    uint32_t checksum;
+    int error;
+    compress_tables_t* tables;
+} compress_slot_t;
+
+typedef struct {
+    compress_config_t config;
+    lambda_t sink;
+    void* ctx;
+    int decompress;
+    int failed;
+    int header_done;
+    int finished;
+    size_t slot_count;
+    size_t pending;
+    compress_slot_t* slots;
+    uint64_t total;
+    uint32_t content;
+    uint8_t frame[24];
+    size_t frame_len;
+} compress_stream_t;
+
+typedef compress_stream_t decompress_stream_t;
+
+/********************* Checksum ***************************/
+
+#define COMPRESS_PRIME1 0x9e3779b1u
+#define COMPRESS_PRIME2 0x85ebca77u
+#define COMPRESS_PRIME3 0xc2b2ae3du
+#define COMPRESS_PRIME4 0x27d4eb2fu
+#define COMPRESS_PRIME5 0x165667b1u
+
+static inline uint32_t compress_rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t compress_read32(const void* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t compress_read64(const void* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline void compress_write32(void* p, uint32_t v) {
+    memcpy(p, &v, 4);
+}
+
+/**
+ * @brief 32-bit checksum (the XXH32 algorithm); runs at several GB/s with four independent lanes.
+ *
+ * Example usage:
+ * ```
+ * uint32_t sum = compress_checksum(block, len, 0);
+ * ```
+ */
+static inline uint32_t compress_checksum(const void* data, size_t len, uint32_t seed) {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + len;
+    uint32_t h;
+    if (len >= 16) {
+        uint32_t v1 = seed + COMPRESS_PRIME1 + COMPRESS_PRIME2;
+        uint32_t v2 = seed + COMPRESS_PRIME2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - COMPRESS_PRIME1;
+        while (p + 16 <= end) {
+            v1 = compress_rotl32(v1 + compress_read32(p) * COMPRESS_PRIME2, 13) * COMPRESS_PRIME1;
+            v2 = compress_rotl32(v2 + compress_read32(p + 4) * COMPRESS_PRIME2, 13) * COMPRESS_PRIME1;
+            v3 = compress_rotl32(v3 + compress_read32(p + 8) * COMPRESS_PRIME2, 13) * COMPRESS_PRIME1;
+            v4 = compress_rotl32(v4 + compress_read32(p + 12) * COMPRESS_PRIME2, 13) * COMPRESS_PRIME1;
+            p += 16;
+        }
+        h = compress_rotl32(v1, 1) + compress_rotl32(v2, 7) + compress_rotl32(v3, 12) + compress_rotl32(v4, 18);
+    } else {
+        h = seed + COMPRESS_PRIME5;
+    }
+    h += (uint32_t)len;
+    while (p + 4 <= end) {
+        h = compress_rotl32(h + compress_read32(p) * COMPRESS_PRIME3, 17) * COMPRESS_PRIME4;
+        p += 4;
+    }
+    while (p < end) {
+        h = compress_rotl32(h + *p++ * COMPRESS_PRIME5, 11) * COMPRESS_PRIME1;
+    }
+    h ^= h >> 15;
+    h *= COMPRESS_PRIME2;
+    h ^= h >> 13;
+    h *= COMPRESS_PRIME3;
+    h ^= h >> 16;
+    return h;
+}
+
+/********************* Block Codec ***************************/
+
+/* Copies len bytes in 16-byte chunks; may write up to 15 bytes past dst + len and read as far past src + len. */
+static inline void compress_wildcopy(uint8_t* dst, const uint8_t* src, size_t len) {
+    uint8_t* end = dst + len;
+    do {
+        memcpy(dst, src, 16);
+        dst += 16;
+        src += 16;
+    } while (dst < end);
+}
+
+static inline size_t compress_bound(size_t len) {
+    return len + len / 255 + 32;
+}
+
+static inline uint32_t compress_hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - COMPRESS_HASH_LOG);
+}
+
+/* Hash of the 5 bytes at p; needs 8 readable bytes. */
+static inline uint32_t compress_hash5(const uint8_t* p) {
+    return (uint32_t)(((compress_read64(p) << 24) * 889523592379ull) >> (64 - COMPRESS_FAST_HASH_LOG));
+}
+
+static inline size_t compress_match_length(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+    const uint8_t* start = a;
+    while (a + 8 <= limit) {
+        uint64_t diff = compress_read64(a) ^ compress_read64(b);
+        if (diff) {
+            return (size_t)(a - start) + (size_t)(__builtin_ctzll(diff) >> 3);
+        }
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return (size_t)(a - start);
+}
+
+static inline uint8_t* compress_put_length(uint8_t* op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/* Writes a literal run (and a match when match_len > 0); returns NULL if dst would overflow. */
+static inline uint8_t* compress_put_sequence(uint8_t* op, uint8_t* oend, const uint8_t* anchor, size_t lit,
+                                             const uint8_t* iend, size_t offset, size_t match_len) {
+    if ((size_t)(oend - op) < lit + lit / 255 + 16 + 3 + match_len / 255 + 1) {
+        return NULL;
+    }
+    uint8_t* token = op++;
+    *token = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+    if (lit >= 15) {
+        op = compress_put_length(op, lit - 15);
+    }
+    if (anchor + lit + 16 <= iend) {
+        compress_wildcopy(op, anchor, lit);
+    } else {
+        memcpy(op, anchor, lit);
+    }
+    op += lit;
+    if (match_len == 0) {
+        return op;
+    }
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    size_t ml = match_len - COMPRESS_MIN_MATCH;
+    *token |= (uint8_t)(ml >= 15 ? 15 : ml);
+    if (ml >= 15) {
+        op = compress_put_length(op, ml - 15);
+    }
+    return op;
+}
+
+static inline void compress_insert(compress_tables_t* t, const uint8_t* base, uint32_t pos) {
+    uint32_t h = compress_hash4(compress_read32(base + pos));
+    uint32_t delta = pos - t->head[h];
+    t->chain[pos & (COMPRESS_CHAIN_SIZE - 1)] = (uint16_t)(delta > COMPRESS_MAX_OFFSET ? 0 : delta);
+    t->head[h] = pos;
+}
+
+/**
+ * @brief Compresses one block with caller-provided match tables (about 384 KB, reusable).
+ */
+static inline size_t compress_block_with(compress_tables_t* t, const void* src, size_t len, void* dst,
+                                         size_t cap, int level) {
+    const uint8_t* base = (const uint8_t*)src;
+    const uint8_t* iend = base + len;
+    uint8_t* op = (uint8_t*)dst;
+    uint8_t* oend = op + cap;
+    const uint8_t* anchor = base;
+    if (len > UINT32_MAX) {
+        return 0;
+    }
+    if (len >= COMPRESS_MATCH_LIMIT + 1) {
+        int fast = level <= 1;
+        int depth = fast ? 1 : 1 << (level > 9 ? 8 : level - 1);
+        int skip_shift = fast ? 6 : 8;
+        const uint8_t* mflimit = iend - COMPRESS_MATCH_LIMIT;
+        const uint8_t* matchlimit = iend - COMPRESS_LAST_LITERALS;
+        const uint8_t* ip = base + 1;
+        size_t attempts = (size_t)1 << skip_shift;
+        memset(t->head, 0, sizeof(uint32_t) << (fast ? COMPRESS_FAST_HASH_LOG : COMPRESS_HASH_LOG));
+        if (!fast) {
+            memset(t->chain, 0, sizeof(t->chain));
+        }
+
+        while (ip < mflimit) {
+            uint32_t pos = (uint32_t)(ip - base);
+            uint32_t h = fast ? compress_hash5(ip) : compress_hash4(compress_read32(ip));
+            uint32_t candidate = t->head[h];
+            uint32_t delta = pos - candidate;
+            t->head[h] = pos;
+
+            size_t best_len = 0;
+            uint32_t best = 0;
+            if (fast) {
+                /* Level 1: only the latest position per hash, in a 64 KB table that stays in cache. */
+                if (delta <= COMPRESS_MAX_OFFSET && compress_read32(base + candidate) == compress_read32(ip)) {
+                    best = candidate;
+                    best_len = COMPRESS_MIN_MATCH + compress_match_length(ip + COMPRESS_MIN_MATCH,
+                                                                          base + candidate + COMPRESS_MIN_MATCH,
+                                                                          matchlimit);
+                }
+            } else {
+                t->chain[pos & (COMPRESS_CHAIN_SIZE - 1)] = (uint16_t)(delta > COMPRESS_MAX_OFFSET ? 0 : delta);
+                for (int probe = 0; probe < depth && delta != 0 && delta <= COMPRESS_MAX_OFFSET; probe++) {
+                    if (compress_read32(base + candidate) == compress_read32(ip)) {
+                        size_t ml = COMPRESS_MIN_MATCH + compress_match_length(ip + COMPRESS_MIN_MATCH,
+                                                                               base + candidate + COMPRESS_MIN_MATCH,
+                                                                               matchlimit);
+                        if (ml > best_len) {
+                            best_len = ml;
+                            best = candidate;
+                            if (ip + ml >= matchlimit) {
+                                break;
+                            }
+                        }
+                    }
+                    uint16_t step = t->chain[candidate & (COMPRESS_CHAIN_SIZE - 1)];
+                    if (step == 0) {
+                        break;
+                    }
+                    candidate -= step;
+                    delta = pos - candidate;
+                }
+            }
+
+            if (best_len < COMPRESS_MIN_MATCH) {
+                /* The step grows by one every 2^skip_shift misses, so incompressible runs are crossed quickly. */
+                ip += attempts++ >> skip_shift;
+                continue;
+            }
+            attempts = (size_t)1 << skip_shift;
+            const uint8_t* match = base + best;
+            while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                ip--;
+                match--;
+                best_len++;
+            }
+            op = compress_put_sequence(op, oend, anchor, (size_t)(ip - anchor), iend, (size_t)(ip - match), best_len);
+            if (!op) {
+                return 0;
+            }
+            const uint8_t* next = ip + best_len;
+            if (!fast) {
+                for (const uint8_t* p = ip + 1; p < next && p < mflimit; p++) {
+                    compress_insert(t, base, (uint32_t)(p - base));
+                }
+            } else if (next - 2 < mflimit) {
+                t->head[compress_hash5(next - 2)] = (uint32_t)(next - 2 - base);
+            }
+            ip = anchor = next;
+        }
+    }
+    op = compress_put_sequence(op, oend, anchor, (size_t)(iend - anchor), iend, 0, 0);
+    return op ? (size_t)(op - (uint8_t*)dst) : 0;
+}
+
+/**
+ * @brief Compresses len bytes into dst (compress_bound(len) bytes always suffice).
+ *
+ * Returns the compressed size, or 0 if the output does not fit in cap.
+ *
+ * Example usage:
+ * ```
+ * uint8_t* packed = SAFE_MALLOC(compress_bound(len));
+ * size_t packed_len = compress_block(data, len, packed, compress_bound(len), 1);
+ * ```
+ */
+static inline size_t compress_block(const void* src, size_t len, void* dst, size_t cap, int level) {
+    compress_tables_t* t = SAFE_MALLOC(sizeof(compress_tables_t));
+    size_t n = compress_block_with(t, src, len, dst, cap, level);
+    free(t);
+    return n;
+}
+
+static inline int decompress_read_length(const uint8_t** ip, const uint8_t* iend, size_t* len) {
+    uint8_t b;
+    do {
+        if (*ip >= iend) {
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+/**
+ * @brief Decodes a block produced by compress_block into exactly raw_len bytes of dst.
+ *
+ * Every length and offset is bounds-checked, so corrupt input returns -1
+ * instead of reading or writing out of range.
+ *
+ * Example usage:
+ * ```
+ * if (decompress_block(packed, packed_len, data, len) != 0) {
+ *     LOG_ERROR("Corrupt block");
+ * }
+ * ```
+ */
+static inline int decompress_block(const void* src, size_t len, void* dst, size_t raw_len) {
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* iend = ip + len;
+    uint8_t* op = (uint8_t*)dst;
+    uint8_t* ostart = op;
+    uint8_t* oend = op + raw_len;
+
+    while (ip < iend) {
+        unsigned token = *ip++;
+        size_t lit = token >> 4;
+        if (lit < 15 && (token & 15) < 15 && iend - ip >= 16 + 2 && oend - op >= 16 + 24) {
+            /* Short literals and a short match: fixed-size copies, no loops. */
+            memcpy(op, ip, 16);
+            op += lit;
+            ip += lit;
+            size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+            size_t ml = (token & 15) + COMPRESS_MIN_MATCH;
+            if (offset >= 16 && offset <= (size_t)(op - ostart) && ml <= (size_t)(oend - op) && ip + 2 < iend) {
+                const uint8_t* match = op - offset;
+                memcpy(op, match, 16);
+                memcpy(op + 16, match + 16, 8);
+                op += ml;
+                ip += 2;
+                continue;
+            }
+            ip -= lit;
+            op -= lit;
+        }
+        if (lit == 15 && decompress_read_length(&ip, iend, &lit) != 0) {
+            return -1;
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) {
+            return -1;
+        }
+        if (ip + lit + 16 <= iend && op + lit + 16 <= oend) {
+            compress_wildcopy(op, ip, lit);
+        } else {
+            memcpy(op, ip, lit);
+        }
+        ip += lit;
+        op += lit;
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t ml = token & 15;
+        if (ml == 15 && decompress_read_length(&ip, iend, &ml) != 0) {
+            return -1;
+        }
+        ml += COMPRESS_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - ostart) || ml > (size_t)(oend - op)) {
+            return -1;
+        }
+        const uint8_t* match = op - offset;
+        if (op + ml + 16 > oend) {
+            for (size_t i = 0; i < ml; i++) {
+                op[i] = match[i];
+            }
+        } else if (offset >= 16) {
+            compress_wildcopy(op, match, ml);
+        } else {
+            /* Short period: lay down one period multiple of at least 16 bytes, then copy from that far back. */
+            size_t period = offset * ((16 + offset - 1) / offset);
+            size_t head = ml < period ? ml : period;
+            for (size_t i = 0; i < head; i++) {
+                op[i] = match[i];
+            }
+            if (ml > head) {
+                compress_wildcopy(op + head, op + head - period, ml - head);
+            }
+        }
+        op += ml;
+    }
+    return op == oend ? 0 : -1;
+}
+
+/********************* Streams ***************************/
+
+static inline int compress_block_log(size_t block_size) {
+    int log = COMPRESS_MIN_BLOCK_LOG;
+    while (((size_t)1 << log) < block_size && log < COMPRESS_MAX_BLOCK_LOG) {
+        log++;
+    }
+    return log;
+}
+
+static inline void compress_stream_apply_config(compress_stream_t* s, const compress_config_t* config) {
+    if (config) {
+        s->config = *config;
+    }
+    if (s->config.level <= 0) {
+        s->config.level = 1;
+    }
+    s->config.block_size = (size_t)1 << compress_block_log(s->config.block_size ? s->config.block_size
+                                                                                   : COMPRESS_BLOCK_SIZE);
+}
+
+static inline void compress_stream_alloc_slots(compress_stream_t* s) {
+    s->slot_count = s->config.pool ? s->config.pool->worker_count * 2 : 1;
+    s->slots = SAFE_MALLOC(s->slot_count * sizeof(compress_slot_t));
+    memset(s->slots, 0, s->slot_count * sizeof(compress_slot_t));
+}
+
+static inline int compress_emit(compress_stream_t* s, const void* data, size_t size) {
+    compress_chunk_t chunk = { data, size, s->ctx };
+    if (size && s->sink(&chunk) != NULL) {
+        s->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+static inline void compress_content_add(compress_stream_t* s, uint32_t checksum, size_t raw_len) {
+    s->content = compress_rotl32((s->content ^ checksum) * COMPRESS_PRIME1, 13);
+    s->total += raw_len;
+}
+
+/**
+ * @brief Creates a streaming compressor. config may be NULL for level 1, 1 MB blocks, checksums and one thread.
+ *
+ * sink receives a compress_chunk_t* for every piece of the frame, in order.
+ *
+ * Example usage:
+ * ```
+ * compress_config_t config = { .level = 1, .pool = numa_pool_create(0) };
+ * compress_stream_t* z = compress_stream_create(&config, to_file, out);
+ * ```
+ */
+static inline compress_stream_t* compress_stream_create(const compress_config_t* config, lambda_t sink, void* ctx) {
+    compress_stream_t* s = SAFE_MALLOC(sizeof(compress_stream_t));
+    memset(s, 0, sizeof(compress_stream_t));
+    compress_stream_apply_config(s, config);
+    s->sink = sink;
+    s->ctx = ctx;
+    compress_stream_alloc_slots(s);
+    size_t out_cap = 8 + compress_bound(s->config.block_size) + 4;
+    for (size_t i = 0; i < s->slot_count; i++) {
+        s->slots[i].stage = SAFE_MALLOC(s->config.block_size);
+        s->slots[i].out = SAFE_MALLOC(out_cap);
+        s->slots[i].tables = SAFE_MALLOC(sizeof(compress_tables_t));
+    }
+    return s;
+}
+
+static inline void compress_slot_task(size_t task, void* ctx) {
+    compress_stream_t* s = (compress_stream_t*)ctx;
+    compress_slot_t* slot = &s->slots[task];
+    size_t cap = compress_bound(s->config.block_size);
+    size_t n = compress_block_with(slot->tables, slot->src, slot->src_len, slot->out + 8, cap, s->config.level);
+    uint32_t header = (uint32_t)n;
+    if (n == 0 || n >= slot->src_len) {
+        memcpy(slot->out + 8, slot->src, slot->src_len);
+        n = slot->src_len;
+        header = (uint32_t)n | COMPRESS_STORED;
+    }
+    compress_write32(slot->out, header);
+    compress_write32(slot->out + 4, (uint32_t)slot->src_len);
+    slot->out_len = 8 + n;
+    if (!(s->config.flags & COMPRESS_NO_CHECKSUM)) {
+        slot->checksum = compress_checksum(slot->src, slot->src_len, 0);
+        compress_write32(slot->out + slot->out_len, slot->checksum);
+        slot->out_len += 4;
+    }
+}
+
+/* Compresses and emits the first count pending blocks, then moves the rest to the front. */
+static inline int compress_flush_blocks(compress_stream_t* s, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    if (s->config.pool && count > 1) {
+        numa_pool_run(s->config.pool, count, compress_slot_task, s);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            compress_slot_task(i, s);
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        compress_content_add(s, s->slots[i].checksum, s->slots[i].src_len);
+        if (compress_emit(s, s->slots[i].out, s->slots[i].out_len) != 0) {
+            return -1;
+        }
+    }
+    for (size_t i = count; i < s->pending; i++) {
+        compress_slot_t moved = s->slots[i - count];
+        s->slots[i - count] = s->slots[i];
+        s->slots[i] = moved;
+    }
+    s->pending -= count;
+    return 0;
+}
+
+static inline int compress_stream_header(compress_stream_t* s) {
+    if (s->header_done) {
+        return 0;
+    }
+    uint8_t header[8];
+    compress_write32(header, COMPRESS_MAGIC);
+    header[4] = COMPRESS_VERSION;
+    header[5] = (uint8_t)(s->config.flags & COMPRESS_NO_CHECKSUM);
+    header[6] = (uint8_t)compress_block_log(s->config.block_size);
+    header[7] = 0;
+    s->header_done = 1;
+    return compress_emit(s, header, sizeof(header));
+}
+
+/**
+ * @brief Feeds len bytes to the compressor. Returns 0, or -1 once the sink has failed.
+ *
+ * Full blocks are compressed straight from data; only a trailing partial
+ * block is copied, to wait for the next write.
+ *
+ * Example usage:
+ * ```
+ * compress_stream_write(z, line, line_len);
+ * ```
+ */
+static inline int compress_stream_write(compress_stream_t* s, const void* data, size_t len) {
+    if (s->failed || s->finished || compress_stream_header(s) != 0) {
+        return -1;
+    }
+    const uint8_t* p = (const uint8_t*)data;
+    size_t block = s->config.block_size;
+    int borrowed = 0;
+    while (len > 0) {
+        compress_slot_t* open = s->pending ? &s->slots[s->pending - 1] : NULL;
+        if (open && open->src == open->stage && open->staged < block) {
+            size_t take = block - open->staged < len ? block - open->staged : len;
+            memcpy(open->stage + open->staged, p, take);
+            open->staged += take;
+            open->src_len = open->staged;
+            p += take;
+            len -= take;
+            continue;
+        }
+        if (s->pending == s->slot_count && compress_flush_blocks(s, s->pending) != 0) {
+            return -1;
+        }
+        compress_slot_t* slot = &s->slots[s->pending++];
+        if (len >= block) {
+            slot->src = p;
+            slot->src_len = block;
+            borrowed = 1;
+            p += block;
+            len -= block;
+        } else {
+            slot->src = slot->stage;
+            slot->staged = 0;
+            slot->src_len = 0;
+        }
+    }
+    if (s->pending == s->slot_count && s->slots[s->pending - 1].src_len == block) {
+        return compress_flush_blocks(s, s->pending);
+    }
+    if (borrowed) {
+        /* Blocks still point into data: finish them before returning, keeping a partial block staged. */
+        size_t full = s->pending;
+        if (full && s->slots[full - 1].src == s->slots[full - 1].stage && s->slots[full - 1].src_len < block) {
+            full--;
+        }
+        return compress_flush_blocks(s, full);
+    }
+    return 0;
+}
+
+/**
+ * @brief Compresses what is buffered and writes the trailer. Returns 0, or -1 if the sink failed.
+ */
+static inline int compress_stream_finish(compress_stream_t* s) {
+    if (s->failed || s->finished || compress_stream_header(s) != 0) {
+        return -1;
+    }
+    if (s->pending && s->slots[s->pending - 1].src_len == 0) {
+        s->pending--;
+    }
+    if (compress_flush_blocks(s, s->pending) != 0) {
+        return -1;
+    }
+    uint8_t trailer[16];
+    size_t n = 0;
+    compress_write32(trailer, 0);
+    n += 4;
+    memcpy(trailer + n, &s->total, 8);
+    n += 8;
+    if (!(s->config.flags & COMPRESS_NO_CHECKSUM)) {
+        compress_write32(trailer + n, s->content);
+        n += 4;
+    }
+    s->finished = 1;
+    return compress_emit(s, trailer, n);
+}
+
+static inline void compress_stream_destroy(compress_stream_t* s) {
+    if (!s) {
+        return;
+    }
+    for (size_t i = 0; i < s->slot_count; i++) {
+        free(s->slots[i].stage);
+        free(s->slots[i].out);
+        free(s->slots[i].tables);
+    }
+    free(s->slots);
+    free(s);
+}
+
+/********************* Decompression Streams ***************************/
+
+/**
+ * @brief Creates a streaming decompressor; config only supplies the pool and may be NULL.
+ *
+ * sink receives each decoded block as a compress_chunk_t*. Checksums are
+ * verified before a block reaches the sink.
+ *
+ * Example usage:
+ * ```
+ * decompress_stream_t* u = decompress_stream_create(NULL, consume, &state);
+ * ```
+ */
+static inline decompress_stream_t* decompress_stream_create(const compress_config_t* config, lambda_t sink,
+                                                            void* ctx) {
+    decompress_stream_t* s = SAFE_MALLOC(sizeof(decompress_stream_t));
+    memset(s, 0, sizeof(decompress_stream_t));
+    if (config) {
+        s->config.pool = config->pool;
+    }
+    s->decompress = 1;
+    s->sink = sink;
+    s->ctx = ctx;
+    compress_stream_alloc_slots(s);
+    return s;
+}
+
+static inline void decompress_slot_task(size_t task, void* ctx) {
+    decompress_stream_t* s = (decompress_stream_t*)ctx;
+    compress_slot_t* slot = &s->slots[task];
+    uint32_t header = compress_read32(slot->src);
+    size_t payload = header & ~COMPRESS_STORED;
+    const uint8_t* data = slot->src + 8;
+    slot->error = 0;
+    if (header & COMPRESS_STORED) {
+        memcpy(slot->out, data, slot->raw_len);
+    } else if (decompress_block(data, payload, slot->out, slot->raw_len) != 0) {
+        slot->error = 1;
+        return;
+    }
+    slot->checksum = 0;
+    if (!(s->config.flags & COMPRESS_NO_CHECKSUM)) {
+        slot->checksum = compress_checksum(slot->out, slot->raw_len, 0);
+        if (slot->checksum != compress_read32(data + payload)) {
+            slot->error = 1;
+        }
+    }
+}
+
+static inline int decompress_flush_blocks(decompress_stream_t* s) {
+    if (s->pending == 0) {
+        return 0;
+    }
+    if (s->config.pool && s->pending > 1) {
+        numa_pool_run(s->config.pool, s->pending, decompress_slot_task, s);
+    } else {
+        for (size_t i = 0; i < s->pending; i++) {
+            decompress_slot_task(i, s);
+        }
+    }
+    size_t count = s->pending;
+    s->pending = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (s->slots[i].error) {
+            LOG_ERROR("Corrupt compressed block");
+            s->failed = 1;
+            return -1;
+        }
+        compress_content_add(s, s->slots[i].checksum, s->slots[i].raw_len);
+        if (compress_emit(s, s->slots[i].out, s->slots[i].raw_len) != 0) {
+            return -1;
+        }
+    }
+    if (count < s->slot_count && s->slots[count].staged > 0) {
+        /* A block cut by the end of the last write waits in the next slot; it becomes the first one. */
+        compress_slot_t partial = s->slots[count];
+        s->slots[count] = s->slots[0];
+        s->slots[0] = partial;
+    }
+    return 0;
+}
+
+/* Collects up to need bytes of fixed-size frame fields into s->frame. Returns 1 once complete. */
+static inline int decompress_gather(decompress_stream_t* s, const uint8_t** p, size_t* len, size_t need) {
+    if (s->frame_len >= need) {
+        return 1;
+    }
+    size_t take = need - s->frame_len < *len ? need - s->frame_len : *len;
+    memcpy(s->frame + s->frame_len, *p, take);
+    s->frame_len += take;
+    *p += take;
+    *len -= take;
+    return s->frame_len == need;
+}
+
+static inline int decompress_fail(decompress_stream_t* s, const char* message) {
+    LOG_ERROR(message);
+    s->failed = 1;
+    return -1;
+}
+
+/**
+ * @brief Feeds compressed bytes, split anywhere. Returns 0, or -1 on corrupt input or a failed sink.
+ *
+ * Complete blocks are decoded straight from data; a block cut by the end
+ * of data is staged until the rest arrives.
+ *
+ * Example usage:
+ * ```
+ * while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+ *     if (decompress_stream_write(u, buf, n) != 0) break;
+ * }
+ * ```
+ */
+static inline int decompress_stream_write(decompress_stream_t* s, const void* data, size_t len) {
+    if (s->failed) {
+        return -1;
+    }
+    const uint8_t* p = (const uint8_t*)data;
+    int borrowed = 0;
+    while (len > 0) {
+        if (s->finished) {
+            return decompress_fail(s, "Data after the end of the compressed frame");
+        }
+        if (!s->header_done) {
+            if (!decompress_gather(s, &p, &len, 8)) {
+                break;
+            }
+            if (compress_read32(s->frame) != COMPRESS_MAGIC || s->frame[4] != COMPRESS_VERSION ||
+                s->frame[6] < COMPRESS_MIN_BLOCK_LOG || s->frame[6] > COMPRESS_MAX_BLOCK_LOG) {
+                return decompress_fail(s, "Not a compressed frame");
+            }
+            s->config.flags = s->frame[5] & COMPRESS_NO_CHECKSUM;
+            s->config.block_size = (size_t)1 << s->frame[6];
+            for (size_t i = 0; i < s->slot_count; i++) {
+                s->slots[i].stage = SAFE_MALLOC(8 + compress_bound(s->config.block_size) + 4);
+                s->slots[i].out = SAFE_MALLOC(s->config.block_size);
+            }
+            s->header_done = 1;
+            s->frame_len = 0;
+            continue;
+        }
+
+        compress_slot_t* slot = &s->slots[s->pending];
+        size_t checksum_len = (s->config.flags & COMPRESS_NO_CHECKSUM) ? 0 : 4;
+        if (slot->staged == 0 && (s->frame_len < 8 || compress_read32(s->frame) == 0)) {
+            /* Block header, or the 0 marker that starts the trailer. */
+            if (!decompress_gather(s, &p, &len, 4)) {
+                break;
+            }
+            if (compress_read32(s->frame) == 0) {
+                if (!decompress_gather(s, &p, &len, 12 + checksum_len)) {
+                    break;
+                }
+                if (decompress_flush_blocks(s) != 0) {
+                    return -1;
+                }
+                uint64_t total;
+                memcpy(&total, s->frame + 4, 8);
+                if (total != s->total || (checksum_len && compress_read32(s->frame + 12) != s->content)) {
+                    return decompress_fail(s, "Compressed frame checksum mismatch");
+                }
+                s->finished = 1;
+                continue;
+            }
+            if (!decompress_gather(s, &p, &len, 8)) {
+                break;
+            }
+        }
+
+        uint32_t header = compress_read32(s->frame);
+        size_t payload = header & ~COMPRESS_STORED;
+        size_t raw_len = compress_read32(s->frame + 4);
+        if (raw_len == 0 || raw_len > s->config.block_size || payload > compress_bound(s->config.block_size) ||
+            ((header & COMPRESS_STORED) && payload != raw_len)) {
+            return decompress_fail(s, "Corrupt compressed block header");
+        }
+        size_t record = 8 + payload + checksum_len;
+        if (slot->staged == 0 && len >= record - 8) {
+            /* The whole block is in data; decode it in place if its header is there too. */
+            if (p >= (const uint8_t*)data + 8) {
+                slot->src = p - 8;
+                borrowed = 1;
+            } else {
+                memcpy(slot->stage, s->frame, 8);
+                memcpy(slot->stage + 8, p, record - 8);
+                slot->src = slot->stage;
+            }
+            p += record - 8;
+            len -= record - 8;
+        } else {
+            if (slot->staged == 0) {
+                memcpy(slot->stage, s->frame, 8);
+                slot->staged = 8;
+            }
+            size_t take = record - slot->staged < len ? record - slot->staged : len;
+            memcpy(slot->stage + slot->staged, p, take);
+            slot->staged += take;
+            p += take;
+            len -= take;
+            if (slot->staged < record) {
+                break;
+            }
+            slot->src = slot->stage;
+        }
+        slot->staged = 0;
+        slot->raw_len = raw_len;
+        s->frame_len = 0;
+        s->pending++;
+        if (s->pending == s->slot_count && decompress_flush_blocks(s) != 0) {
+            return -1;
+        }
+    }
+    if (borrowed) {
+        return decompress_flush_blocks(s);
+    }
+    return 0;
+}
+
+/**
+ * @brief Decodes what is pending and checks that the trailer was seen. Returns 0, or -1 for a truncated frame.
+ */
+static inline int decompress_stream_finish(decompress_stream_t* s) {
+    if (s->failed) {
+        return -1;
+    }
+    if (decompress_flush_blocks(s) != 0) {
+        return -1;
+    }
+    if (!s->finished) {
+        return decompress_fail(s, "Compressed frame is truncated");
+    }
+    return 0;
+}
+
+static inline void decompress_stream_destroy(decompress_stream_t* s) {
+    if (!s) {
+        return;
+    }
+    for (size_t i = 0; i < s->slot_count; i++) {
+        free(s->slots[i].stage);
+        free(s->slots[i].out);
+    }
+    free(s->slots);
+    free(s);
+}
+
+
+#endif /* LAMBDA_COMPRESS_H */
@@ -0,0 +1,481 @@
+#ifndef LAMBDA_EPOCH_H
+#define LAMBDA_EPOCH_H
+
+#include "lambda.h"
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/membarrier.h>
+#endif
+
+
+// summarized list of all of the macros and functions defined in the lambda_epoch.h
+
+/**
+ * Epoch-Based Reclamation:
+ *
+ * epoch_domain_create(interval_ms, batch): Creates a domain with a background reclaimer thread.
+ * epoch_domain_destroy(domain): Stops the reclaimer and frees everything still retired.
+ * epoch_register(domain): Registers the calling thread and returns its reader record.
+ * epoch_unregister(rec): Releases a reader record for reuse by another thread.
+ * epoch_enter(rec) / epoch_exit(rec): Begin / end a read-side critical section.
+ * epoch_retire(rec, retired, destructor): Defers destructor(retired) until no reader can see it.
+ * epoch_barrier(domain): Blocks until everything retired so far has been reclaimed.
+ * EPOCH_CRITICAL(rec, body): Runs body inside a read-side critical section.
+ * EPOCH_SAFE_FREE(rec, ptr): Deferred counterpart of SAFE_FREE.
+ */
+
+
+/**
+ * @file lambda_epoch.h
+ * @brief Epoch-based memory reclamation for lambda results shared across threads.
+ *
+ * Lambdas such as appendWorld hand back heap pointers that the caller frees.
+ * Once such a pointer is published in a structure read by other threads it
+ * can no longer be freed on the spot, because a reader may still hold it.
+ * Writers unlink the pointer and retire it instead; a background thread
+ * frees it once every reader that could have seen it has left its critical
+ * section.
+ *
+ * Readers only perform plain loads and stores. When the kernel supports
+ * MEMBARRIER_CMD_PRIVATE_EXPEDITED the store-load fence is moved from the
+ * readers onto the reclaimer as well, so epoch_enter() costs two plain
+ * memory accesses.
+ */
+
+/********************* Type Definitions ***************************/
+
+/**
+ * @brief A retired pointer waiting for its grace period to end.
+ */
+typedef struct epoch_retired {
+    void* ptr;
+    lambda_t destructor;
+    uint64_t epoch;
+    struct epoch_retired* next;
+} epoch_retired_t;
+
+struct epoch_domain;
+
+/**
+ * @brief Per-thread reader record.
+ *
+ * state is 0 when the thread is outside any critical section, otherwise
+ * (observed_epoch << 1) | 1. Only the owning thread writes it.
+ */
+typedef struct epoch_record {
+    _Atomic uint64_t state;
+    _Atomic(epoch_retired_t*) retired;
+    unsigned nesting;
+    _Atomic int in_use;
+    struct epoch_domain* domain;
+    struct epoch_record* next;
+} __attribute__((aligned(64))) epoch_record_t;
+
+/**
+ * @brief Reclamation domain shared by a set of readers and writers.
+ */
+typedef struct epoch_domain {
+    _Atomic uint64_t global_epoch;
+    _Atomic(epoch_record_t*) records;
+    _Atomic size_t pending;
+    _Atomic size_t reclaimed;
+    int asymmetric;
+    size_t batch;
+    unsigned interval_ms;
+    epoch_retired_t* limbo;
+    pthread_mutex_t registry_mutex;
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake_cond;
+    pthread_cond_t done_cond;
+    unsigned barrier_waiters;
+    int stop;
+    pthread_t reclaimer;
+} epoch_domain_t;
+
+/********************* Internal Helpers ***************************/
+
+static inline int epoch_membarrier_register(void) {
+#if defined(__linux__) && defined(__NR_membarrier) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+    return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#else
+    return 0;
+#endif
+}
+
+static inline void epoch_heavy_fence(epoch_domain_t* domain) {
+#if defined(__linux__) && defined(__NR_membarrier) && defined(MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+    if (domain->asymmetric) {
+        syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+        return;
+    }
+#endif
+    (void)domain;
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline void epoch_reclaim_one(epoch_retired_t* item) {
+    if (item->destructor) {
+        item->destructor(item->ptr);
+    } else {
+        free(item->ptr);
+    }
+    free(item);
+}
+
+/**
+ * @brief Advances the global epoch if every active reader has observed it.
+ *
+ * @return Returns the (possibly advanced) global epoch.
+ */
+static inline uint64_t epoch_try_advance(epoch_domain_t* domain) {
+    epoch_heavy_fence(domain);
+    uint64_t current = atomic_load_explicit(&domain->global_epoch, memory_order_acquire);
+    for (epoch_record_t* rec = atomic_load_explicit(&domain->records, memory_order_acquire);
+         rec; rec = rec->next) {
+        uint64_t state = atomic_load_explicit(&rec->state, memory_order_acquire);
+        if ((state & 1) && (state >> 1) != current) {
+            return current;
+        }
+    }
+    atomic_store_explicit(&domain->global_epoch, current + 1, memory_order_release);
+    return current + 1;
+}
+
+/**
+ * @brief Moves per-thread retire stacks into the limbo list and frees what is safe.
+ *
+ * Only called from the reclaimer thread, or from epoch_domain_destroy() once
+ * the reclaimer has stopped.
+ */
+static inline size_t epoch_collect(epoch_domain_t* domain) {
+    uint64_t epoch = epoch_try_advance(domain);
+
+    for (epoch_record_t* rec = atomic_load_explicit(&domain->records, memory_order_acquire);
+         rec; rec = rec->next) {
+        epoch_retired_t* batch = atomic_exchange_explicit(&rec->retired, NULL, memory_order_acquire);
+        while (batch) {
+            epoch_retired_t* next = batch->next;
+            batch->epoch = epoch;
+            batch->next = domain->limbo;
+            domain->limbo = batch;
+            batch = next;
+        }
+    }
+
+    size_t freed = 0;
+    epoch_retired_t** link = &domain->limbo;
+    while (*link) {
+        epoch_retired_t* item = *link;
+        if (epoch >= item->epoch + 2) {
+            *link = item->next;
+            epoch_reclaim_one(item);
+            freed++;
+        } else {
+            link = &item->next;
+        }
+    }
+    if (freed) {
+        atomic_fetch_sub_explicit(&domain->pending, freed, memory_order_relaxed);
+        atomic_fetch_add_explicit(&domain->reclaimed, freed, memory_order_relaxed);
+    }
+    return freed;
+}
+
+static inline void* epoch_reclaimer_main(void* arg) {
+    epoch_domain_t* domain = (epoch_domain_t*)arg;
+
+    pthread_mutex_lock(&domain->wake_mutex);
+    while (!domain->stop) {
+        if (domain->barrier_waiters == 0 &&
+            atomic_load_explicit(&domain->pending, memory_order_relaxed) < domain->batch) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)(domain->interval_ms % 1000) * 1000000L;
+            deadline.tv_sec += domain->interval_ms / 1000 + deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&domain->wake_cond, &domain->wake_mutex, &deadline);
+            if (domain->stop) {
+                break;
+            }
+        }
+        pthread_mutex_unlock(&domain->wake_mutex);
+
+        epoch_collect(domain);
+
+        pthread_mutex_lock(&domain->wake_mutex);
+        if (domain->barrier_waiters) {
+            pthread_cond_broadcast(&domain->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&domain->wake_mutex);
+    return NULL;
+}
+
+/********************* Domain Management ***************************/
+
+/**
+ * @brief Creates a reclamation domain and starts its background reclaimer.
+ *
+ * @param interval_ms How often the reclaimer wakes up when nothing forces it.
+ * @param batch Number of pending retirements that wakes the reclaimer early.
+ * @return epoch_domain_t* The new domain.
+ *
+ * Example usage:
+ * ```
+ * epoch_domain_t* domain = epoch_domain_create(10, 1024);
+ * ```
+ */
+static inline epoch_domain_t* epoch_domain_create(unsigned interval_ms, size_t batch) {
+    epoch_domain_t* domain = SAFE_MALLOC(sizeof(epoch_domain_t));
+    memset(domain, 0, sizeof(*domain));
+    atomic_init(&domain->global_epoch, 1);
+    domain->interval_ms = interval_ms ? interval_ms : 1;
+    domain->batch = batch ? batch : 1;
+    domain->asymmetric = epoch_membarrier_register();
+    pthread_mutex_init(&domain->registry_mutex, NULL);
+    pthread_mutex_init(&domain->wake_mutex, NULL);
+    pthread_cond_init(&domain->wake_cond, NULL);
+    pthread_cond_init(&domain->done_cond, NULL);
+    if (pthread_create(&domain->reclaimer, NULL, epoch_reclaimer_main, domain) != 0) {
+        HANDLE_ERROR("Failed to start epoch reclaimer thread");
+    }
+    return domain;
+}
+
+/**
+ * @brief Blocks until everything retired before the call has been reclaimed.
+ *
+ * Must not be called from inside a critical section.
+ *
+ * Example usage:
+ * ```
+ * epoch_barrier(domain);
+ * ```
+ */
+static inline void epoch_barrier(epoch_domain_t* domain) {
+    size_t target = atomic_load_explicit(&domain->reclaimed, memory_order_relaxed) +
+                    atomic_load_explicit(&domain->pending, memory_order_relaxed);
+    LOCK_MUTEX(&domain->wake_mutex);
+    domain->barrier_waiters++;
+    pthread_cond_signal(&domain->wake_cond);
+    while (atomic_load_explicit(&domain->reclaimed, memory_order_relaxed) < target && !domain->stop) {
+        pthread_cond_wait(&domain->done_cond, &domain->wake_mutex);
+    }
+    domain->barrier_waiters--;
+    UNLOCK_MUTEX(&domain->wake_mutex);
+}
+
+/**
+ * @brief Stops the reclaimer and frees every record and retired pointer.
+ *
+ * No thread may be inside a critical section of the domain.
+ *
+ * Example usage:
+ * ```
+ * epoch_domain_destroy(domain);
+ * ```
+ */
+static inline void epoch_domain_destroy(epoch_domain_t* domain) {
+    if (!domain) {
+        return;
+    }
+    LOCK_MUTEX(&domain->wake_mutex);
+    domain->stop = 1;
+    pthread_cond_broadcast(&domain->wake_cond);
+    pthread_cond_broadcast(&domain->done_cond);
+    UNLOCK_MUTEX(&domain->wake_mutex);
+    pthread_join(domain->reclaimer, NULL);
+
+    while (atomic_load_explicit(&domain->pending, memory_order_relaxed) > 0) {
+        epoch_collect(domain);
+    }
+
+    epoch_record_t* rec = atomic_load_explicit(&domain->records, memory_order_relaxed);
+    while (rec) {
+        epoch_record_t* next = rec->next;
+        free(rec);
+        rec = next;
+    }
+    pthread_mutex_destroy(&domain->registry_mutex);
+    pthread_mutex_destroy(&domain->wake_mutex);
+    pthread_cond_destroy(&domain->wake_cond);
+    pthread_cond_destroy(&domain->done_cond);
+    free(domain);
+}
+
+/********************* Reader Registration ***************************/
+
+/**
+ * @brief Returns a reader record for the calling thread.
+ *
+ * Records released with epoch_unregister() are reused before new ones are
+ * allocated, so the record list only grows to the peak thread count.
+ *
+ * Example usage:
+ * ```
+ * epoch_record_t* rec = epoch_register(domain);
+ * ```
+ */
+static inline epoch_record_t* epoch_register(epoch_domain_t* domain) {
+    for (epoch_record_t* rec = atomic_load_explicit(&domain->records, memory_order_acquire);
+         rec; rec = rec->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&rec->in_use, &expected, 1)) {
+            rec->nesting = 0;
+            return rec;
+        }
+    }
+
+    epoch_record_t* rec = NULL;
+    if (posix_memalign((void**)&rec, 64, sizeof(epoch_record_t)) != 0) {
+        HANDLE_MEMORY_ERROR("Failed to allocate epoch record");
+    }
+    memset(rec, 0, sizeof(*rec));
+    atomic_init(&rec->in_use, 1);
+    rec->domain = domain;
+
+    LOCK_MUTEX(&domain->registry_mutex);
+    rec->next = atomic_load_explicit(&domain->records, memory_order_relaxed);
+    atomic_store_explicit(&domain->records, rec, memory_order_release);
+    UNLOCK_MUTEX(&domain->registry_mutex);
+    return rec;
+}
+
+/**
+ * @brief Releases a reader record. Pending retirements stay with the domain.
+ *
+ * Example usage:
+ * ```
+ * epoch_unregister(rec);
+ * ```
+ */
+static inline void epoch_unregister(epoch_record_t* rec) {
+    atomic_store_explicit(&rec->state, 0, memory_order_release);
+    rec->nesting = 0;
+    atomic_store_explicit(&rec->in_use, 0, memory_order_release);
+}
+
+/********************* Read-Side Critical Sections ***************************/
+
+/**
+ * @brief Enters a read-side critical section. Sections may nest.
+ *
+ * No atomic read-modify-write is performed.
+ *
+ * Example usage:
+ * ```
+ * epoch_enter(rec);
+ * char* value = atomic_load_explicit(&shared, memory_order_acquire);
+ * printf("%s\n", value);
+ * epoch_exit(rec);
+ * ```
+ */
+static inline void epoch_enter(epoch_record_t* rec) {
+    if (rec->nesting++ == 0) {
+        uint64_t epoch = atomic_load_explicit(&rec->domain->global_epoch, memory_order_relaxed);
+        atomic_store_explicit(&rec->state, (epoch << 1) | 1, memory_order_relaxed);
+        if (rec->domain->asymmetric) {
+            atomic_signal_fence(memory_order_seq_cst);
+        } else {
+            atomic_thread_fence(memory_order_seq_cst);
+        }
+    }
+}
+
+/**
+ * @brief Leaves a read-side critical section.
+ *
+ * Example usage:
+ * ```
+ * epoch_exit(rec);
+ * ```
+ */
+static inline void epoch_exit(epoch_record_t* rec) {
+    if (--rec->nesting == 0) {
+        atomic_store_explicit(&rec->state, 0, memory_order_release);
+    }
+}
+
+/**
+ * @brief Macro to run a block of code inside a read-side critical section.
+ *
+ * @param rec The reader record of the calling thread.
+ * @param body The code to run. It must not return or jump out of the block.
+ *
+ * Example usage:
+ * ```
+ * EPOCH_CRITICAL(rec, {
+ *     printf("%s\n", atomic_load(&shared));
+ * });
+ * ```
+ */
+#define EPOCH_CRITICAL(rec, body) \
+    do { \
+        epoch_enter(rec); \
+        body \
+        epoch_exit(rec); \
+    } while (0)
+
+/********************* Retirement ***************************/
+
+/**
+ * @brief Defers destructor(retired) until no reader can still reference it.
+ *
+ * The pointer must already be unlinked from every shared structure. A NULL
+ * destructor means free(). The destructor runs on the reclaimer thread and
+ * its return value is ignored.
+ *
+ * Example usage:
+ * ```
+ * char* old = atomic_exchange(&shared, SAFE_STRDUP("new"));
+ * epoch_retire(rec, old, NULL);
+ * ```
+ */
+static inline void epoch_retire(epoch_record_t* rec, void* retired, lambda_t destructor) {
+    if (!retired) {
+        return;
+    }
+    epoch_retired_t* item = SAFE_MALLOC(sizeof(epoch_retired_t));
+    item->ptr = retired;
+    item->destructor = destructor;
+    item->epoch = 0;
+
+    epoch_domain_t* domain = rec->domain;
+    size_t pending = atomic_fetch_add_explicit(&domain->pending, 1, memory_order_relaxed) + 1;
+    item->next = atomic_load_explicit(&rec->retired, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&rec->retired, &item->next, item,
+                                                  memory_order_release, memory_order_relaxed)) {
+    }
+    if (pending == domain->batch) {
+        pthread_mutex_lock(&domain->wake_mutex);
+        pthread_cond_signal(&domain->wake_cond);
+        pthread_mutex_unlock(&domain->wake_mutex);
+    }
+}
+
+/**
+ * @brief Macro for deferred memory freeing, the shared-data counterpart of SAFE_FREE.
+ *
+ * @param rec The reader record of the calling thread.
+ * @param epoch_ptr__ The pointer to retire. It is set to NULL afterwards.
+ *
+ * Example usage:
+ * ```
+ * char* old = atomic_exchange(&shared, NULL);
+ * EPOCH_SAFE_FREE(rec, old);
+ * ```
+ */
+#define EPOCH_SAFE_FREE(rec, epoch_ptr__) \
+    do { \
+        if (epoch_ptr__) { \
+            epoch_retire(rec, (void*)(epoch_ptr__), NULL); \
+            (epoch_ptr__) = NULL; \
+        } \
+    } while (0)
+
+
+#endif /* LAMBDA_EPOCH_H */
@@ -0,0 +1,840 @@
+#ifndef LAMBDA_EVENT_H
+#define LAMBDA_EVENT_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "lambda.h"
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_event.h
+
+/**
+ * Event Loop:
+ *
+ * event_loop_create(): Creates an edge-triggered epoll loop with an eventfd wakeup.
+ * event_loop_destroy(loop): Frees the loop and every handler still registered.
+ * event_loop_add(loop, fd, events, on_read, on_write, arg): Registers lambdas for fd readiness.
+ * event_loop_modify(loop, handler, events): Changes the readiness a handler is interested in.
+ * event_loop_remove(loop, handler, close_fd): Unregisters a handler (safe inside callbacks).
+ * event_loop_add_timer(loop, delay_ms, interval_ms, on_timer, arg): Runs a lambda on timer expiry.
+ * event_loop_post(loop, fn, arg): Runs fn(arg) on the loop thread; callable from any thread.
+ * event_loop_run(loop) / event_loop_run_once(loop, timeout_ms): Dispatches ready events.
+ * event_loop_stop(loop): Makes event_loop_run() return; callable from any thread.
+ */
+
+/**
+ * Sockets and Reactors:
+ *
+ * event_set_nonblocking(fd): Puts a descriptor in non-blocking mode.
+ * event_listen_tcp(host, port, reuseport): Opens a non-blocking TCP listener.
+ * event_listen_unix(path): Opens a non-blocking unix stream listener.
+ * event_loop_add_listener(loop, listen_fd, on_read, on_write, on_accept, arg): Accepts connections into the loop.
+ * event_reactor_group_start(config, threads): Starts one pinned loop per core on a SO_REUSEPORT port.
+ * event_reactor_group_stop(group): Stops and joins every reactor.
+ * event_raise_fd_limit(): Raises RLIMIT_NOFILE to its hard limit.
+ */
+
+
+/**
+ * @file lambda_event.h
+ * @brief epoll-based event loop that dispatches lambdas on socket and timer readiness.
+ *
+ * Descriptors are registered edge-triggered, so a callback is invoked once
+ * per readiness change and must read or write until EAGAIN. Callbacks are
+ * ordinary lambda_t functions; they receive the event_handler_t of the
+ * descriptor, whose `arg` field carries the user argument and whose
+ * `ready` field holds the EVENT_* bits that fired.
+ *
+ * A loop is single-threaded. To use every core, run one loop per core
+ * (event_reactor_group_start()), each with its own SO_REUSEPORT listener so
+ * the kernel spreads incoming connections without a shared accept queue.
+ */
+
+/********************* Constants ***************************/
+
+#define EVENT_READ 0x1u
+#define EVENT_WRITE 0x2u
+#define EVENT_HANGUP 0x4u
+#define EVENT_ERROR 0x8u
+
+#ifndef EVENT_LOOP_BATCH
+#define EVENT_LOOP_BATCH 256
+#endif
+
+/********************* Type Definitions ***************************/
+
+struct event_loop;
+
+/**
+ * @brief Registration of one descriptor.
+ *
+ * For listeners, on_read/on_write/arg are the callbacks given to every
+ * accepted connection and on_accept runs once per new connection.
+ */
+typedef struct event_handler {
+    int fd;
+    unsigned interest;
+    unsigned ready;
+    int closed;
+    int is_timer;
+    int is_listener;
+    lambda_t on_read;
+    lambda_t on_write;
+    lambda_t on_accept;
+    void* arg;
+    struct event_loop* loop;
+    struct event_handler* prev;
+    struct event_handler* next;
+    struct event_handler* next_closed;
+} event_handler_t;
+
+/**
+ * @brief Cross-thread request queued by event_loop_post().
+ */
+typedef struct event_post {
+    lambda_t fn;
+    void* arg;
+    struct event_post* next;
+} event_post_t;
+
+/**
+ * @brief Single-threaded edge-triggered event loop.
+ */
+typedef struct event_loop {
+    int epfd;
+    int wakefd;
+    int spare_fd;   /* held in reserve so pending connections can be shed when descriptors run out */
+    _Atomic int running;
+    _Atomic(event_post_t*) posts;
+    event_handler_t* handlers;
+    event_handler_t* closed;
+    size_t handler_count;
+    uint64_t dispatched;
+    struct epoll_event events[EVENT_LOOP_BATCH];
+} event_loop_t;
+
+/********************* Descriptor Helpers ***************************/
+
+/**
+ * @brief Puts a descriptor into non-blocking mode.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ *
+ * Example usage:
+ * ```
+ * HANDLE_NETWORK_STATUS(event_set_nonblocking(fd), "fcntl failed");
+ * ```
+ */
+static inline int event_set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * @brief Raises the open file limit to the hard limit, for 100k+ connections.
+ *
+ * @return Returns the new soft limit.
+ */
+static inline long event_raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return -1;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return (long)limit.rlim_cur;
+}
+
+static inline uint32_t event_to_epoll(unsigned events) {
+    uint32_t mask = EPOLLET | EPOLLRDHUP;
+    if (events & EVENT_READ) {
+        mask |= EPOLLIN;
+    }
+    if (events & EVENT_WRITE) {
+        mask |= EPOLLOUT;
+    }
+    return mask;
+}
+
+/********************* Loop Management ***************************/
+
+/**
+ * @brief Creates an event loop.
+ *
+ * @return event_loop_t* The new loop.
+ *
+ * Example usage:
+ * ```
+ * event_loop_t* loop = event_loop_create();
+ * ```
+ */
+static inline event_loop_t* event_loop_create(void) {
+    event_loop_t* loop = SAFE_MALLOC(sizeof(event_loop_t));
+    memset(loop, 0, sizeof(*loop));
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    HANDLE_NETWORK_STATUS(loop->epfd, "epoll_create1 failed");
+    loop->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    HANDLE_NETWORK_STATUS(loop->wakefd, "eventfd failed");
+    loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    HANDLE_NETWORK_STATUS(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev),
+                          "Failed to register eventfd");
+    return loop;
+}
+
+/**
+ * @brief Registers lambdas for readiness of a descriptor.
+ *
+ * The descriptor is switched to non-blocking mode. Either callback may be
+ * NULL. The returned handler stays valid until event_loop_remove().
+ *
+ * @param loop The loop.
+ * @param fd The descriptor.
+ * @param events EVENT_READ and/or EVENT_WRITE.
+ * @param on_read Called with the handler when fd becomes readable (or hangs up).
+ * @param on_write Called with the handler when fd becomes writable.
+ * @param arg Stored in handler->arg.
+ * @return event_handler_t* The handler, or NULL if epoll refused the descriptor.
+ *
+ * Example usage:
+ * ```
+ * Lambda(on_read, h, {
+ *     event_handler_t* handler = h;
+ *     char buf[4096];
+ *     while (read(handler->fd, buf, sizeof(buf)) > 0) {}
+ *     return NULL;
+ * });
+ * event_loop_add(loop, fd, EVENT_READ, on_read, NULL, NULL);
+ * ```
+ */
+static inline event_handler_t* event_loop_add(event_loop_t* loop, int fd, unsigned events,
+                                              lambda_t on_read, lambda_t on_write, void* arg) {
+    event_handler_t* handler = SAFE_MALLOC(sizeof(event_handler_t));
+    memset(handler, 0, sizeof(*handler));
+    handler->fd = fd;
+    handler->interest = events;
+    handler->on_read = on_read;
+    handler->on_write = on_write;
+    handler->arg = arg;
+    handler->loop = loop;
+    event_set_nonblocking(fd);
+
+    struct epoll_event ev;
+    ev.events = event_to_epoll(events);
+    ev.data.ptr = handler;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        LOG_ERROR("epoll_ctl(EPOLL_CTL_ADD) failed");
+        free(handler);
+        return NULL;
+    }
+    handler->next = loop->handlers;
+    if (loop->handlers) {
+        loop->handlers->prev = handler;
+    }
+    loop->handlers = handler;
+    loop->handler_count++;
+    return handler;
+}
+
+/**
+ * @brief Changes the readiness a handler is interested in.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ *
+ * Example usage:
+ * ```
+ * event_loop_modify(loop, handler, EVENT_READ | EVENT_WRITE);
+ * ```
+ */
+static inline int event_loop_modify(event_loop_t* loop, event_handler_t* handler, unsigned events) {
+    struct epoll_event ev;
+    ev.events = event_to_epoll(events);
+    ev.data.ptr = handler;
+    handler->interest = events;
+    return epoll_ctl(loop->epfd, EPOLL_CTL_MOD, handler->fd, &ev);
+}
+
+/**
+ * @brief Unregisters a handler and optionally closes its descriptor.
+ *
+ * Safe to call from inside any callback, including the handler's own; the
+ * handler is freed after the current batch of events has been dispatched.
+ *
+ * Example usage:
+ * ```
+ * event_loop_remove(loop, handler, 1);
+ * ```
+ */
+static inline void event_loop_remove(event_loop_t* loop, event_handler_t* handler, int close_fd) {
+    if (!handler || handler->closed) {
+        return;
+    }
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, handler->fd, NULL);
+    if (close_fd || handler->is_timer) {
+        close(handler->fd);
+    }
+    handler->closed = 1;
+    if (handler->prev) {
+        handler->prev->next = handler->next;
+    } else {
+        loop->handlers = handler->next;
+    }
+    if (handler->next) {
+        handler->next->prev = handler->prev;
+    }
+    handler->next_closed = loop->closed;
+    loop->closed = handler;
+    loop->handler_count--;
+}
+
+static inline void event_loop_reap(event_loop_t* loop) {
+    while (loop->closed) {
+        event_handler_t* next = loop->closed->next_closed;
+        free(loop->closed);
+        loop->closed = next;
+    }
+}
+
+/**
+ * @brief Frees the loop. Handlers still registered are freed and their descriptors closed.
+ *
+ * Example usage:
+ * ```
+ * event_loop_destroy(loop);
+ * ```
+ */
+static inline void event_loop_destroy(event_loop_t* loop) {
+    if (!loop) {
+        return;
+    }
+    while (loop->handlers) {
+        event_loop_remove(loop, loop->handlers, 1);
+    }
+    event_loop_reap(loop);
+
+    event_post_t* post = atomic_exchange(&loop->posts, NULL);
+    while (post) {
+        event_post_t* next = post->next;
+        free(post);
+        post = next;
+    }
+    if (loop->spare_fd >= 0) {
+        close(loop->spare_fd);
+    }
+    close(loop->wakefd);
+    close(loop->epfd);
+    free(loop);
+}
+
+/********************* Timers ***************************/
+
+static inline void* event_timer_dispatch(void* arg) {
+    event_handler_t* handler = (event_handler_t*)arg;
+    uint64_t expirations;
+    /* A callback may remove the timer, which closes its fd; stop before reading it again. */
+    while (!handler->closed && read(handler->fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+        for (uint64_t i = 0; i < expirations; i++) {
+            handler->on_write(handler);
+            if (handler->closed) {
+                return NULL;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs a lambda when a timerfd expires.
+ *
+ * The lambda receives the timer's handler (with `arg` set) and runs once
+ * per expiration, so a periodic timer that fell behind catches up.
+ * One-shot timers stay registered until removed.
+ *
+ * @param loop The loop.
+ * @param delay_ms Delay before the first expiry (0 is treated as 1 ns).
+ * @param interval_ms Period after the first expiry, 0 for one-shot.
+ * @param on_timer The lambda to run.
+ * @param arg Stored in handler->arg.
+ * @return event_handler_t* The timer handler; pass it to event_loop_remove() to cancel.
+ *
+ * Example usage:
+ * ```
+ * Lambda(tick, h, printf("tick\n"); return NULL;);
+ * event_loop_add_timer(loop, 100, 100, tick, NULL);
+ * ```
+ */
+static inline event_handler_t* event_loop_add_timer(event_loop_t* loop, uint64_t delay_ms,
+                                                    uint64_t interval_ms, lambda_t on_timer, void* arg) {
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0) {
+        LOG_ERROR("timerfd_create failed");
+        return NULL;
+    }
+    struct itimerspec spec;
+    spec.it_value.tv_sec = delay_ms / 1000;
+    spec.it_value.tv_nsec = (long)(delay_ms % 1000) * 1000000L;
+    if (delay_ms == 0) {
+        spec.it_value.tv_nsec = 1;
+    }
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (long)(interval_ms % 1000) * 1000000L;
+    timerfd_settime(tfd, 0, &spec, NULL);
+
+    event_handler_t* handler = event_loop_add(loop, tfd, EVENT_READ,
+                                              event_timer_dispatch, on_timer, arg);
+    if (!handler) {
+        close(tfd);
+        return NULL;
+    }
+    handler->is_timer = 1;
+    return handler;
+}
+
+/********************* Cross-Thread Wakeups ***************************/
+
+static inline void event_loop_wake(event_loop_t* loop) {
+    uint64_t one = 1;
+    ssize_t ignored = write(loop->wakefd, &one, sizeof(one));
+    (void)ignored;
+}
+
+/**
+ * @brief Runs fn(arg) on the loop thread during its next iteration.
+ *
+ * Callable from any thread; posts are run in the order they were made.
+ *
+ * Example usage:
+ * ```
+ * event_loop_post(loop, flush_stats, stats);
+ * ```
+ */
+static inline void event_loop_post(event_loop_t* loop, lambda_t fn, void* arg) {
+    event_post_t* post = SAFE_MALLOC(sizeof(event_post_t));
+    post->fn = fn;
+    post->arg = arg;
+    post->next = atomic_load_explicit(&loop->posts, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&loop->posts, &post->next, post,
+                                                  memory_order_release, memory_order_relaxed)) {
+    }
+    event_loop_wake(loop);
+}
+
+static inline void event_loop_run_posts(event_loop_t* loop) {
+    uint64_t counter;
+    while (read(loop->wakefd, &counter, sizeof(counter)) == sizeof(counter)) {
+    }
+    event_post_t* list = atomic_exchange_explicit(&loop->posts, NULL, memory_order_acquire);
+    event_post_t* ordered = NULL;
+    while (list) {
+        event_post_t* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+    while (ordered) {
+        event_post_t* next = ordered->next;
+        ordered->fn(ordered->arg);
+        free(ordered);
+        ordered = next;
+    }
+}
+
+/********************* Dispatch ***************************/
+
+static inline void event_loop_accept(event_handler_t* listener);
+
+/**
+ * @brief Waits up to timeout_ms for events and dispatches one batch.
+ *
+ * @return Returns the number of events dispatched, or -1 on error.
+ *
+ * Example usage:
+ * ```
+ * while (event_loop_run_once(loop, 10) >= 0 && !done) {}
+ * ```
+ */
+static inline int event_loop_run_once(event_loop_t* loop, int timeout_ms) {
+    int n = epoll_wait(loop->epfd, loop->events, EVENT_LOOP_BATCH, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < n; i++) {
+        event_handler_t* handler = (event_handler_t*)loop->events[i].data.ptr;
+        uint32_t mask = loop->events[i].events;
+        if (!handler) {
+            event_loop_run_posts(loop);
+            continue;
+        }
+        if (handler->closed) {
+            continue;
+        }
+        handler->ready = 0;
+        if (mask & (EPOLLIN | EPOLLRDHUP)) {
+            handler->ready |= EVENT_READ;
+        }
+        if (mask & EPOLLOUT) {
+            handler->ready |= EVENT_WRITE;
+        }
+        if (mask & (EPOLLHUP | EPOLLRDHUP)) {
+            handler->ready |= EVENT_HANGUP;
+        }
+        if (mask & EPOLLERR) {
+            handler->ready |= EVENT_ERROR | EVENT_READ;
+        }
+
+        if (handler->is_listener) {
+            event_loop_accept(handler);
+            continue;
+        }
+        if ((handler->ready & EVENT_READ) && handler->on_read) {
+            handler->on_read(handler);
+        }
+        if ((handler->ready & EVENT_WRITE) && handler->on_write && !handler->closed) {
+            handler->on_write(handler);
+        }
+    }
+    loop->dispatched += (uint64_t)n;
+    event_loop_reap(loop);
+    return n;
+}
+
+/**
+ * @brief Dispatches events until event_loop_stop() is called.
+ *
+ * Example usage:
+ * ```
+ * event_loop_run(loop);
+ * ```
+ */
+static inline void event_loop_run(event_loop_t* loop) {
+    atomic_store(&loop->running, 1);
+    while (atomic_load_explicit(&loop->running, memory_order_relaxed)) {
+        if (event_loop_run_once(loop, -1) < 0) {
+            LOG_ERROR("epoll_wait failed");
+            break;
+        }
+    }
+}
+
+static inline void* event_loop_stop_posted(void* arg) {
+    atomic_store(&((event_loop_t*)arg)->running, 0);
+    return NULL;
+}
+
+/**
+ * @brief Makes event_loop_run() return after the current batch. Callable from any thread.
+ *
+ * Example usage:
+ * ```
+ * event_loop_stop(loop);
+ * ```
+ */
+static inline void event_loop_stop(event_loop_t* loop) {
+    event_loop_post(loop, event_loop_stop_posted, loop);
+}
+
+/********************* Listeners ***************************/
+
+/**
+ * @brief Opens a non-blocking TCP listener.
+ *
+ * @param host IPv4 address to bind, NULL for any.
+ * @param port Port to bind, 0 for an ephemeral port.
+ * @param reuseport Set SO_REUSEPORT so several loops can bind the same port.
+ * @return Returns the listening descriptor, or -1 on failure.
+ *
+ * Example usage:
+ * ```
+ * int fd = event_listen_tcp("127.0.0.1", 8080, 1);
+ * HANDLE_NETWORK_STATUS(fd, "Failed to listen");
+ * ```
+ */
+static inline int event_listen_tcp(const char* host, uint16_t port, int reuseport) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+        close(fd);
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = host ? inet_addr(host) : htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Opens a non-blocking unix stream listener, replacing a stale socket file.
+ *
+ * @return Returns the listening descriptor, or -1 on failure.
+ *
+ * Example usage:
+ * ```
+ * int fd = event_listen_unix("/tmp/lambda.sock");
+ * ```
+ */
+static inline int event_listen_unix(const char* path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Out of descriptors, a pending connection cannot be accepted, and the
+ * edge-triggered listener gets no new edge for the ones still queued. The
+ * spare descriptor is released to accept and close one of them, so the
+ * client sees the connection close instead of a hang. Returns 1 if one was shed.
+ */
+static inline int event_loop_shed(event_handler_t* listener) {
+    event_loop_t* loop = listener->loop;
+    if (loop->spare_fd < 0) {
+        return 0;
+    }
+    close(loop->spare_fd);
+    int fd = accept4(listener->fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd >= 0) {
+        close(fd);
+    }
+    loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return fd >= 0;
+}
+
+static inline void event_loop_accept(event_handler_t* listener) {
+    for (;;) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+                if (event_loop_shed(listener)) {
+                    LOG_WARNING("Out of file descriptors; shed a pending connection");
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return;
+                }
+                // No spare to give up: re-arm so the queued connections raise a new edge.
+                LOG_WARNING("Out of file descriptors; pending connections stay queued");
+                event_loop_modify(listener->loop, listener, listener->interest);
+                return;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARNING("accept4 failed");
+            }
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        event_handler_t* conn = event_loop_add(listener->loop, fd, EVENT_READ,
+                                               listener->on_read, listener->on_write, listener->arg);
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        if (listener->on_accept) {
+            listener->on_accept(conn);
+        }
+    }
+}
+
+/**
+ * @brief Accepts every connection arriving on listen_fd into the loop.
+ *
+ * Accepted descriptors are registered for EVENT_READ with on_read/on_write
+ * and arg, then on_accept (if any) is called with the new handler. While
+ * the process is out of descriptors, pending connections are accepted and
+ * closed straight away so the backlog keeps draining.
+ *
+ * Example usage:
+ * ```
+ * event_loop_add_listener(loop, fd, echo_read, NULL, NULL, NULL);
+ * ```
+ */
+static inline event_handler_t* event_loop_add_listener(event_loop_t* loop, int listen_fd,
+                                                       lambda_t on_read, lambda_t on_write,
+                                                       lambda_t on_accept, void* arg) {
+    event_handler_t* listener = event_loop_add(loop, listen_fd, EVENT_READ, on_read, on_write, arg);
+    if (listener) {
+        listener->is_listener = 1;
+        listener->on_accept = on_accept;
+    }
+    return listener;
+}
+
+/********************* Reactor Per Core ***************************/
+
+/**
+ * @brief Configuration shared by every reactor of a group.
+ */
+typedef struct {
+    const char* host;
+    uint16_t port;
+    lambda_t on_read;
+    lambda_t on_write;
+    lambda_t on_accept;
+    void* arg;
+    int pin_threads;
+} event_server_config_t;
+
+typedef struct {
+    pthread_t thread;
+    event_loop_t* loop;
+    int listen_fd;
+    int cpu;
+    int pin;
+} event_reactor_t;
+
+/**
+ * @brief A set of independent loops, one per core, sharing a SO_REUSEPORT port.
+ */
+typedef struct {
+    size_t count;
+    uint16_t port;
+    event_reactor_t* reactors;
+} event_reactor_group_t;
+
+static inline void* event_reactor_main(void* arg) {
+    event_reactor_t* reactor = (event_reactor_t*)arg;
+#ifdef __linux__
+    if (reactor->pin) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(reactor->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+    event_loop_run(reactor->loop);
+    return NULL;
+}
+
+/**
+ * @brief Starts `threads` reactors, each with its own loop and SO_REUSEPORT listener.
+ *
+ * With port 0 the first reactor picks an ephemeral port and the others bind
+ * to the same one; the chosen port is stored in group->port.
+ *
+ * @param config Listener address and connection callbacks.
+ * @param threads Number of reactors, 0 for one per online CPU.
+ * @return event_reactor_group_t* The running group, or NULL if binding failed.
+ *
+ * Example usage:
+ * ```
+ * event_server_config_t config = { "127.0.0.1", 8080, echo_read, NULL, NULL, NULL, 1 };
+ * event_reactor_group_t* group = event_reactor_group_start(&config, 0);
+ * ```
+ */
+static inline event_reactor_group_t* event_reactor_group_start(const event_server_config_t* config,
+                                                               size_t threads) {
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (size_t)online : 1;
+    }
+    event_reactor_group_t* group = SAFE_MALLOC(sizeof(event_reactor_group_t));
+    group->count = threads;
+    group->port = config->port;
+    group->reactors = SAFE_MALLOC(threads * sizeof(event_reactor_t));
+
+    for (size_t i = 0; i < threads; i++) {
+        event_reactor_t* reactor = &group->reactors[i];
+        reactor->listen_fd = event_listen_tcp(config->host, group->port, 1);
+        if (reactor->listen_fd < 0) {
+            LOG_ERROR("Failed to open SO_REUSEPORT listener");
+            for (size_t j = 0; j < i; j++) {
+                event_loop_destroy(group->reactors[j].loop);
+            }
+            free(group->reactors);
+            free(group);
+            return NULL;
+        }
+        if (group->port == 0) {
+            struct sockaddr_in addr;
+            socklen_t len = sizeof(addr);
+            getsockname(reactor->listen_fd, (struct sockaddr*)&addr, &len);
+            group->port = ntohs(addr.sin_port);
+        }
+        reactor->loop = event_loop_create();
+        reactor->cpu = (int)i;
+        reactor->pin = config->pin_threads;
+        event_loop_add_listener(reactor->loop, reactor->listen_fd, config->on_read,
+                                config->on_write, config->on_accept, config->arg);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        if (pthread_create(&group->reactors[i].thread, NULL, event_reactor_main, &group->reactors[i]) != 0) {
+            HANDLE_ERROR("Failed to start reactor thread");
+        }
+    }
+    return group;
+}
+
+/**
+ * @brief Stops every reactor, joins the threads and frees the loops.
+ *
+ * Example usage:
+ * ```
+ * event_reactor_group_stop(group);
+ * ```
+ */
+static inline void event_reactor_group_stop(event_reactor_group_t* group) {
+    if (!group) {
+        return;
+    }
+    for (size_t i = 0; i < group->count; i++) {
+        event_loop_stop(group->reactors[i].loop);
+    }
+    for (size_t i = 0; i < group->count; i++) {
+        pthread_join(group->reactors[i].thread, NULL);
+        event_loop_destroy(group->reactors[i].loop);
+    }
+    free(group->reactors);
+    free(group);
+}
+
+
+#endif /* LAMBDA_EVENT_H */
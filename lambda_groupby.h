@@ -0,0 +1,670 @@
+#ifndef LAMBDA_GROUPBY_H
+#define LAMBDA_GROUPBY_H
+
+#include "lambda.h"
+#include "lambda_numa.h"
+#include <unistd.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_groupby.h
+
+/**
+ * Group-By Engine:
+ *
+ * groupby_create(pool, config): Creates an aggregation over lambdas that extract a key and a value per row.
+ * groupby_add(groupby, rows, count, stride): Pre-aggregates rows in parallel; may be called repeatedly.
+ * groupby_finish(groupby): Merges all partitions in parallel and returns the groups.
+ * groupby_destroy(groupby): Frees the engine and any spill files.
+ * groupby_run(pool, config, rows, count, stride): create + add + finish + destroy in one call.
+ */
+
+/**
+ * Results:
+ *
+ * groupby_result_find(result, key): Looks up one group, or returns NULL.
+ * groupby_result_free(result): Frees a result.
+ * GROUPBY_DYNAMIC_ARRAY(pool, config, arr): groupby_run over the elements of a DYNAMIC_ARRAY.
+ */
+
+
+/**
+ * @file lambda_groupby.h
+ * @brief Hash-partitioned parallel group-by aggregation driven by lambdas.
+ *
+ * For every row an extract lambda yields a 64-bit key and a double value.
+ * Each group accumulates count, sum, min and max. When a combine lambda is
+ * given, it also keeps a custom accumulator, which combine must fold
+ * associatively (product, gcd, bitwise or, ...).
+ *
+ * The work runs in two lock-free phases on a numa_pool_t:
+ *
+ * 1. Each worker task pre-aggregates its slice of the rows into a small
+ *    cache-resident hash table. When that table is half full, its groups
+ *    are appended to per-partition buffers chosen by the top bits of the
+ *    key hash, and the table is cleared. Low-cardinality inputs never
+ *    leave the local table. When a flush shows the table folded fewer
+ *    than two rows per group, the task stops probing and appends raw
+ *    16-byte (key, value) pairs to the partitions, so high-cardinality
+ *    inputs stream through at memory speed.
+ * 2. groupby_finish() merges each partition in its own task. Every key
+ *    lives in exactly one partition, so no two tasks touch the same group.
+ *
+ * Once the partials buffered in memory exceed memory_budget, a task writes
+ * its buffers to its own temporary file and frees them. Phase 2 reads the
+ * spilled segments back partition by partition. Each task owns its file,
+ * so spilling also needs no locks.
+ *
+ * ```
+ * Lambda(by_customer, arg,
+ *     groupby_row_t* row = (groupby_row_t*)arg;
+ *     const order_t* order = (const order_t*)row->row;
+ *     row->key = order->customer;
+ *     row->value = order->price;
+ *     return NULL;
+ * );
+ * groupby_config_t config = { by_customer, NULL, 256u << 20, NULL };
+ * groupby_result_t* totals = groupby_run(pool, &config, orders, count, sizeof(order_t));
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+/** log2 of the number of hash partitions merged in parallel by groupby_finish(). */
+#define GROUPBY_PARTITION_BITS 6
+#define GROUPBY_PARTITIONS (1u << GROUPBY_PARTITION_BITS)
+
+/** Slots of each task's pre-aggregation table (about 400 KB, sized for L2); flushed at half load. */
+#define GROUPBY_LOCAL_SLOTS (1u << 13)
+
+/** Groups read back per pread() when merging a spilled segment. */
+#define GROUPBY_SPILL_READ 4096
+
+/**
+ * @brief Passed to the extract lambda: row points at the input row, which sets key and value.
+ */
+typedef struct {
+    const void* row;
+    size_t index;
+    uint64_t key;
+    double value;
+    void* ctx;
+} groupby_row_t;
+
+/**
+ * @brief Passed to the combine lambda, which must fold value into acc.
+ */
+typedef struct {
+    double acc;
+    double value;
+    void* ctx;
+} groupby_combine_t;
+
+typedef struct {
+    lambda_t extract;
+    lambda_t combine;
+    size_t memory_budget;
+    void* ctx;
+} groupby_config_t;
+
+/**
+ * @brief One group. count is never 0 for a real group, which also marks empty hash slots.
+ */
+typedef struct {
+    uint64_t key;
+    uint64_t count;
+    double sum;
+    double min;
+    double max;
+    double custom;
+} groupby_group_t;
+
+typedef struct {
+    groupby_group_t* groups;
+    size_t count;
+    size_t spilled_groups;
+} groupby_result_t;
+
+typedef struct {
+    groupby_group_t* slots;
+    size_t mask;
+    size_t used;
+} groupby_table_t;
+
+/**
+ * @brief A single row carried as its key and value: what a one-row group costs in 16 bytes instead of 48.
+ */
+typedef struct {
+    uint64_t key;
+    double value;
+} groupby_pair_t;
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} groupby_buffer_t;
+
+typedef struct {
+    off_t offset;
+    size_t count;
+    int pairs;
+} groupby_segment_t;
+
+typedef struct {
+    groupby_segment_t* segments;
+    size_t size;
+    size_t capacity;
+} groupby_segments_t;
+
+/**
+ * @brief Everything one pre-aggregation task owns. Only that task writes it during groupby_add().
+ */
+typedef struct {
+    groupby_table_t table;
+    size_t rows_since_flush;
+    int direct;
+    groupby_buffer_t groups[GROUPBY_PARTITIONS];
+    groupby_buffer_t pairs[GROUPBY_PARTITIONS];
+    size_t buffered;
+    groupby_segments_t spilled[GROUPBY_PARTITIONS];
+    FILE* spill;
+    off_t spill_end;
+    size_t spilled_groups;
+    char pad[64];
+} groupby_local_t;
+
+typedef struct {
+    numa_pool_t* pool;
+    groupby_config_t config;
+    size_t task_count;
+    groupby_local_t* locals;
+    _Atomic size_t buffered_bytes;
+    const char* rows;
+    size_t row_count;
+    size_t stride;
+    size_t row_base;
+    groupby_table_t* merged;
+} groupby_t;
+
+/********************* Hash Tables ***************************/
+
+static inline uint64_t groupby_hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+static inline size_t groupby_partition_of(uint64_t hash) {
+    return (size_t)(hash >> (64 - GROUPBY_PARTITION_BITS));
+}
+
+static inline void groupby_table_init(groupby_table_t* table, size_t slots) {
+    table->slots = calloc(slots, sizeof(groupby_group_t));
+    if (!table->slots) {
+        HANDLE_MEMORY_ERROR("Group-by table allocation failed");
+    }
+    table->mask = slots - 1;
+    table->used = 0;
+}
+
+/* Returns the slot for key: either its group or an empty slot (count == 0) to claim. */
+static inline groupby_group_t* groupby_table_slot(groupby_table_t* table, uint64_t key, uint64_t hash) {
+    size_t i = (size_t)hash & table->mask;
+    for (;;) {
+        groupby_group_t* slot = &table->slots[i];
+        if (slot->count == 0 || slot->key == key) {
+            return slot;
+        }
+        i = (i + 1) & table->mask;
+    }
+}
+
+static inline void groupby_table_grow(groupby_table_t* table) {
+    groupby_table_t bigger;
+    groupby_table_init(&bigger, (table->mask + 1) * 2);
+    for (size_t i = 0; i <= table->mask; i++) {
+        if (table->slots[i].count) {
+            *groupby_table_slot(&bigger, table->slots[i].key, groupby_hash(table->slots[i].key)) = table->slots[i];
+        }
+    }
+    bigger.used = table->used;
+    free(table->slots);
+    *table = bigger;
+}
+
+static inline double groupby_combine(const groupby_config_t* config, double acc, double value) {
+    groupby_combine_t c = { acc, value, config->ctx };
+    config->combine(&c);
+    return c.acc;
+}
+
+/* Folds partial group src into dst, which is either empty or has the same key. */
+static inline void groupby_merge_group(const groupby_config_t* config, groupby_group_t* dst,
+                                       const groupby_group_t* src) {
+    if (dst->count == 0) {
+        *dst = *src;
+        return;
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    dst->min = src->min < dst->min ? src->min : dst->min;
+    dst->max = src->max > dst->max ? src->max : dst->max;
+    if (config->combine) {
+        dst->custom = groupby_combine(config, dst->custom, src->custom);
+    }
+}
+
+/* Folds one row's value into slot, which is either empty or holds the same key. */
+static inline void groupby_update(const groupby_config_t* config, groupby_group_t* slot, uint64_t key, double value) {
+    if (slot->count == 0) {
+        slot->key = key;
+        slot->count = 1;
+        slot->sum = slot->min = slot->max = slot->custom = value;
+        return;
+    }
+    slot->count++;
+    slot->sum += value;
+    slot->min = value < slot->min ? value : slot->min;
+    slot->max = value > slot->max ? value : slot->max;
+    if (config->combine) {
+        slot->custom = groupby_combine(config, slot->custom, value);
+    }
+}
+
+/********************* Phase 1: Pre-Aggregation ***************************/
+
+/* Appends one element of width bytes and returns how many bytes the buffer grew by. */
+static inline size_t groupby_buffer_push(groupby_buffer_t* buffer, const void* element, size_t width) {
+    size_t grown = 0;
+    if (buffer->size == buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        char* data = realloc(buffer->data, capacity * width);
+        if (!data) {
+            HANDLE_MEMORY_ERROR("Group-by partition allocation failed");
+        }
+        grown = (capacity - buffer->capacity) * width;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size++ * width, element, width);
+    return grown;
+}
+
+static inline void groupby_spill_buffer(groupby_local_t* local, size_t partition, groupby_buffer_t* buffer,
+                                        int pairs) {
+    size_t width = pairs ? sizeof(groupby_pair_t) : sizeof(groupby_group_t);
+    size_t bytes = buffer->size * width;
+    for (size_t done = 0; done < bytes;) {
+        ssize_t n = pwrite(fileno(local->spill), buffer->data + done, bytes - done, local->spill_end + (off_t)done);
+        if (n <= 0) {
+            HANDLE_ERROR("Group-by spill write failed");
+        }
+        done += (size_t)n;
+    }
+    groupby_segments_t* segments = &local->spilled[partition];
+    if (segments->size == segments->capacity) {
+        segments->capacity = segments->capacity ? segments->capacity * 2 : 8;
+        segments->segments = realloc(segments->segments, segments->capacity * sizeof(groupby_segment_t));
+        if (!segments->segments) {
+            HANDLE_MEMORY_ERROR("Group-by segment allocation failed");
+        }
+    }
+    segments->segments[segments->size++] = (groupby_segment_t){ local->spill_end, buffer->size, pairs };
+    local->spill_end += (off_t)bytes;
+    local->spilled_groups += buffer->size;
+    SAFE_FREE(buffer->data);
+    buffer->size = buffer->capacity = 0;
+}
+
+/* Writes every partition buffer of the task to its spill file and releases the memory. */
+static inline void groupby_spill(groupby_t* g, groupby_local_t* local) {
+    if (!local->spill) {
+        local->spill = tmpfile();
+        if (!local->spill) {
+            HANDLE_ERROR("Group-by could not create a spill file");
+        }
+    }
+    for (size_t p = 0; p < GROUPBY_PARTITIONS; p++) {
+        if (local->groups[p].size) {
+            groupby_spill_buffer(local, p, &local->groups[p], 0);
+        }
+        if (local->pairs[p].size) {
+            groupby_spill_buffer(local, p, &local->pairs[p], 1);
+        }
+    }
+    atomic_fetch_sub_explicit(&g->buffered_bytes, local->buffered, memory_order_relaxed);
+    local->buffered = 0;
+}
+
+static inline void groupby_account(groupby_t* g, groupby_local_t* local, size_t grown) {
+    local->buffered += grown;
+    size_t total = atomic_fetch_add_explicit(&g->buffered_bytes, grown, memory_order_relaxed) + grown;
+    if (g->config.memory_budget && total > g->config.memory_budget) {
+        groupby_spill(g, local);
+    }
+}
+
+/*
+ * Moves the local table into the partition buffers. Single-row groups go
+ * out as 16-byte pairs. If the table folded fewer than two rows per group,
+ * the task switches to appending raw pairs.
+ */
+static inline void groupby_flush_local(groupby_t* g, groupby_local_t* local) {
+    size_t grown = 0;
+    for (size_t i = 0; i <= local->table.mask; i++) {
+        groupby_group_t* slot = &local->table.slots[i];
+        if (slot->count == 1) {
+            groupby_pair_t pair = { slot->key, slot->sum };
+            grown += groupby_buffer_push(&local->pairs[groupby_partition_of(groupby_hash(slot->key))], &pair,
+                                         sizeof(pair));
+        } else if (slot->count) {
+            grown += groupby_buffer_push(&local->groups[groupby_partition_of(groupby_hash(slot->key))], slot,
+                                         sizeof(*slot));
+        }
+    }
+    if (local->rows_since_flush < local->table.used * 2) {
+        local->direct = 1;
+    }
+    memset(local->table.slots, 0, (local->table.mask + 1) * sizeof(groupby_group_t));
+    local->table.used = 0;
+    local->rows_since_flush = 0;
+    groupby_account(g, local, grown);
+}
+
+static inline void groupby_add_task(size_t task, void* ctx) {
+    groupby_t* g = (groupby_t*)ctx;
+    groupby_local_t* local = &g->locals[task];
+    size_t begin = g->row_count * task / g->task_count;
+    size_t end = g->row_count * (task + 1) / g->task_count;
+    const groupby_config_t* config = &g->config;
+    groupby_row_t row = { NULL, 0, 0, 0.0, config->ctx };
+    size_t limit = (local->table.mask + 1) / 2;
+
+    for (size_t i = begin; i < end; i++) {
+        row.row = g->rows + i * g->stride;
+        row.index = g->row_base + i;
+        config->extract(&row);
+        uint64_t hash = groupby_hash(row.key);
+        if (local->direct) {
+            groupby_pair_t pair = { row.key, row.value };
+            size_t grown = groupby_buffer_push(&local->pairs[groupby_partition_of(hash)], &pair, sizeof(pair));
+            if (grown) {
+                groupby_account(g, local, grown);
+            }
+            continue;
+        }
+        local->rows_since_flush++;
+        groupby_group_t* slot = groupby_table_slot(&local->table, row.key, hash);
+        if (slot->count == 0 && ++local->table.used >= limit) {
+            groupby_update(config, slot, row.key, row.value);
+            groupby_flush_local(g, local);
+            continue;
+        }
+        groupby_update(config, slot, row.key, row.value);
+    }
+}
+
+/* Runs the tasks of a phase on the pool, or one after another on the caller's thread without one. */
+static inline void groupby_run_tasks(groupby_t* g, size_t tasks, numa_task_fn fn) {
+    if (g->pool) {
+        numa_pool_run(g->pool, tasks, fn, g);
+        return;
+    }
+    for (size_t t = 0; t < tasks; t++) {
+        fn(t, g);
+    }
+}
+
+/**
+ * @brief Creates a group-by engine that runs on pool.
+ *
+ * config->extract is required. config->combine may be NULL. A memory_budget
+ * of 0 never spills. With a NULL pool the work runs single-threaded on the
+ * calling thread.
+ *
+ * Example usage:
+ * ```
+ * groupby_config_t config = { by_customer, product_of_values, 64u << 20, NULL };
+ * groupby_t* groupby = groupby_create(pool, &config);
+ * ```
+ */
+static inline groupby_t* groupby_create(numa_pool_t* pool, const groupby_config_t* config) {
+    if (!config || !config->extract) {
+        HANDLE_INVALID_ARGUMENT(config && config->extract, "Group-by needs an extract lambda");
+        return NULL;
+    }
+    groupby_t* g = SAFE_MALLOC(sizeof(groupby_t));
+    g->pool = pool;
+    g->config = *config;
+    g->task_count = pool && pool->worker_count ? pool->worker_count : 1;
+    g->locals = calloc(g->task_count, sizeof(groupby_local_t));
+    if (!g->locals) {
+        HANDLE_MEMORY_ERROR("Group-by task state allocation failed");
+    }
+    for (size_t t = 0; t < g->task_count; t++) {
+        groupby_table_init(&g->locals[t].table, GROUPBY_LOCAL_SLOTS);
+    }
+    atomic_init(&g->buffered_bytes, 0);
+    g->row_base = 0;
+    g->merged = NULL;
+    return g;
+}
+
+/**
+ * @brief Pre-aggregates count rows of stride bytes each, one slice per pool worker.
+ *
+ * The extract lambda sees row indexes that continue across calls.
+ *
+ * Example usage:
+ * ```
+ * groupby_add(groupby, orders, count, sizeof(order_t));
+ * ```
+ */
+static inline void groupby_add(groupby_t* g, const void* rows, size_t count, size_t stride) {
+    g->rows = (const char*)rows;
+    g->row_count = count;
+    g->stride = stride;
+    groupby_run_tasks(g, g->task_count, groupby_add_task);
+    g->row_base += count;
+}
+
+/********************* Phase 2: Partition Merge ***************************/
+
+static inline void groupby_table_reserve_one(groupby_table_t* table) {
+    if ((table->used + 1) * 2 > table->mask + 1) {
+        groupby_table_grow(table);
+    }
+}
+
+static inline void groupby_merge_into(const groupby_config_t* config, groupby_table_t* table,
+                                      const void* data, size_t count, int pairs) {
+    for (size_t i = 0; i < count; i++) {
+        groupby_table_reserve_one(table);
+        if (pairs) {
+            const groupby_pair_t* pair = (const groupby_pair_t*)data + i;
+            groupby_group_t* slot = groupby_table_slot(table, pair->key, groupby_hash(pair->key));
+            table->used += slot->count == 0;
+            groupby_update(config, slot, pair->key, pair->value);
+        } else {
+            const groupby_group_t* group = (const groupby_group_t*)data + i;
+            groupby_group_t* slot = groupby_table_slot(table, group->key, groupby_hash(group->key));
+            table->used += slot->count == 0;
+            groupby_merge_group(config, slot, group);
+        }
+    }
+}
+
+static inline void groupby_merge_spilled(groupby_t* g, groupby_local_t* local, groupby_table_t* table,
+                                         groupby_segment_t segment, char* chunk) {
+    size_t width = segment.pairs ? sizeof(groupby_pair_t) : sizeof(groupby_group_t);
+    for (size_t done = 0; done < segment.count;) {
+        size_t n = segment.count - done < GROUPBY_SPILL_READ ? segment.count - done : GROUPBY_SPILL_READ;
+        size_t bytes = n * width;
+        off_t offset = segment.offset + (off_t)(done * width);
+        for (size_t got = 0; got < bytes;) {
+            ssize_t r = pread(fileno(local->spill), chunk + got, bytes - got, offset + (off_t)got);
+            if (r <= 0) {
+                HANDLE_ERROR("Group-by spill read failed");
+            }
+            got += (size_t)r;
+        }
+        groupby_merge_into(&g->config, table, chunk, n, segment.pairs);
+        done += n;
+    }
+}
+
+static inline void groupby_merge_task(size_t partition, void* ctx) {
+    groupby_t* g = (groupby_t*)ctx;
+    groupby_table_t* table = &g->merged[partition];
+    groupby_table_init(table, 1024);
+    char* chunk = NULL;
+    for (size_t t = 0; t < g->task_count; t++) {
+        groupby_local_t* local = &g->locals[t];
+        groupby_segments_t* segments = &local->spilled[partition];
+        for (size_t s = 0; s < segments->size; s++) {
+            if (!chunk) {
+                chunk = SAFE_MALLOC(GROUPBY_SPILL_READ * sizeof(groupby_group_t));
+            }
+            groupby_merge_spilled(g, local, table, segments->segments[s], chunk);
+        }
+        groupby_buffer_t* groups = &local->groups[partition];
+        groupby_buffer_t* pairs = &local->pairs[partition];
+        groupby_merge_into(&g->config, table, groups->data, groups->size, 0);
+        groupby_merge_into(&g->config, table, pairs->data, pairs->size, 1);
+        SAFE_FREE(groups->data);
+        SAFE_FREE(pairs->data);
+        groups->size = groups->capacity = 0;
+        pairs->size = pairs->capacity = 0;
+    }
+    SAFE_FREE(chunk);
+}
+
+/**
+ * @brief Merges every partition in parallel and returns all groups, in no particular order.
+ *
+ * The engine is left empty and can take new rows, or be destroyed; the
+ * result is independent of it.
+ *
+ * Example usage:
+ * ```
+ * groupby_result_t* result = groupby_finish(groupby);
+ * for (size_t i = 0; i < result->count; i++) {
+ *     printf("%llu: %f\n", (unsigned long long)result->groups[i].key, result->groups[i].sum);
+ * }
+ * ```
+ */
+static inline groupby_result_t* groupby_finish(groupby_t* g) {
+    groupby_result_t* result = SAFE_MALLOC(sizeof(groupby_result_t));
+    result->spilled_groups = 0;
+    for (size_t t = 0; t < g->task_count; t++) {
+        groupby_flush_local(g, &g->locals[t]);
+        result->spilled_groups += g->locals[t].spilled_groups;
+    }
+
+    g->merged = calloc(GROUPBY_PARTITIONS, sizeof(groupby_table_t));
+    if (!g->merged) {
+        HANDLE_MEMORY_ERROR("Group-by merge allocation failed");
+    }
+    groupby_run_tasks(g, GROUPBY_PARTITIONS, groupby_merge_task);
+
+    size_t total = 0;
+    for (size_t p = 0; p < GROUPBY_PARTITIONS; p++) {
+        total += g->merged[p].used;
+    }
+    result->groups = SAFE_MALLOC((total ? total : 1) * sizeof(groupby_group_t));
+    result->count = 0;
+    for (size_t p = 0; p < GROUPBY_PARTITIONS; p++) {
+        groupby_table_t* table = &g->merged[p];
+        for (size_t i = 0; i <= table->mask; i++) {
+            if (table->slots[i].count) {
+                result->groups[result->count++] = table->slots[i];
+            }
+        }
+        SAFE_FREE(table->slots);
+    }
+    SAFE_FREE(g->merged);
+    for (size_t t = 0; t < g->task_count; t++) {
+        groupby_local_t* local = &g->locals[t];
+        for (size_t p = 0; p < GROUPBY_PARTITIONS; p++) {
+            local->spilled[p].size = 0;
+        }
+        local->spill_end = 0;
+        local->spilled_groups = 0;
+        local->buffered = 0;
+        local->direct = 0;
+    }
+    atomic_store(&g->buffered_bytes, 0);
+    return result;
+}
+
+static inline void groupby_destroy(groupby_t* g) {
+    if (!g) {
+        return;
+    }
+    for (size_t t = 0; t < g->task_count; t++) {
+        groupby_local_t* local = &g->locals[t];
+        SAFE_FREE(local->table.slots);
+        for (size_t p = 0; p < GROUPBY_PARTITIONS; p++) {
+            SAFE_FREE(local->groups[p].data);
+            SAFE_FREE(local->pairs[p].data);
+            SAFE_FREE(local->spilled[p].segments);
+        }
+        if (local->spill) {
+            fclose(local->spill);
+        }
+    }
+    SAFE_FREE(g->locals);
+    free(g);
+}
+
+/**
+ * @brief Runs a complete group-by over one array of rows.
+ *
+ * Example usage:
+ * ```
+ * groupby_result_t* result = groupby_run(pool, &config, orders, count, sizeof(order_t));
+ * groupby_result_free(result);
+ * ```
+ */
+static inline groupby_result_t* groupby_run(numa_pool_t* pool, const groupby_config_t* config,
+                                            const void* rows, size_t count, size_t stride) {
+    groupby_t* g = groupby_create(pool, config);
+    if (!g) {
+        return NULL;
+    }
+    groupby_add(g, rows, count, stride);
+    groupby_result_t* result = groupby_finish(g);
+    groupby_destroy(g);
+    return result;
+}
+
+#define GROUPBY_DYNAMIC_ARRAY(pool, config, arr) \
+    groupby_run((pool), (config), (arr).array, (arr).size, sizeof((arr).array[0]))
+
+/********************* Results ***************************/
+
+/**
+ * @brief Returns the group for key by linear scan, or NULL. Sort or index the result for repeated lookups.
+ */
+static inline const groupby_group_t* groupby_result_find(const groupby_result_t* result, uint64_t key) {
+    for (size_t i = 0; i < result->count; i++) {
+        if (result->groups[i].key == key) {
+            return &result->groups[i];
+        }
+    }
+    return NULL;
+}
+
+static inline void groupby_result_free(groupby_result_t* result) {
+    if (!result) {
+        return;
+    }
+    SAFE_FREE(result->groups);
+    free(result);
+}
+
+
+#endif /* LAMBDA_GROUPBY_H */
@@ -0,0 +1,455 @@
+#ifndef LAMBDA_INTERN_H
+#define LAMBDA_INTERN_H
+
+#include "lambda.h"
+#include "lambda_lock.h"
+#include <stdatomic.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_intern.h
+
+/**
+ * Interning Table:
+ *
+ * intern_create(expected): Creates a table sized for about expected distinct strings.
+ * intern_destroy(table): Frees the table and every interned string.
+ * intern_bytes(table, data, len) / intern_cstr(table, str): Interns a string and returns its intern_ref_t.
+ * intern_take(table, str): Interns a heap string returned by a lambda and frees it.
+ * intern_find(table, data, len): Looks a string up without inserting; id is INTERN_NONE if absent.
+ * intern_str(table, id) / intern_length(table, id): The canonical string of an ID.
+ * intern_count(table): Number of distinct strings.
+ * INTERN_EQ(a, b): Equality of two references, an integer compare.
+ */
+
+/**
+ * Statistics:
+ *
+ * intern_stats(table, stats): Fills an intern_stats_t with string, arena and index memory use.
+ * intern_stats_print(table, out): Prints the statistics.
+ */
+
+
+/**
+ * @file lambda_intern.h
+ * @brief Thread-safe string interning for strings produced by lambdas.
+ *
+ * Each distinct string is stored once, in an append-only arena, and gets a
+ * dense 32-bit ID assigned in insertion order. An intern_ref_t pairs the ID
+ * with the canonical pointer. Two references are equal exactly when their
+ * IDs are, and the pointer stays valid until the table is destroyed.
+ *
+ * Lookups of strings that are already interned take no lock and write no
+ * shared memory. They probe an open-addressing index whose slots pack 32
+ * hash bits with the ID, so a probe only touches the string on a likely
+ * match. Inserts are serialized by an adaptive lock. They publish the
+ * string, then its directory entry, then its slot, each with release
+ * ordering, so a reader that finds the slot always sees a complete string.
+ *
+ * When the index grows it is copied into one twice the size. The old
+ * index is kept until destroy because readers may still be probing it; a
+ * reader that misses in a stale index falls back to the locked path. The
+ * sizes are geometric, so the kept indexes total less than the live one.
+ *
+ * ```
+ * intern_table_t* hosts = intern_create(4096);
+ * intern_ref_t a = intern_take(hosts, appendWorld("host-"));
+ * intern_ref_t b = intern_cstr(hosts, "host-World");
+ * assert(INTERN_EQ(a, b) && a.str == b.str);
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+#define INTERN_NONE UINT32_MAX
+
+/** Bytes per arena block; longer strings get a block of their own. */
+#define INTERN_ARENA_BLOCK (64 * 1024)
+
+/** Capacity of the first ID directory chunk; chunk k holds INTERN_DIR_FIRST << k entries. */
+#define INTERN_DIR_FIRST 1024
+#define INTERN_DIR_CHUNKS 23
+
+typedef struct {
+    uint32_t id;
+    const char* str;
+} intern_ref_t;
+
+#define INTERN_EQ(a, b) ((a).id == (b).id)
+
+/**
+ * @brief Arena record of one string: its hash and length, then the NUL-terminated bytes.
+ */
+typedef struct {
+    uint64_t hash;
+    uint32_t length;
+    char data[];
+} intern_entry_t;
+
+typedef struct intern_block {
+    struct intern_block* next;
+    size_t size;
+    size_t used;
+    char data[] __attribute__((aligned(8)));
+} intern_block_t;
+
+/**
+ * @brief Open-addressing index. A slot is 0 when empty, else (hash >> 32) << 32 | (id + 1).
+ */
+typedef struct intern_index {
+    size_t mask;
+    struct intern_index* previous;
+    _Atomic uint64_t slots[];
+} intern_index_t;
+
+typedef struct {
+    _Atomic(intern_index_t*) index;
+    _Atomic(_Atomic(intern_entry_t*)*) directory[INTERN_DIR_CHUNKS];
+    _Atomic uint32_t count;
+    adaptive_lock_t lock;
+    intern_block_t* blocks;
+    size_t string_bytes;
+    size_t arena_bytes;
+    size_t index_bytes;
+} intern_table_t;
+
+typedef struct {
+    size_t strings;
+    size_t string_bytes;
+    size_t arena_bytes;
+    size_t index_bytes;
+    size_t directory_bytes;
+    size_t total_bytes;
+} intern_stats_t;
+
+/********************* Internals ***************************/
+
+static inline uint64_t intern_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t intern_hash(const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = len * 0x9e3779b97f4a7c15ull;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 0x9fb21c651e98df25ull;
+        h = (h << 27) | (h >> 37);
+        p += 8;
+        len -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, len);
+    return intern_mix(h ^ tail);
+}
+
+static inline size_t intern_dir_chunk(uint32_t id, size_t* offset) {
+    size_t scaled = (size_t)id / INTERN_DIR_FIRST + 1;
+    size_t chunk = 63 - (size_t)__builtin_clzll(scaled);
+    *offset = (size_t)id - INTERN_DIR_FIRST * ((1ull << chunk) - 1);
+    return chunk;
+}
+
+static inline intern_entry_t* intern_entry(intern_table_t* table, uint32_t id) {
+    size_t offset;
+    size_t chunk = intern_dir_chunk(id, &offset);
+    _Atomic(intern_entry_t*)* entries = atomic_load_explicit(&table->directory[chunk], memory_order_acquire);
+    return atomic_load_explicit(&entries[offset], memory_order_acquire);
+}
+
+static inline intern_index_t* intern_index_create(size_t capacity) {
+    intern_index_t* index = SAFE_MALLOC(sizeof(intern_index_t) + capacity * sizeof(uint64_t));
+    index->mask = capacity - 1;
+    index->previous = NULL;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&index->slots[i], 0);
+    }
+    return index;
+}
+
+/* Returns the ID of the string in index, or INTERN_NONE after reaching an empty slot. */
+static inline uint32_t intern_probe(intern_table_t* table, intern_index_t* index, uint64_t hash,
+                                    const void* data, size_t len) {
+    uint64_t tag = hash >> 32;
+    for (size_t i = (size_t)hash & index->mask;; i = (i + 1) & index->mask) {
+        uint64_t slot = atomic_load_explicit(&index->slots[i], memory_order_acquire);
+        if (slot == 0) {
+            return INTERN_NONE;
+        }
+        if ((slot >> 32) == tag) {
+            uint32_t id = (uint32_t)slot - 1;
+            intern_entry_t* entry = intern_entry(table, id);
+            if (entry->length == len && memcmp(entry->data, data, len) == 0) {
+                return id;
+            }
+        }
+    }
+}
+
+static inline void intern_index_put(intern_index_t* index, uint64_t hash, uint32_t id) {
+    size_t i = (size_t)hash & index->mask;
+    while (atomic_load_explicit(&index->slots[i], memory_order_relaxed) != 0) {
+        i = (i + 1) & index->mask;
+    }
+    atomic_store_explicit(&index->slots[i], ((hash >> 32) << 32) | ((uint64_t)id + 1), memory_order_release);
+}
+
+/* Caller holds the lock. Publishes an index twice the size; the old one stays readable. */
+static inline void intern_grow(intern_table_t* table, intern_index_t* old) {
+    size_t capacity = (old->mask + 1) * 2;
+    intern_index_t* index = intern_index_create(capacity);
+    uint32_t count = atomic_load_explicit(&table->count, memory_order_relaxed);
+    for (uint32_t id = 0; id < count; id++) {
+        intern_index_put(index, intern_entry(table, id)->hash, id);
+    }
+    index->previous = old;
+    table->index_bytes += sizeof(intern_index_t) + capacity * sizeof(uint64_t);
+    atomic_store_explicit(&table->index, index, memory_order_release);
+}
+
+/* Caller holds the lock. */
+static inline intern_entry_t* intern_arena_alloc(intern_table_t* table, size_t len) {
+    size_t need = (sizeof(intern_entry_t) + len + 1 + 7) & ~(size_t)7;
+    intern_block_t* block = table->blocks;
+    if (!block || block->size - block->used < need) {
+        size_t size = need > INTERN_ARENA_BLOCK / 4 ? need : INTERN_ARENA_BLOCK;
+        intern_block_t* fresh = SAFE_MALLOC(sizeof(intern_block_t) + size);
+        fresh->size = size;
+        fresh->used = 0;
+        table->arena_bytes += sizeof(intern_block_t) + size;
+        if (block && size == need) {
+            /* Oversized string: keep filling the current block afterwards. */
+            fresh->next = block->next;
+            block->next = fresh;
+            block = fresh;
+        } else {
+            fresh->next = block;
+            table->blocks = block = fresh;
+        }
+    }
+    intern_entry_t* entry = (intern_entry_t*)(block->data + block->used);
+    block->used += need;
+    return entry;
+}
+
+/********************* Interning Table ***************************/
+
+/**
+ * @brief Creates a table sized for about expected distinct strings; it grows past that as needed.
+ *
+ * Example usage:
+ * ```
+ * intern_table_t* statuses = intern_create(1024);
+ * ```
+ */
+static inline intern_table_t* intern_create(size_t expected) {
+    intern_table_t* table = SAFE_MALLOC(sizeof(intern_table_t));
+    size_t capacity = 64;
+    while (capacity < expected * 2) {
+        capacity *= 2;
+    }
+    atomic_init(&table->index, intern_index_create(capacity));
+    for (size_t i = 0; i < INTERN_DIR_CHUNKS; i++) {
+        atomic_init(&table->directory[i], NULL);
+    }
+    atomic_init(&table->count, 0);
+    adaptive_lock_init(&table->lock, "intern");
+    table->blocks = NULL;
+    table->string_bytes = 0;
+    table->arena_bytes = 0;
+    table->index_bytes = sizeof(intern_index_t) + capacity * sizeof(uint64_t);
+    return table;
+}
+
+/**
+ * @brief Frees the table. Every pointer it returned becomes invalid.
+ */
+static inline void intern_destroy(intern_table_t* table) {
+    if (!table) {
+        return;
+    }
+    intern_index_t* index = atomic_load(&table->index);
+    while (index) {
+        intern_index_t* previous = index->previous;
+        free(index);
+        index = previous;
+    }
+    for (size_t i = 0; i < INTERN_DIR_CHUNKS; i++) {
+        free((void*)atomic_load(&table->directory[i]));
+    }
+    while (table->blocks) {
+        intern_block_t* next = table->blocks->next;
+        free(table->blocks);
+        table->blocks = next;
+    }
+    adaptive_lock_destroy(&table->lock);
+    free(table);
+}
+
+/**
+ * @brief Looks a string up without inserting it. Lock-free; id is INTERN_NONE if absent.
+ *
+ * Example usage:
+ * ```
+ * if (intern_find(hosts, name, strlen(name)).id == INTERN_NONE) {
+ *     printf("unknown host %s\n", name);
+ * }
+ * ```
+ */
+static inline intern_ref_t intern_find(intern_table_t* table, const void* data, size_t len) {
+    uint64_t hash = intern_hash(data, len);
+    uint32_t id = intern_probe(table, atomic_load_explicit(&table->index, memory_order_acquire), hash, data, len);
+    intern_ref_t ref = { id, id == INTERN_NONE ? NULL : intern_entry(table, id)->data };
+    return ref;
+}
+
+/**
+ * @brief Interns len bytes of data (which may contain NULs) and returns the ID and canonical copy.
+ *
+ * Strings seen before are found without locking. New ones are copied
+ * into the arena under the writer lock and receive the next ID.
+ *
+ * Example usage:
+ * ```
+ * intern_ref_t status = intern_bytes(statuses, line + 9, 3);
+ * ```
+ */
+static inline intern_ref_t intern_bytes(intern_table_t* table, const void* data, size_t len) {
+    uint64_t hash = intern_hash(data, len);
+    intern_index_t* index = atomic_load_explicit(&table->index, memory_order_acquire);
+    uint32_t id = intern_probe(table, index, hash, data, len);
+    if (id != INTERN_NONE) {
+        intern_ref_t ref = { id, intern_entry(table, id)->data };
+        return ref;
+    }
+    if (len > UINT32_MAX - 1) {
+        LOG_ERROR("String too long to intern");
+        intern_ref_t none = { INTERN_NONE, NULL };
+        return none;
+    }
+
+    adaptive_lock(&table->lock);
+    index = atomic_load_explicit(&table->index, memory_order_relaxed);
+    id = intern_probe(table, index, hash, data, len);
+    if (id == INTERN_NONE) {
+        id = atomic_load_explicit(&table->count, memory_order_relaxed);
+        if (id == INTERN_NONE) {
+            adaptive_unlock(&table->lock);
+            LOG_ERROR("Interning table is full");
+            intern_ref_t none = { INTERN_NONE, NULL };
+            return none;
+        }
+        if (((size_t)id + 1) * 2 > index->mask + 1) {
+            intern_grow(table, index);
+            index = atomic_load_explicit(&table->index, memory_order_relaxed);
+        }
+
+        intern_entry_t* entry = intern_arena_alloc(table, len);
+        entry->hash = hash;
+        entry->length = (uint32_t)len;
+        memcpy(entry->data, data, len);
+        entry->data[len] = '\0';
+        table->string_bytes += len + 1;
+
+        size_t offset;
+        size_t chunk = intern_dir_chunk(id, &offset);
+        _Atomic(intern_entry_t*)* entries = atomic_load_explicit(&table->directory[chunk], memory_order_relaxed);
+        if (!entries) {
+            entries = SAFE_MALLOC(((size_t)INTERN_DIR_FIRST << chunk) * sizeof(*entries));
+            atomic_store_explicit(&table->directory[chunk], entries, memory_order_release);
+        }
+        atomic_store_explicit(&entries[offset], entry, memory_order_release);
+        intern_index_put(index, hash, id);
+        atomic_store_explicit(&table->count, id + 1, memory_order_release);
+    }
+    intern_ref_t ref = { id, intern_entry(table, id)->data };
+    adaptive_unlock(&table->lock);
+    return ref;
+}
+
+static inline intern_ref_t intern_cstr(intern_table_t* table, const char* str) {
+    return intern_bytes(table, str, strlen(str));
+}
+
+/**
+ * @brief Interns a heap string returned by a lambda (appendWorld, SAFE_STRDUP, ...) and frees it.
+ *
+ * Example usage:
+ * ```
+ * intern_ref_t greeting = intern_take(table, appendWorld("Hello "));
+ * ```
+ */
+static inline intern_ref_t intern_take(intern_table_t* table, void* str) {
+    if (!str) {
+        intern_ref_t none = { INTERN_NONE, NULL };
+        return none;
+    }
+    intern_ref_t ref = intern_cstr(table, (const char*)str);
+    free(str);
+    return ref;
+}
+
+/**
+ * @brief Canonical string of an ID returned by this table, or NULL for an unknown ID.
+ */
+static inline const char* intern_str(intern_table_t* table, uint32_t id) {
+    if (id >= atomic_load_explicit(&table->count, memory_order_acquire)) {
+        return NULL;
+    }
+    return intern_entry(table, id)->data;
+}
+
+static inline size_t intern_length(intern_table_t* table, uint32_t id) {
+    if (id >= atomic_load_explicit(&table->count, memory_order_acquire)) {
+        return 0;
+    }
+    return intern_entry(table, id)->length;
+}
+
+static inline size_t intern_count(intern_table_t* table) {
+    return atomic_load_explicit(&table->count, memory_order_acquire);
+}
+
+/********************* Statistics ***************************/
+
+/**
+ * @brief Memory use of the table: the string bytes themselves, the arena holding them and the indexes.
+ *
+ * Example usage:
+ * ```
+ * intern_stats_t stats;
+ * intern_stats(table, &stats);
+ * printf("%zu strings in %zu bytes\n", stats.strings, stats.total_bytes);
+ * ```
+ */
+static inline void intern_stats(intern_table_t* table, intern_stats_t* stats) {
+    adaptive_lock(&table->lock);
+    stats->strings = atomic_load_explicit(&table->count, memory_order_relaxed);
+    stats->string_bytes = table->string_bytes;
+    stats->arena_bytes = table->arena_bytes;
+    stats->index_bytes = table->index_bytes;
+    stats->directory_bytes = 0;
+    for (size_t i = 0; i < INTERN_DIR_CHUNKS; i++) {
+        if (atomic_load_explicit(&table->directory[i], memory_order_relaxed)) {
+            stats->directory_bytes += ((size_t)INTERN_DIR_FIRST << i) * sizeof(intern_entry_t*);
+        }
+    }
+    adaptive_unlock(&table->lock);
+    stats->total_bytes = sizeof(intern_table_t) + stats->arena_bytes + stats->index_bytes + stats->directory_bytes;
+}
+
+static inline void intern_stats_print(intern_table_t* table, FILE* out) {
+    intern_stats_t stats;
+    intern_stats(table, &stats);
+    fprintf(out, "interned strings: %zu (%zu bytes), arena %zu bytes, index %zu bytes, directory %zu bytes, total %zu bytes\n",
+            stats.strings, stats.string_bytes, stats.arena_bytes, stats.index_bytes, stats.directory_bytes,
+            stats.total_bytes);
+}
+
+
+#endif /* LAMBDA_INTERN_H */
@@ -0,0 +1,107 @@
+#ifndef LAMBDA_ISA_H
+#define LAMBDA_ISA_H
+
+#include "lambda.h"
+#include <stdatomic.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LAMBDA_ISA_X86 1
+#else
+#define LAMBDA_ISA_X86 0
+#endif
+
+
+// summarized list of all of the macros and functions defined in the lambda_isa.h
+
+/**
+ * Instruction Set Dispatch:
+ *
+ * lambda_isa_detect(): Best instruction set of this CPU (LAMBDA_ISA_SCALAR, LAMBDA_ISA_SSE2 or LAMBDA_ISA_AVX2).
+ * lambda_isa_selected(slot): Instruction set stored in a module's slot, detecting it on first use.
+ * lambda_isa_select(slot, isa): Stores isa, clamped to what the CPU supports; returns the one in effect.
+ * lambda_isa_name(isa): Printable name of an instruction set.
+ */
+
+
+/**
+ * @file lambda_isa.h
+ * @brief CPU feature detection and kernel-tier selection shared by the SIMD headers.
+ *
+ * lambda_text.h and lambda_select.h each keep a table of kernels per
+ * instruction set and pick one row at run time. The detection and the
+ * override live here; each header owns its slot, so one module can be
+ * forced down without affecting the other. Forcing a lower tier is how
+ * the SIMD kernels are compared against the scalar fallback.
+ */
+
+/********************* Type Definitions ***************************/
+
+typedef enum {
+    LAMBDA_ISA_SCALAR,
+    LAMBDA_ISA_SSE2,
+    LAMBDA_ISA_AVX2
+} lambda_isa_t;
+
+/** Initializer of a selection slot: nothing selected yet. */
+#define LAMBDA_ISA_UNSELECTED (-1)
+
+/********************* Detection and Selection ***************************/
+
+/**
+ * @brief Returns the best instruction set the kernels can use on this CPU.
+ */
+static inline lambda_isa_t lambda_isa_detect(void) {
+#if LAMBDA_ISA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return LAMBDA_ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return LAMBDA_ISA_SSE2;
+    }
+#endif
+    return LAMBDA_ISA_SCALAR;
+}
+
+/**
+ * @brief Returns the instruction set stored in slot, detecting it on first call.
+ *
+ * Example usage:
+ * ```
+ * static _Atomic int my_isa = LAMBDA_ISA_UNSELECTED;
+ * lambda_isa_t isa = lambda_isa_selected(&my_isa);
+ * ```
+ */
+static inline lambda_isa_t lambda_isa_selected(_Atomic int* slot) {
+    int isa = atomic_load_explicit(slot, memory_order_relaxed);
+    if (isa < 0) {
+        isa = (int)lambda_isa_detect();
+        atomic_store_explicit(slot, isa, memory_order_relaxed);
+    }
+    return (lambda_isa_t)isa;
+}
+
+/**
+ * @brief Stores an instruction set in slot, clamped to what the CPU supports. Returns the one in effect.
+ *
+ * Example usage:
+ * ```
+ * lambda_isa_select(&my_isa, LAMBDA_ISA_SCALAR);   // compare kernels against the fallback
+ * ```
+ */
+static inline lambda_isa_t lambda_isa_select(_Atomic int* slot, lambda_isa_t isa) {
+    lambda_isa_t best = lambda_isa_detect();
+    if (isa > best) {
+        isa = best;
+    }
+    atomic_store(slot, (int)isa);
+    return isa;
+}
+
+static inline const char* lambda_isa_name(lambda_isa_t isa) {
+    static const char* const names[] = { "scalar", "sse2", "avx2" };
+    return names[isa];
+}
+
+
+#endif /* LAMBDA_ISA_H */
@@ -0,0 +1,698 @@
+#ifndef LAMBDA_JIT_H
+#define LAMBDA_JIT_H
+
+#include "lambda_vm.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_jit.h
+
+/**
+ * Native Compilation:
+ *
+ * jit_compile(prog): Translates a VM program to machine code, falling back to the VM when it cannot.
+ * jit_compile_expr(src, param, param_type): Compiles an expression string straight to a jit function.
+ * jit_free(jf): Releases the machine code (or VM thunk) of a jit function.
+ * jit_supported(prog): Returns 1 when a program can be compiled to machine code on this target.
+ * jit_eval_int(jf, x) / jit_eval_float(jf, x): Typed calls, native when possible.
+ */
+
+
+/**
+ * @file lambda_jit.h
+ * @brief x86-64 JIT tier for runtime lambda expressions compiled by lambda_vm.h.
+ *
+ * jit_compile() translates the bytecode of a vm_program_t into x86-64
+ * machine code. Every VM register lives in a machine register for the
+ * whole call, so an expression such as `x * 3 + 7` becomes a handful of
+ * instructions with no dispatch and no memory traffic.
+ *
+ * Three entry points are emitted per program:
+ * - `fn`: a real lambda_t, boxing values like vm_as_lambda() does.
+ * - `int_fn`: `int64_t (*)(int64_t)`, converting like vm_eval_int().
+ * - `float_fn`: `double (*)(double)`, converting like vm_eval_float().
+ *
+ * Code is written into an anonymous read-write mapping which is then
+ * switched to read-execute with mprotect(), so no page is ever writable
+ * and executable at the same time.
+ *
+ * Integer and float arithmetic, comparisons, min/max/abs, conversions,
+ * logical operators and select are supported. Programs that use strings
+ * or more than JIT_MAX_REGS registers, and every program on other
+ * architectures (or with -DLAMBDA_JIT_DISABLE), fall back to the VM:
+ * `fn` is then a vm_as_lambda() thunk and the typed pointers are NULL,
+ * so call them through jit_eval_int() and jit_eval_float().
+ */
+
+/********************* Type Definitions ***************************/
+
+/**
+ * @brief A compiled expression. The program must outlive it.
+ */
+typedef struct {
+    const vm_program_t* prog;
+    vm_program_t* owned;
+    lambda_t fn;
+    int64_t (*int_fn)(int64_t);
+    double (*float_fn)(double);
+    void* code;
+    size_t code_size;
+    int native;
+} jit_function_t;
+
+#if defined(__x86_64__) && !defined(LAMBDA_JIT_DISABLE)
+#define LAMBDA_JIT_NATIVE 1
+#else
+#define LAMBDA_JIT_NATIVE 0
+#endif
+
+/** VM registers that fit in machine registers: six caller-saved plus five callee-saved homes. */
+#define JIT_MAX_REGS 11
+
+/********************* Code Buffer ***************************/
+
+typedef struct {
+    uint8_t* buf;
+    size_t len;
+    size_t cap;
+} jit_buf_t;
+
+static inline void jit_byte(jit_buf_t* b, uint8_t x) {
+    if (b->len == b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 256;
+        uint8_t* grown = realloc(b->buf, b->cap);
+        if (!grown) {
+            HANDLE_MEMORY_ERROR("Failed to grow JIT code buffer");
+        }
+        b->buf = grown;
+    }
+    b->buf[b->len++] = x;
+}
+
+static inline void jit_u32(jit_buf_t* b, uint32_t x) {
+    for (int i = 0; i < 4; i++) {
+        jit_byte(b, (uint8_t)(x >> (8 * i)));
+    }
+}
+
+static inline void jit_u64(jit_buf_t* b, uint64_t x) {
+    for (int i = 0; i < 8; i++) {
+        jit_byte(b, (uint8_t)(x >> (8 * i)));
+    }
+}
+
+/********************* x86-64 Encoding ***************************/
+
+enum { JIT_RAX = 0, JIT_RCX = 1, JIT_RDX = 2, JIT_RBX = 3, JIT_RSI = 6, JIT_RDI = 7 };
+enum { JIT_X14 = 14, JIT_X15 = 15 };
+
+/** Condition codes, as used by Jcc, SETcc and CMOVcc. */
+enum {
+    JIT_CC_B = 0x2, JIT_CC_AE = 0x3, JIT_CC_E = 0x4, JIT_CC_NE = 0x5,
+    JIT_CC_A = 0x7, JIT_CC_S = 0x8, JIT_CC_P = 0xA, JIT_CC_NP = 0xB,
+    JIT_CC_L = 0xC, JIT_CC_GE = 0xD, JIT_CC_LE = 0xE, JIT_CC_G = 0xF
+};
+
+static inline void jit_rex(jit_buf_t* b, int w, int reg, int rm) {
+    uint8_t rex = (uint8_t)(0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3));
+    if (rex != 0x40) {
+        jit_byte(b, rex);
+    }
+}
+
+static inline void jit_modrm(jit_buf_t* b, int reg, int rm) {
+    jit_byte(b, (uint8_t)(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+/** 64-bit `op rm, reg` for mov (0x89), add, sub, and, or, xor, cmp and test. */
+static inline void jit_alu_rr(jit_buf_t* b, uint8_t op, int rm, int reg) {
+    jit_rex(b, 1, reg, rm);
+    jit_byte(b, op);
+    jit_modrm(b, reg, rm);
+}
+
+static inline void jit_mov_rr(jit_buf_t* b, int dst, int src) {
+    if (dst != src) {
+        jit_alu_rr(b, 0x89, dst, src);
+    }
+}
+
+/** 64-bit `op rm, imm32` with the group-1 extension (0 add, 5 sub, 7 cmp). */
+static inline void jit_alu_ri(jit_buf_t* b, int ext, int rm, int32_t imm) {
+    jit_rex(b, 1, 0, rm);
+    jit_byte(b, 0x81);
+    jit_modrm(b, ext, rm);
+    jit_u32(b, (uint32_t)imm);
+}
+
+static inline void jit_mov_ri(jit_buf_t* b, int dst, int64_t imm) {
+    if (imm == (int32_t)imm) {
+        jit_rex(b, 1, 0, dst);
+        jit_byte(b, 0xC7);
+        jit_modrm(b, 0, dst);
+        jit_u32(b, (uint32_t)imm);
+    } else {
+        jit_rex(b, 1, 0, dst);
+        jit_byte(b, (uint8_t)(0xB8 + (dst & 7)));
+        jit_u64(b, (uint64_t)imm);
+    }
+}
+
+static inline void jit_op0f_rr(jit_buf_t* b, uint8_t op, int reg, int rm) {
+    jit_rex(b, 1, reg, rm);
+    jit_byte(b, 0x0F);
+    jit_byte(b, op);
+    jit_modrm(b, reg, rm);
+}
+
+static inline void jit_imul_rr(jit_buf_t* b, int dst, int src) {
+    jit_op0f_rr(b, 0xAF, dst, src);
+}
+
+static inline void jit_imul_rri(jit_buf_t* b, int dst, int src, int32_t imm) {
+    jit_rex(b, 1, dst, src);
+    jit_byte(b, 0x69);
+    jit_modrm(b, dst, src);
+    jit_u32(b, (uint32_t)imm);
+}
+
+static inline void jit_cmov(jit_buf_t* b, int cc, int dst, int src) {
+    jit_op0f_rr(b, (uint8_t)(0x40 + cc), dst, src);
+}
+
+/** Group-3 unary on a 64-bit register (3 neg, 7 idiv). */
+static inline void jit_unary(jit_buf_t* b, int ext, int rm) {
+    jit_rex(b, 1, 0, rm);
+    jit_byte(b, 0xF7);
+    jit_modrm(b, ext, rm);
+}
+
+/** setcc into al (reg 0) or cl (reg 1). */
+static inline void jit_setcc(jit_buf_t* b, int cc, int reg) {
+    jit_byte(b, 0x0F);
+    jit_byte(b, (uint8_t)(0x90 + cc));
+    jit_modrm(b, 0, reg);
+}
+
+/** dst = zero-extended al. */
+static inline void jit_movzx_al(jit_buf_t* b, int dst) {
+    jit_op0f_rr(b, 0xB6, dst, JIT_RAX);
+}
+
+/** Scalar SSE2 instruction `prefix [rex] 0F op` with xmm or gpr operands. */
+static inline void jit_sse(jit_buf_t* b, uint8_t prefix, int w, uint8_t op, int reg, int rm) {
+    if (prefix) {
+        jit_byte(b, prefix);
+    }
+    jit_rex(b, w, reg, rm);
+    jit_byte(b, 0x0F);
+    jit_byte(b, op);
+    jit_modrm(b, reg, rm);
+}
+
+static inline void jit_movapd(jit_buf_t* b, int dst, int src) {
+    if (dst != src) {
+        jit_sse(b, 0x66, 0, 0x28, dst, src);
+    }
+}
+
+/** Emits a short conditional jump (cc >= 0) or jmp (cc < 0) and returns its patch offset. */
+static inline size_t jit_jump(jit_buf_t* b, int cc) {
+    jit_byte(b, cc < 0 ? 0xEB : (uint8_t)(0x70 + cc));
+    jit_byte(b, 0);
+    return b->len - 1;
+}
+
+static inline void jit_patch(jit_buf_t* b, size_t at) {
+    b->buf[at] = (uint8_t)(b->len - at - 1);
+}
+
+/** Loads the bit pattern of a double into xmm via rcx. */
+static inline void jit_load_double(jit_buf_t* b, int xmm, uint64_t bits) {
+    jit_mov_ri(b, JIT_RCX, (int64_t)bits);
+    jit_sse(b, 0x66, 1, 0x6E, xmm, JIT_RCX);
+}
+
+/********************* Translation ***************************/
+
+enum { JIT_ENTRY_BOXED, JIT_ENTRY_INT, JIT_ENTRY_FLOAT };
+
+/** VM register -> integer home. The last five are callee-saved. */
+static const uint8_t jit_int_home[JIT_MAX_REGS] = { 7, 6, 8, 9, 10, 11, 3, 12, 13, 14, 15 };
+#define JIT_CALLER_SAVED_HOMES 6
+
+/**
+ * @brief Infers the type held by every register written by each instruction.
+ *
+ * Returns 0 when the program uses an instruction the JIT does not handle.
+ */
+static inline int jit_check(const vm_program_t* prog) {
+    if (!LAMBDA_JIT_NATIVE || prog->reg_count > JIT_MAX_REGS ||
+        prog->param_type == VM_STR || prog->result_type == VM_STR) {
+        return 0;
+    }
+    for (size_t i = 0; i < prog->code_len; i++) {
+        const vm_instr_t* in = &prog->code[i];
+        switch (in->op) {
+        case VM_OP_SEQ: case VM_OP_SNE: case VM_OP_SLT: case VM_OP_SLE:
+        case VM_OP_SLEN: case VM_OP_SCONTAINS: case VM_OP_SSTARTS:
+            return 0;
+        case VM_OP_LOADK:
+            if (prog->const_types[in->a] == VM_STR) {
+                return 0;
+            }
+            break;
+        case VM_OP_SELECT:
+            i++;
+            break;
+        default:
+            break;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Returns 1 when jit_compile() will produce machine code for the program.
+ *
+ * Example usage:
+ * ```
+ * if (!jit_supported(prog)) printf("running on the VM\n");
+ * ```
+ */
+static inline int jit_supported(const vm_program_t* prog) {
+    return prog && jit_check(prog);
+}
+
+/** Emits one entry point; types[] tracks the type of each VM register. */
+static inline void jit_emit_entry(jit_buf_t* b, const vm_program_t* prog, int entry) {
+    vm_type_t types[JIT_MAX_REGS];
+    const vm_value_t* k = prog->consts;
+    int saved = prog->reg_count - JIT_CALLER_SAVED_HOMES;
+
+    for (int i = 0; i < saved; i++) {
+        int reg = jit_int_home[JIT_CALLER_SAVED_HOMES + i];
+        jit_rex(b, 0, 0, reg);
+        jit_byte(b, (uint8_t)(0x50 + (reg & 7)));
+    }
+
+    types[0] = prog->param_type;
+    if (prog->param_type == VM_INT && entry == JIT_ENTRY_FLOAT) {
+        jit_sse(b, 0xF2, 1, 0x2C, JIT_RDI, 0);                /* cvttsd2si rdi, xmm0 */
+    } else if (prog->param_type == VM_FLOAT && entry == JIT_ENTRY_BOXED) {
+        jit_sse(b, 0x66, 1, 0x6E, 0, JIT_RDI);                /* movq xmm0, rdi */
+    } else if (prog->param_type == VM_FLOAT && entry == JIT_ENTRY_INT) {
+        jit_sse(b, 0x66, 0, 0x57, 0, 0);                      /* xorpd xmm0, xmm0 */
+        jit_sse(b, 0xF2, 1, 0x2A, 0, JIT_RDI);                /* cvtsi2sd xmm0, rdi */
+    }
+
+    for (size_t pc = 0; pc < prog->code_len; pc++) {
+        const vm_instr_t* in = &prog->code[pc];
+        int D = jit_int_home[in->dst], A = jit_int_home[in->a], B = jit_int_home[in->b];
+        int XD = in->dst, XA = in->a, XB = in->b;
+        int64_t kv = k[in->b].i;
+        int fits = kv == (int32_t)kv;
+        vm_type_t result = VM_INT;
+        size_t j1, j2, j3;
+
+        switch (in->op) {
+        case VM_OP_RET:
+            if (types[in->a] == VM_INT) {
+                if (entry == JIT_ENTRY_FLOAT) {
+                    jit_sse(b, 0x66, 0, 0x57, 0, 0);
+                    jit_sse(b, 0xF2, 1, 0x2A, 0, A);          /* cvtsi2sd xmm0, home */
+                } else {
+                    jit_mov_rr(b, JIT_RAX, A);
+                }
+            } else if (entry == JIT_ENTRY_BOXED) {
+                jit_sse(b, 0x66, 1, 0x7E, XA, JIT_RAX);       /* movq rax, xmm */
+            } else if (entry == JIT_ENTRY_INT) {
+                jit_sse(b, 0xF2, 1, 0x2C, JIT_RAX, XA);       /* cvttsd2si rax, xmm */
+            } else {
+                jit_movapd(b, 0, XA);
+            }
+            for (int i = saved - 1; i >= 0; i--) {
+                int reg = jit_int_home[JIT_CALLER_SAVED_HOMES + i];
+                jit_rex(b, 0, 0, reg);
+                jit_byte(b, (uint8_t)(0x58 + (reg & 7)));
+            }
+            jit_byte(b, 0xC3);
+            return;
+
+        case VM_OP_LOADK:
+            result = prog->const_types[in->a];
+            if (result == VM_INT) {
+                jit_mov_ri(b, D, k[in->a].i);
+            } else {
+                jit_load_double(b, XD, (uint64_t)k[in->a].i);
+            }
+            break;
+        case VM_OP_MOV:
+            result = types[in->a];
+            if (result == VM_INT) {
+                jit_mov_rr(b, D, A);
+            } else {
+                jit_movapd(b, XD, XA);
+            }
+            break;
+
+        case VM_OP_IADD: case VM_OP_ISUB: case VM_OP_IMUL:
+            jit_mov_rr(b, JIT_RAX, A);
+            if (in->op == VM_OP_IMUL) {
+                jit_imul_rr(b, JIT_RAX, B);
+            } else {
+                jit_alu_rr(b, in->op == VM_OP_IADD ? 0x01 : 0x29, JIT_RAX, B);
+            }
+            jit_mov_rr(b, D, JIT_RAX);
+            break;
+        case VM_OP_IADDK: case VM_OP_ISUBK:
+            jit_mov_rr(b, JIT_RAX, A);
+            if (fits) {
+                jit_alu_ri(b, in->op == VM_OP_IADDK ? 0 : 5, JIT_RAX, (int32_t)kv);
+            } else {
+                jit_mov_ri(b, JIT_RCX, kv);
+                jit_alu_rr(b, in->op == VM_OP_IADDK ? 0x01 : 0x29, JIT_RAX, JIT_RCX);
+            }
+            jit_mov_rr(b, D, JIT_RAX);
+            break;
+        case VM_OP_IMULK:
+            if (fits) {
+                jit_imul_rri(b, D, A, (int32_t)kv);
+            } else {
+                jit_mov_ri(b, JIT_RAX, kv);
+                jit_imul_rr(b, JIT_RAX, A);
+                jit_mov_rr(b, D, JIT_RAX);
+            }
+            break;
+        case VM_OP_IDIV: case VM_OP_IMOD:
+            /* Matches vm_idiv/vm_imod: x / 0 == 0, x / -1 wraps, x % 0 == x % -1 == 0. */
+            jit_mov_rr(b, JIT_RCX, B);
+            jit_mov_rr(b, JIT_RAX, A);
+            jit_alu_rr(b, 0x85, JIT_RCX, JIT_RCX);
+            j1 = jit_jump(b, JIT_CC_E);
+            jit_alu_ri(b, 7, JIT_RCX, -1);
+            j2 = jit_jump(b, JIT_CC_E);
+            jit_byte(b, 0x48);
+            jit_byte(b, 0x99);                                /* cqo */
+            jit_unary(b, 7, JIT_RCX);                         /* idiv rcx */
+            if (in->op == VM_OP_IMOD) {
+                jit_mov_rr(b, JIT_RAX, JIT_RDX);
+            }
+            j3 = jit_jump(b, -1);
+            jit_patch(b, j2);
+            if (in->op == VM_OP_IDIV) {
+                jit_unary(b, 3, JIT_RAX);
+                size_t j4 = jit_jump(b, -1);
+                jit_patch(b, j1);
+                jit_mov_ri(b, JIT_RAX, 0);
+                jit_patch(b, j4);
+            } else {
+                jit_patch(b, j1);
+                jit_mov_ri(b, JIT_RAX, 0);
+            }
+            jit_patch(b, j3);
+            jit_mov_rr(b, D, JIT_RAX);
+            break;
+        case VM_OP_INEG:
+            jit_mov_rr(b, JIT_RAX, A);
+            jit_unary(b, 3, JIT_RAX);
+            jit_mov_rr(b, D, JIT_RAX);
+            break;
+        case VM_OP_IABS:
+            jit_mov_rr(b, JIT_RAX, A);
+            jit_unary(b, 3, JIT_RAX);
+            jit_cmov(b, JIT_CC_S, JIT_RAX, A);
+            jit_mov_rr(b, D, JIT_RAX);
+            break;
+        case VM_OP_IMIN: case VM_OP_IMAX:
+            jit_mov_rr(b, JIT_RAX, A);
+            jit_alu_rr(b, 0x39, JIT_RAX, B);
+            jit_cmov(b, in->op == VM_OP_IMIN ? JIT_CC_G : JIT_CC_L, JIT_RAX, B);
+            jit_mov_rr(b, D, JIT_RAX);
+            break;
+        case VM_OP_NOT:
+            jit_alu_rr(b, 0x85, A, A);
+            jit_setcc(b, JIT_CC_E, JIT_RAX);
+            jit_movzx_al(b, D);
+            break;
+        case VM_OP_AND: case VM_OP_OR:
+            jit_alu_rr(b, 0x85, A, A);
+            jit_setcc(b, JIT_CC_NE, JIT_RAX);
+            jit_alu_rr(b, 0x85, B, B);
+            jit_setcc(b, JIT_CC_NE, JIT_RCX);
+            jit_byte(b, in->op == VM_OP_AND ? 0x20 : 0x08);
+            jit_byte(b, 0xC8);                                /* and/or al, cl */
+            jit_movzx_al(b, D);
+            break;
+        case VM_OP_IEQ: case VM_OP_INE: case VM_OP_ILT: case VM_OP_ILE: {
+            static const int cc[] = { JIT_CC_E, JIT_CC_NE, JIT_CC_L, JIT_CC_LE };
+            jit_alu_rr(b, 0x39, A, B);
+            jit_setcc(b, cc[in->op - VM_OP_IEQ], JIT_RAX);
+            jit_movzx_al(b, D);
+            break;
+        }
+        case VM_OP_IEQK: case VM_OP_INEK: case VM_OP_ILTK:
+        case VM_OP_ILEK: case VM_OP_IGTK: case VM_OP_IGEK: {
+            static const int cc[] = { JIT_CC_E, JIT_CC_NE, JIT_CC_L, JIT_CC_LE, JIT_CC_G, JIT_CC_GE };
+            if (fits) {
+                jit_alu_ri(b, 7, A, (int32_t)kv);
+            } else {
+                jit_mov_ri(b, JIT_RCX, kv);
+                jit_alu_rr(b, 0x39, A, JIT_RCX);
+            }
+            jit_setcc(b, cc[in->op - VM_OP_IEQK], JIT_RAX);
+            jit_movzx_al(b, D);
+            break;
+        }
+        case VM_OP_SELECT: {
+            const vm_instr_t* ext = &prog->code[++pc];
+            result = types[ext->a];
+            if (result == VM_INT) {
+                jit_mov_rr(b, JIT_RAX, jit_int_home[ext->b]);
+                jit_alu_rr(b, 0x85, A, A);
+                jit_cmov(b, JIT_CC_NE, JIT_RAX, jit_int_home[ext->a]);
+                jit_mov_rr(b, D, JIT_RAX);
+            } else {
+                jit_sse(b, 0x66, 0, 0x28, JIT_X15, ext->b);
+                jit_alu_rr(b, 0x85, A, A);
+                j1 = jit_jump(b, JIT_CC_E);
+                jit_sse(b, 0x66, 0, 0x28, JIT_X15, ext->a);
+                jit_patch(b, j1);
+                jit_movapd(b, XD, JIT_X15);
+            }
+            break;
+        }
+
+        case VM_OP_FADD: case VM_OP_FSUB: case VM_OP_FMUL: case VM_OP_FDIV: {
+            static const uint8_t op[] = { 0x58, 0x5C, 0x59, 0x5E };
+            jit_sse(b, 0x66, 0, 0x28, JIT_X15, XA);
+            jit_sse(b, 0xF2, 0, op[in->op - VM_OP_FADD], JIT_X15, XB);
+            jit_movapd(b, XD, JIT_X15);
+            result = VM_FLOAT;
+            break;
+        }
+        case VM_OP_FADDK: case VM_OP_FSUBK: case VM_OP_FMULK: case VM_OP_FDIVK: {
+            static const uint8_t op[] = { 0x58, 0x5C, 0x59, 0x5E };
+            jit_load_double(b, JIT_X14, (uint64_t)kv);
+            jit_sse(b, 0x66, 0, 0x28, JIT_X15, XA);
+            jit_sse(b, 0xF2, 0, op[in->op - VM_OP_FADDK], JIT_X15, JIT_X14);
+            jit_movapd(b, XD, JIT_X15);
+            result = VM_FLOAT;
+            break;
+        }
+        case VM_OP_FNEG: case VM_OP_FABS:
+            jit_load_double(b, JIT_X15, in->op == VM_OP_FNEG ? 0x8000000000000000ull : 0x7FFFFFFFFFFFFFFFull);
+            jit_sse(b, 0x66, 0, in->op == VM_OP_FNEG ? 0x57 : 0x54, JIT_X15, XA);
+            jit_movapd(b, XD, JIT_X15);
+            result = VM_FLOAT;
+            break;
+        case VM_OP_FMIN: case VM_OP_FMAX:
+            /* minsd/maxsd return the second operand when either is NaN; fmin wants the other one. */
+            jit_sse(b, 0x66, 0, 0x28, JIT_X15, XA);
+            jit_sse(b, 0x66, 0, 0x2E, XB, XB);
+            j1 = jit_jump(b, JIT_CC_P);
+            jit_sse(b, 0xF2, 0, in->op == VM_OP_FMIN ? 0x5D : 0x5F, JIT_X15, XB);
+            jit_patch(b, j1);
+            jit_movapd(b, XD, JIT_X15);
+            result = VM_FLOAT;
+            break;
+        case VM_OP_I2F:
+            jit_sse(b, 0x66, 0, 0x57, JIT_X15, JIT_X15);
+            jit_sse(b, 0xF2, 1, 0x2A, JIT_X15, A);
+            jit_movapd(b, XD, JIT_X15);
+            result = VM_FLOAT;
+            break;
+        case VM_OP_F2I:
+            /* cvttsd2si yields INT64_MIN for NaN and out-of-range values; fix up NaN and +overflow. */
+            jit_sse(b, 0xF2, 1, 0x2C, JIT_RAX, XA);
+            jit_sse(b, 0x66, 0, 0x2E, XA, XA);
+            j1 = jit_jump(b, JIT_CC_P);
+            jit_load_double(b, JIT_X15, 0x43E0000000000000ull);
+            jit_sse(b, 0x66, 0, 0x2E, XA, JIT_X15);
+            j2 = jit_jump(b, JIT_CC_B);
+            jit_mov_ri(b, JIT_RAX, INT64_MAX);
+            j3 = jit_jump(b, -1);
+            jit_patch(b, j1);
+            jit_mov_ri(b, JIT_RAX, 0);
+            jit_patch(b, j2);
+            jit_patch(b, j3);
+            jit_mov_rr(b, D, JIT_RAX);
+            break;
+        case VM_OP_FEQ: case VM_OP_FNE:
+            jit_sse(b, 0x66, 0, 0x2E, XA, XB);
+            jit_setcc(b, in->op == VM_OP_FEQ ? JIT_CC_E : JIT_CC_NE, JIT_RAX);
+            jit_setcc(b, in->op == VM_OP_FEQ ? JIT_CC_NP : JIT_CC_P, JIT_RCX);
+            jit_byte(b, in->op == VM_OP_FEQ ? 0x20 : 0x08);
+            jit_byte(b, 0xC8);
+            jit_movzx_al(b, D);
+            break;
+        case VM_OP_FLT: case VM_OP_FLE:
+            /* b > a and b >= a are false for unordered operands. */
+            jit_sse(b, 0x66, 0, 0x2E, XB, XA);
+            jit_setcc(b, in->op == VM_OP_FLT ? JIT_CC_A : JIT_CC_AE, JIT_RAX);
+            jit_movzx_al(b, D);
+            break;
+        default:
+            break;
+        }
+        types[in->dst] = result;
+    }
+}
+
+/********************* Compilation ***************************/
+
+/**
+ * @brief Compiles a program to machine code, or binds it to the VM when the JIT cannot handle it.
+ *
+ * Check `native` to learn which tier was chosen. The VM tier needs one of
+ * the VM_LAMBDA_SLOTS thunks; when they are all in use the compile fails,
+ * so a returned function always has a callable `fn`.
+ *
+ * @return jit_function_t* The function, or NULL (see vm_last_error()).
+ *
+ * Example usage:
+ * ```
+ * vm_program_t* prog = vm_compile("x > 10 && x < 500 ? x * 3 : 0", "x", VM_INT);
+ * jit_function_t* jf = jit_compile(prog);
+ * if (!jf) {
+ *     LOG_ERROR(vm_last_error());
+ * }
+ * void* r = jf->fn((void*)20);           // lambda_t
+ * int64_t v = jit_eval_int(jf, 20);       // typed, 60
+ * jit_free(jf);
+ * vm_free(prog);
+ * ```
+ */
+static inline jit_function_t* jit_compile(const vm_program_t* prog) {
+    HANDLE_INVALID_ARGUMENT(prog, "jit_compile requires a program");
+    if (!prog) {
+        return NULL;
+    }
+    jit_function_t* jf = SAFE_MALLOC(sizeof(jit_function_t));
+    memset(jf, 0, sizeof(*jf));
+    jf->prog = prog;
+
+    if (jit_check(prog)) {
+        jit_buf_t b = { NULL, 0, 0 };
+        size_t entry[3];
+        for (int e = JIT_ENTRY_BOXED; e <= JIT_ENTRY_FLOAT; e++) {
+            while (b.len % 16) {
+                jit_byte(&b, 0xCC);
+            }
+            entry[e] = b.len;
+            jit_emit_entry(&b, prog, e);
+        }
+
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size = (b.len + page - 1) / page * page;
+        void* code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code != MAP_FAILED) {
+            memcpy(code, b.buf, b.len);
+            if (mprotect(code, size, PROT_READ | PROT_EXEC) == 0) {
+                jf->code = code;
+                jf->code_size = size;
+                jf->native = 1;
+                jf->fn = (lambda_t)(void*)((uint8_t*)code + entry[JIT_ENTRY_BOXED]);
+                jf->int_fn = (int64_t (*)(int64_t))(void*)((uint8_t*)code + entry[JIT_ENTRY_INT]);
+                jf->float_fn = (double (*)(double))(void*)((uint8_t*)code + entry[JIT_ENTRY_FLOAT]);
+            } else {
+                LOG_WARNING("mprotect(PROT_EXEC) refused, falling back to the VM");
+                munmap(code, size);
+            }
+        }
+        free(b.buf);
+    }
+
+    if (!jf->native) {
+        jf->fn = vm_as_lambda(prog);
+        if (!jf->fn) {
+            snprintf(vm_error_buffer, sizeof(vm_error_buffer), "no free VM lambda slot");
+            free(jf);
+            return NULL;
+        }
+    }
+    return jf;
+}
+
+/**
+ * @brief Compiles an expression string straight to a jit function.
+ *
+ * The program is owned by the returned function and freed by jit_free().
+ * Returns NULL and sets vm_last_error() when the expression does not
+ * compile or jit_compile() fails.
+ *
+ * Example usage:
+ * ```
+ * jit_function_t* add = jit_compile_expr("x + 10", "x", VM_INT);
+ * int result = (intptr_t)add->fn((void*)5);
+ * ```
+ */
+static inline jit_function_t* jit_compile_expr(const char* src, const char* param, vm_type_t param_type) {
+    vm_program_t* prog = vm_compile(src, param, param_type);
+    if (!prog) {
+        return NULL;
+    }
+    jit_function_t* jf = jit_compile(prog);
+    if (!jf) {
+        vm_free(prog);
+        return NULL;
+    }
+    jf->owned = prog;
+    return jf;
+}
+
+/**
+ * @brief Releases a jit function. Programs from jit_compile_expr() are freed too.
+ */
+static inline void jit_free(jit_function_t* jf) {
+    if (!jf) {
+        return;
+    }
+    if (jf->native) {
+        munmap(jf->code, jf->code_size);
+    } else if (jf->fn) {
+        vm_release_lambda(jf->fn);
+    }
+    if (jf->owned) {
+        vm_free(jf->owned);
+    }
+    SAFE_FREE(jf);
+}
+
+/**
+ * @brief Calls a jit function with an integer argument, like vm_eval_int().
+ */
+static inline int64_t jit_eval_int(const jit_function_t* jf, int64_t x) {
+    return jf->int_fn ? jf->int_fn(x) : vm_eval_int(jf->prog, x);
+}
+
+/**
+ * @brief Calls a jit function with a float argument, like vm_eval_float().
+ */
+static inline double jit_eval_float(const jit_function_t* jf, double x) {
+    return jf->float_fn ? jf->float_fn(x) : vm_eval_float(jf->prog, x);
+}
+
+
+#endif /* LAMBDA_JIT_H */
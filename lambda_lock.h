@@ -0,0 +1,649 @@
+#ifndef LAMBDA_LOCK_H
+#define LAMBDA_LOCK_H
+
+#include "lambda.h"
+#include <stdatomic.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#endif
+
+
+// summarized list of all of the macros and functions defined in the lambda_lock.h
+
+/**
+ * Lock Types (usable as the type parameter of the macros below):
+ *
+ * mutex: pthread_mutex_t, same behaviour as LOCK_MUTEX / UNLOCK_MUTEX.
+ * adaptive: Spins for an adaptively tuned number of rounds, then parks on a futex.
+ * ticket: FIFO ticket lock for fairness under heavy contention; collapses when threads outnumber cores.
+ * rw: Writer-preferring reader-writer lock; LOCK_AS takes it exclusively.
+ */
+
+/**
+ * Generic Lock Macros:
+ *
+ * DEFINE_LOCK(type, name): Declares a lock of the given type.
+ * INIT_LOCK(type, lock_ptr): Initializes a lock (named after lock_ptr when profiling).
+ * LOCK_AS(type, lock_ptr): Acquires a lock exclusively.
+ * UNLOCK_AS(type, lock_ptr): Releases an exclusively held lock.
+ * DESTROY_LOCK(type, lock_ptr): Releases the resources of a lock.
+ * READ_LOCK(lock_ptr) / READ_UNLOCK(lock_ptr): Shared acquisition of an rw lock.
+ */
+
+/**
+ * Contention Profiling (compile with -DLOCK_PROFILING):
+ *
+ * lock_profile_report(out): Prints per-lock acquisitions, contended acquires, wait and hold time.
+ *   Shared (read) acquisitions of an rw lock count toward acquisitions, contention and wait time only;
+ *   hold time is that of exclusive holders.
+ * lock_profile_reset(): Clears all recorded statistics.
+ */
+
+
+/**
+ * @file lambda_lock.h
+ * @brief Lock implementations selectable per call site, with optional contention profiling.
+ *
+ * LOCK_MUTEX always maps onto pthread_mutex_lock. The macros in this header
+ * take the lock type as their first argument, so a hot lock can be switched
+ * from `mutex` to `adaptive`, `ticket` or `rw` by editing its declaration and
+ * the type argument at its call sites. Building with -DLOCK_PROFILING makes
+ * every lock record its statistics; lock_profile_report() then shows which
+ * locks are worth switching.
+ */
+
+/********************* Tuning Parameters ***************************/
+
+#ifndef LOCK_SPIN_MAX
+#define LOCK_SPIN_MAX 1000
+#endif
+
+#ifndef LOCK_SPIN_MIN
+#define LOCK_SPIN_MIN 16
+#endif
+
+/********************* Platform Helpers ***************************/
+
+static inline void lock_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+static inline void lock_futex_wait(_Atomic uint32_t* addr, uint32_t expected) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    (void)addr;
+    (void)expected;
+    sched_yield();
+#endif
+}
+
+static inline void lock_futex_wake(_Atomic uint32_t* addr, int count) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+    (void)addr;
+    (void)count;
+#endif
+}
+
+/********************* Contention Profiling ***************************/
+
+/**
+ * @brief Statistics recorded for one lock when LOCK_PROFILING is defined.
+ */
+typedef struct lock_stats {
+    const char* name;
+    _Atomic uint64_t acquisitions;
+    _Atomic uint64_t contended;
+    _Atomic uint64_t wait_ns;
+    _Atomic uint64_t hold_ns;
+    _Atomic uint64_t acquired_at;
+    struct lock_stats* next;
+} lock_stats_t;
+
+#ifdef LOCK_PROFILING
+
+static inline uint64_t lock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static _Atomic(lock_stats_t*) lock_profile_registry;
+
+static inline void lock_stats_register(lock_stats_t* stats, const char* name) {
+    memset(stats, 0, sizeof(*stats));
+    stats->name = name;
+    stats->next = atomic_load_explicit(&lock_profile_registry, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&lock_profile_registry, &stats->next, stats,
+                                                  memory_order_release, memory_order_relaxed)) {
+    }
+}
+
+static inline void lock_stats_unregister(lock_stats_t* stats) {
+    // Locks are expected to be destroyed while no profiling report runs.
+    _Atomic(lock_stats_t*)* link = &lock_profile_registry;
+    lock_stats_t* cur;
+    while ((cur = atomic_load_explicit(link, memory_order_acquire))) {
+        if (cur == stats) {
+            atomic_store_explicit(link, cur->next, memory_order_release);
+            return;
+        }
+        link = (_Atomic(lock_stats_t*)*)&cur->next;
+    }
+}
+
+#define LOCK_PROFILE_BEGIN() uint64_t lock_wait_start__ = lock_now_ns()
+
+static inline uint64_t lock_profile_acquired(lock_stats_t* stats, uint64_t wait_start, int was_contended) {
+    uint64_t now = lock_now_ns();
+    atomic_fetch_add_explicit(&stats->acquisitions, 1, memory_order_relaxed);
+    if (was_contended) {
+        atomic_fetch_add_explicit(&stats->contended, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&stats->wait_ns, now - wait_start, memory_order_relaxed);
+    return now;
+}
+
+#define LOCK_PROFILE_ACQUIRED(stats, was_contended) \
+    atomic_store_explicit(&(stats)->acquired_at, \
+                          lock_profile_acquired(stats, lock_wait_start__, was_contended), memory_order_relaxed)
+
+/* Shared holders overlap, so they record wait and contention but not hold time. */
+#define LOCK_PROFILE_SHARED_ACQUIRED(stats, was_contended) \
+    ((void)lock_profile_acquired(stats, lock_wait_start__, was_contended))
+
+#define LOCK_PROFILE_RELEASED(stats) \
+    atomic_fetch_add_explicit(&(stats)->hold_ns, \
+                              lock_now_ns() - atomic_load_explicit(&(stats)->acquired_at, memory_order_relaxed), \
+                              memory_order_relaxed)
+
+/**
+ * @brief Prints the statistics of every live lock, most contended first.
+ *
+ * @param out The stream to print to.
+ *
+ * Example usage:
+ * ```
+ * lock_profile_report(stderr);
+ * ```
+ */
+static inline void lock_profile_report(FILE* out) {
+    size_t count = 0;
+    for (lock_stats_t* s = atomic_load(&lock_profile_registry); s; s = s->next) {
+        count++;
+    }
+    if (count == 0) {
+        return;
+    }
+    lock_stats_t** sorted = SAFE_MALLOC(count * sizeof(lock_stats_t*));
+    size_t i = 0;
+    for (lock_stats_t* s = atomic_load(&lock_profile_registry); s && i < count; s = s->next) {
+        sorted[i++] = s;
+    }
+    count = i;
+    for (i = 1; i < count; i++) {
+        lock_stats_t* key = sorted[i];
+        size_t j = i;
+        while (j > 0 && atomic_load(&sorted[j - 1]->wait_ns) < atomic_load(&key->wait_ns)) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = key;
+    }
+    fprintf(out, "%-32s %14s %12s %8s %14s %14s\n",
+            "lock", "acquisitions", "contended", "cont%", "wait_us", "hold_us");
+    for (i = 0; i < count; i++) {
+        lock_stats_t* s = sorted[i];
+        uint64_t acq = atomic_load(&s->acquisitions);
+        uint64_t cont = atomic_load(&s->contended);
+        fprintf(out, "%-32s %14llu %12llu %7.2f%% %14.1f %14.1f\n",
+                s->name ? s->name : "(unnamed)",
+                (unsigned long long)acq, (unsigned long long)cont,
+                acq ? 100.0 * (double)cont / (double)acq : 0.0,
+                (double)atomic_load(&s->wait_ns) / 1000.0,
+                (double)atomic_load(&s->hold_ns) / 1000.0);
+    }
+    free(sorted);
+}
+
+/**
+ * @brief Clears the statistics of every live lock.
+ *
+ * Example usage:
+ * ```
+ * lock_profile_reset();
+ * ```
+ */
+static inline void lock_profile_reset(void) {
+    for (lock_stats_t* s = atomic_load(&lock_profile_registry); s; s = s->next) {
+        atomic_store(&s->acquisitions, 0);
+        atomic_store(&s->contended, 0);
+        atomic_store(&s->wait_ns, 0);
+        atomic_store(&s->hold_ns, 0);
+    }
+}
+
+#define LOCK_STATS_FIELD lock_stats_t stats;
+
+#else
+
+#define lock_stats_register(stats, name) ((void)(name))
+#define lock_stats_unregister(stats) ((void)0)
+#define LOCK_PROFILE_BEGIN() ((void)0)
+#define LOCK_PROFILE_SHARED_ACQUIRED(stats, was_contended) ((void)(was_contended))
+#define LOCK_PROFILE_ACQUIRED(stats, was_contended) ((void)(was_contended))
+#define LOCK_PROFILE_RELEASED(stats) ((void)0)
+#define LOCK_STATS_FIELD
+
+static inline void lock_profile_report(FILE* out) {
+    (void)out;
+}
+
+static inline void lock_profile_reset(void) {
+}
+
+#endif
+
+/********************* Mutex Lock ***************************/
+
+/**
+ * @brief pthread mutex wrapper with the same error handling as LOCK_MUTEX.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    LOCK_STATS_FIELD
+} mutex_lock_t;
+
+static inline void mutex_lock_init(mutex_lock_t* lock, const char* name) {
+    if (pthread_mutex_init(&lock->mutex, NULL) != 0) {
+        HANDLE_ERROR("Failed to initialize mutex");
+    }
+    lock_stats_register(&lock->stats, name);
+}
+
+static inline void mutex_lock_destroy(mutex_lock_t* lock) {
+    lock_stats_unregister(&lock->stats);
+    pthread_mutex_destroy(&lock->mutex);
+}
+
+static inline void mutex_lock(mutex_lock_t* lock) {
+    LOCK_PROFILE_BEGIN();
+    int contended = 0;
+    if (pthread_mutex_trylock(&lock->mutex) != 0) {
+        contended = 1;
+        LOCK_MUTEX(&lock->mutex);
+    }
+    LOCK_PROFILE_ACQUIRED(&lock->stats, contended);
+}
+
+static inline void mutex_unlock(mutex_lock_t* lock) {
+    LOCK_PROFILE_RELEASED(&lock->stats);
+    UNLOCK_MUTEX(&lock->mutex);
+}
+
+/********************* Adaptive Lock ***************************/
+
+/**
+ * @brief Spin-then-park lock.
+ *
+ * state is 0 (free), 1 (held) or 2 (held with sleepers). Contended
+ * acquisitions first spin for spin_limit rounds; the limit follows a moving
+ * average of how long spinning actually took to succeed, so locks with short
+ * critical sections spin and locks with long ones park almost immediately.
+ */
+typedef struct {
+    _Atomic uint32_t state;
+    _Atomic uint32_t spin_limit;
+    LOCK_STATS_FIELD
+} adaptive_lock_t;
+
+static inline void adaptive_lock_init(adaptive_lock_t* lock, const char* name) {
+    atomic_init(&lock->state, 0);
+    atomic_init(&lock->spin_limit, LOCK_SPIN_MIN * 4);
+    lock_stats_register(&lock->stats, name);
+}
+
+static inline void adaptive_lock_destroy(adaptive_lock_t* lock) {
+    (void)lock;
+    lock_stats_unregister(&lock->stats);
+}
+
+static inline int adaptive_trylock(adaptive_lock_t* lock) {
+    uint32_t expected = 0;
+    return atomic_compare_exchange_strong_explicit(&lock->state, &expected, 1,
+                                                   memory_order_acquire, memory_order_relaxed);
+}
+
+static inline void adaptive_lock_slow(adaptive_lock_t* lock) {
+    uint32_t limit = atomic_load_explicit(&lock->spin_limit, memory_order_relaxed);
+    uint32_t spins = 0;
+    while (spins < limit) {
+        spins++;
+        if (atomic_load_explicit(&lock->state, memory_order_relaxed) == 0 && adaptive_trylock(lock)) {
+            int64_t grown = (int64_t)limit + ((int64_t)spins * 2 - (int64_t)limit) / 8 + 1;
+            if (grown > LOCK_SPIN_MAX) {
+                grown = LOCK_SPIN_MAX;
+            } else if (grown < LOCK_SPIN_MIN) {
+                grown = LOCK_SPIN_MIN;
+            }
+            atomic_store_explicit(&lock->spin_limit, (uint32_t)grown, memory_order_relaxed);
+            return;
+        }
+        lock_cpu_relax();
+    }
+    uint32_t shrunk = limit - limit / 8;
+    atomic_store_explicit(&lock->spin_limit, shrunk < LOCK_SPIN_MIN ? LOCK_SPIN_MIN : shrunk,
+                          memory_order_relaxed);
+
+    uint32_t state = atomic_exchange_explicit(&lock->state, 2, memory_order_acquire);
+    while (state != 0) {
+        lock_futex_wait(&lock->state, 2);
+        state = atomic_exchange_explicit(&lock->state, 2, memory_order_acquire);
+    }
+}
+
+static inline void adaptive_lock(adaptive_lock_t* lock) {
+    LOCK_PROFILE_BEGIN();
+    int contended = 0;
+    if (!adaptive_trylock(lock)) {
+        contended = 1;
+        adaptive_lock_slow(lock);
+    }
+    LOCK_PROFILE_ACQUIRED(&lock->stats, contended);
+}
+
+static inline void adaptive_unlock(adaptive_lock_t* lock) {
+    LOCK_PROFILE_RELEASED(&lock->stats);
+    if (atomic_exchange_explicit(&lock->state, 0, memory_order_release) == 2) {
+        lock_futex_wake(&lock->state, 1);
+    }
+}
+
+/********************* Ticket Lock ***************************/
+
+/**
+ * @brief FIFO ticket lock.
+ *
+ * Waiters back off in proportion to their distance from the head of the
+ * queue and yield the CPU once they have spun for LOCK_SPIN_MAX rounds, so
+ * an oversubscribed machine does not livelock.
+ *
+ * It still collapses under oversubscription. With more contending threads
+ * than cores, the lock is handed in FIFO order to waiters that are not
+ * running, and every hand-off waits for the scheduler: lockBenchmark.c
+ * measures about 20 us per acquisition against about 26 ns for the mutex
+ * on one core. Use it only when contenders do not outnumber cores.
+ */
+typedef struct {
+    _Atomic uint32_t next;
+    _Atomic uint32_t serving;
+    LOCK_STATS_FIELD
+} ticket_lock_t;
+
+static inline void ticket_lock_init(ticket_lock_t* lock, const char* name) {
+    atomic_init(&lock->next, 0);
+    atomic_init(&lock->serving, 0);
+    lock_stats_register(&lock->stats, name);
+}
+
+static inline void ticket_lock_destroy(ticket_lock_t* lock) {
+    (void)lock;
+    lock_stats_unregister(&lock->stats);
+}
+
+static inline void ticket_lock(ticket_lock_t* lock) {
+    LOCK_PROFILE_BEGIN();
+    uint32_t ticket = atomic_fetch_add_explicit(&lock->next, 1, memory_order_relaxed);
+    uint32_t serving = atomic_load_explicit(&lock->serving, memory_order_acquire);
+    int contended = serving != ticket;
+    uint32_t spins = 0;
+    while (serving != ticket) {
+        uint32_t distance = ticket - serving;
+        for (uint32_t i = 0; i < distance * 8; i++) {
+            lock_cpu_relax();
+        }
+        spins += distance * 8;
+        if (spins > LOCK_SPIN_MAX) {
+            sched_yield();
+            spins = 0;
+        }
+        serving = atomic_load_explicit(&lock->serving, memory_order_acquire);
+    }
+    LOCK_PROFILE_ACQUIRED(&lock->stats, contended);
+}
+
+static inline void ticket_unlock(ticket_lock_t* lock) {
+    LOCK_PROFILE_RELEASED(&lock->stats);
+    atomic_store_explicit(&lock->serving,
+                          atomic_load_explicit(&lock->serving, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+/********************* Reader-Writer Lock ***************************/
+
+#define RW_LOCK_WRITER 0x80000000u
+#define RW_LOCK_WRITER_WAITING 0x40000000u
+#define RW_LOCK_READERS 0x3fffffffu
+
+/**
+ * @brief Writer-preferring reader-writer lock.
+ *
+ * A waiting writer sets RW_LOCK_WRITER_WAITING, which stops new readers
+ * from entering, so writers are not starved by a steady stream of readers.
+ * Waiting writers are also counted, and whoever replaces the state word
+ * (an acquiring writer or rw_unlock) recomputes the bit from that count
+ * rather than clearing it under another waiter. Both sides spin briefly
+ * before parking on the state word.
+ */
+typedef struct {
+    _Atomic uint32_t state;
+    _Atomic uint32_t sleepers;
+    _Atomic uint32_t writers_waiting;
+    LOCK_STATS_FIELD
+} rw_lock_t;
+
+static inline void rw_lock_init(rw_lock_t* lock, const char* name) {
+    atomic_init(&lock->state, 0);
+    atomic_init(&lock->sleepers, 0);
+    atomic_init(&lock->writers_waiting, 0);
+    lock_stats_register(&lock->stats, name);
+}
+
+static inline void rw_lock_destroy(rw_lock_t* lock) {
+    (void)lock;
+    lock_stats_unregister(&lock->stats);
+}
+
+static inline void rw_lock_park(rw_lock_t* lock, uint32_t observed) {
+    atomic_fetch_add_explicit(&lock->sleepers, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&lock->state, memory_order_seq_cst) == observed) {
+        lock_futex_wait(&lock->state, observed);
+    }
+    atomic_fetch_sub_explicit(&lock->sleepers, 1, memory_order_relaxed);
+}
+
+static inline void rw_lock_wake(rw_lock_t* lock) {
+    if (atomic_load_explicit(&lock->sleepers, memory_order_seq_cst)) {
+        lock_futex_wake(&lock->state, INT_MAX);
+    }
+}
+
+static inline void rw_read_lock(rw_lock_t* lock) {
+    LOCK_PROFILE_BEGIN();
+    int contended = 0;
+    uint32_t spins = 0;
+    for (;;) {
+        uint32_t state = atomic_load_explicit(&lock->state, memory_order_relaxed);
+        if (!(state & (RW_LOCK_WRITER | RW_LOCK_WRITER_WAITING))) {
+            if (atomic_compare_exchange_weak_explicit(&lock->state, &state, state + 1,
+                                                      memory_order_acquire, memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+        contended = 1;
+        if (++spins < LOCK_SPIN_MAX) {
+            lock_cpu_relax();
+        } else {
+            rw_lock_park(lock, state);
+        }
+    }
+    LOCK_PROFILE_SHARED_ACQUIRED(&lock->stats, contended);
+}
+
+static inline void rw_read_unlock(rw_lock_t* lock) {
+    uint32_t state = atomic_fetch_sub_explicit(&lock->state, 1, memory_order_seq_cst) - 1;
+    if ((state & RW_LOCK_READERS) == 0 && (state & RW_LOCK_WRITER_WAITING)) {
+        rw_lock_wake(lock);
+    }
+}
+
+static inline void rw_lock(rw_lock_t* lock) {
+    LOCK_PROFILE_BEGIN();
+    int contended = 0;
+    uint32_t spins = 0;
+    for (;;) {
+        uint32_t state = atomic_load_explicit(&lock->state, memory_order_relaxed);
+        if ((state & ~RW_LOCK_WRITER_WAITING) == 0) {
+            // Other writers still waiting keep the bit; a writer registering after this
+            // load sets it again itself, which makes this CAS fail or lands on top of it.
+            uint32_t others = atomic_load_explicit(&lock->writers_waiting, memory_order_seq_cst) - (uint32_t)contended;
+            uint32_t desired = RW_LOCK_WRITER | (others ? RW_LOCK_WRITER_WAITING : 0);
+            if (atomic_compare_exchange_weak_explicit(&lock->state, &state, desired,
+                                                      memory_order_acquire, memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+        if (!contended) {
+            atomic_fetch_add_explicit(&lock->writers_waiting, 1, memory_order_seq_cst);
+            contended = 1;
+        }
+        if (!(state & RW_LOCK_WRITER_WAITING)) {
+            atomic_fetch_or_explicit(&lock->state, RW_LOCK_WRITER_WAITING, memory_order_relaxed);
+            state |= RW_LOCK_WRITER_WAITING;
+        }
+        if (++spins < LOCK_SPIN_MAX) {
+            lock_cpu_relax();
+        } else {
+            rw_lock_park(lock, state);
+        }
+    }
+    if (contended) {
+        atomic_fetch_sub_explicit(&lock->writers_waiting, 1, memory_order_relaxed);
+    }
+    LOCK_PROFILE_ACQUIRED(&lock->stats, contended);
+}
+
+static inline void rw_unlock(rw_lock_t* lock) {
+    LOCK_PROFILE_RELEASED(&lock->stats);
+    uint32_t waiting = atomic_load_explicit(&lock->writers_waiting, memory_order_seq_cst);
+    atomic_store_explicit(&lock->state, waiting ? RW_LOCK_WRITER_WAITING : 0, memory_order_seq_cst);
+    rw_lock_wake(lock);
+}
+
+/********************* Generic Lock Macros ***************************/
+
+/**
+ * @brief Macro for declaring a lock of a selectable type.
+ *
+ * @param type One of mutex, adaptive, ticket or rw.
+ * @param name The name of the lock variable.
+ *
+ * Example usage:
+ * ```
+ * DEFINE_LOCK(adaptive, table_lock);
+ * ```
+ */
+#define DEFINE_LOCK(type, name) \
+    type##_lock_t name
+
+/**
+ * @brief Macro for initializing a lock. The lock is named after its expression when profiling.
+ *
+ * @param type The lock type.
+ * @param lock_ptr Pointer to the lock.
+ *
+ * Example usage:
+ * ```
+ * INIT_LOCK(adaptive, &table_lock);
+ * ```
+ */
+#define INIT_LOCK(type, lock_ptr) \
+    type##_lock_init(lock_ptr, #lock_ptr)
+
+/**
+ * @brief Macro for releasing the resources of a lock.
+ *
+ * @param type The lock type.
+ * @param lock_ptr Pointer to the lock.
+ *
+ * Example usage:
+ * ```
+ * DESTROY_LOCK(adaptive, &table_lock);
+ * ```
+ */
+#define DESTROY_LOCK(type, lock_ptr) \
+    type##_lock_destroy(lock_ptr)
+
+/**
+ * @brief Macro for acquiring a lock exclusively; the typed counterpart of LOCK_MUTEX.
+ *
+ * @param type The lock type.
+ * @param lock_ptr Pointer to the lock.
+ *
+ * Example usage:
+ * ```
+ * LOCK_AS(adaptive, &table_lock);
+ * ```
+ */
+#define LOCK_AS(type, lock_ptr) \
+    type##_lock(lock_ptr)
+
+/**
+ * @brief Macro for releasing an exclusively held lock; the typed counterpart of UNLOCK_MUTEX.
+ *
+ * @param type The lock type.
+ * @param lock_ptr Pointer to the lock.
+ *
+ * Example usage:
+ * ```
+ * UNLOCK_AS(adaptive, &table_lock);
+ * ```
+ */
+#define UNLOCK_AS(type, lock_ptr) \
+    type##_unlock(lock_ptr)
+
+/**
+ * @brief Macros for taking an rw lock in shared mode.
+ *
+ * @param lock_ptr Pointer to an rw_lock_t.
+ *
+ * Example usage:
+ * ```
+ * READ_LOCK(&config_lock);
+ * // read shared state
+ * READ_UNLOCK(&config_lock);
+ * ```
+ */
+#define READ_LOCK(lock_ptr) \
+    rw_read_lock(lock_ptr)
+
+#define READ_UNLOCK(lock_ptr) \
+    rw_read_unlock(lock_ptr)
+
+
+#endif /* LAMBDA_LOCK_H */
@@ -0,0 +1,829 @@
+#ifndef LAMBDA_NUMA_H
+#define LAMBDA_NUMA_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "lambda.h"
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef LAMBDA_HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+
+// summarized list of all of the macros and functions defined in the lambda_numa.h
+
+/**
+ * Topology:
+ *
+ * numa_topology_detect(topo): Reads nodes, their CPUs and distances (libnuma or sysfs).
+ * numa_topology_free(topo): Releases a detected topology.
+ */
+
+/**
+ * Worker Pool:
+ *
+ * numa_pool_create(workers_per_node): Starts workers pinned to the cores of every node.
+ * numa_pool_destroy(pool): Stops and joins the workers.
+ * numa_pool_run(pool, tasks, fn, ctx): Runs fn(task, ctx) for every task, node-local first.
+ * numa_pool_task_node(pool, task, tasks): Home node of a task in a run of `tasks` tasks.
+ * numa_pool_current_node(): Node of the calling worker, -1 outside the pool.
+ */
+
+/**
+ * NUMA Arrays:
+ *
+ * numa_array_create(pool, elem_size, count): Allocates chunks preferring, and first-touched on, their home node.
+ * numa_array_free(arr): Frees a NUMA array.
+ * numa_array_for_each_chunk(pool, arr, fn, ctx): Runs fn over every chunk on the chunk's node.
+ * numa_array_apply(pool, arr, lambda): Replaces every pointer-sized element by lambda(element).
+ * NUMA_ARRAY_FROM_DYNAMIC(pool, dyn): Copies a DYNAMIC_ARRAY into a NUMA array.
+ * NUMA_ARRAY_GET(arr, type, index): Accesses an element of a NUMA array.
+ */
+
+
+/**
+ * @file lambda_numa.h
+ * @brief NUMA-aware worker placement and first-touch memory for parallel lambda execution.
+ *
+ * Each node gets its own pinned workers. A parallel run splits its tasks
+ * into one contiguous range per node, in proportion to the node's worker
+ * count; workers drain their own node's range first and only then steal
+ * from other nodes, nearest first. NUMA arrays split their storage into
+ * chunks whose home node matches that split, set each chunk's policy to
+ * prefer its node and fault it in from a worker on that node, so chunk i
+ * is processed by the node that holds it.
+ *
+ * The policy is MPOL_PREFERRED rather than MPOL_BIND: when the home node
+ * runs out of free memory the kernel places the remaining pages on other
+ * nodes instead of failing the fault or invoking the OOM killer, so an
+ * oversized array runs slower instead of killing the process.
+ *
+ * With -DLAMBDA_HAVE_LIBNUMA (and -lnuma) the topology comes from
+ * numa_max_node(), numa_node_to_cpus() and numa_distance(), otherwise from
+ * sysfs; memory policy always goes through the raw mbind system call.
+ * Machines without NUMA information are treated as a single node holding
+ * every online CPU.
+ */
+
+/********************* Tuning Parameters ***************************/
+
+#ifndef NUMA_ARRAY_CHUNK_BYTES
+#define NUMA_ARRAY_CHUNK_BYTES (4u << 20)
+#endif
+
+#ifndef NUMA_MAX_NODES
+#define NUMA_MAX_NODES 64
+#endif
+
+/********************* Topology ***************************/
+
+/**
+ * @brief One NUMA node and the CPUs that belong to it.
+ */
+typedef struct {
+    int id;
+    int cpu_count;
+    int* cpus;
+} numa_node_t;
+
+/**
+ * @brief Detected machine topology. distance is node_count x node_count.
+ */
+typedef struct {
+    int node_count;
+    numa_node_t* nodes;
+    int* distance;
+} numa_topology_t;
+
+static inline int numa_parse_cpulist(const char* list, int** out) {
+    int capacity = 16, count = 0;
+    int* cpus = SAFE_MALLOC(capacity * sizeof(int));
+    const char* p = list;
+    while (*p && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p) {
+            break;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count == capacity) {
+                capacity *= 2;
+                int* grown = realloc(cpus, capacity * sizeof(int));
+                if (!grown) {
+                    HANDLE_MEMORY_ERROR("Failed to grow CPU list");
+                }
+                cpus = grown;
+            }
+            cpus[count++] = (int)cpu;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    *out = cpus;
+    return count;
+}
+
+static inline int numa_read_sysfs(const char* path, char* buf, size_t size) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    size_t n = fread(buf, 1, size - 1, fp);
+    buf[n] = '\0';
+    SAFE_FILE_CLOSE(fp);
+    return n > 0;
+}
+
+static inline void numa_topology_single(numa_topology_t* topo) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) {
+        online = 1;
+    }
+    topo->node_count = 1;
+    topo->nodes = SAFE_MALLOC(sizeof(numa_node_t));
+    topo->nodes[0].id = 0;
+    topo->nodes[0].cpu_count = (int)online;
+    topo->nodes[0].cpus = SAFE_MALLOC(online * sizeof(int));
+    for (long i = 0; i < online; i++) {
+        topo->nodes[0].cpus[i] = (int)i;
+    }
+    topo->distance = SAFE_MALLOC(sizeof(int));
+    topo->distance[0] = 10;
+}
+
+/**
+ * @brief Detects the NUMA nodes, their CPUs and the node distance matrix.
+ *
+ * Nodes without CPUs (memory-only nodes) are skipped. Falls back to a
+ * single node when no NUMA information is available.
+ *
+ * @param topo The topology to fill in.
+ *
+ * Example usage:
+ * ```
+ * numa_topology_t topo;
+ * numa_topology_detect(&topo);
+ * printf("%d nodes\n", topo.node_count);
+ * numa_topology_free(&topo);
+ * ```
+ */
+static inline void numa_topology_detect(numa_topology_t* topo) {
+    memset(topo, 0, sizeof(*topo));
+#ifdef LAMBDA_HAVE_LIBNUMA
+    if (numa_available() < 0) {
+        numa_topology_single(topo);
+        return;
+    }
+    int max_id = numa_max_node() < NUMA_MAX_NODES ? numa_max_node() + 1 : NUMA_MAX_NODES;
+    struct bitmask* mask = numa_allocate_cpumask();
+#else
+    int max_id = NUMA_MAX_NODES;
+    char path[128];
+    char buf[4096];
+#endif
+#ifdef __linux__
+    // Only CPUs this process may run on count, so cgroup/taskset limits are respected.
+    cpu_set_t allowed;
+    int have_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+#endif
+    topo->nodes = SAFE_MALLOC(NUMA_MAX_NODES * sizeof(numa_node_t));
+    for (int id = 0; id < max_id; id++) {
+        int* cpus;
+        int count;
+#ifdef LAMBDA_HAVE_LIBNUMA
+        if (numa_node_to_cpus(id, mask) != 0) {
+            continue;
+        }
+        cpus = SAFE_MALLOC((mask->size + 1) * sizeof(int));
+        count = 0;
+        for (unsigned long cpu = 0; cpu < mask->size; cpu++) {
+            if (numa_bitmask_isbitset(mask, (unsigned int)cpu)) {
+                cpus[count++] = (int)cpu;
+            }
+        }
+#else
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        if (!numa_read_sysfs(path, buf, sizeof(buf))) {
+            continue;
+        }
+        count = numa_parse_cpulist(buf, &cpus);
+#endif
+#ifdef __linux__
+        if (have_allowed) {
+            int kept = 0;
+            for (int i = 0; i < count; i++) {
+                if (cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &allowed)) {
+                    cpus[kept++] = cpus[i];
+                }
+            }
+            count = kept;
+        }
+#endif
+        if (count == 0) {
+            free(cpus);
+            continue;
+        }
+        numa_node_t* node = &topo->nodes[topo->node_count++];
+        node->id = id;
+        node->cpu_count = count;
+        node->cpus = cpus;
+    }
+#ifdef LAMBDA_HAVE_LIBNUMA
+    numa_free_cpumask(mask);
+#endif
+    if (topo->node_count == 0) {
+        free(topo->nodes);
+        numa_topology_single(topo);
+        return;
+    }
+
+    int n = topo->node_count;
+    topo->distance = SAFE_MALLOC((size_t)n * n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        int distances[NUMA_MAX_NODES] = {0};
+        int known = 0;
+#ifdef LAMBDA_HAVE_LIBNUMA
+        for (known = 0; known < max_id; known++) {
+            distances[known] = numa_distance(topo->nodes[i].id, known);
+        }
+#else
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/distance", topo->nodes[i].id);
+        if (numa_read_sysfs(path, buf, sizeof(buf))) {
+            char* p = buf;
+            char* end;
+            while (known < NUMA_MAX_NODES) {
+                long d = strtol(p, &end, 10);
+                if (end == p) {
+                    break;
+                }
+                distances[known++] = (int)d;
+                p = end;
+            }
+        }
+#endif
+        for (int j = 0; j < n; j++) {
+            int id = topo->nodes[j].id;
+            // numa_distance() reports 0 when the distance is unknown.
+            topo->distance[i * n + j] = id < known && distances[id] > 0 ? distances[id] : (i == j ? 10 : 20);
+        }
+    }
+}
+
+/**
+ * @brief Releases a topology filled in by numa_topology_detect().
+ *
+ * Example usage:
+ * ```
+ * numa_topology_free(&topo);
+ * ```
+ */
+static inline void numa_topology_free(numa_topology_t* topo) {
+    for (int i = 0; i < topo->node_count; i++) {
+        SAFE_FREE(topo->nodes[i].cpus);
+    }
+    SAFE_FREE(topo->nodes);
+    SAFE_FREE(topo->distance);
+    topo->node_count = 0;
+}
+
+/********************* Node-Local Memory ***************************/
+
+#define NUMA_MPOL_PREFERRED 1
+
+/**
+ * @brief Allocates page-aligned memory that prefers the given node.
+ *
+ * Pages land on node_id while it has free memory and on other nodes once
+ * it does not. If mbind fails (no NUMA support in the kernel) no policy is
+ * set and the node of the first write decides each page. The memory is not
+ * faulted in here.
+ */
+static inline void* numa_alloc_on_node(size_t bytes, int node_id) {
+    void* ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        HANDLE_MEMORY_ERROR("mmap failed for NUMA chunk");
+    }
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node_id >= 0 && node_id < NUMA_MAX_NODES) {
+        unsigned long mask[(NUMA_MAX_NODES + 63) / 64] = {0};
+        mask[node_id / 64] = 1ul << (node_id % 64);
+        syscall(SYS_mbind, ptr, bytes, NUMA_MPOL_PREFERRED, mask, NUMA_MAX_NODES + 1, 0);
+    }
+#endif
+    return ptr;
+}
+
+static inline void numa_free_on_node(void* ptr, size_t bytes) {
+    if (!ptr) {
+        return;
+    }
+    munmap(ptr, bytes);
+}
+
+/********************* Worker Pool ***************************/
+
+/**
+ * @brief Task callback run by numa_pool_run().
+ */
+typedef void (*numa_task_fn)(size_t task, void* ctx);
+
+typedef struct {
+    _Atomic size_t next;
+    size_t end;
+    char pad[64 - sizeof(size_t) * 2];
+} numa_range_t;
+
+struct numa_pool;
+
+typedef struct {
+    pthread_t thread;
+    struct numa_pool* pool;
+    int node;
+    int cpu;
+} numa_worker_t;
+
+/**
+ * @brief Pool of workers pinned per node.
+ *
+ * steal_order[n] lists the other nodes of node n, nearest first.
+ */
+typedef struct numa_pool {
+    numa_topology_t topo;
+    size_t worker_count;
+    numa_worker_t* workers;
+    size_t* node_workers;
+    int* steal_order;
+    numa_range_t* ranges;
+    numa_task_fn fn;
+    void* ctx;
+    int allow_steal;
+    uint64_t generation;
+    size_t active;
+    int stop;
+    _Atomic size_t local_tasks;
+    _Atomic size_t stolen_tasks;
+    pthread_mutex_t mutex;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    pthread_mutex_t run_mutex;
+} numa_pool_t;
+
+static __thread int numa_current_node = -1;
+
+/**
+ * @brief Returns the node index of the calling pool worker, or -1 for other threads.
+ */
+static inline int numa_pool_current_node(void) {
+    return numa_current_node;
+}
+
+/**
+ * @brief Returns the home node index of a task when `tasks` tasks are run.
+ *
+ * Tasks are split into contiguous per-node ranges proportional to each
+ * node's worker count. NUMA arrays use the same split for their chunks.
+ */
+static inline int numa_pool_task_node(const numa_pool_t* pool, size_t task, size_t tasks) {
+    size_t seen = 0;
+    for (int n = 0; n < pool->topo.node_count; n++) {
+        seen += pool->node_workers[n];
+        if ((unsigned __int128)task * pool->worker_count < (unsigned __int128)tasks * seen) {
+            return n;
+        }
+    }
+    return pool->topo.node_count - 1;
+}
+
+static inline int numa_pool_drain(numa_pool_t* pool, int node) {
+    numa_range_t* range = &pool->ranges[node];
+    int ran = 0;
+    for (;;) {
+        size_t task = atomic_fetch_add_explicit(&range->next, 1, memory_order_relaxed);
+        if (task >= range->end) {
+            return ran;
+        }
+        pool->fn(task, pool->ctx);
+        ran++;
+    }
+}
+
+static inline void* numa_worker_main(void* arg) {
+    numa_worker_t* worker = (numa_worker_t*)arg;
+    numa_pool_t* pool = worker->pool;
+    int nodes = pool->topo.node_count;
+    uint64_t seen = 0;
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    numa_current_node = worker->node;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->start_cond, &pool->mutex);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        size_t local = numa_pool_drain(pool, worker->node);
+        size_t stolen = 0;
+        if (pool->allow_steal) {
+            for (int i = 0; i < nodes - 1; i++) {
+                stolen += numa_pool_drain(pool, pool->steal_order[worker->node * nodes + i]);
+            }
+        }
+        atomic_fetch_add_explicit(&pool->local_tasks, local, memory_order_relaxed);
+        atomic_fetch_add_explicit(&pool->stolen_tasks, stolen, memory_order_relaxed);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+/**
+ * @brief Creates a pool with workers pinned to the CPUs of every node.
+ *
+ * @param workers_per_node Maximum workers per node, 0 for one per CPU.
+ * @return numa_pool_t* The new pool.
+ *
+ * Example usage:
+ * ```
+ * numa_pool_t* pool = numa_pool_create(0);
+ * ```
+ */
+static inline numa_pool_t* numa_pool_create(size_t workers_per_node) {
+    numa_pool_t* pool = SAFE_MALLOC(sizeof(numa_pool_t));
+    memset(pool, 0, sizeof(*pool));
+    numa_topology_detect(&pool->topo);
+    int nodes = pool->topo.node_count;
+
+    pool->node_workers = SAFE_MALLOC(nodes * sizeof(size_t));
+    for (int n = 0; n < nodes; n++) {
+        size_t count = (size_t)pool->topo.nodes[n].cpu_count;
+        if (workers_per_node && count > workers_per_node) {
+            count = workers_per_node;
+        }
+        pool->node_workers[n] = count;
+        pool->worker_count += count;
+    }
+
+    pool->steal_order = SAFE_MALLOC((size_t)nodes * nodes * sizeof(int));
+    for (int n = 0; n < nodes; n++) {
+        int* order = &pool->steal_order[n * nodes];
+        int k = 0;
+        for (int m = 0; m < nodes; m++) {
+            if (m != n) {
+                order[k++] = m;
+            }
+        }
+        for (int i = 1; i < k; i++) {
+            int key = order[i];
+            int j = i;
+            while (j > 0 && pool->topo.distance[n * nodes + order[j - 1]] >
+                                pool->topo.distance[n * nodes + key]) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = key;
+        }
+    }
+
+    if (posix_memalign((void**)&pool->ranges, 64, nodes * sizeof(numa_range_t)) != 0) {
+        HANDLE_MEMORY_ERROR("Failed to allocate NUMA task ranges");
+    }
+    memset(pool->ranges, 0, nodes * sizeof(numa_range_t));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_mutex_init(&pool->run_mutex, NULL);
+    pthread_cond_init(&pool->start_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    pool->workers = SAFE_MALLOC(pool->worker_count * sizeof(numa_worker_t));
+    size_t w = 0;
+    for (int n = 0; n < nodes; n++) {
+        for (size_t i = 0; i < pool->node_workers[n]; i++, w++) {
+            numa_worker_t* worker = &pool->workers[w];
+            worker->pool = pool;
+            worker->node = n;
+            worker->cpu = pool->topo.nodes[n].cpus[i];
+            if (pthread_create(&worker->thread, NULL, numa_worker_main, worker) != 0) {
+                HANDLE_ERROR("Failed to start NUMA worker thread");
+            }
+        }
+    }
+    return pool;
+}
+
+/**
+ * @brief Stops and joins the workers and frees the pool.
+ *
+ * Example usage:
+ * ```
+ * numa_pool_destroy(pool);
+ * ```
+ */
+static inline void numa_pool_destroy(numa_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    LOCK_MUTEX(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start_cond);
+    UNLOCK_MUTEX(&pool->mutex);
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->run_mutex);
+    pthread_cond_destroy(&pool->start_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->workers);
+    free(pool->ranges);
+    free(pool->steal_order);
+    free(pool->node_workers);
+    numa_topology_free(&pool->topo);
+    free(pool);
+}
+
+static inline void numa_pool_dispatch(numa_pool_t* pool, size_t tasks, numa_task_fn fn,
+                                      void* ctx, int allow_steal) {
+    if (tasks == 0) {
+        return;
+    }
+    LOCK_MUTEX(&pool->run_mutex);
+    size_t begin = 0, seen = 0;
+    for (int n = 0; n < pool->topo.node_count; n++) {
+        seen += pool->node_workers[n];
+        size_t end = (size_t)(((unsigned __int128)tasks * seen + pool->worker_count - 1) /
+                              pool->worker_count);
+        atomic_store_explicit(&pool->ranges[n].next, begin, memory_order_relaxed);
+        pool->ranges[n].end = end;
+        begin = end;
+    }
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->allow_steal = allow_steal;
+
+    LOCK_MUTEX(&pool->mutex);
+    pool->active = pool->worker_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start_cond);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    UNLOCK_MUTEX(&pool->mutex);
+    UNLOCK_MUTEX(&pool->run_mutex);
+}
+
+/**
+ * @brief Runs fn(task, ctx) for every task in [0, tasks) and waits for completion.
+ *
+ * Each node first runs its own contiguous range of tasks (see
+ * numa_pool_task_node()); idle workers then steal from the nearest nodes.
+ * Must not be called from inside a task of the same pool.
+ *
+ * Example usage:
+ * ```
+ * void square_block(size_t task, void* ctx) { ... }
+ * numa_pool_run(pool, 64, square_block, data);
+ * ```
+ */
+static inline void numa_pool_run(numa_pool_t* pool, size_t tasks, numa_task_fn fn, void* ctx) {
+    numa_pool_dispatch(pool, tasks, fn, ctx, 1);
+}
+
+/********************* NUMA Arrays ***************************/
+
+/**
+ * @brief Array stored as node-local chunks.
+ */
+typedef struct {
+    size_t elem_size;
+    size_t count;
+    size_t chunk_elems;
+    size_t chunk_count;
+    void** chunks;
+    size_t* chunk_bytes;
+    int* chunk_node;
+} numa_array_t;
+
+/**
+ * @brief Chunk callback: elements [first, first + n) live at data.
+ */
+typedef void (*numa_chunk_fn)(void* data, size_t n, size_t first, void* ctx);
+
+typedef struct {
+    numa_array_t* arr;
+    numa_chunk_fn fn;
+    void* ctx;
+} numa_chunk_job_t;
+
+static inline size_t numa_chunk_len(const numa_array_t* arr, size_t chunk) {
+    size_t first = chunk * arr->chunk_elems;
+    size_t left = arr->count - first;
+    return left < arr->chunk_elems ? left : arr->chunk_elems;
+}
+
+static inline void numa_chunk_task(size_t task, void* ctx) {
+    numa_chunk_job_t* job = (numa_chunk_job_t*)ctx;
+    job->fn(job->arr->chunks[task], numa_chunk_len(job->arr, task),
+            task * job->arr->chunk_elems, job->ctx);
+}
+
+static inline void numa_first_touch_task(size_t task, void* ctx) {
+    numa_array_t* arr = (numa_array_t*)ctx;
+    long page = sysconf(_SC_PAGESIZE);
+    char* data = (char*)arr->chunks[task];
+    for (size_t off = 0; off < arr->chunk_bytes[task]; off += (size_t)page) {
+        data[off] = 0;
+    }
+}
+
+/**
+ * @brief Allocates a zeroed NUMA array whose chunks live on their home nodes.
+ *
+ * Each chunk prefers its node and is then faulted in by a worker of that
+ * node, so placement is right whether or not mbind succeeded. Chunks that
+ * do not fit on their node spill to other nodes rather than failing.
+ *
+ * @param pool The pool that will process the array.
+ * @param elem_size Size of one element.
+ * @param count Number of elements.
+ * @return numa_array_t* The new array, or NULL if elem_size is 0.
+ *
+ * Example usage:
+ * ```
+ * numa_array_t* arr = numa_array_create(pool, sizeof(double), 100000000);
+ * ```
+ */
+static inline numa_array_t* numa_array_create(numa_pool_t* pool, size_t elem_size, size_t count) {
+    if (elem_size == 0) {
+        HANDLE_INVALID_ARGUMENT(elem_size, "NUMA array elements need a non-zero size");
+        return NULL;
+    }
+    numa_array_t* arr = SAFE_MALLOC(sizeof(numa_array_t));
+    arr->elem_size = elem_size;
+    arr->count = count;
+    arr->chunk_elems = NUMA_ARRAY_CHUNK_BYTES / elem_size;
+    if (arr->chunk_elems == 0) {
+        arr->chunk_elems = 1;
+    }
+    size_t min_chunks = pool->worker_count * 4;
+    if (count / arr->chunk_elems < min_chunks && count >= min_chunks) {
+        arr->chunk_elems = (count + min_chunks - 1) / min_chunks;
+    }
+    arr->chunk_count = count ? (count + arr->chunk_elems - 1) / arr->chunk_elems : 0;
+    arr->chunks = SAFE_MALLOC((arr->chunk_count + 1) * sizeof(void*));
+    arr->chunk_bytes = SAFE_MALLOC((arr->chunk_count + 1) * sizeof(size_t));
+    arr->chunk_node = SAFE_MALLOC((arr->chunk_count + 1) * sizeof(int));
+
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t c = 0; c < arr->chunk_count; c++) {
+        size_t bytes = numa_chunk_len(arr, c) * elem_size;
+        bytes = (bytes + (size_t)page - 1) & ~((size_t)page - 1);
+        int node = numa_pool_task_node(pool, c, arr->chunk_count);
+        arr->chunk_node[c] = node;
+        arr->chunk_bytes[c] = bytes;
+        arr->chunks[c] = numa_alloc_on_node(bytes, pool->topo.nodes[node].id);
+    }
+    numa_pool_dispatch(pool, arr->chunk_count, numa_first_touch_task, arr, 0);
+    return arr;
+}
+
+/**
+ * @brief Frees a NUMA array.
+ *
+ * Example usage:
+ * ```
+ * numa_array_free(arr);
+ * ```
+ */
+static inline void numa_array_free(numa_array_t* arr) {
+    if (!arr) {
+        return;
+    }
+    for (size_t c = 0; c < arr->chunk_count; c++) {
+        numa_free_on_node(arr->chunks[c], arr->chunk_bytes[c]);
+    }
+    free(arr->chunks);
+    free(arr->chunk_bytes);
+    free(arr->chunk_node);
+    free(arr);
+}
+
+/**
+ * @brief Macro for accessing an element of a NUMA array.
+ *
+ * @param arr Pointer to the numa_array_t.
+ * @param type The element type.
+ * @param index The element index.
+ *
+ * Example usage:
+ * ```
+ * NUMA_ARRAY_GET(arr, double, 42) = 1.0;
+ * ```
+ */
+#define NUMA_ARRAY_GET(arr, type, index) \
+    (((type*)(arr)->chunks[(index) / (arr)->chunk_elems])[(index) % (arr)->chunk_elems])
+
+/**
+ * @brief Runs fn over every chunk of the array, each chunk on its home node first.
+ *
+ * Example usage:
+ * ```
+ * void scale(void* data, size_t n, size_t first, void* ctx) { ... }
+ * numa_array_for_each_chunk(pool, arr, scale, &factor);
+ * ```
+ */
+static inline void numa_array_for_each_chunk(numa_pool_t* pool, numa_array_t* arr,
+                                             numa_chunk_fn fn, void* ctx) {
+    numa_chunk_job_t job = { arr, fn, ctx };
+    numa_pool_run(pool, arr->chunk_count, numa_chunk_task, &job);
+}
+
+static inline void numa_apply_chunk(void* data, size_t n, size_t first, void* ctx) {
+    (void)first;
+    lambda_t fn = *(lambda_t*)ctx;
+    void** items = (void**)data;
+    for (size_t i = 0; i < n; i++) {
+        items[i] = fn(items[i]);
+    }
+}
+
+/**
+ * @brief Replaces every element of a pointer-sized NUMA array by lambda(element).
+ *
+ * Example usage:
+ * ```
+ * Lambda(add5, x, return (void*)((intptr_t)x + 5););
+ * numa_array_apply(pool, arr, add5);
+ * ```
+ */
+static inline void numa_array_apply(numa_pool_t* pool, numa_array_t* arr, lambda_t fn) {
+    if (arr->elem_size != sizeof(void*)) {
+        HANDLE_INVALID_ARGUMENT(0, "numa_array_apply needs pointer-sized elements");
+        return;
+    }
+    numa_array_for_each_chunk(pool, arr, numa_apply_chunk, &fn);
+}
+
+typedef struct {
+    const char* src;
+    size_t elem_size;
+} numa_copy_job_t;
+
+static inline void numa_copy_in_chunk(void* data, size_t n, size_t first, void* ctx) {
+    numa_copy_job_t* job = (numa_copy_job_t*)ctx;
+    memcpy(data, job->src + first * job->elem_size, n * job->elem_size);
+}
+
+/**
+ * @brief Copies raw elements into a NUMA array, each chunk copied by its home node.
+ */
+static inline numa_array_t* numa_array_from(numa_pool_t* pool, const void* src,
+                                            size_t elem_size, size_t count) {
+    numa_array_t* arr = numa_array_create(pool, elem_size, count);
+    numa_copy_job_t job = { (const char*)src, elem_size };
+    numa_chunk_job_t chunk_job = { arr, numa_copy_in_chunk, &job };
+    numa_pool_dispatch(pool, arr->chunk_count, numa_chunk_task, &chunk_job, 0);
+    return arr;
+}
+
+/**
+ * @brief Macro for copying a DYNAMIC_ARRAY into a NUMA array.
+ *
+ * @param pool The pool that will process the array.
+ * @param dyn The dynamic array (not a pointer).
+ * @return numa_array_t* The new NUMA array.
+ *
+ * Example usage:
+ * ```
+ * DYNAMIC_ARRAY(double) values;
+ * numa_array_t* arr = NUMA_ARRAY_FROM_DYNAMIC(pool, values);
+ * ```
+ */
+#define NUMA_ARRAY_FROM_DYNAMIC(pool, dyn) \
+    numa_array_from(pool, (dyn).array, sizeof((dyn).array[0]), (dyn).size)
+
+
+#endif /* LAMBDA_NUMA_H */
@@ -0,0 +1,745 @@
+#ifndef LAMBDA_OUTPUT_H
+#define LAMBDA_OUTPUT_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "lambda.h"
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_output.h
+
+/**
+ * Sinks:
+ *
+ * output_sink_open(path, flags, buffer_size): Creates or truncates a file and returns a sink writing to it.
+ * output_sink_from_fd(fd, flags, buffer_size): Sink over an open descriptor (stdout, a pipe, a socket).
+ * output_sink_flush(sink): Waits until everything submitted so far has been written.
+ * output_sink_close(sink): Flushes, stops the flusher and closes the file; returns 0 or -1 after a write error.
+ */
+
+/**
+ * Writers (one per thread):
+ *
+ * output_writer_create(sink) / output_writer_destroy(writer): Per-thread double buffer.
+ * output_reserve(writer, n) / output_commit(writer, n): Direct access to n bytes of buffer space.
+ * output_end_record(writer): Marks a record boundary; records are never split between buffers.
+ * output_bytes(writer, data, n) / output_str(writer, s) / output_char(writer, c): Raw output.
+ * output_u64 / output_i64(writer, v): Integers in decimal, without printf.
+ * output_double(writer, v, decimals): Fixed-point decimal, without printf.
+ * output_newline(writer): Writes '\n' and ends the record.
+ * output_map(writer, base, stride, count, fn): Calls a formatting lambda for each element.
+ * output_writer_flush(writer): Submits the current buffer and waits for it to be written.
+ */
+
+/**
+ * Formatting:
+ *
+ * output_format_u64(buf, v) / output_format_i64(buf, v): Writes digits to buf and returns the length.
+ * output_format_double(buf, v, decimals): Writes v with decimals digits after the point.
+ */
+
+
+/**
+ * @file lambda_output.h
+ * @brief Batched, buffered output for lambda results, flushed in the background with writev.
+ *
+ * Each thread formats into its own writer: two large page-aligned buffers.
+ * A full buffer is queued on the sink and the writer carries on in the
+ * other one (a double-buffer swap), so formatting never waits for the
+ * disk unless both buffers are in flight. A flusher thread takes every
+ * queued buffer at once and hands them to a single writev, so the kernel
+ * sees a few large writes instead of one per line, and nothing is copied
+ * on the way. There is no stdio lock: threads only meet on the sink's
+ * queue, once per buffer.
+ *
+ * Buffers are submitted only at record boundaries (output_newline() or
+ * output_end_record()), so lines from different threads never interleave.
+ *
+ * OUTPUT_DIRECT opens files with O_DIRECT to bypass the page cache. The
+ * flusher then packs buffers into an aligned staging area, writes whole
+ * 4 KB blocks with pwrite and writes the final partial block without
+ * O_DIRECT on close. OUTPUT_SYNC skips the flusher thread and writes on
+ * the calling thread when a buffer fills.
+ *
+ * ```
+ * output_sink_t* sink = output_sink_open("results.txt", 0, 0);
+ * output_writer_t* out = output_writer_create(sink);
+ * for (size_t i = 0; i < n; i++) {
+ *     output_u64(out, ids[i]);
+ *     output_char(out, ',');
+ *     output_double(out, scores[i], 3);
+ *     output_newline(out);
+ * }
+ * output_writer_destroy(out);
+ * output_sink_close(sink);
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+#define OUTPUT_BUFFER_SIZE (1u << 20)
+#define OUTPUT_ALIGN 4096
+
+/** Flag: open the file with O_DIRECT (falls back to buffered I/O where unsupported). */
+#define OUTPUT_DIRECT 0x1
+/** Flag: write on the calling thread instead of a background flusher. */
+#define OUTPUT_SYNC 0x2
+/** Flag: append to an existing file instead of truncating it. */
+#define OUTPUT_APPEND 0x4
+
+/** Most buffers handed to one writev call. */
+#define OUTPUT_GATHER_MAX 64
+
+struct output_writer;
+
+/**
+ * @brief A full buffer waiting for the flusher.
+ */
+typedef struct {
+    struct output_writer* writer;
+    int slot;
+    size_t length;
+} output_chunk_t;
+
+typedef struct {
+    int fd;
+    int flags;
+    int owns_fd;
+    int error;
+    int stop;
+    size_t buffer_size;
+    output_chunk_t* queue;
+    size_t queued;
+    size_t queue_capacity;
+    size_t in_flight;
+    uint8_t* stage;
+    size_t staged;
+    off_t offset;
+    size_t bytes_written;
+    size_t write_calls;
+    pthread_t flusher;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_mutex_t write_mutex;
+} output_sink_t;
+
+/**
+ * @brief Per-thread writer. busy[i] is set while buffer i is queued or being written.
+ */
+typedef struct output_writer {
+    output_sink_t* sink;
+    uint8_t* buffers[2];
+    int busy[2];
+    int active;
+    size_t used;
+    size_t record_start;
+} output_writer_t;
+
+/**
+ * @brief Argument of an output_map() lambda.
+ */
+typedef struct {
+    output_writer_t* writer;
+    void* item;
+    size_t index;
+} output_item_t;
+
+/********************* Formatting ***************************/
+
+static const char output_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/**
+ * @brief Writes v in decimal to buf (up to 20 bytes, no terminator) and returns the length.
+ *
+ * Counts the digits first, then writes two at a time from a table, right to left.
+ *
+ * Example usage:
+ * ```
+ * char buf[20];
+ * size_t n = output_format_u64(buf, 1234567);
+ * ```
+ */
+static inline size_t output_format_u64(char* buf, uint64_t v) {
+    size_t n = 1;
+    for (uint64_t bound = 10; n < 20 && v >= bound; bound *= 10) {
+        n++;
+    }
+    char* p = buf + n;
+    while (v >= 100) {
+        unsigned pair = (unsigned)(v % 100);
+        v /= 100;
+        p -= 2;
+        memcpy(p, output_digit_pairs + pair * 2, 2);
+    }
+    if (v >= 10) {
+        memcpy(p - 2, output_digit_pairs + v * 2, 2);
+    } else {
+        p[-1] = (char)('0' + v);
+    }
+    return n;
+}
+
+/**
+ * @brief Signed variant of output_format_u64 (up to 20 bytes).
+ */
+static inline size_t output_format_i64(char* buf, int64_t v) {
+    if (v < 0) {
+        buf[0] = '-';
+        return 1 + output_format_u64(buf + 1, (uint64_t)0 - (uint64_t)v);
+    }
+    return output_format_u64(buf, (uint64_t)v);
+}
+
+/**
+ * @brief Writes v with decimals (0 to 9) digits after the point; returns the length (at most 32 bytes).
+ *
+ * v is scaled by 10^decimals and printed as two integers, rounded like
+ * printf's "%.*f". Scaled values of 2^52 and above go through snprintf
+ * ("%.17g" from 1e15 up). NaN and infinities print as "nan" and "inf".
+ *
+ * Example usage:
+ * ```
+ * char buf[32];
+ * size_t n = output_format_double(buf, 3.14159, 2);   // "3.14"
+ * ```
+ */
+static inline size_t output_format_double(char* buf, double v, int decimals) {
+    static const uint64_t scales[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+                                         100000000, 1000000000 };
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > 9) {
+        decimals = 9;
+    }
+    if (isnan(v)) {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+    size_t n = 0;
+    if (signbit(v)) {
+        buf[n++] = '-';
+        v = -v;
+    }
+    if (isinf(v)) {
+        memcpy(buf + n, "inf", 3);
+        return n + 3;
+    }
+    if (v >= 1e15) {
+        return n + (size_t)snprintf(buf + n, 32 - n, "%.17g", v);
+    }
+    uint64_t scale = scales[decimals];
+    double product = v * (double)scale;
+    if (product >= 4503599627370496.0) { /* 2^52: no longer exact to half a unit */
+        return n + (size_t)snprintf(buf + n, 32 - n, "%.*f", decimals, v);
+    }
+    double whole = floor(product);
+    double rest = product - whole;
+    uint64_t scaled = (uint64_t)whole;
+    if (rest > 0.5 + 1e-6) {
+        scaled++;
+    } else if (rest >= 0.5 - 1e-6) {
+        /* Near a tie the rounding error of the product decides, as printf rounds the exact value. */
+        double error = fma(v, (double)scale, -product);
+        if (rest > 0.5 || (rest == 0.5 && (error > 0 || (error == 0 && (scaled & 1))))) {
+            scaled++;
+        }
+    }
+    n += output_format_u64(buf + n, scaled / scale);
+    if (decimals > 0) {
+        buf[n++] = '.';
+        uint64_t frac = scaled % scale;
+        for (int d = decimals - 1; d >= 0; d--) {
+            buf[n + (size_t)d] = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+        n += (size_t)decimals;
+    }
+    return n;
+}
+
+/********************* Flushing ***************************/
+
+/* Writes all of iov, retrying short writes, EINTR and EAGAIN on non-blocking descriptors. */
+static inline int output_writev_all(output_sink_t* sink, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(sink->fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = { sink->fd, POLLOUT, 0 };
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            return -1;
+        }
+        sink->write_calls++;
+        sink->bytes_written += (size_t)n;
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+static inline int output_pwrite_all(output_sink_t* sink, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = pwrite(sink->fd, data, length, sink->offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sink->write_calls++;
+        sink->bytes_written += (size_t)n;
+        sink->offset += n;
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/* O_DIRECT: packs chunks into the aligned stage and writes whole blocks; the tail waits for more. */
+static inline int output_write_direct(output_sink_t* sink, const output_chunk_t* chunks, size_t count) {
+    size_t capacity = sink->buffer_size * 2;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* data = chunks[i].writer->buffers[chunks[i].slot];
+        size_t length = chunks[i].length;
+        while (length > 0) {
+            size_t take = capacity - sink->staged < length ? capacity - sink->staged : length;
+            memcpy(sink->stage + sink->staged, data, take);
+            sink->staged += take;
+            data += take;
+            length -= take;
+            size_t whole = sink->staged & ~(size_t)(OUTPUT_ALIGN - 1);
+            if (whole >= sink->buffer_size) {
+                if (output_pwrite_all(sink, sink->stage, whole) != 0) {
+                    return -1;
+                }
+                memmove(sink->stage, sink->stage + whole, sink->staged - whole);
+                sink->staged -= whole;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Writes a batch of chunks under write_mutex. Records the first error on the sink. */
+static inline void output_write_chunks(output_sink_t* sink, const output_chunk_t* chunks, size_t count) {
+    if (sink->error) {
+        return;
+    }
+    int rc = 0;
+    if (sink->flags & OUTPUT_DIRECT) {
+        rc = output_write_direct(sink, chunks, count);
+    } else {
+        struct iovec iov[OUTPUT_GATHER_MAX];
+        for (size_t i = 0; i < count && rc == 0; i += OUTPUT_GATHER_MAX) {
+            int n = 0;
+            for (size_t j = i; j < count && n < OUTPUT_GATHER_MAX; j++, n++) {
+                iov[n].iov_base = chunks[j].writer->buffers[chunks[j].slot];
+                iov[n].iov_len = chunks[j].length;
+            }
+            rc = output_writev_all(sink, iov, n);
+        }
+    }
+    if (rc != 0) {
+        sink->error = errno ? errno : EIO;
+        LOG_ERROR("Output sink write failed");
+    }
+}
+
+static inline void* output_flusher_main(void* arg) {
+    output_sink_t* sink = (output_sink_t*)arg;
+    output_chunk_t* batch = NULL;
+    size_t batch_capacity = 0;
+    LOCK_MUTEX(&sink->mutex);
+    for (;;) {
+        while (sink->queued == 0 && !sink->stop) {
+            pthread_cond_wait(&sink->work_cond, &sink->mutex);
+        }
+        if (sink->queued == 0) {
+            break;
+        }
+        if (batch_capacity < sink->queued) {
+            batch_capacity = sink->queue_capacity;
+            output_chunk_t* grown = realloc(batch, batch_capacity * sizeof(output_chunk_t));
+            if (!grown) {
+                HANDLE_MEMORY_ERROR("Output batch allocation failed");
+            }
+            batch = grown;
+        }
+        size_t count = sink->queued;
+        memcpy(batch, sink->queue, count * sizeof(output_chunk_t));
+        sink->queued = 0;
+        sink->in_flight = count;
+        UNLOCK_MUTEX(&sink->mutex);
+
+        LOCK_MUTEX(&sink->write_mutex);
+        output_write_chunks(sink, batch, count);
+        UNLOCK_MUTEX(&sink->write_mutex);
+
+        LOCK_MUTEX(&sink->mutex);
+        for (size_t i = 0; i < count; i++) {
+            batch[i].writer->busy[batch[i].slot] = 0;
+        }
+        sink->in_flight = 0;
+        pthread_cond_broadcast(&sink->done_cond);
+    }
+    UNLOCK_MUTEX(&sink->mutex);
+    free(batch);
+    return NULL;
+}
+
+/********************* Sinks ***************************/
+
+static inline output_sink_t* output_sink_init(int fd, int flags, size_t buffer_size, int owns_fd) {
+    output_sink_t* sink = SAFE_MALLOC(sizeof(output_sink_t));
+    memset(sink, 0, sizeof(output_sink_t));
+    sink->fd = fd;
+    sink->flags = flags;
+    sink->owns_fd = owns_fd;
+    if (buffer_size == 0) {
+        buffer_size = OUTPUT_BUFFER_SIZE;
+    }
+    sink->buffer_size = (buffer_size + OUTPUT_ALIGN - 1) & ~(size_t)(OUTPUT_ALIGN - 1);
+    if (flags & OUTPUT_DIRECT) {
+        if (posix_memalign((void**)&sink->stage, OUTPUT_ALIGN, sink->buffer_size * 2) != 0) {
+            HANDLE_MEMORY_ERROR("Output staging allocation failed");
+        }
+        sink->offset = lseek(fd, 0, SEEK_CUR);
+        if (sink->offset < 0) {
+            sink->offset = 0;
+        }
+    }
+    pthread_mutex_init(&sink->mutex, NULL);
+    pthread_mutex_init(&sink->write_mutex, NULL);
+    pthread_cond_init(&sink->work_cond, NULL);
+    pthread_cond_init(&sink->done_cond, NULL);
+    if (!(flags & OUTPUT_SYNC) && pthread_create(&sink->flusher, NULL, output_flusher_main, sink) != 0) {
+        LOG_WARNING("Output flusher thread unavailable, writing synchronously");
+        sink->flags |= OUTPUT_SYNC;
+    }
+    return sink;
+}
+
+/**
+ * @brief Opens path for writing (created with mode 0644) and returns a sink, or NULL if it cannot be opened.
+ *
+ * buffer_size is the size of each writer buffer, 0 for OUTPUT_BUFFER_SIZE.
+ * OUTPUT_DIRECT falls back to buffered I/O with a warning on file systems
+ * without O_DIRECT support and when combined with OUTPUT_APPEND.
+ *
+ * Example usage:
+ * ```
+ * output_sink_t* sink = output_sink_open("/data/out.csv", OUTPUT_DIRECT, 4 << 20);
+ * ```
+ */
+static inline output_sink_t* output_sink_open(const char* path, int flags, size_t buffer_size) {
+    int mode = O_WRONLY | O_CREAT | O_CLOEXEC | ((flags & OUTPUT_APPEND) ? O_APPEND : O_TRUNC);
+    if ((flags & OUTPUT_DIRECT) && (flags & OUTPUT_APPEND)) {
+        LOG_WARNING("O_DIRECT output cannot append; using buffered I/O");
+        flags &= ~OUTPUT_DIRECT;
+    }
+    int fd = open(path, mode | ((flags & OUTPUT_DIRECT) ? O_DIRECT : 0), 0644);
+    if (fd < 0 && (flags & OUTPUT_DIRECT) && errno == EINVAL) {
+        LOG_WARNING("O_DIRECT not supported here; using buffered I/O");
+        flags &= ~OUTPUT_DIRECT;
+        fd = open(path, mode, 0644);
+    }
+    if (fd < 0) {
+        LOG_ERROR("Failed to open output file");
+        return NULL;
+    }
+    return output_sink_init(fd, flags, buffer_size, 1);
+}
+
+/**
+ * @brief Wraps an open descriptor, which the sink never closes. OUTPUT_DIRECT is ignored here.
+ *
+ * Example usage:
+ * ```
+ * output_sink_t* out = output_sink_from_fd(STDOUT_FILENO, 0, 0);
+ * ```
+ */
+static inline output_sink_t* output_sink_from_fd(int fd, int flags, size_t buffer_size) {
+    return output_sink_init(fd, flags & ~OUTPUT_DIRECT, buffer_size, 0);
+}
+
+/**
+ * @brief Waits until every buffer submitted so far has been written. Returns 0, or -1 after a write error.
+ */
+static inline int output_sink_flush(output_sink_t* sink) {
+    LOCK_MUTEX(&sink->mutex);
+    while (sink->queued > 0 || sink->in_flight > 0) {
+        pthread_cond_wait(&sink->done_cond, &sink->mutex);
+    }
+    UNLOCK_MUTEX(&sink->mutex);
+    LOCK_MUTEX(&sink->write_mutex);
+    int error = sink->error;
+    UNLOCK_MUTEX(&sink->write_mutex);
+    return error ? -1 : 0;
+}
+
+/**
+ * @brief Writes what is pending, stops the flusher and closes an owned descriptor.
+ *
+ * Every writer of the sink must have been destroyed first. Returns 0, or
+ * -1 if any write failed.
+ */
+static inline int output_sink_close(output_sink_t* sink) {
+    if (!sink) {
+        return -1;
+    }
+    if (!(sink->flags & OUTPUT_SYNC)) {
+        LOCK_MUTEX(&sink->mutex);
+        sink->stop = 1;
+        pthread_cond_signal(&sink->work_cond);
+        UNLOCK_MUTEX(&sink->mutex);
+        pthread_join(sink->flusher, NULL);
+    }
+    if ((sink->flags & OUTPUT_DIRECT) && sink->staged > 0 && !sink->error) {
+        /* The last partial block cannot be written with O_DIRECT. */
+        int fl = fcntl(sink->fd, F_GETFL);
+        if (fl < 0 || fcntl(sink->fd, F_SETFL, fl & ~O_DIRECT) != 0 ||
+            output_pwrite_all(sink, sink->stage, sink->staged) != 0) {
+            sink->error = errno ? errno : EIO;
+            LOG_ERROR("Output sink write failed");
+        }
+    }
+    int rc = sink->error ? -1 : 0;
+    if (sink->owns_fd && close(sink->fd) != 0 && rc == 0) {
+        LOG_ERROR("Output sink close failed");
+        rc = -1;
+    }
+    pthread_mutex_destroy(&sink->mutex);
+    pthread_mutex_destroy(&sink->write_mutex);
+    pthread_cond_destroy(&sink->work_cond);
+    pthread_cond_destroy(&sink->done_cond);
+    free(sink->stage);
+    free(sink->queue);
+    free(sink);
+    return rc;
+}
+
+/********************* Writers ***************************/
+
+/**
+ * @brief Creates a writer for the calling thread: two page-aligned buffers of the sink's buffer size.
+ *
+ * Example usage:
+ * ```
+ * output_writer_t* out = output_writer_create(sink);
+ * ```
+ */
+static inline output_writer_t* output_writer_create(output_sink_t* sink) {
+    output_writer_t* w = SAFE_MALLOC(sizeof(output_writer_t));
+    memset(w, 0, sizeof(output_writer_t));
+    w->sink = sink;
+    for (int i = 0; i < 2; i++) {
+        if (posix_memalign((void**)&w->buffers[i], OUTPUT_ALIGN, sink->buffer_size) != 0) {
+            HANDLE_MEMORY_ERROR("Output buffer allocation failed");
+        }
+    }
+    return w;
+}
+
+/* Hands the first length bytes of the active buffer to the sink and switches to the other buffer. */
+static inline void output_submit(output_writer_t* w, size_t length) {
+    output_sink_t* sink = w->sink;
+    int slot = w->active;
+    if (length > 0) {
+        if (sink->flags & OUTPUT_SYNC) {
+            output_chunk_t chunk = { w, slot, length };
+            LOCK_MUTEX(&sink->write_mutex);
+            output_write_chunks(sink, &chunk, 1);
+            UNLOCK_MUTEX(&sink->write_mutex);
+        } else {
+            LOCK_MUTEX(&sink->mutex);
+            if (sink->queued == sink->queue_capacity) {
+                size_t capacity = sink->queue_capacity ? sink->queue_capacity * 2 : 16;
+                output_chunk_t* grown = realloc(sink->queue, capacity * sizeof(output_chunk_t));
+                if (!grown) {
+                    HANDLE_MEMORY_ERROR("Output queue allocation failed");
+                }
+                sink->queue = grown;
+                sink->queue_capacity = capacity;
+            }
+            w->busy[slot] = 1;
+            sink->queue[sink->queued].writer = w;
+            sink->queue[sink->queued].slot = slot;
+            sink->queue[sink->queued].length = length;
+            sink->queued++;
+            pthread_cond_signal(&sink->work_cond);
+            UNLOCK_MUTEX(&sink->mutex);
+        }
+    }
+
+    int next = slot ^ 1;
+    if (!(sink->flags & OUTPUT_SYNC)) {
+        LOCK_MUTEX(&sink->mutex);
+        while (w->busy[next]) {
+            pthread_cond_wait(&sink->done_cond, &sink->mutex);
+        }
+        UNLOCK_MUTEX(&sink->mutex);
+    }
+    /* Carry the unfinished record over so it stays contiguous in the output. */
+    size_t partial = w->used - length;
+    if (partial > 0) {
+        memcpy(w->buffers[next], w->buffers[slot] + length, partial);
+    }
+    w->active = next;
+    w->used = partial;
+    w->record_start = 0;
+}
+
+/**
+ * @brief Returns space for n bytes (n <= buffer size) in the active buffer; follow with output_commit().
+ *
+ * When the buffer is full, its complete records are submitted first. A
+ * single record larger than the buffer is split.
+ *
+ * Example usage:
+ * ```
+ * char* p = output_reserve(out, 20);
+ * output_commit(out, output_format_u64(p, id));
+ * ```
+ */
+static inline char* output_reserve(output_writer_t* w, size_t n) {
+    if (w->sink->buffer_size - w->used < n) {
+        size_t complete = w->record_start;
+        if (complete == 0 || w->used - complete + n > w->sink->buffer_size) {
+            complete = w->used;
+        }
+        output_submit(w, complete);
+    }
+    return (char*)w->buffers[w->active] + w->used;
+}
+
+static inline void output_commit(output_writer_t* w, size_t n) {
+    w->used += n;
+}
+
+static inline void output_end_record(output_writer_t* w) {
+    w->record_start = w->used;
+}
+
+/**
+ * @brief Copies n bytes of data; longer than a buffer is allowed, but then the record may be split.
+ */
+static inline void output_bytes(output_writer_t* w, const void* data, size_t n) {
+    const char* p = (const char*)data;
+    while (n > 0) {
+        size_t take = n < w->sink->buffer_size ? n : w->sink->buffer_size;
+        memcpy(output_reserve(w, take), p, take);
+        output_commit(w, take);
+        p += take;
+        n -= take;
+    }
+}
+
+static inline void output_str(output_writer_t* w, const char* s) {
+    output_bytes(w, s, strlen(s));
+}
+
+static inline void output_char(output_writer_t* w, char c) {
+    *output_reserve(w, 1) = c;
+    output_commit(w, 1);
+}
+
+static inline void output_newline(output_writer_t* w) {
+    output_char(w, '\n');
+    output_end_record(w);
+}
+
+static inline void output_u64(output_writer_t* w, uint64_t v) {
+    char* p = output_reserve(w, 20);
+    output_commit(w, output_format_u64(p, v));
+}
+
+static inline void output_i64(output_writer_t* w, int64_t v) {
+    char* p = output_reserve(w, 20);
+    output_commit(w, output_format_i64(p, v));
+}
+
+static inline void output_double(output_writer_t* w, double v, int decimals) {
+    char* p = output_reserve(w, 32);
+    output_commit(w, output_format_double(p, v, decimals));
+}
+
+/**
+ * @brief Calls fn with an output_item_t for each of count elements, ending a record after each call.
+ *
+ * Example usage:
+ * ```
+ * Lambda(format_order, arg,
+ *     output_item_t* it = (output_item_t*)arg;
+ *     order_t* o = (order_t*)it->item;
+ *     output_u64(it->writer, o->id);
+ *     output_char(it->writer, ' ');
+ *     output_double(it->writer, o->price, 2);
+ *     output_char(it->writer, '\n');
+ *     return NULL;
+ * );
+ * output_map(out, orders, sizeof(order_t), count, format_order);
+ * ```
+ */
+static inline void output_map(output_writer_t* w, void* base, size_t stride, size_t count, lambda_t fn) {
+    output_item_t item = { w, NULL, 0 };
+    for (size_t i = 0; i < count; i++) {
+        item.item = (char*)base + i * stride;
+        item.index = i;
+        fn(&item);
+        output_end_record(w);
+    }
+}
+
+/**
+ * @brief Submits everything written so far and waits until the sink has written it. Returns 0 or -1.
+ */
+static inline int output_writer_flush(output_writer_t* w) {
+    output_submit(w, w->used);
+    return output_sink_flush(w->sink);
+}
+
+/**
+ * @brief Flushes and frees the writer.
+ */
+static inline void output_writer_destroy(output_writer_t* w) {
+    if (!w) {
+        return;
+    }
+    output_writer_flush(w);
+    LOCK_MUTEX(&w->sink->mutex);
+    while (w->busy[0] || w->busy[1]) {
+        pthread_cond_wait(&w->sink->done_cond, &w->sink->mutex);
+    }
+    UNLOCK_MUTEX(&w->sink->mutex);
+    free(w->buffers[0]);
+    free(w->buffers[1]);
+    free(w);
+}
+
+
+#endif /* LAMBDA_OUTPUT_H */
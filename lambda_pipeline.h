@@ -0,0 +1,975 @@
+#ifndef LAMBDA_PIPELINE_H
+#define LAMBDA_PIPELINE_H
+
+#include "lambda_lock.h"
+#include <time.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_pipeline.h
+
+/**
+ * Ring Buffers:
+ *
+ * spsc_ring_init(ring, capacity) / spsc_ring_destroy(ring): Single-producer single-consumer ring.
+ * spsc_ring_push(ring, items, n) / spsc_ring_pop(ring, items, max): Non-blocking batch transfer.
+ * mpmc_ring_init(ring, capacity) / mpmc_ring_destroy(ring): Multi-producer multi-consumer ring.
+ * mpmc_ring_push(ring, items, n) / mpmc_ring_pop(ring, items, max): Non-blocking batch transfer.
+ * spsc_ring_count(ring) / mpmc_ring_count(ring): Approximate number of queued items.
+ */
+
+/**
+ * Pipelines:
+ *
+ * pipeline_create(queue_capacity, batch_size): Creates an empty pipeline.
+ * pipeline_add_stage(p, name, fn, workers, flags): Appends a stage running fn on its own threads.
+ * pipeline_start(p): Starts the stage threads.
+ * pipeline_push(p, item) / pipeline_push_batch(p, items, n): Feeds items, blocking when the first queue is full.
+ * pipeline_close(p): Marks the end of the input.
+ * pipeline_pop(p, item) / pipeline_pop_batch(p, items, max): Takes results from the last stage.
+ * pipeline_destroy(p): Closes the input, discards unread results and joins every thread.
+ * pipeline_get_stats(p, stage, stats): Throughput, busy/starved/blocked time and queue depth of a stage.
+ * pipeline_report(p, out): Prints the stats of every stage and names the bottleneck.
+ */
+
+
+/**
+ * @file lambda_pipeline.h
+ * @brief Multi-stage threaded pipelines of lambdas connected by bounded ring buffers.
+ *
+ * compose_lambda() runs every step on the caller's thread. A pipeline
+ * gives each stage its own threads instead, so a parse, transform and
+ * serialize chain keeps as many cores busy as it has stages and workers:
+ *
+ * ```
+ * pipeline_t* p = pipeline_create(1024, 64);
+ * pipeline_add_stage(p, "parse", parse, 1, 0);
+ * pipeline_add_stage(p, "transform", transform, 4, PIPELINE_ORDERED);
+ * pipeline_add_stage(p, "serialize", serialize, 1, 0);
+ * pipeline_start(p);
+ * ```
+ *
+ * Stages are joined by bounded queues. A queue between one producer
+ * thread and one consumer thread is a lock-free SPSC ring; anything
+ * else uses a lock-free MPMC ring. Items move in batches of up to
+ * batch_size per enqueue and dequeue. A full queue blocks its producers,
+ * which is how a slow stage pushes back all the way to pipeline_push().
+ * Threads spin briefly and then sleep on a futex, so idle stages cost
+ * nothing.
+ *
+ * Stages with several workers must be stateless. Their items complete
+ * out of order unless the stage is PIPELINE_ORDERED, which puts results
+ * back in input order before they leave the stage. A stage that returns
+ * NULL drops the item, which makes filters ordinary stages.
+ *
+ * An ordered stage reorders through a window sized for everything that
+ * can be in flight upstream of it. pipeline_push() never lets an item
+ * enter the pipeline further ahead than that window, so a worker that
+ * stalls on one early item upstream makes the source wait instead of
+ * filling the window and wedging the stages behind it.
+ */
+
+/********************* Type Definitions ***************************/
+
+#ifndef PIPELINE_MAX_STAGES
+#define PIPELINE_MAX_STAGES 16
+#endif
+
+/** Spin iterations before a blocked producer or consumer sleeps (0 on single-CPU machines). */
+#ifndef PIPELINE_SPIN
+#define PIPELINE_SPIN 256
+#endif
+
+/** Stage flag: results leave the stage in the order items entered it. */
+#define PIPELINE_ORDERED 0x1
+
+/** Set in the sequence number of an item that an earlier stage dropped. */
+#define PIPELINE_DROPPED (1ull << 63)
+
+/**
+ * @brief An item in flight: the value and its position in the input stream.
+ */
+typedef struct {
+    void* value;
+    uint64_t seq;
+} pipeline_item_t;
+
+/**
+ * @brief Bounded single-producer single-consumer ring. Each side caches the other's index.
+ */
+typedef struct {
+    pipeline_item_t* slots;
+    size_t mask;
+    _Alignas(64) _Atomic size_t head;
+    size_t tail_cache;
+    _Alignas(64) _Atomic size_t tail;
+    size_t head_cache;
+} spsc_ring_t;
+
+typedef struct {
+    _Atomic size_t seq;
+    pipeline_item_t item;
+} mpmc_cell_t;
+
+/**
+ * @brief Bounded multi-producer multi-consumer ring (per-cell sequence numbers).
+ */
+typedef struct {
+    mpmc_cell_t* cells;
+    size_t mask;
+    _Alignas(64) _Atomic size_t tail;
+    _Alignas(64) _Atomic size_t head;
+} mpmc_ring_t;
+
+/**
+ * @brief Snapshot of one stage's counters. Times are summed over the stage's workers.
+ */
+typedef struct {
+    const char* name;
+    int workers;
+    uint64_t items_in;
+    uint64_t items_out;
+    uint64_t dropped;
+    uint64_t busy_ns;
+    uint64_t starved_ns;
+    uint64_t blocked_ns;
+    size_t queue_capacity;
+    double queue_avg_depth;
+    size_t queue_max_depth;
+} pipeline_stats_t;
+
+/**
+ * @brief A queue between two stages: a ring, two futex event counts and close tracking.
+ */
+typedef struct {
+    int multi;
+    int spin;
+    spsc_ring_t spsc;
+    mpmc_ring_t mpmc;
+    size_t capacity;
+    _Atomic uint32_t not_empty;
+    _Atomic uint32_t not_full;
+    _Atomic uint32_t empty_waiters;
+    _Atomic uint32_t full_waiters;
+    _Atomic int producers;
+    _Atomic int closed;
+    _Atomic uint64_t depth_sum;
+    _Atomic uint64_t depth_samples;
+    _Atomic size_t depth_max;
+} pipeline_queue_t;
+
+typedef struct {
+    pipeline_item_t item;
+    _Atomic int ready;
+} pipeline_slot_t;
+
+struct pipeline;
+
+typedef struct {
+    const char* name;
+    lambda_t fn;
+    int workers;
+    int flags;
+    int forward_drops;
+    struct pipeline* pipeline;
+    pipeline_queue_t* in;
+    pipeline_queue_t* out;
+    pthread_t* threads;
+    _Atomic int running;
+
+    /* Reorder window of an ordered stage. */
+    pipeline_slot_t* window;
+    size_t window_mask;
+    _Atomic uint64_t next_emit;
+    _Atomic int emitting;
+    _Atomic uint32_t window_moved;
+    _Atomic uint32_t window_waiters;
+
+    _Atomic uint64_t items_in;
+    _Atomic uint64_t items_out;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t busy_ns;
+    _Atomic uint64_t starved_ns;
+    _Atomic uint64_t blocked_ns;
+} pipeline_stage_t;
+
+typedef struct pipeline {
+    pipeline_stage_t stages[PIPELINE_MAX_STAGES];
+    pipeline_queue_t* queues[PIPELINE_MAX_STAGES + 1];
+    int stage_count;
+    size_t queue_capacity;
+    size_t batch_size;
+    uint64_t next_seq;
+    uint64_t source_blocked_ns;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int started;
+    int closed;
+} pipeline_t;
+
+static inline uint64_t pipeline_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline size_t pipeline_pow2(size_t n) {
+    size_t p = 2;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/********************* SPSC Ring ***************************/
+
+/**
+ * @brief Initializes an SPSC ring; capacity is rounded up to a power of two.
+ *
+ * Example usage:
+ * ```
+ * spsc_ring_t ring;
+ * spsc_ring_init(&ring, 1024);
+ * ```
+ */
+static inline void spsc_ring_init(spsc_ring_t* ring, size_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    capacity = pipeline_pow2(capacity);
+    ring->slots = SAFE_MALLOC(capacity * sizeof(pipeline_item_t));
+    ring->mask = capacity - 1;
+}
+
+static inline void spsc_ring_destroy(spsc_ring_t* ring) {
+    SAFE_FREE(ring->slots);
+}
+
+/**
+ * @brief Pushes up to n items without blocking and returns how many were pushed.
+ */
+static inline size_t spsc_ring_push(spsc_ring_t* ring, const pipeline_item_t* items, size_t n) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t capacity = ring->mask + 1;
+    size_t space = capacity - (tail - ring->head_cache);
+    if (space < n) {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        space = capacity - (tail - ring->head_cache);
+    }
+    if (n > space) {
+        n = space;
+    }
+    for (size_t i = 0; i < n; i++) {
+        ring->slots[(tail + i) & ring->mask] = items[i];
+    }
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
+
+/**
+ * @brief Pops up to max items without blocking and returns how many were popped.
+ */
+static inline size_t spsc_ring_pop(spsc_ring_t* ring, pipeline_item_t* items, size_t max) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t avail = ring->tail_cache - head;
+    if (avail < max) {
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        avail = ring->tail_cache - head;
+    }
+    if (max > avail) {
+        max = avail;
+    }
+    for (size_t i = 0; i < max; i++) {
+        items[i] = ring->slots[(head + i) & ring->mask];
+    }
+    atomic_store_explicit(&ring->head, head + max, memory_order_release);
+    return max;
+}
+
+static inline size_t spsc_ring_count(spsc_ring_t* ring) {
+    return atomic_load(&ring->tail) - atomic_load(&ring->head);
+}
+
+/********************* MPMC Ring ***************************/
+
+/**
+ * @brief Initializes an MPMC ring; capacity is rounded up to a power of two.
+ */
+static inline void mpmc_ring_init(mpmc_ring_t* ring, size_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    capacity = pipeline_pow2(capacity);
+    ring->cells = SAFE_MALLOC(capacity * sizeof(mpmc_cell_t));
+    ring->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&ring->cells[i].seq, i);
+    }
+}
+
+static inline void mpmc_ring_destroy(mpmc_ring_t* ring) {
+    SAFE_FREE(ring->cells);
+}
+
+/**
+ * @brief Pushes up to n items without blocking and returns how many were pushed.
+ *
+ * Claims a run of free cells with a single CAS on the tail.
+ */
+static inline size_t mpmc_ring_push(mpmc_ring_t* ring, const pipeline_item_t* items, size_t n) {
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t k;
+    for (;;) {
+        size_t seq = 0;
+        for (k = 0; k < n; k++) {
+            seq = atomic_load_explicit(&ring->cells[(pos + k) & ring->mask].seq, memory_order_acquire);
+            if (seq != pos + k) {
+                break;
+            }
+        }
+        if (k == 0) {
+            if ((intptr_t)(seq - pos) < 0) {
+                return 0;
+            }
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + k,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < k; i++) {
+        mpmc_cell_t* cell = &ring->cells[(pos + i) & ring->mask];
+        cell->item = items[i];
+        atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+    }
+    return k;
+}
+
+/**
+ * @brief Pops up to max items without blocking and returns how many were popped.
+ */
+static inline size_t mpmc_ring_pop(mpmc_ring_t* ring, pipeline_item_t* items, size_t max) {
+    size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t k;
+    for (;;) {
+        size_t seq = 0;
+        for (k = 0; k < max; k++) {
+            seq = atomic_load_explicit(&ring->cells[(pos + k) & ring->mask].seq, memory_order_acquire);
+            if (seq != pos + k + 1) {
+                break;
+            }
+        }
+        if (k == 0) {
+            if ((intptr_t)(seq - (pos + 1)) < 0) {
+                return 0;
+            }
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + k,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < k; i++) {
+        mpmc_cell_t* cell = &ring->cells[(pos + i) & ring->mask];
+        items[i] = cell->item;
+        atomic_store_explicit(&cell->seq, pos + i + ring->mask + 1, memory_order_release);
+    }
+    return k;
+}
+
+static inline size_t mpmc_ring_count(mpmc_ring_t* ring) {
+    size_t head = atomic_load(&ring->head);
+    size_t tail = atomic_load(&ring->tail);
+    return tail > head ? tail - head : 0;
+}
+
+/********************* Blocking Queues ***************************/
+
+static inline pipeline_queue_t* pipeline_queue_create(size_t capacity, int multi, int producers) {
+    pipeline_queue_t* q = SAFE_MALLOC(sizeof(pipeline_queue_t));
+    memset(q, 0, sizeof(*q));
+    q->multi = multi;
+    if (multi) {
+        mpmc_ring_init(&q->mpmc, capacity);
+        q->capacity = q->mpmc.mask + 1;
+    } else {
+        spsc_ring_init(&q->spsc, capacity);
+        q->capacity = q->spsc.mask + 1;
+    }
+    atomic_init(&q->producers, producers);
+    q->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? PIPELINE_SPIN : 0;
+    return q;
+}
+
+static inline void pipeline_queue_free(pipeline_queue_t* q) {
+    if (q->multi) {
+        mpmc_ring_destroy(&q->mpmc);
+    } else {
+        spsc_ring_destroy(&q->spsc);
+    }
+    free(q);
+}
+
+static inline size_t pipeline_queue_count(pipeline_queue_t* q) {
+    return q->multi ? mpmc_ring_count(&q->mpmc) : spsc_ring_count(&q->spsc);
+}
+
+/** Wakes sleepers on an event count if there are any. */
+static inline void pipeline_queue_signal(_Atomic uint32_t* event, _Atomic uint32_t* waiters) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiters, memory_order_relaxed)) {
+        atomic_fetch_add(event, 1);
+        lock_futex_wake(event, INT32_MAX);
+    }
+}
+
+/**
+ * @brief Sleeps on an event count unless the condition already holds.
+ *
+ * The waiter registers before re-checking, and signallers fence before
+ * looking for waiters, so a wakeup cannot be lost between the two.
+ */
+static inline void pipeline_queue_wait(pipeline_queue_t* q, _Atomic uint32_t* event,
+                                       _Atomic uint32_t* waiters, int want_items) {
+    uint32_t seen = atomic_load(event);
+    atomic_fetch_add(waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t count = pipeline_queue_count(q);
+    int ready = want_items ? (count > 0 || atomic_load(&q->closed)) : count < q->capacity;
+    if (!ready) {
+        lock_futex_wait(event, seen);
+    }
+    atomic_fetch_sub(waiters, 1);
+}
+
+/**
+ * @brief Pushes every item, blocking while the queue is full. Adds the time spent blocked to *blocked_ns.
+ */
+static inline void pipeline_queue_push(pipeline_queue_t* q, const pipeline_item_t* items, size_t n,
+                                       uint64_t* blocked_ns) {
+    uint64_t start = 0;
+    int spins = 0;
+    while (n) {
+        size_t k = q->multi ? mpmc_ring_push(&q->mpmc, items, n) : spsc_ring_push(&q->spsc, items, n);
+        if (k) {
+            items += k;
+            n -= k;
+            spins = 0;
+            pipeline_queue_signal(&q->not_empty, &q->empty_waiters);
+            continue;
+        }
+        if (!start) {
+            start = pipeline_now_ns();
+        }
+        if (spins++ < q->spin) {
+            lock_cpu_relax();
+        } else {
+            pipeline_queue_wait(q, &q->not_full, &q->full_waiters, 0);
+        }
+    }
+    if (start) {
+        *blocked_ns += pipeline_now_ns() - start;
+    }
+}
+
+/**
+ * @brief Pops up to max items, blocking while the queue is empty.
+ *
+ * Returns 0 once the queue is closed and drained. Adds the time spent
+ * waiting to *starved_ns.
+ */
+static inline size_t pipeline_queue_pop(pipeline_queue_t* q, pipeline_item_t* items, size_t max,
+                                        uint64_t* starved_ns) {
+    uint64_t start = 0;
+    int spins = 0;
+    size_t k;
+    for (;;) {
+        size_t depth = pipeline_queue_count(q);
+        k = q->multi ? mpmc_ring_pop(&q->mpmc, items, max) : spsc_ring_pop(&q->spsc, items, max);
+        if (k) {
+            pipeline_queue_signal(&q->not_full, &q->full_waiters);
+            atomic_fetch_add_explicit(&q->depth_sum, depth, memory_order_relaxed);
+            atomic_fetch_add_explicit(&q->depth_samples, 1, memory_order_relaxed);
+            size_t seen = atomic_load_explicit(&q->depth_max, memory_order_relaxed);
+            while (depth > seen && !atomic_compare_exchange_weak_explicit(&q->depth_max, &seen, depth,
+                                                                          memory_order_relaxed,
+                                                                          memory_order_relaxed)) {
+            }
+            break;
+        }
+        if (atomic_load_explicit(&q->closed, memory_order_acquire)) {
+            k = q->multi ? mpmc_ring_pop(&q->mpmc, items, max) : spsc_ring_pop(&q->spsc, items, max);
+            if (k) {
+                break;
+            }
+            if (pipeline_queue_count(q) == 0) {
+                k = 0;
+                break;
+            }
+            continue;
+        }
+        if (!start) {
+            start = pipeline_now_ns();
+        }
+        if (spins++ < q->spin) {
+            lock_cpu_relax();
+        } else {
+            pipeline_queue_wait(q, &q->not_empty, &q->empty_waiters, 1);
+        }
+    }
+    if (start) {
+        *starved_ns += pipeline_now_ns() - start;
+    }
+    return k;
+}
+
+/** Called by each producer when it is done; the last one closes the queue. */
+static inline void pipeline_queue_producer_done(pipeline_queue_t* q) {
+    if (atomic_fetch_sub_explicit(&q->producers, 1, memory_order_acq_rel) == 1) {
+        atomic_store_explicit(&q->closed, 1, memory_order_release);
+        atomic_fetch_add(&q->not_empty, 1);
+        lock_futex_wake(&q->not_empty, INT32_MAX);
+    }
+}
+
+/********************* Stage Workers ***************************/
+
+/**
+ * @brief Emits consecutive completed items of an ordered stage downstream.
+ *
+ * Only one thread drains at a time; after releasing the drain flag it
+ * re-checks the next slot so an item placed meanwhile is not stranded.
+ */
+static inline void pipeline_drain(pipeline_stage_t* stage, pipeline_item_t* buf, size_t batch,
+                                  uint64_t* blocked_ns) {
+    for (;;) {
+        int expected = 0;
+        if (!atomic_compare_exchange_strong(&stage->emitting, &expected, 1)) {
+            return;
+        }
+        for (;;) {
+            uint64_t next = atomic_load_explicit(&stage->next_emit, memory_order_relaxed);
+            size_t n = 0;
+            while (n < batch) {
+                pipeline_slot_t* slot = &stage->window[(next + n) & stage->window_mask];
+                if (!atomic_load_explicit(&slot->ready, memory_order_acquire)) {
+                    break;
+                }
+                pipeline_item_t item = slot->item;
+                atomic_store_explicit(&slot->ready, 0, memory_order_relaxed);
+                if (!(item.seq & PIPELINE_DROPPED) || stage->forward_drops) {
+                    buf[n++] = item;
+                } else {
+                    next++;
+                }
+            }
+            if (n == 0 && next == atomic_load_explicit(&stage->next_emit, memory_order_relaxed)) {
+                break;
+            }
+            atomic_store_explicit(&stage->next_emit, next + n, memory_order_release);
+            pipeline_queue_signal(&stage->window_moved, &stage->window_waiters);
+            if (n) {
+                pipeline_queue_push(stage->out, buf, n, blocked_ns);
+            }
+        }
+        atomic_store(&stage->emitting, 0);
+        uint64_t next = atomic_load(&stage->next_emit);
+        if (!atomic_load(&stage->window[next & stage->window_mask].ready)) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Places finished items into the reorder window of an ordered stage.
+ *
+ * pipeline_push_batch() admits an item only once its sequence number
+ * fits in the window, so the loop below is a guard and does not spin.
+ */
+static inline void pipeline_place(pipeline_stage_t* stage, const pipeline_item_t* items, size_t n,
+                                  pipeline_item_t* buf, size_t batch, uint64_t* blocked_ns) {
+    size_t window = stage->window_mask + 1;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t seq = items[i].seq & ~PIPELINE_DROPPED;
+        while (seq >= atomic_load_explicit(&stage->next_emit, memory_order_acquire) + window) {
+            pipeline_drain(stage, buf, batch, blocked_ns);
+            sched_yield();
+        }
+        pipeline_slot_t* slot = &stage->window[seq & stage->window_mask];
+        slot->item = items[i];
+        atomic_store(&slot->ready, 1);
+    }
+    pipeline_drain(stage, buf, batch, blocked_ns);
+}
+
+static inline void* pipeline_worker(void* arg) {
+    pipeline_stage_t* stage = (pipeline_stage_t*)arg;
+    size_t batch = stage->pipeline->batch_size;
+    pipeline_item_t* in = SAFE_MALLOC(batch * sizeof(pipeline_item_t));
+    pipeline_item_t* out = SAFE_MALLOC(batch * sizeof(pipeline_item_t));
+    pipeline_item_t* drain = SAFE_MALLOC(batch * sizeof(pipeline_item_t));
+    int ordered = stage->flags & PIPELINE_ORDERED;
+
+    for (;;) {
+        uint64_t starved = 0, blocked = 0;
+        size_t n = pipeline_queue_pop(stage->in, in, batch, &starved);
+        if (n == 0) {
+            break;
+        }
+
+        uint64_t start = pipeline_now_ns();
+        size_t m = 0, live = 0, dropped = 0;
+        for (size_t i = 0; i < n; i++) {
+            pipeline_item_t item = in[i];
+            if (!(item.seq & PIPELINE_DROPPED)) {
+                live++;
+                item.value = stage->fn(item.value);
+                if (!item.value) {
+                    item.seq |= PIPELINE_DROPPED;
+                    dropped++;
+                }
+            }
+            if (!(item.seq & PIPELINE_DROPPED) || stage->forward_drops || ordered) {
+                out[m++] = item;
+            }
+        }
+        uint64_t busy = pipeline_now_ns() - start;
+
+        if (ordered) {
+            pipeline_place(stage, out, m, drain, batch, &blocked);
+        } else if (m) {
+            pipeline_queue_push(stage->out, out, m, &blocked);
+        }
+
+        atomic_fetch_add_explicit(&stage->items_in, live, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stage->items_out, live - dropped, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stage->dropped, dropped, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stage->busy_ns, busy, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stage->starved_ns, starved, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stage->blocked_ns, blocked, memory_order_relaxed);
+    }
+
+    /* Ordered stages emit through a single drainer, so the whole stage counts as one producer. */
+    if (atomic_fetch_sub(&stage->running, 1) == 1 && ordered) {
+        uint64_t blocked = 0;
+        pipeline_drain(stage, drain, batch, &blocked);
+        atomic_fetch_add_explicit(&stage->blocked_ns, blocked, memory_order_relaxed);
+        pipeline_queue_producer_done(stage->out);
+    } else if (!ordered) {
+        pipeline_queue_producer_done(stage->out);
+    }
+    free(in);
+    free(out);
+    free(drain);
+    return NULL;
+}
+
+/********************* Pipeline ***************************/
+
+/**
+ * @brief Creates an empty pipeline.
+ *
+ * @param queue_capacity Items each inter-stage queue holds before producers block.
+ * @param batch_size Items moved per enqueue and dequeue.
+ *
+ * Example usage:
+ * ```
+ * pipeline_t* p = pipeline_create(1024, 64);
+ * ```
+ */
+static inline pipeline_t* pipeline_create(size_t queue_capacity, size_t batch_size) {
+    pipeline_t* p = SAFE_MALLOC(sizeof(pipeline_t));
+    memset(p, 0, sizeof(*p));
+    p->queue_capacity = queue_capacity ? queue_capacity : 1024;
+    p->batch_size = batch_size ? batch_size : 1;
+    return p;
+}
+
+/**
+ * @brief Appends a stage. Returns its index, or -1 when the pipeline is full or already running.
+ *
+ * @param workers Threads running the stage; more than one requires a stateless lambda.
+ * @param flags 0 or PIPELINE_ORDERED.
+ *
+ * Example usage:
+ * ```
+ * pipeline_add_stage(p, "transform", transform, 4, PIPELINE_ORDERED);
+ * ```
+ */
+static inline int pipeline_add_stage(pipeline_t* p, const char* name, lambda_t fn, int workers, int flags) {
+    if (p->started || p->stage_count == PIPELINE_MAX_STAGES || !fn) {
+        LOG_ERROR("Cannot add pipeline stage");
+        return -1;
+    }
+    pipeline_stage_t* stage = &p->stages[p->stage_count];
+    stage->name = name;
+    stage->fn = fn;
+    stage->workers = workers > 0 ? workers : 1;
+    stage->flags = flags;
+    stage->pipeline = p;
+    return p->stage_count++;
+}
+
+/**
+ * @brief Creates the queues and starts every stage's threads.
+ */
+static inline void pipeline_start(pipeline_t* p) {
+    if (p->started || p->stage_count == 0) {
+        return;
+    }
+    for (int i = 0; i <= p->stage_count; i++) {
+        int producers = 1, consumers = 1;
+        if (i > 0) {
+            pipeline_stage_t* prev = &p->stages[i - 1];
+            producers = (prev->flags & PIPELINE_ORDERED) ? 1 : prev->workers;
+        }
+        if (i < p->stage_count) {
+            consumers = p->stages[i].workers;
+        }
+        p->queues[i] = pipeline_queue_create(p->queue_capacity, producers > 1 || consumers > 1, producers);
+    }
+    for (int i = 0; i < p->stage_count; i++) {
+        pipeline_stage_t* stage = &p->stages[i];
+        stage->in = p->queues[i];
+        stage->out = p->queues[i + 1];
+        for (int j = i + 1; j < p->stage_count; j++) {
+            if (p->stages[j].flags & PIPELINE_ORDERED) {
+                stage->forward_drops = 1;
+            }
+        }
+        if (stage->flags & PIPELINE_ORDERED) {
+            /* Everything between the source and this stage's emit point: queues, worker batches, drain buffers. */
+            size_t in_flight = p->batch_size;
+            for (int j = 0; j <= i; j++) {
+                in_flight += p->queues[j]->capacity + p->batch_size * ((size_t)p->stages[j].workers + 1);
+            }
+            size_t window = pipeline_pow2(in_flight);
+            stage->window = SAFE_MALLOC(window * sizeof(pipeline_slot_t));
+            memset(stage->window, 0, window * sizeof(pipeline_slot_t));
+            stage->window_mask = window - 1;
+        }
+    }
+    p->start_ns = pipeline_now_ns();
+    for (int i = 0; i < p->stage_count; i++) {
+        pipeline_stage_t* stage = &p->stages[i];
+        atomic_init(&stage->running, stage->workers);
+        stage->threads = SAFE_MALLOC((size_t)stage->workers * sizeof(pthread_t));
+        for (int w = 0; w < stage->workers; w++) {
+            if (pthread_create(&stage->threads[w], NULL, pipeline_worker, stage) != 0) {
+                HANDLE_ERROR("Failed to start pipeline worker");
+            }
+        }
+    }
+    p->started = 1;
+}
+
+/**
+ * @brief Waits until the item numbered seq fits in the reorder window of an ordered stage.
+ *
+ * Counts toward the source's blocked time: it is backpressure from an
+ * ordered stage still waiting for an earlier item.
+ */
+static inline void pipeline_window_wait(pipeline_t* p, pipeline_stage_t* stage, uint64_t seq) {
+    size_t window = stage->window_mask + 1;
+    if (seq < atomic_load_explicit(&stage->next_emit, memory_order_acquire) + window) {
+        return;
+    }
+    uint64_t start = pipeline_now_ns();
+    int spins = 0;
+    while (seq >= atomic_load_explicit(&stage->next_emit, memory_order_acquire) + window) {
+        if (spins++ < stage->in->spin) {
+            lock_cpu_relax();
+            continue;
+        }
+        uint32_t seen = atomic_load(&stage->window_moved);
+        atomic_fetch_add(&stage->window_waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (seq >= atomic_load(&stage->next_emit) + window) {
+            lock_futex_wait(&stage->window_moved, seen);
+        }
+        atomic_fetch_sub(&stage->window_waiters, 1);
+    }
+    p->source_blocked_ns += pipeline_now_ns() - start;
+}
+
+/**
+ * @brief Feeds n items, blocking while the first stage is behind. Call from one thread.
+ *
+ * Example usage:
+ * ```
+ * pipeline_push_batch(p, lines, count);
+ * ```
+ */
+static inline void pipeline_push_batch(pipeline_t* p, void* const* items, size_t n) {
+    pipeline_item_t buf[64];
+    while (n) {
+        size_t k = n < 64 ? n : 64;
+        if (k > p->batch_size && p->batch_size) {
+            k = p->batch_size;
+        }
+        for (int s = 0; s < p->stage_count; s++) {
+            if (p->stages[s].flags & PIPELINE_ORDERED) {
+                pipeline_window_wait(p, &p->stages[s], p->next_seq + k - 1);
+            }
+        }
+        for (size_t i = 0; i < k; i++) {
+            buf[i].value = items[i];
+            buf[i].seq = p->next_seq++;
+        }
+        pipeline_queue_push(p->queues[0], buf, k, &p->source_blocked_ns);
+        items += k;
+        n -= k;
+    }
+}
+
+static inline void pipeline_push(pipeline_t* p, void* item) {
+    pipeline_push_batch(p, &item, 1);
+}
+
+/**
+ * @brief Marks the end of the input; stages finish once they have drained their queues.
+ */
+static inline void pipeline_close(pipeline_t* p) {
+    if (p->started && !p->closed) {
+        p->closed = 1;
+        pipeline_queue_producer_done(p->queues[0]);
+    }
+}
+
+/**
+ * @brief Takes up to max results from the last stage, blocking until at least one is ready.
+ *
+ * Returns 0 once the pipeline is closed and every result has been taken.
+ * Call from one thread.
+ *
+ * Example usage:
+ * ```
+ * void* out[64];
+ * size_t n;
+ * while ((n = pipeline_pop_batch(p, out, 64)) > 0) {
+ *     // consume out[0..n)
+ * }
+ * ```
+ */
+static inline size_t pipeline_pop_batch(pipeline_t* p, void** items, size_t max) {
+    pipeline_item_t buf[64];
+    uint64_t starved = 0;
+    if (max > 64) {
+        max = 64;
+    }
+    for (;;) {
+        size_t n = pipeline_queue_pop(p->queues[p->stage_count], buf, max, &starved);
+        if (n == 0) {
+            if (!p->end_ns) {
+                p->end_ns = pipeline_now_ns();
+            }
+            return 0;
+        }
+        size_t m = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (!(buf[i].seq & PIPELINE_DROPPED)) {
+                items[m++] = buf[i].value;
+            }
+        }
+        if (m) {
+            return m;
+        }
+    }
+}
+
+static inline int pipeline_pop(pipeline_t* p, void** item) {
+    return pipeline_pop_batch(p, item, 1) == 1;
+}
+
+/**
+ * @brief Reads the counters of one stage.
+ */
+static inline void pipeline_get_stats(pipeline_t* p, int index, pipeline_stats_t* stats) {
+    pipeline_stage_t* stage = &p->stages[index];
+    pipeline_queue_t* q = stage->in;
+    memset(stats, 0, sizeof(*stats));
+    stats->name = stage->name;
+    stats->workers = stage->workers;
+    stats->items_in = atomic_load(&stage->items_in);
+    stats->items_out = atomic_load(&stage->items_out);
+    stats->dropped = atomic_load(&stage->dropped);
+    stats->busy_ns = atomic_load(&stage->busy_ns);
+    stats->starved_ns = atomic_load(&stage->starved_ns);
+    stats->blocked_ns = atomic_load(&stage->blocked_ns);
+    if (q) {
+        uint64_t samples = atomic_load(&q->depth_samples);
+        stats->queue_capacity = q->capacity;
+        stats->queue_avg_depth = samples ? (double)atomic_load(&q->depth_sum) / (double)samples : 0.0;
+        stats->queue_max_depth = atomic_load(&q->depth_max);
+    }
+}
+
+/**
+ * @brief Prints per-stage throughput, utilization and input queue depth, and names the bottleneck.
+ *
+ * busy is the share of the stage's worker time spent inside its lambda,
+ * starved the share spent waiting for input and blocked the share spent
+ * waiting for the next stage. The bottleneck is the busiest stage per
+ * worker: it starves the stages after it and blocks the ones before it.
+ *
+ * Example usage:
+ * ```
+ * pipeline_report(p, stdout);
+ * ```
+ */
+static inline void pipeline_report(pipeline_t* p, FILE* out) {
+    uint64_t elapsed = (p->end_ns ? p->end_ns : pipeline_now_ns()) - p->start_ns;
+    double seconds = elapsed ? (double)elapsed / 1e9 : 1e-9;
+    int bottleneck = -1;
+    double busiest = -1.0;
+
+    fprintf(out, "%-14s %7s %12s %12s %7s %8s %8s %10s %10s\n", "stage", "workers", "items",
+            "items/s", "busy", "starved", "blocked", "queue avg", "queue max");
+    for (int i = 0; i < p->stage_count; i++) {
+        pipeline_stats_t s;
+        pipeline_get_stats(p, i, &s);
+        double worker_ns = seconds * 1e9 * p->stages[i].workers;
+        double busy = s.busy_ns / worker_ns;
+        if (busy > busiest) {
+            busiest = busy;
+            bottleneck = i;
+        }
+        fprintf(out, "%-14s %7d %12llu %12.0f %6.1f%% %7.1f%% %7.1f%% %10.1f %6zu/%zu\n",
+                s.name ? s.name : "?", p->stages[i].workers, (unsigned long long)s.items_in,
+                (double)s.items_in / seconds, 100.0 * busy, 100.0 * s.starved_ns / worker_ns,
+                100.0 * s.blocked_ns / worker_ns, s.queue_avg_depth, s.queue_max_depth, s.queue_capacity);
+    }
+    fprintf(out, "source blocked %.1f%% of %.3f s\n", 100.0 * p->source_blocked_ns / (seconds * 1e9), seconds);
+    if (bottleneck >= 0) {
+        fprintf(out, "bottleneck: %s\n", p->stages[bottleneck].name);
+    }
+}
+
+/**
+ * @brief Closes the input, discards unread results, joins every thread and frees the pipeline.
+ */
+static inline void pipeline_destroy(pipeline_t* p) {
+    if (!p) {
+        return;
+    }
+    if (p->started) {
+        void* discard[64];
+        pipeline_close(p);
+        while (pipeline_pop_batch(p, discard, 64) > 0) {
+        }
+        for (int i = 0; i < p->stage_count; i++) {
+            pipeline_stage_t* stage = &p->stages[i];
+            for (int w = 0; w < stage->workers; w++) {
+                pthread_join(stage->threads[w], NULL);
+            }
+            free(stage->threads);
+            free(stage->window);
+        }
+        for (int i = 0; i <= p->stage_count; i++) {
+            pipeline_queue_free(p->queues[i]);
+        }
+    }
+    free(p);
+}
+
+
+#endif /* LAMBDA_PIPELINE_H */
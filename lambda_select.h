@@ -0,0 +1,571 @@
+#ifndef LAMBDA_SELECT_H
+#define LAMBDA_SELECT_H
+
+#include "lambda_isa.h"
+
+#define LAMBDA_SELECT_X86 LAMBDA_ISA_X86
+
+
+// summarized list of all of the macros and functions defined in the lambda_select.h
+
+/**
+ * Selections:
+ *
+ * select_create(size): Creates a selection of size rows with no row selected.
+ * select_fill(sel, value): Selects all rows (value != 0) or none.
+ * select_set(sel, i) / select_clear(sel, i) / select_test(sel, i): Single-row access.
+ * select_destroy(sel): Frees a selection.
+ */
+
+/**
+ * Filters:
+ *
+ * SELECT_FILTER(sel, arr, type, x, pred): Sets bit i to pred with x = arr[i], 64 rows at a time.
+ * SELECT_FILTER_AND(sel, arr, type, x, pred): Keeps bit i only if pred also holds; skips empty words.
+ * select_filter_lambda(sel, base, stride, pred): Sets bit i when pred(base + i * stride) returns non-NULL.
+ */
+
+/**
+ * Combinators:
+ *
+ * select_and(dst, a, b) / select_or(dst, a, b) / select_andnot(dst, a, b): dst = a & b, a | b, a & ~b.
+ * select_not(dst, a): dst = ~a.
+ * select_count(sel): Number of selected rows.
+ */
+
+/**
+ * Consumers:
+ *
+ * SELECT_FOR_EACH(sel, i): Loops over selected row indexes in ascending order.
+ * SELECT_MAP(sel, out, in, x, expr): out[i] = expr for x = in[i], selected rows only.
+ * SELECT_REDUCE(sel, arr, type, acc, init, x, expr): Folds the selected values of arr.
+ * select_apply(sel, base, stride, fn): Calls a lambda with a pointer to each selected element.
+ * select_to_indices(sel, out) / select_from_indices(sel, indices, count): Converts to and from a selection vector.
+ */
+
+/**
+ * Dispatch:
+ *
+ * select_isa(): Instruction set selected for this CPU (SELECT_ISA_SCALAR, SELECT_ISA_SSE2 or SELECT_ISA_AVX2).
+ * select_set_isa(isa): Forces a lower instruction set for these kernels only (see lambda_isa.h).
+ * select_isa_name(isa): Printable name of an instruction set.
+ */
+
+
+/**
+ * @file lambda_select.h
+ * @brief Packed bitset selections for filter lambda results.
+ *
+ * A predicate over n rows is stored as n bits, not n ints: 32 times less
+ * memory to write, combine and read back. Filters evaluate the predicate
+ * for 64 rows into a byte array (a loop the compiler vectorizes) and pack
+ * it into one word with movemask. AND, OR and NOT process whole 256-bit
+ * vectors, and counting uses the nibble-lookup popcount.
+ *
+ * Consumers read the bits in place. Fully selected words run a dense
+ * loop, empty words are skipped, and mixed words iterate their set bits.
+ * Nothing is compacted or copied.
+ *
+ * Words are 64-byte aligned and padded to a multiple of 512 bits, and
+ * bits past size are always zero, so kernels need no tail handling.
+ *
+ * ```
+ * selection_t* hot = select_create(n);
+ * SELECT_FILTER(hot, temperature, float, t, t > 80.0f);
+ * SELECT_FILTER_AND(hot, state, int, s, s == STATE_RUNNING);
+ * SELECT_MAP(hot, alarm, temperature, t, t - 80.0f);
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+/** Words per padding block: 512 bits, one cache line and two AVX2 vectors. */
+#define SELECT_BLOCK_WORDS 8
+
+typedef struct {
+    uint64_t* words;
+    size_t size;
+    size_t word_count;
+} selection_t;
+
+/********************* Selections ***************************/
+
+/**
+ * @brief Creates a selection of size rows, all cleared.
+ *
+ * Example usage:
+ * ```
+ * selection_t* sel = select_create(1000000);
+ * ```
+ */
+static inline selection_t* select_create(size_t size) {
+    selection_t* sel = SAFE_MALLOC(sizeof(selection_t));
+    size_t words = (size + 63) / 64;
+    sel->word_count = (words + SELECT_BLOCK_WORDS - 1) / SELECT_BLOCK_WORDS * SELECT_BLOCK_WORDS;
+    if (sel->word_count == 0) {
+        sel->word_count = SELECT_BLOCK_WORDS;
+    }
+    sel->size = size;
+    if (posix_memalign((void**)&sel->words, 64, sel->word_count * sizeof(uint64_t)) != 0) {
+        HANDLE_MEMORY_ERROR("Selection allocation failed");
+    }
+    memset(sel->words, 0, sel->word_count * sizeof(uint64_t));
+    return sel;
+}
+
+static inline void select_destroy(selection_t* sel) {
+    if (sel) {
+        SAFE_FREE(sel->words);
+        free(sel);
+    }
+}
+
+/* Restores the invariant that bits past size are zero. */
+static inline void select_trim(selection_t* sel) {
+    size_t full = sel->size / 64;
+    if (sel->size % 64) {
+        sel->words[full] &= (1ull << (sel->size % 64)) - 1;
+        full++;
+    }
+    if (full < sel->word_count) {
+        memset(sel->words + full, 0, (sel->word_count - full) * sizeof(uint64_t));
+    }
+}
+
+static inline void select_fill(selection_t* sel, int value) {
+    memset(sel->words, value ? 0xff : 0, sel->word_count * sizeof(uint64_t));
+    select_trim(sel);
+}
+
+static inline void select_set(selection_t* sel, size_t i) {
+    sel->words[i >> 6] |= 1ull << (i & 63);
+}
+
+static inline void select_clear(selection_t* sel, size_t i) {
+    sel->words[i >> 6] &= ~(1ull << (i & 63));
+}
+
+static inline int select_test(const selection_t* sel, size_t i) {
+    return (int)((sel->words[i >> 6] >> (i & 63)) & 1);
+}
+
+/********************* Kernels ***************************/
+
+typedef enum {
+    SELECT_OP_AND,
+    SELECT_OP_OR,
+    SELECT_OP_ANDNOT,
+    SELECT_OP_NOT
+} select_op_t;
+
+static inline uint64_t select_scalar_popcount(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (x * 0x0101010101010101ull) >> 56;
+}
+
+static inline void select_scalar_combine(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t words,
+                                         select_op_t op) {
+    for (size_t i = 0; i < words; i++) {
+        switch (op) {
+        case SELECT_OP_AND: dst[i] = a[i] & b[i]; break;
+        case SELECT_OP_OR: dst[i] = a[i] | b[i]; break;
+        case SELECT_OP_ANDNOT: dst[i] = a[i] & ~b[i]; break;
+        case SELECT_OP_NOT: dst[i] = ~a[i]; break;
+        }
+    }
+}
+
+static inline size_t select_scalar_count(const uint64_t* words, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += (size_t)select_scalar_popcount(words[i]);
+    }
+    return total;
+}
+
+#if LAMBDA_SELECT_X86
+
+__attribute__((target("sse2")))
+static void select_sse2_combine(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t words, select_op_t op) {
+    for (size_t i = 0; i < words; i += 2) {
+        __m128i x = _mm_load_si128((const __m128i*)(a + i));
+        __m128i r;
+        switch (op) {
+        case SELECT_OP_AND: r = _mm_and_si128(x, _mm_load_si128((const __m128i*)(b + i))); break;
+        case SELECT_OP_OR: r = _mm_or_si128(x, _mm_load_si128((const __m128i*)(b + i))); break;
+        case SELECT_OP_ANDNOT: r = _mm_andnot_si128(_mm_load_si128((const __m128i*)(b + i)), x); break;
+        default: r = _mm_xor_si128(x, _mm_set1_epi32(-1)); break;
+        }
+        _mm_store_si128((__m128i*)(dst + i), r);
+    }
+}
+
+__attribute__((target("avx2")))
+static void select_avx2_combine(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t words, select_op_t op) {
+    for (size_t i = 0; i < words; i += 4) {
+        __m256i x = _mm256_load_si256((const __m256i*)(a + i));
+        __m256i r;
+        switch (op) {
+        case SELECT_OP_AND: r = _mm256_and_si256(x, _mm256_load_si256((const __m256i*)(b + i))); break;
+        case SELECT_OP_OR: r = _mm256_or_si256(x, _mm256_load_si256((const __m256i*)(b + i))); break;
+        case SELECT_OP_ANDNOT: r = _mm256_andnot_si256(_mm256_load_si256((const __m256i*)(b + i)), x); break;
+        default: r = _mm256_xor_si256(x, _mm256_set1_epi32(-1)); break;
+        }
+        _mm256_store_si256((__m256i*)(dst + i), r);
+    }
+}
+
+/* Nibble-lookup popcount (Mula): vpshufb counts each nibble, vpsadbw sums the bytes per 64-bit lane. */
+__attribute__((target("avx2")))
+static size_t select_avx2_count(const uint64_t* words, size_t count) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    for (size_t i = 0; i < count; i += 4) {
+        __m256i v = _mm256_load_si256((const __m256i*)(words + i));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    return (size_t)(_mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                    _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3));
+}
+
+#endif
+
+typedef lambda_isa_t select_isa_t;
+#define SELECT_ISA_SCALAR LAMBDA_ISA_SCALAR
+#define SELECT_ISA_SSE2 LAMBDA_ISA_SSE2
+#define SELECT_ISA_AVX2 LAMBDA_ISA_AVX2
+
+typedef struct {
+    const char* name;
+    void (*combine)(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t words, select_op_t op);
+    size_t (*count)(const uint64_t* words, size_t count);
+} select_kernels_t;
+
+static const select_kernels_t select_kernel_table[] = {
+    { "scalar", select_scalar_combine, select_scalar_count },
+#if LAMBDA_SELECT_X86
+    { "sse2", select_sse2_combine, select_scalar_count },
+    { "avx2", select_avx2_combine, select_avx2_count },
+#endif
+};
+
+static _Atomic int select_selected_isa = LAMBDA_ISA_UNSELECTED;
+
+/**
+ * @brief Instruction set the combinators and count run with; detected on first use.
+ */
+static inline select_isa_t select_isa(void) {
+    return lambda_isa_selected(&select_selected_isa);
+}
+
+/**
+ * @brief Selects the instruction set of the selection kernels; see lambda_isa_select().
+ */
+static inline select_isa_t select_set_isa(select_isa_t isa) {
+    return lambda_isa_select(&select_selected_isa, isa);
+}
+
+static inline const char* select_isa_name(select_isa_t isa) {
+    return select_kernel_table[isa].name;
+}
+
+static inline const select_kernels_t* select_kernels(void) {
+    return &select_kernel_table[select_isa()];
+}
+
+/**
+ * @brief Packs 64 bytes (zero = not selected) into one word, bit j from byte j.
+ */
+static inline uint64_t select_pack64(const uint8_t* bytes) {
+#if LAMBDA_SELECT_X86
+    uint64_t word = 0;
+    for (int q = 0; q < 4; q++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(bytes + 16 * q));
+        uint32_t zero = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        word |= (uint64_t)(~zero & 0xffffu) << (16 * q);
+    }
+    return word;
+#else
+    uint64_t word = 0;
+    for (int j = 0; j < 64; j++) {
+        word |= (uint64_t)(bytes[j] != 0) << j;
+    }
+    return word;
+#endif
+}
+
+/********************* Filters ***************************/
+
+/**
+ * @brief Sets bit i of sel to pred, evaluated with x = arr[i], for every row of sel.
+ *
+ * The 64 predicates of a word are written to a byte array first; that loop
+ * has a fixed trip count and no branches, so the compiler vectorizes it.
+ *
+ * Example usage:
+ * ```
+ * SELECT_FILTER(running, states, int, s, s == STATE_RUNNING);
+ * ```
+ */
+#define SELECT_FILTER(sel, arr, type, x, pred) \
+    SELECT_FILTER_WORDS_(sel, arr, type, x, pred, 0)
+
+/**
+ * @brief ANDs pred into sel: rows already cleared stay cleared, and words with no row selected are not evaluated.
+ *
+ * Example usage:
+ * ```
+ * SELECT_FILTER(sel, price, double, p, p > 100.0);
+ * SELECT_FILTER_AND(sel, quantity, int, q, q >= 10);
+ * ```
+ */
+#define SELECT_FILTER_AND(sel, arr, type, x, pred) \
+    SELECT_FILTER_WORDS_(sel, arr, type, x, pred, 1)
+
+#define SELECT_FILTER_WORDS_(sel, arr, type, x, pred, and_into) \
+    do { \
+        selection_t* select_s_ = (sel); \
+        const type* select_a_ = (arr); \
+        size_t select_n_ = select_s_->size; \
+        uint8_t select_hits_[64]; \
+        for (size_t select_w_ = 0; select_w_ * 64 < select_n_; select_w_++) { \
+            if ((and_into) && select_s_->words[select_w_] == 0) { \
+                continue; \
+            } \
+            const type* select_row_ = select_a_ + select_w_ * 64; \
+            size_t select_len_ = select_n_ - select_w_ * 64; \
+            if (select_len_ >= 64) { \
+                for (int select_j_ = 0; select_j_ < 64; select_j_++) { \
+                    type x = select_row_[select_j_]; \
+                    select_hits_[select_j_] = (pred) ? 1 : 0; \
+                } \
+            } else { \
+                memset(select_hits_, 0, sizeof(select_hits_)); \
+                for (size_t select_j_ = 0; select_j_ < select_len_; select_j_++) { \
+                    type x = select_row_[select_j_]; \
+                    select_hits_[select_j_] = (pred) ? 1 : 0; \
+                } \
+            } \
+            uint64_t select_bits_ = select_pack64(select_hits_); \
+            select_s_->words[select_w_] = (and_into) ? (select_s_->words[select_w_] & select_bits_) : select_bits_; \
+        } \
+    } while (0)
+
+/**
+ * @brief Sets bit i when pred, called with a pointer to element i, returns non-NULL.
+ *
+ * Example usage:
+ * ```
+ * Lambda(is_running, p, return *(int*)p == STATE_RUNNING ? p : NULL;);
+ * select_filter_lambda(sel, states, sizeof(int), is_running);
+ * ```
+ */
+static inline void select_filter_lambda(selection_t* sel, const void* base, size_t stride, lambda_t pred) {
+    uint8_t hits[64];
+    const char* row = (const char*)base;
+    for (size_t w = 0; w * 64 < sel->size; w++) {
+        size_t len = sel->size - w * 64 < 64 ? sel->size - w * 64 : 64;
+        memset(hits, 0, sizeof(hits));
+        for (size_t j = 0; j < len; j++) {
+            hits[j] = pred((void*)(row + (w * 64 + j) * stride)) != NULL;
+        }
+        sel->words[w] = select_pack64(hits);
+    }
+}
+
+/********************* Combinators ***************************/
+
+static inline int select_check_sizes(const selection_t* a, const selection_t* b) {
+    if (a->size != b->size) {
+        LOG_ERROR("Selections have different sizes");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief dst = a & b. dst may be a or b. Returns 0, or -1 if the sizes differ.
+ *
+ * Example usage:
+ * ```
+ * select_and(both, expensive, in_stock);
+ * ```
+ */
+static inline int select_and(selection_t* dst, const selection_t* a, const selection_t* b) {
+    if (select_check_sizes(dst, a) || select_check_sizes(a, b)) {
+        return -1;
+    }
+    select_kernels()->combine(dst->words, a->words, b->words, dst->word_count, SELECT_OP_AND);
+    return 0;
+}
+
+static inline int select_or(selection_t* dst, const selection_t* a, const selection_t* b) {
+    if (select_check_sizes(dst, a) || select_check_sizes(a, b)) {
+        return -1;
+    }
+    select_kernels()->combine(dst->words, a->words, b->words, dst->word_count, SELECT_OP_OR);
+    return 0;
+}
+
+static inline int select_andnot(selection_t* dst, const selection_t* a, const selection_t* b) {
+    if (select_check_sizes(dst, a) || select_check_sizes(a, b)) {
+        return -1;
+    }
+    select_kernels()->combine(dst->words, a->words, b->words, dst->word_count, SELECT_OP_ANDNOT);
+    return 0;
+}
+
+static inline int select_not(selection_t* dst, const selection_t* a) {
+    if (select_check_sizes(dst, a)) {
+        return -1;
+    }
+    select_kernels()->combine(dst->words, a->words, NULL, dst->word_count, SELECT_OP_NOT);
+    select_trim(dst);
+    return 0;
+}
+
+/**
+ * @brief Number of selected rows.
+ */
+static inline size_t select_count(const selection_t* sel) {
+    return select_kernels()->count(sel->words, sel->word_count);
+}
+
+/********************* Consumers ***************************/
+
+/**
+ * @brief Loops over the selected row indexes of sel in ascending order.
+ *
+ * The body is the statement that follows. A break inside it only leaves the
+ * current word; use a flag or goto to stop the whole loop.
+ *
+ * Example usage:
+ * ```
+ * SELECT_FOR_EACH(sel, i) {
+ *     printf("%zu\n", i);
+ * }
+ * ```
+ */
+#define SELECT_FOR_EACH(sel, i) \
+    for (size_t select_w_ = 0, i = 0; select_w_ < (sel)->word_count; select_w_++) \
+        for (uint64_t select_m_ = (sel)->words[select_w_]; \
+             select_m_ && ((i = select_w_ * 64 + (size_t)__builtin_ctzll(select_m_)), 1); \
+             select_m_ &= select_m_ - 1)
+
+/**
+ * @brief out[i] = expr, with x = in[i], for every selected row; other rows of out are untouched.
+ *
+ * Fully selected words run as a dense 64-row loop the compiler vectorizes.
+ *
+ * Example usage:
+ * ```
+ * SELECT_MAP(sel, discounted, price, p, p * 0.9);
+ * ```
+ */
+#define SELECT_MAP(sel, out, in, x, expr) \
+    do { \
+        const selection_t* select_s_ = (sel); \
+        for (size_t select_w_ = 0; select_w_ < select_s_->word_count; select_w_++) { \
+            uint64_t select_m_ = select_s_->words[select_w_]; \
+            size_t select_base_ = select_w_ * 64; \
+            if (select_m_ == ~0ull) { \
+                for (size_t select_j_ = select_base_; select_j_ < select_base_ + 64; select_j_++) { \
+                    __typeof__((in)[0]) x = (in)[select_j_]; \
+                    (out)[select_j_] = (expr); \
+                } \
+                continue; \
+            } \
+            for (; select_m_; select_m_ &= select_m_ - 1) { \
+                size_t select_j_ = select_base_ + (size_t)__builtin_ctzll(select_m_); \
+                __typeof__((in)[0]) x = (in)[select_j_]; \
+                (out)[select_j_] = (expr); \
+            } \
+        } \
+    } while (0)
+
+/**
+ * @brief Folds the selected values of arr: acc starts at init and becomes expr for each x.
+ *
+ * Example usage:
+ * ```
+ * double revenue = SELECT_REDUCE(sel, price, double, acc, 0.0, p, acc + p);
+ * ```
+ */
+#define SELECT_REDUCE(sel, arr, type, acc, init, x, expr) \
+    ({ \
+        const selection_t* select_s_ = (sel); \
+        const type* select_a_ = (arr); \
+        __typeof__(init) acc = (init); \
+        for (size_t select_w_ = 0; select_w_ < select_s_->word_count; select_w_++) { \
+            uint64_t select_m_ = select_s_->words[select_w_]; \
+            size_t select_base_ = select_w_ * 64; \
+            if (select_m_ == ~0ull) { \
+                for (size_t select_j_ = select_base_; select_j_ < select_base_ + 64; select_j_++) { \
+                    type x = select_a_[select_j_]; \
+                    acc = (expr); \
+                } \
+                continue; \
+            } \
+            for (; select_m_; select_m_ &= select_m_ - 1) { \
+                type x = select_a_[select_base_ + (size_t)__builtin_ctzll(select_m_)]; \
+                acc = (expr); \
+            } \
+        } \
+        acc; \
+    })
+
+/**
+ * @brief Calls fn with a pointer to each selected element; a non-NULL return stops. Returns the calls made.
+ *
+ * Example usage:
+ * ```
+ * select_apply(sel, tasks, sizeof(task_t), cancel_task);
+ * ```
+ */
+static inline size_t select_apply(const selection_t* sel, void* base, size_t stride, lambda_t fn) {
+    size_t calls = 0;
+    SELECT_FOR_EACH(sel, i) {
+        calls++;
+        if (fn((char*)base + i * stride)) {
+            return calls;
+        }
+    }
+    return calls;
+}
+
+/**
+ * @brief Writes the selected row indexes to out (room for select_count() entries) and returns how many.
+ *
+ * Example usage:
+ * ```
+ * uint32_t* rows = SAFE_MALLOC(select_count(sel) * sizeof(uint32_t));
+ * size_t n = select_to_indices(sel, rows);
+ * ```
+ */
+static inline size_t select_to_indices(const selection_t* sel, uint32_t* out) {
+    size_t n = 0;
+    for (size_t w = 0; w < sel->word_count; w++) {
+        for (uint64_t m = sel->words[w]; m; m &= m - 1) {
+            out[n++] = (uint32_t)(w * 64 + (size_t)__builtin_ctzll(m));
+        }
+    }
+    return n;
+}
+
+static inline void select_from_indices(selection_t* sel, const uint32_t* indices, size_t count) {
+    memset(sel->words, 0, sel->word_count * sizeof(uint64_t));
+    for (size_t k = 0; k < count; k++) {
+        if (indices[k] < sel->size) {
+            select_set(sel, indices[k]);
+        }
+    }
+}
+
+
+#endif /* LAMBDA_SELECT_H */
@@ -0,0 +1,880 @@
+#ifndef LAMBDA_SHARD_H
+#define LAMBDA_SHARD_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "lambda.h"
+#include "lambda_lock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_shard.h
+
+/**
+ * Pools:
+ *
+ * shard_pool_create(config): Maps the shared region; no workers run yet.
+ * shard_register(pool, name, fn): Registers a worker lambda before start; returns its function ID.
+ * shard_lookup(pool, name): Function ID of a registered name, -1 if unknown.
+ * shard_pool_start(pool): Forks the worker processes.
+ * shard_pool_destroy(pool): Drains, stops and reaps the workers and unmaps the region.
+ */
+
+/**
+ * Work:
+ *
+ * shard_of(pool, key): Worker that handles key.
+ * shard_submit(pool, function, key, data, size): Queues a call on the key's worker.
+ * shard_poll(pool): Delivers the results that have arrived; returns their number.
+ * shard_drain(pool): Waits for every submitted call, restarting crashed workers.
+ * shard_alloc(pool, size): Payload space in shared memory; submitted by reference, never copied.
+ * shard_heap_reset(pool): Frees all shard_alloc() space once nothing is outstanding.
+ */
+
+
+/**
+ * @file lambda_shard.h
+ * @brief Multi-process execution of lambdas over shared-memory rings, with crash restart.
+ *
+ * For workloads that cannot share a process: callbacks that are not
+ * thread-safe, or code that must not take the service down with it.
+ * The pool maps one memfd region before forking, so every worker sees it
+ * at the same address. Each worker owns a request ring and a response
+ * ring, both single-producer single-consumer. shard_submit() hashes the
+ * key to pick the worker, so all calls for a key run in the same process,
+ * in submission order.
+ *
+ * Workers run lambdas by function ID; IDs come from shard_register(), which
+ * must be called before shard_pool_start() so that every worker inherits
+ * the table. A lambda receives a shard_task_t whose data points straight
+ * into the ring, or into the shared heap when the payload came from
+ * shard_alloc(), and sets result/result_size to reply. Results are
+ * delivered to the config's on_result lambda on the parent while it polls.
+ *
+ * A worker takes a request off its ring only after publishing the reply.
+ * When a worker dies, everything still on its ring is intact: the parent
+ * forks a replacement, which picks up where its predecessor stopped.
+ * A request that kills max_attempts workers in a row is dropped and
+ * reported as SHARD_CRASHED, so one poisoned input cannot stall a shard.
+ *
+ * ```
+ * shard_config_t config = { .workers = 8, .on_result = collect, .ctx = &totals };
+ * shard_pool_t* pool = shard_pool_create(&config);
+ * int parse = shard_register(pool, "parse", legacy_parse);
+ * shard_pool_start(pool);
+ * for (size_t i = 0; i < n; i++) {
+ *     shard_submit(pool, parse, user_ids[i], records[i], lengths[i]);
+ * }
+ * shard_drain(pool);
+ * shard_pool_destroy(pool);
+ * ```
+ */
+
+/********************* Tuning Parameters ***************************/
+
+#ifndef SHARD_RING_SIZE
+#define SHARD_RING_SIZE (1u << 20)
+#endif
+
+#ifndef SHARD_HEAP_SIZE
+#define SHARD_HEAP_SIZE (64u << 20)
+#endif
+
+#ifndef SHARD_SPIN
+#define SHARD_SPIN 1024
+#endif
+
+/** Records published before a sleeping peer is woken; waiting or polling wakes it sooner. */
+#ifndef SHARD_WAKE_BATCH
+#define SHARD_WAKE_BATCH 64
+#endif
+
+/** How often a waiting parent checks its workers for crashes. */
+#ifndef SHARD_POLL_MS
+#define SHARD_POLL_MS 10
+#endif
+
+#define SHARD_MAX_WORKERS 1024
+#define SHARD_DEFAULT_ATTEMPTS 2
+
+/********************* Type Definitions ***************************/
+
+typedef enum {
+    SHARD_OK = 0,
+    SHARD_FAILED,           /* the lambda returned non-NULL */
+    SHARD_CRASHED,          /* the request killed max_attempts workers */
+    SHARD_UNKNOWN_FUNCTION,
+    SHARD_RESULT_TOO_LARGE  /* the result did not fit half a ring */
+} shard_status_t;
+
+#define SHARD_RECORD_ALIGN 32
+#define SHARD_RECORD_PAD 0x1
+#define SHARD_RECORD_REF 0x2
+
+/**
+ * @brief Header of every ring record; the payload follows it.
+ *
+ * Records are padded to SHARD_RECORD_ALIGN bytes, so a record never
+ * leaves less than a header's worth of space before the end of the ring.
+ */
+typedef struct {
+    uint32_t size;
+    uint16_t function;
+    uint16_t flags;
+    uint32_t status;
+    uint32_t reserved;
+    uint64_t key;
+    uint64_t seq;
+} shard_record_t;
+
+/**
+ * @brief SPSC byte ring in shared memory. data is an offset from the start of the region.
+ */
+typedef struct {
+    _Alignas(64) _Atomic uint64_t head;
+    _Atomic uint32_t not_empty;
+    _Atomic uint32_t empty_waiters;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Atomic uint32_t not_full;
+    _Atomic uint32_t full_waiters;
+    _Alignas(64) uint64_t capacity;
+    uint64_t data;
+} shard_ring_t;
+
+/**
+ * @brief Start of the shared region: settings every process reads, and the parent's doorbell.
+ */
+typedef struct {
+    uint64_t workers;
+    uint64_t ring_size;
+    uint64_t heap;
+    uint64_t heap_size;
+    int spin;
+    _Atomic uint32_t stop;
+    _Alignas(64) _Atomic uint32_t doorbell;
+    _Atomic uint32_t doorbell_waiters;
+} shard_region_t;
+
+/**
+ * @brief Argument of a worker lambda.
+ *
+ * result must stay valid after the lambda returns, until its next call
+ * (a static or worker-owned buffer); it is copied into the response ring.
+ */
+typedef struct {
+    uint32_t shard;
+    uint32_t function;
+    uint64_t key;
+    const void* data;
+    size_t size;
+    const void* result;
+    size_t result_size;
+    void* ctx;
+} shard_task_t;
+
+/**
+ * @brief Argument of the on_result lambda. data points into the ring and is valid during the call only.
+ */
+typedef struct {
+    uint32_t shard;
+    uint32_t function;
+    uint64_t key;
+    uint64_t seq;
+    shard_status_t status;
+    const void* data;
+    size_t size;
+    void* ctx;
+} shard_result_t;
+
+typedef struct {
+    size_t workers;          /* 0: one per online CPU */
+    size_t ring_size;        /* bytes per ring, rounded up to a power of two; 0: SHARD_RING_SIZE */
+    size_t heap_size;        /* bytes of shard_alloc() space; 0: SHARD_HEAP_SIZE */
+    unsigned max_attempts;   /* runs of a request that crashes its worker; 0: SHARD_DEFAULT_ATTEMPTS */
+    lambda_t on_result;      /* receives shard_result_t*; may be NULL. Must not submit or poll. */
+    void* ctx;               /* passed to worker lambdas and to on_result */
+} shard_config_t;
+
+typedef struct {
+    const char* name;
+    lambda_t fn;
+} shard_function_t;
+
+typedef struct {
+    shard_config_t config;
+    size_t workers;
+    int fd;
+    uint8_t* base;
+    size_t region_size;
+    shard_region_t* region;
+    pid_t* pids;            /* 0 while a shard has no worker because fork failed */
+    uint64_t* submitted;    /* next sequence number, per shard */
+    uint64_t* answered;     /* sequence numbers below this have been delivered */
+    uint64_t* crash_seq;    /* request at the head of the ring when the last worker died */
+    unsigned* unsignalled;  /* requests published since the worker was last woken */
+    unsigned* crash_count;
+    shard_function_t* functions;
+    size_t function_count;
+    size_t function_capacity;
+    size_t heap_used;
+    size_t restarts;
+    int started;
+} shard_pool_t;
+
+/********************* Shared Futexes ***************************/
+
+/* The futex words live in a MAP_SHARED region, so the private variants of lambda_lock.h do not apply. */
+static inline void shard_futex_wait(_Atomic uint32_t* addr, uint32_t expected, int timeout_ms) {
+    struct timespec timeout = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, expected, timeout_ms >= 0 ? &timeout : NULL, NULL, 0);
+}
+
+static inline void shard_futex_wake(_Atomic uint32_t* addr) {
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+/** Wakes sleepers on an event count if there are any. */
+static inline void shard_signal(_Atomic uint32_t* event, _Atomic uint32_t* waiters) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiters, memory_order_relaxed)) {
+        atomic_fetch_add(event, 1);
+        shard_futex_wake(event);
+    }
+}
+
+/********************* Rings ***************************/
+
+static inline size_t shard_record_span(size_t payload) {
+    return (sizeof(shard_record_t) + payload + SHARD_RECORD_ALIGN - 1) & ~(size_t)(SHARD_RECORD_ALIGN - 1);
+}
+
+/**
+ * @brief Reserves a record with room for payload bytes, or returns NULL while the ring is too full.
+ *
+ * When the record would cross the end of the ring, the rest of the ring
+ * is published as a pad record first.
+ */
+static inline shard_record_t* shard_ring_reserve(uint8_t* base, shard_ring_t* ring, size_t payload) {
+    size_t span = shard_record_span(payload);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint64_t pos = head & (ring->capacity - 1);
+    uint64_t to_end = ring->capacity - pos;
+    if (ring->capacity - (head - tail) < (span <= to_end ? span : to_end + span)) {
+        return NULL;
+    }
+    uint8_t* data = base + ring->data;
+    if (span > to_end) {
+        shard_record_t* pad = (shard_record_t*)(data + pos);
+        pad->size = (uint32_t)(to_end - sizeof(shard_record_t));
+        pad->flags = SHARD_RECORD_PAD;
+        atomic_store_explicit(&ring->head, head + to_end, memory_order_release);
+        pos = 0;
+    }
+    shard_record_t* record = (shard_record_t*)(data + pos);
+    record->size = (uint32_t)payload;
+    record->flags = 0;
+    return record;
+}
+
+/** Publishes the record returned by the last shard_ring_reserve(). Waking the consumer is up to the caller. */
+static inline void shard_ring_publish(shard_ring_t* ring, const shard_record_t* record) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + shard_record_span(record->size), memory_order_release);
+}
+
+/** Oldest unreleased record, or NULL if the ring is empty. Pad records are skipped. */
+static inline shard_record_t* shard_ring_peek(uint8_t* base, shard_ring_t* ring) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for (;;) {
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail) {
+            return NULL;
+        }
+        shard_record_t* record = (shard_record_t*)(base + ring->data + (tail & (ring->capacity - 1)));
+        if (!(record->flags & SHARD_RECORD_PAD)) {
+            return record;
+        }
+        tail += shard_record_span(record->size);
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+}
+
+/** Gives the space of the record returned by shard_ring_peek() back to the producer. */
+static inline void shard_ring_release(shard_ring_t* ring, const shard_record_t* record) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + shard_record_span(record->size), memory_order_release);
+    shard_signal(&ring->not_full, &ring->full_waiters);
+}
+
+static inline shard_ring_t* shard_request_ring(shard_pool_t* pool, size_t shard) {
+    return (shard_ring_t*)(pool->base + sizeof(shard_region_t)) + shard * 2;
+}
+
+static inline shard_ring_t* shard_response_ring(shard_pool_t* pool, size_t shard) {
+    return (shard_ring_t*)(pool->base + sizeof(shard_region_t)) + shard * 2 + 1;
+}
+
+/********************* Workers ***************************/
+
+/** Sleeps until cond holds: spins first when there are CPUs to spare, then waits on event. */
+#define SHARD_WAIT_UNTIL(region, cond, event, waiters)                        \
+    do {                                                                      \
+        for (int spins_ = 0; !(cond); spins_++) {                             \
+            if (spins_ < (region)->spin) {                                    \
+                lock_cpu_relax();                                             \
+                continue;                                                     \
+            }                                                                 \
+            uint32_t seen_ = atomic_load(event);                              \
+            atomic_fetch_add(waiters, 1);                                     \
+            atomic_thread_fence(memory_order_seq_cst);                        \
+            if (!(cond)) {                                                    \
+                shard_futex_wait(event, seen_, -1);                           \
+            }                                                                 \
+            atomic_fetch_sub(waiters, 1);                                     \
+        }                                                                     \
+    } while (0)
+
+/**
+ * @brief Body of a worker process: serves its request ring until the pool stops. Never returns.
+ */
+static inline void shard_worker_main(shard_pool_t* pool, uint32_t shard) {
+    shard_region_t* region = pool->region;
+    shard_ring_t* requests = shard_request_ring(pool, shard);
+    shard_ring_t* responses = shard_response_ring(pool, shard);
+    shard_record_t* request = NULL;
+    int unsignalled = 0;
+    for (;;) {
+        SHARD_WAIT_UNTIL(region, (request = shard_ring_peek(pool->base, requests)) || atomic_load(&region->stop),
+                         &requests->not_empty, &requests->empty_waiters);
+        if (!request) {
+            break;
+        }
+        shard_task_t task = { shard, request->function, request->key, request + 1, request->size, NULL, 0,
+                              pool->config.ctx };
+        if (request->flags & SHARD_RECORD_REF) {
+            uint64_t ref[2];
+            memcpy(ref, request + 1, sizeof(ref));
+            task.data = pool->base + region->heap + ref[0];
+            task.size = (size_t)ref[1];
+        }
+        shard_status_t status = SHARD_OK;
+        if (request->function >= pool->function_count) {
+            status = SHARD_UNKNOWN_FUNCTION;
+        } else if (pool->functions[request->function].fn(&task) != NULL) {
+            status = SHARD_FAILED;
+        }
+        if (shard_record_span(task.result_size) > responses->capacity / 2) {
+            status = SHARD_RESULT_TOO_LARGE;
+            task.result_size = 0;
+        }
+        shard_record_t* response = shard_ring_reserve(pool->base, responses, task.result_size);
+        if (!response) {
+            /* The parent has replies to read; make sure it knows before sleeping on a full ring. */
+            shard_signal(&region->doorbell, &region->doorbell_waiters);
+            unsignalled = 0;
+            SHARD_WAIT_UNTIL(region, (response = shard_ring_reserve(pool->base, responses, task.result_size)),
+                             &responses->not_full, &responses->full_waiters);
+        }
+        response->function = request->function;
+        response->status = status;
+        response->key = request->key;
+        response->seq = request->seq;
+        if (task.result_size > 0) {
+            memcpy(response + 1, task.result, task.result_size);
+        }
+        shard_ring_publish(responses, response);
+        /* Only now is the request gone: a crash before this line re-runs it. */
+        shard_ring_release(requests, request);
+        /* Ring the doorbell per batch, and always before going idle. */
+        if (++unsignalled >= SHARD_WAKE_BATCH || !shard_ring_peek(pool->base, requests)) {
+            shard_signal(&region->doorbell, &region->doorbell_waiters);
+            unsignalled = 0;
+        }
+    }
+    fflush(NULL);
+    _exit(0);
+}
+
+static inline int shard_spawn(shard_pool_t* pool, uint32_t shard) {
+    pid_t parent = getpid();
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG_ERROR("Failed to fork shard worker");
+        return -1;
+    }
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) {
+            _exit(0);
+        }
+        shard_worker_main(pool, shard);
+    }
+    pool->pids[shard] = pid;
+    return 0;
+}
+
+/********************* Pools ***************************/
+
+/**
+ * @brief Maps the shared region for a pool. Register functions, then call shard_pool_start().
+ *
+ * Returns NULL if the shared memory cannot be created.
+ *
+ * Example usage:
+ * ```
+ * shard_config_t config = { .workers = 4, .on_result = print_result };
+ * shard_pool_t* pool = shard_pool_create(&config);
+ * ```
+ */
+static inline shard_pool_t* shard_pool_create(const shard_config_t* config) {
+    shard_pool_t* pool = SAFE_MALLOC(sizeof(shard_pool_t));
+    memset(pool, 0, sizeof(shard_pool_t));
+    pool->config = *config;
+    if (pool->config.max_attempts == 0) {
+        pool->config.max_attempts = SHARD_DEFAULT_ATTEMPTS;
+    }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    pool->workers = config->workers ? config->workers : (online > 0 ? (size_t)online : 1);
+    if (pool->workers > SHARD_MAX_WORKERS) {
+        pool->workers = SHARD_MAX_WORKERS;
+    }
+    size_t ring_size = 4096;
+    while (ring_size < (config->ring_size ? config->ring_size : SHARD_RING_SIZE)) {
+        ring_size <<= 1;
+    }
+    size_t heap_size = config->heap_size ? config->heap_size : SHARD_HEAP_SIZE;
+    size_t rings_end = sizeof(shard_region_t) + pool->workers * 2 * sizeof(shard_ring_t);
+    size_t data = (rings_end + 4095) & ~(size_t)4095;
+    size_t heap = data + pool->workers * 2 * ring_size;
+    pool->region_size = heap + ((heap_size + 4095) & ~(size_t)4095);
+
+    pool->fd = memfd_create("lambda_shard", MFD_CLOEXEC);
+    if (pool->fd < 0) {
+        char name[64];
+        snprintf(name, sizeof(name), "/lambda_shard_%d", (int)getpid());
+        pool->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        shm_unlink(name);
+    }
+    if (pool->fd < 0 || ftruncate(pool->fd, (off_t)pool->region_size) != 0) {
+        LOG_ERROR("Failed to create shard shared memory");
+        if (pool->fd >= 0) {
+            close(pool->fd);
+        }
+        free(pool);
+        return NULL;
+    }
+    pool->base = mmap(NULL, pool->region_size, PROT_READ | PROT_WRITE, MAP_SHARED, pool->fd, 0);
+    if (pool->base == MAP_FAILED) {
+        LOG_ERROR("Failed to map shard shared memory");
+        close(pool->fd);
+        free(pool);
+        return NULL;
+    }
+    pool->region = (shard_region_t*)pool->base;
+    pool->region->workers = pool->workers;
+    pool->region->ring_size = ring_size;
+    pool->region->heap = heap;
+    pool->region->heap_size = pool->region_size - heap;
+    pool->region->spin = online > 1 ? SHARD_SPIN : 0;
+    for (size_t s = 0; s < pool->workers * 2; s++) {
+        shard_ring_t* ring = shard_request_ring(pool, 0) + s;
+        ring->capacity = ring_size;
+        ring->data = data + s * ring_size;
+    }
+
+    pool->pids = SAFE_MALLOC(pool->workers * sizeof(pid_t));
+    pool->submitted = SAFE_MALLOC(pool->workers * sizeof(uint64_t));
+    pool->answered = SAFE_MALLOC(pool->workers * sizeof(uint64_t));
+    pool->crash_seq = SAFE_MALLOC(pool->workers * sizeof(uint64_t));
+    pool->crash_count = SAFE_MALLOC(pool->workers * sizeof(unsigned));
+    pool->unsignalled = SAFE_MALLOC(pool->workers * sizeof(unsigned));
+    memset(pool->pids, 0, pool->workers * sizeof(pid_t));
+    memset(pool->submitted, 0, pool->workers * sizeof(uint64_t));
+    memset(pool->answered, 0, pool->workers * sizeof(uint64_t));
+    memset(pool->crash_count, 0, pool->workers * sizeof(unsigned));
+    memset(pool->unsignalled, 0, pool->workers * sizeof(unsigned));
+    return pool;
+}
+
+/**
+ * @brief Registers fn under name and returns its function ID, or -1 after shard_pool_start().
+ *
+ * fn runs in the worker processes with a shard_task_t*; returning non-NULL
+ * reports SHARD_FAILED. Registering a name twice returns the first ID.
+ *
+ * Example usage:
+ * ```
+ * Lambda(word_count, arg,
+ *     shard_task_t* task = (shard_task_t*)arg;
+ *     static uint64_t count;
+ *     count = count_words(task->data, task->size);
+ *     task->result = &count;
+ *     task->result_size = sizeof(count);
+ *     return NULL;
+ * );
+ * int id = shard_register(pool, "word_count", word_count);
+ * ```
+ */
+static inline int shard_register(shard_pool_t* pool, const char* name, lambda_t fn) {
+    if (pool->started) {
+        LOG_ERROR("Shard functions must be registered before shard_pool_start");
+        return -1;
+    }
+    for (size_t i = 0; i < pool->function_count; i++) {
+        if (strcmp(pool->functions[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    if (pool->function_count > UINT16_MAX) {
+        LOG_ERROR("Too many shard functions");
+        return -1;
+    }
+    if (pool->function_count == pool->function_capacity) {
+        pool->function_capacity = pool->function_capacity ? pool->function_capacity * 2 : 8;
+        shard_function_t* grown = realloc(pool->functions, pool->function_capacity * sizeof(shard_function_t));
+        if (!grown) {
+            HANDLE_MEMORY_ERROR("Shard function table allocation failed");
+        }
+        pool->functions = grown;
+    }
+    pool->functions[pool->function_count].name = name;
+    pool->functions[pool->function_count].fn = fn;
+    return (int)pool->function_count++;
+}
+
+static inline int shard_lookup(shard_pool_t* pool, const char* name) {
+    for (size_t i = 0; i < pool->function_count; i++) {
+        if (strcmp(pool->functions[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Forks the workers. Returns 0, or -1 if a worker could not be started.
+ *
+ * The shard count never changes, so keys keep their shards. A shard whose
+ * fork failed is left without a worker and shard_submit() retries the fork.
+ */
+static inline int shard_pool_start(shard_pool_t* pool) {
+    if (pool->started) {
+        return 0;
+    }
+    pool->started = 1;
+    int result = 0;
+    for (uint32_t s = 0; s < pool->workers; s++) {
+        if (shard_spawn(pool, s) != 0) {
+            pool->pids[s] = 0;
+            result = -1;
+        }
+    }
+    return result;
+}
+
+static inline uint32_t shard_of(shard_pool_t* pool, uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return (uint32_t)(key % pool->workers);
+}
+
+/********************* Results and Crash Recovery ***************************/
+
+static inline void shard_deliver(shard_pool_t* pool, uint32_t shard, const shard_record_t* record,
+                                 shard_status_t status, const void* data, size_t size) {
+    pool->answered[shard] = record->seq + 1;
+    if (pool->config.on_result) {
+        shard_result_t result = { shard, record->function, record->key, record->seq, status, data, size,
+                                  pool->config.ctx };
+        pool->config.on_result(&result);
+    }
+}
+
+static inline size_t shard_poll_one(shard_pool_t* pool, uint32_t shard) {
+    shard_ring_t* responses = shard_response_ring(pool, shard);
+    size_t delivered = 0;
+    shard_record_t* record;
+    while ((record = shard_ring_peek(pool->base, responses)) != NULL) {
+        /* A worker that died between replying and releasing its request replies twice. */
+        if (record->seq >= pool->answered[shard]) {
+            shard_deliver(pool, shard, record, (shard_status_t)record->status, record + 1, record->size);
+            delivered++;
+        }
+        shard_ring_release(responses, record);
+    }
+    return delivered;
+}
+
+/* Wakes the worker of shard for the requests published since its last wakeup. */
+static inline void shard_wake(shard_pool_t* pool, uint32_t shard) {
+    if (pool->unsignalled[shard] > 0) {
+        shard_ring_t* requests = shard_request_ring(pool, shard);
+        shard_signal(&requests->not_empty, &requests->empty_waiters);
+        pool->unsignalled[shard] = 0;
+    }
+}
+
+/**
+ * @brief Wakes workers with unannounced requests, then delivers every result that has arrived
+ * to on_result and returns how many there were.
+ */
+static inline size_t shard_poll(shard_pool_t* pool) {
+    size_t delivered = 0;
+    for (uint32_t s = 0; s < pool->workers; s++) {
+        shard_wake(pool, s);
+        delivered += shard_poll_one(pool, s);
+    }
+    return delivered;
+}
+
+/* The worker of shard has died: deliver its last replies, settle the request it died on, fork a new one. */
+static inline void shard_recover(shard_pool_t* pool, uint32_t shard) {
+    shard_ring_t* requests = shard_request_ring(pool, shard);
+    shard_poll_one(pool, shard);
+    shard_record_t* request;
+    while ((request = shard_ring_peek(pool->base, requests)) != NULL && request->seq < pool->answered[shard]) {
+        shard_ring_release(requests, request);
+    }
+    if (request) {
+        if (pool->crash_count[shard] > 0 && pool->crash_seq[shard] == request->seq) {
+            pool->crash_count[shard]++;
+        } else {
+            pool->crash_seq[shard] = request->seq;
+            pool->crash_count[shard] = 1;
+        }
+        if (pool->crash_count[shard] >= pool->config.max_attempts) {
+            LOG_WARNING("Shard request crashed its worker repeatedly; dropping it");
+            shard_deliver(pool, shard, request, SHARD_CRASHED, NULL, 0);
+            shard_ring_release(requests, request);
+            pool->crash_count[shard] = 0;
+        }
+    }
+    atomic_store(&requests->empty_waiters, 0);
+    atomic_store(&shard_response_ring(pool, shard)->full_waiters, 0);
+    LOG_WARNING("Shard worker died; restarting it");
+    if (shard_spawn(pool, shard) == 0) {
+        pool->restarts++;
+        return;
+    }
+    /* No worker will serve this ring: settle everything in it now. shard_submit() retries the fork. */
+    pool->pids[shard] = 0;
+    pool->crash_count[shard] = 0;
+    while ((request = shard_ring_peek(pool->base, requests)) != NULL) {
+        if (request->seq >= pool->answered[shard]) {
+            shard_deliver(pool, shard, request, SHARD_CRASHED, NULL, 0);
+        }
+        shard_ring_release(requests, request);
+    }
+}
+
+/**
+ * @brief Reaps dead workers and restarts them. Returns the number reaped.
+ *
+ * A worker that cannot be re-forked leaves its shard without one: its
+ * pending calls are delivered as SHARD_CRASHED, and the next
+ * shard_submit() to that shard tries the fork again.
+ */
+static inline size_t shard_check_workers(shard_pool_t* pool) {
+    size_t restarted = 0;
+    for (uint32_t s = 0; s < pool->workers; s++) {
+        int status;
+        if (pool->pids[s] > 0 && waitpid(pool->pids[s], &status, WNOHANG) == pool->pids[s]) {
+            shard_recover(pool, s);
+            restarted++;
+        }
+    }
+    return restarted;
+}
+
+static inline int shard_has_responses(shard_pool_t* pool) {
+    for (uint32_t s = 0; s < pool->workers; s++) {
+        shard_ring_t* responses = shard_response_ring(pool, s);
+        if (atomic_load_explicit(&responses->head, memory_order_acquire) !=
+            atomic_load_explicit(&responses->tail, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Parent side of a wait: polls, then sleeps on the doorbell, checking for crashed workers every SHARD_POLL_MS. */
+static inline void shard_wait_progress(shard_pool_t* pool) {
+    shard_region_t* region = pool->region;
+    for (uint32_t s = 0; s < pool->workers; s++) {
+        shard_wake(pool, s);
+    }
+    for (int spins = 0; spins < region->spin; spins++) {
+        if (shard_has_responses(pool)) {
+            shard_poll(pool);
+            return;
+        }
+        lock_cpu_relax();
+    }
+    uint32_t seen = atomic_load(&region->doorbell);
+    atomic_fetch_add(&region->doorbell_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!shard_has_responses(pool)) {
+        shard_futex_wait(&region->doorbell, seen, SHARD_POLL_MS);
+    }
+    atomic_fetch_sub(&region->doorbell_waiters, 1);
+    if (shard_poll(pool) == 0) {
+        shard_check_workers(pool);
+    }
+}
+
+/********************* Submission ***************************/
+
+/**
+ * @brief Queues a call of function on the worker that owns key.
+ *
+ * Returns 0, or -1 on invalid arguments or when the shard has no worker
+ * and forking one fails again.
+ *
+ * Payloads that lie inside shard_alloc() memory are passed by reference;
+ * others are copied into the ring and must fit half of it. While the ring
+ * is full, arriving results are delivered and crashed workers restarted.
+ * A sleeping worker is woken every SHARD_WAKE_BATCH requests, and by
+ * shard_poll() and shard_drain(), so a lone submission needs one of those.
+ *
+ * Example usage:
+ * ```
+ * shard_submit(pool, parse, hash_of(user), line, line_length);
+ * ```
+ */
+static inline int shard_submit(shard_pool_t* pool, int function, uint64_t key, const void* data, size_t size) {
+    if (!pool->started || function < 0 || (size_t)function >= pool->function_count) {
+        LOG_ERROR("Invalid shard submission");
+        return -1;
+    }
+    uint8_t* heap = pool->base + pool->region->heap;
+    int by_ref = size > 0 && (const uint8_t*)data >= heap && (const uint8_t*)data + size <= heap + pool->heap_used;
+    size_t payload = by_ref ? 2 * sizeof(uint64_t) : size;
+    uint32_t shard = shard_of(pool, key);
+    shard_ring_t* requests = shard_request_ring(pool, shard);
+    if (shard_record_span(payload) > requests->capacity / 2) {
+        LOG_ERROR("Shard payload too large for the ring; allocate it with shard_alloc");
+        return -1;
+    }
+    shard_record_t* record = NULL;
+    while (pool->pids[shard] > 0 || shard_spawn(pool, shard) == 0) {
+        if ((record = shard_ring_reserve(pool->base, requests, payload)) != NULL) {
+            break;
+        }
+        shard_wait_progress(pool);
+    }
+    if (!record) {
+        LOG_ERROR("Shard has no worker");
+        return -1;
+    }
+    record->function = (uint16_t)function;
+    record->status = SHARD_OK;
+    record->key = key;
+    record->seq = pool->submitted[shard]++;
+    if (by_ref) {
+        uint64_t ref[2] = { (uint64_t)((const uint8_t*)data - heap), size };
+        record->flags = SHARD_RECORD_REF;
+        memcpy(record + 1, ref, sizeof(ref));
+    } else if (size > 0) {
+        memcpy(record + 1, data, size);
+    }
+    shard_ring_publish(requests, record);
+    if (++pool->unsignalled[shard] >= SHARD_WAKE_BATCH) {
+        shard_wake(pool, shard);
+    }
+    return 0;
+}
+
+static inline size_t shard_outstanding(shard_pool_t* pool) {
+    size_t outstanding = 0;
+    for (uint32_t s = 0; s < pool->workers; s++) {
+        outstanding += pool->submitted[s] - pool->answered[s];
+    }
+    return outstanding;
+}
+
+/**
+ * @brief Waits until every submitted call has been answered and delivered.
+ */
+static inline void shard_drain(shard_pool_t* pool) {
+    shard_poll(pool);
+    while (shard_outstanding(pool) > 0) {
+        shard_wait_progress(pool);
+    }
+}
+
+/**
+ * @brief Returns size bytes (64-byte aligned) of shared memory for zero-copy payloads, or NULL when the heap is full.
+ *
+ * Example usage:
+ * ```
+ * char* page = shard_alloc(pool, length);
+ * read(fd, page, length);
+ * shard_submit(pool, index_page, page_id, page, length);   // workers read it in place
+ * ```
+ */
+static inline void* shard_alloc(shard_pool_t* pool, size_t size) {
+    size_t offset = (pool->heap_used + 63) & ~(size_t)63;
+    if (offset + size > pool->region->heap_size) {
+        return NULL;
+    }
+    pool->heap_used = offset + size;
+    return pool->base + pool->region->heap + offset;
+}
+
+/**
+ * @brief Releases all shard_alloc() memory. Returns -1 (and keeps it) while calls are outstanding.
+ */
+static inline int shard_heap_reset(shard_pool_t* pool) {
+    if (shard_outstanding(pool) > 0) {
+        LOG_WARNING("shard_heap_reset with calls outstanding; call shard_drain first");
+        return -1;
+    }
+    pool->heap_used = 0;
+    return 0;
+}
+
+/**
+ * @brief Drains outstanding calls, stops and reaps the workers, and unmaps the shared region.
+ */
+static inline void shard_pool_destroy(shard_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    if (pool->started) {
+        shard_drain(pool);
+        atomic_store(&pool->region->stop, 1);
+        for (uint32_t s = 0; s < pool->workers; s++) {
+            shard_ring_t* requests = shard_request_ring(pool, s);
+            atomic_fetch_add(&requests->not_empty, 1);
+            shard_futex_wake(&requests->not_empty);
+        }
+        for (uint32_t s = 0; s < pool->workers; s++) {
+            while (pool->pids[s] > 0 && waitpid(pool->pids[s], NULL, 0) < 0 && errno == EINTR) {
+            }
+        }
+    }
+    munmap(pool->base, pool->region_size);
+    close(pool->fd);
+    free(pool->functions);
+    free(pool->pids);
+    free(pool->submitted);
+    free(pool->answered);
+    free(pool->crash_seq);
+    free(pool->crash_count);
+    free(pool->unsignalled);
+    free(pool);
+}
+
+
+#endif /* LAMBDA_SHARD_H */
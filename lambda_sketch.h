@@ -0,0 +1,1044 @@
+#ifndef LAMBDA_SKETCH_H
+#define LAMBDA_SKETCH_H
+
+#include "lambda.h"
+#include <math.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_sketch.h
+
+/**
+ * Hashing:
+ *
+ * sketch_hash64(key, seed): Mixes a 64-bit key into a well-distributed hash.
+ * sketch_hash_bytes(data, len, seed): Hashes a byte string to 64 bits.
+ */
+
+/**
+ * Distinct Count (HyperLogLog):
+ *
+ * hll_create(precision): 2^precision one-byte registers; relative error about 1.04 / sqrt(2^precision).
+ * hll_add(hll, key) / hll_add_hash(hll, hash): Counts one item.
+ * hll_estimate(hll): Estimated number of distinct items.
+ * hll_merge(dst, src): dst becomes the sketch of the union of both streams.
+ * hll_destroy(hll): Frees the sketch.
+ */
+
+/**
+ * Heavy Hitters (Count-Min + heap):
+ *
+ * topk_create(k, width, depth): Tracks the k most frequent keys in width * depth counters.
+ * topk_add(topk, key, weight): Counts weight occurrences of key.
+ * topk_estimate(topk, key): Upper-bound estimate of a key's count.
+ * topk_list(topk, out, max): Writes the tracked keys, most frequent first.
+ * topk_merge(dst, src): Adds src's counts into dst.
+ * topk_destroy(topk): Frees the sketch.
+ */
+
+/**
+ * Quantiles (KLL):
+ *
+ * kll_create(k): Quantile sketch with rank error about 1.7 / k, in O(k) doubles.
+ * kll_add(kll, value): Adds one observation.
+ * kll_quantile(kll, q): Approximate q-quantile (0 <= q <= 1).
+ * kll_rank(kll, value): Approximate fraction of observations <= value.
+ * kll_merge(dst, src): Adds src's observations into dst.
+ * kll_destroy(kll): Frees the sketch.
+ */
+
+/**
+ * Serialization:
+ *
+ * X_serialized_size(sketch): Bytes needed by X_serialize.
+ * X_serialize(sketch, buf, cap): Writes the sketch; returns bytes written, or 0 if cap is too small.
+ * X_deserialize(buf, len): Rebuilds a sketch, or returns NULL for malformed input.
+ */
+
+/**
+ * Accumulator Lambdas:
+ *
+ * hll_accumulate / topk_accumulate / kll_accumulate: lambda_t accumulators over a sketch_input_t.
+ * SKETCH_ACCUMULATE(input, ...): Feeds one input to several accumulators.
+ */
+
+
+/**
+ * @file lambda_sketch.h
+ * @brief Mergeable streaming sketches for top-k, quantiles and distinct counts.
+ *
+ * Each sketch uses a fixed amount of memory, set at creation, however long
+ * the stream runs.
+ *
+ * Two sketches with the same configuration merge into the sketch of the
+ * combined stream. Each thread can keep its own sketch without locking;
+ * merge them when reporting. A serialized sketch can be sent to another
+ * process and merged there.
+ *
+ * The accumulator lambdas take a sketch_input_t carrying the observation
+ * and the sketches to update. Each returns its argument, so several can
+ * be applied to one input in sequence.
+ *
+ * ```
+ * hll_t* users = hll_create(14);
+ * kll_t* latency = kll_create(200);
+ * sketch_input_t in = { 0 };
+ * in.distinct = users;
+ * in.quantiles = latency;
+ * in.key = request->user_id;
+ * in.value = request->millis;
+ * SKETCH_ACCUMULATE(&in, hll_accumulate, kll_accumulate);
+ * printf("users ~%.0f, p99 %.1f ms\n", hll_estimate(users), kll_quantile(latency, 0.99));
+ * ```
+ */
+
+/********************* Hashing ***************************/
+
+static inline uint64_t sketch_hash64(uint64_t key, uint64_t seed) {
+    key ^= seed * 0x9e3779b97f4a7c15ull;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+/**
+ * @brief Hashes a byte string, e.g. to turn string items into sketch keys.
+ *
+ * Example usage:
+ * ```
+ * hll_add(users, sketch_hash_bytes(name, strlen(name), 0));
+ * ```
+ */
+static inline uint64_t sketch_hash_bytes(const void* data, size_t len, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = seed ^ (len * 0x9e3779b97f4a7c15ull);
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ sketch_hash64(word, 0)) * 0x9fb21c651e98df25ull;
+        h = (h << 27) | (h >> 37);
+        p += 8;
+        len -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, len);
+    return sketch_hash64(h ^ tail, len + 1);
+}
+
+/********************* Serialization Helpers ***************************/
+
+#define SKETCH_MAGIC 0x544b534cu /* "LSKT" */
+#define SKETCH_VERSION 1u
+
+typedef enum {
+    SKETCH_HLL = 1,
+    SKETCH_TOPK = 2,
+    SKETCH_KLL = 3
+} sketch_type_t;
+
+/**
+ * @brief Prefix of every serialized sketch. Fields are in host byte order.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint64_t size;
+} sketch_header_t;
+
+typedef struct {
+    unsigned char* buf;
+    size_t pos;
+    size_t cap;
+} sketch_writer_t;
+
+typedef struct {
+    const unsigned char* buf;
+    size_t pos;
+    size_t len;
+    int failed;
+} sketch_reader_t;
+
+static inline void sketch_put(sketch_writer_t* w, const void* data, size_t bytes) {
+    if (w->pos + bytes <= w->cap) {
+        memcpy(w->buf + w->pos, data, bytes);
+    }
+    w->pos += bytes;
+}
+
+/** Bytes left before the end of the serialized sketch. */
+static inline size_t sketch_remaining(const sketch_reader_t* r) {
+    return r->pos <= r->len ? r->len - r->pos : 0;
+}
+
+static inline void sketch_get(sketch_reader_t* r, void* data, size_t bytes) {
+    if (r->failed || bytes > sketch_remaining(r)) {
+        r->failed = 1;
+        memset(data, 0, bytes);
+        return;
+    }
+    memcpy(data, r->buf + r->pos, bytes);
+    r->pos += bytes;
+}
+
+static inline size_t sketch_finish_write(sketch_writer_t* w, sketch_type_t type) {
+    if (w->pos > w->cap) {
+        return 0;
+    }
+    sketch_header_t header = { SKETCH_MAGIC, SKETCH_VERSION, (uint16_t)type, w->pos };
+    memcpy(w->buf, &header, sizeof(header));
+    return w->pos;
+}
+
+static inline int sketch_begin_read(sketch_reader_t* r, const void* buf, size_t len, sketch_type_t type) {
+    sketch_header_t header;
+    r->buf = (const unsigned char*)buf;
+    r->pos = 0;
+    r->len = len;
+    r->failed = 0;
+    sketch_get(r, &header, sizeof(header));
+    if (r->failed || header.magic != SKETCH_MAGIC || header.version != SKETCH_VERSION ||
+        header.type != type || header.size < sizeof(header) || header.size > len) {
+        LOG_ERROR("Malformed or mismatched serialized sketch");
+        return 0;
+    }
+    r->len = (size_t)header.size;
+    return 1;
+}
+
+/********************* HyperLogLog ***************************/
+
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+
+typedef struct {
+    uint32_t precision;
+    uint32_t registers;
+    uint8_t* reg;
+} hll_t;
+
+/**
+ * @brief Creates a HyperLogLog sketch of 2^precision bytes.
+ *
+ * precision 14 uses 16 KB for about 0.8% error.
+ *
+ * Example usage:
+ * ```
+ * hll_t* visitors = hll_create(14);
+ * ```
+ */
+static inline hll_t* hll_create(uint32_t precision) {
+    if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) {
+        HANDLE_INVALID_ARGUMENT(precision >= HLL_MIN_PRECISION && precision <= HLL_MAX_PRECISION,
+                                "HyperLogLog precision must be between 4 and 18");
+        return NULL;
+    }
+    hll_t* hll = SAFE_MALLOC(sizeof(hll_t));
+    hll->precision = precision;
+    hll->registers = 1u << precision;
+    hll->reg = calloc(hll->registers, 1);
+    if (!hll->reg) {
+        HANDLE_MEMORY_ERROR("HyperLogLog allocation failed");
+    }
+    return hll;
+}
+
+static inline void hll_destroy(hll_t* hll) {
+    if (hll) {
+        SAFE_FREE(hll->reg);
+        free(hll);
+    }
+}
+
+static inline void hll_add_hash(hll_t* hll, uint64_t hash) {
+    uint32_t index = (uint32_t)(hash >> (64 - hll->precision));
+    /* The guard bit caps the rank at 64 - precision + 1 when the remaining bits are all zero. */
+    uint64_t rest = (hash << hll->precision) | (1ull << (hll->precision - 1));
+    uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+    if (rank > hll->reg[index]) {
+        hll->reg[index] = rank;
+    }
+}
+
+static inline void hll_add(hll_t* hll, uint64_t key) {
+    hll_add_hash(hll, sketch_hash64(key, 0));
+}
+
+/**
+ * @brief Estimates the number of distinct items, with linear counting for small cardinalities.
+ */
+static inline double hll_estimate(const hll_t* hll) {
+    double m = hll->registers;
+    double sum = 0;
+    uint32_t zeros = 0;
+    for (uint32_t i = 0; i < hll->registers; i++) {
+        sum += ldexp(1.0, -hll->reg[i]);
+        zeros += hll->reg[i] == 0;
+    }
+    double alpha = hll->registers == 16 ? 0.673 : hll->registers == 32 ? 0.697 : hll->registers == 64 ? 0.709
+                 : 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros) {
+        estimate = m * log(m / zeros);
+    }
+    return estimate;
+}
+
+/**
+ * @brief Merges src into dst. Both must have the same precision; returns 0, or -1 if they differ.
+ */
+static inline int hll_merge(hll_t* dst, const hll_t* src) {
+    if (dst->precision != src->precision) {
+        LOG_ERROR("Cannot merge HyperLogLog sketches of different precision");
+        return -1;
+    }
+    for (uint32_t i = 0; i < dst->registers; i++) {
+        dst->reg[i] = src->reg[i] > dst->reg[i] ? src->reg[i] : dst->reg[i];
+    }
+    return 0;
+}
+
+static inline size_t hll_serialized_size(const hll_t* hll) {
+    return sizeof(sketch_header_t) + sizeof(uint32_t) + hll->registers;
+}
+
+static inline size_t hll_serialize(const hll_t* hll, void* buf, size_t cap) {
+    sketch_writer_t w = { (unsigned char*)buf, sizeof(sketch_header_t), cap };
+    sketch_put(&w, &hll->precision, sizeof(hll->precision));
+    sketch_put(&w, hll->reg, hll->registers);
+    return sketch_finish_write(&w, SKETCH_HLL);
+}
+
+static inline hll_t* hll_deserialize(const void* buf, size_t len) {
+    sketch_reader_t r;
+    uint32_t precision;
+    if (!sketch_begin_read(&r, buf, len, SKETCH_HLL)) {
+        return NULL;
+    }
+    sketch_get(&r, &precision, sizeof(precision));
+    if (r.failed || precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) {
+        return NULL;
+    }
+    hll_t* hll = hll_create(precision);
+    sketch_get(&r, hll->reg, hll->registers);
+    if (r.failed) {
+        hll_destroy(hll);
+        return NULL;
+    }
+    return hll;
+}
+
+/********************* Count-Min Top-K ***************************/
+
+typedef struct {
+    uint64_t key;
+    uint64_t count;
+} topk_entry_t;
+
+/**
+ * @brief Count-Min sketch plus a min-heap of the k keys with the highest estimates.
+ *
+ * index maps a heap key to its position (stored + 1, 0 = empty) so updates
+ * to tracked keys are O(log k) rather than a scan of the heap.
+ */
+typedef struct {
+    uint32_t k;
+    uint32_t width;
+    uint32_t depth;
+    uint64_t total;
+    uint64_t* counters;
+    topk_entry_t* heap;
+    uint32_t heap_size;
+    uint64_t* index_keys;
+    uint32_t* index_pos;
+    uint32_t index_mask;
+} topk_t;
+
+/** Largest k and width topk_create() accepts, so that 2 * k and the rounded width fit in 32 bits. */
+#define TOPK_MAX_K (1u << 30)
+#define TOPK_MAX_WIDTH (1u << 31)
+
+/**
+ * @brief Creates a top-k sketch: width is rounded up to a power of two, depth is the number of hash rows.
+ *
+ * Returns NULL when k exceeds TOPK_MAX_K or width exceeds TOPK_MAX_WIDTH.
+ * Each estimate overcounts by at most about e * total / width with probability 1 - e^-depth.
+ *
+ * Example usage:
+ * ```
+ * topk_t* hot = topk_create(100, 1 << 16, 4);
+ * ```
+ */
+static inline topk_t* topk_create(uint32_t k, uint32_t width, uint32_t depth) {
+    if (k == 0 || width == 0 || depth == 0 || depth > 64) {
+        HANDLE_INVALID_ARGUMENT(k && width && depth && depth <= 64, "Top-k sketch needs k, width > 0 and 1..64 rows");
+        return NULL;
+    }
+    if (k > TOPK_MAX_K || width > TOPK_MAX_WIDTH) {
+        LOG_ERROR("Top-k sketch k or width too large");
+        return NULL;
+    }
+    topk_t* t = SAFE_MALLOC(sizeof(topk_t));
+    uint32_t w = 1;
+    while (w < width) {
+        w <<= 1;
+    }
+    uint32_t slots = 4;
+    while (slots < 2 * k) {
+        slots <<= 1;
+    }
+    t->k = k;
+    t->width = w;
+    t->depth = depth;
+    t->total = 0;
+    t->counters = calloc((size_t)w * depth, sizeof(uint64_t));
+    t->heap = SAFE_MALLOC(k * sizeof(topk_entry_t));
+    t->heap_size = 0;
+    t->index_keys = SAFE_MALLOC(slots * sizeof(uint64_t));
+    t->index_pos = calloc(slots, sizeof(uint32_t));
+    t->index_mask = slots - 1;
+    if (!t->counters || !t->index_pos) {
+        HANDLE_MEMORY_ERROR("Top-k sketch allocation failed");
+    }
+    return t;
+}
+
+static inline void topk_destroy(topk_t* t) {
+    if (t) {
+        SAFE_FREE(t->counters);
+        SAFE_FREE(t->heap);
+        SAFE_FREE(t->index_keys);
+        SAFE_FREE(t->index_pos);
+        free(t);
+    }
+}
+
+static inline uint32_t topk_index_find(const topk_t* t, uint64_t key) {
+    uint32_t i = (uint32_t)sketch_hash64(key, 0x70b) & t->index_mask;
+    while (t->index_pos[i]) {
+        if (t->index_keys[i] == key) {
+            return i;
+        }
+        i = (i + 1) & t->index_mask;
+    }
+    return UINT32_MAX;
+}
+
+static inline void topk_index_set(topk_t* t, uint64_t key, uint32_t pos) {
+    uint32_t i = (uint32_t)sketch_hash64(key, 0x70b) & t->index_mask;
+    while (t->index_pos[i] && t->index_keys[i] != key) {
+        i = (i + 1) & t->index_mask;
+    }
+    t->index_keys[i] = key;
+    t->index_pos[i] = pos + 1;
+}
+
+/* Linear-probing delete by backward shift, so lookups never need tombstones. */
+static inline void topk_index_remove(topk_t* t, uint64_t key) {
+    uint32_t i = topk_index_find(t, key);
+    if (i == UINT32_MAX) {
+        return;
+    }
+    for (uint32_t j = (i + 1) & t->index_mask; t->index_pos[j]; j = (j + 1) & t->index_mask) {
+        uint32_t home = (uint32_t)sketch_hash64(t->index_keys[j], 0x70b) & t->index_mask;
+        /* Move j into the hole at i unless its home lies cyclically in (i, j]. */
+        if (((j - home) & t->index_mask) >= ((j - i) & t->index_mask)) {
+            t->index_keys[i] = t->index_keys[j];
+            t->index_pos[i] = t->index_pos[j];
+            i = j;
+        }
+    }
+    t->index_pos[i] = 0;
+}
+
+static inline void topk_heap_sift_down(topk_t* t, uint32_t i) {
+    topk_entry_t entry = t->heap[i];
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= t->heap_size) {
+            break;
+        }
+        if (child + 1 < t->heap_size && t->heap[child + 1].count < t->heap[child].count) {
+            child++;
+        }
+        if (t->heap[child].count >= entry.count) {
+            break;
+        }
+        t->heap[i] = t->heap[child];
+        topk_index_set(t, t->heap[i].key, i);
+        i = child;
+    }
+    t->heap[i] = entry;
+    topk_index_set(t, entry.key, i);
+}
+
+static inline void topk_heap_sift_up(topk_t* t, uint32_t i) {
+    topk_entry_t entry = t->heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (t->heap[parent].count <= entry.count) {
+            break;
+        }
+        t->heap[i] = t->heap[parent];
+        topk_index_set(t, t->heap[i].key, i);
+        i = parent;
+    }
+    t->heap[i] = entry;
+    topk_index_set(t, entry.key, i);
+}
+
+static inline uint64_t topk_estimate(const topk_t* t, uint64_t key) {
+    uint64_t estimate = UINT64_MAX;
+    for (uint32_t d = 0; d < t->depth; d++) {
+        uint64_t c = t->counters[(size_t)d * t->width + (sketch_hash64(key, d + 1) & (t->width - 1))];
+        estimate = c < estimate ? c : estimate;
+    }
+    return estimate;
+}
+
+/* Keeps key in the heap if its estimate is among the k largest. */
+static inline void topk_offer(topk_t* t, uint64_t key, uint64_t estimate) {
+    uint32_t slot = topk_index_find(t, key);
+    if (slot != UINT32_MAX) {
+        uint32_t pos = t->index_pos[slot] - 1;
+        t->heap[pos].count = estimate;
+        topk_heap_sift_down(t, pos);
+    } else if (t->heap_size < t->k) {
+        t->heap[t->heap_size] = (topk_entry_t){ key, estimate };
+        topk_heap_sift_up(t, t->heap_size++);
+    } else if (estimate > t->heap[0].count) {
+        topk_index_remove(t, t->heap[0].key);
+        t->heap[0] = (topk_entry_t){ key, estimate };
+        topk_heap_sift_down(t, 0);
+    }
+}
+
+/**
+ * @brief Counts weight occurrences of key, with the conservative update that only raises the minimum counters.
+ *
+ * Example usage:
+ * ```
+ * topk_add(hot, url_hash, 1);
+ * ```
+ */
+static inline void topk_add(topk_t* t, uint64_t key, uint64_t weight) {
+    size_t cells[64];
+    uint32_t depth = t->depth;
+    uint64_t estimate = UINT64_MAX;
+    for (uint32_t d = 0; d < depth; d++) {
+        cells[d] = (size_t)d * t->width + (sketch_hash64(key, d + 1) & (t->width - 1));
+        estimate = t->counters[cells[d]] < estimate ? t->counters[cells[d]] : estimate;
+    }
+    estimate += weight;
+    for (uint32_t d = 0; d < depth; d++) {
+        if (t->counters[cells[d]] < estimate) {
+            t->counters[cells[d]] = estimate;
+        }
+    }
+    t->total += weight;
+    topk_offer(t, key, estimate);
+}
+
+static inline int topk_compare_desc(const void* a, const void* b) {
+    const topk_entry_t* x = (const topk_entry_t*)a;
+    const topk_entry_t* y = (const topk_entry_t*)b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/**
+ * @brief Copies up to max tracked keys into out, most frequent first, and returns how many were written.
+ *
+ * Example usage:
+ * ```
+ * topk_entry_t top[10];
+ * size_t n = topk_list(hot, top, 10);
+ * ```
+ */
+static inline size_t topk_list(const topk_t* t, topk_entry_t* out, size_t max) {
+    topk_entry_t* all = SAFE_MALLOC((t->heap_size ? t->heap_size : 1) * sizeof(topk_entry_t));
+    memcpy(all, t->heap, t->heap_size * sizeof(topk_entry_t));
+    qsort(all, t->heap_size, sizeof(topk_entry_t), topk_compare_desc);
+    size_t n = t->heap_size < max ? t->heap_size : max;
+    memcpy(out, all, n * sizeof(topk_entry_t));
+    free(all);
+    return n;
+}
+
+/* Rebuilds the heap from candidate keys, using the current counters for their estimates. */
+static inline void topk_rebuild(topk_t* t, const uint64_t* keys, size_t count) {
+    topk_entry_t* candidates = SAFE_MALLOC((count ? count : 1) * sizeof(topk_entry_t));
+    for (size_t i = 0; i < count; i++) {
+        candidates[i] = (topk_entry_t){ keys[i], topk_estimate(t, keys[i]) };
+    }
+    qsort(candidates, count, sizeof(topk_entry_t), topk_compare_desc);
+    memset(t->index_pos, 0, (t->index_mask + 1) * sizeof(uint32_t));
+    t->heap_size = 0;
+    for (size_t i = 0; i < count && t->heap_size < t->k; i++) {
+        if (i > 0 && candidates[i].key == candidates[i - 1].key) {
+            continue;
+        }
+        t->heap[t->heap_size] = candidates[i];
+        topk_heap_sift_up(t, t->heap_size++);
+    }
+    free(candidates);
+}
+
+static inline int topk_compare_key(const void* a, const void* b) {
+    uint64_t x = ((const topk_entry_t*)a)->key, y = ((const topk_entry_t*)b)->key;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Adds src's counts into dst. Both need the same width and depth; returns 0, or -1 if they differ.
+ *
+ * The merged heap is chosen from the keys either sketch tracked, re-estimated from the merged counters.
+ */
+static inline int topk_merge(topk_t* dst, const topk_t* src) {
+    if (dst->width != src->width || dst->depth != src->depth) {
+        LOG_ERROR("Cannot merge top-k sketches of different dimensions");
+        return -1;
+    }
+    size_t cells = (size_t)dst->width * dst->depth;
+    for (size_t i = 0; i < cells; i++) {
+        dst->counters[i] += src->counters[i];
+    }
+    dst->total += src->total;
+    size_t count = dst->heap_size + src->heap_size;
+    topk_entry_t* merged = SAFE_MALLOC((count ? count : 1) * sizeof(topk_entry_t));
+    memcpy(merged, dst->heap, dst->heap_size * sizeof(topk_entry_t));
+    memcpy(merged + dst->heap_size, src->heap, src->heap_size * sizeof(topk_entry_t));
+    /* Keys tracked by both sketches appear once among the candidates. */
+    qsort(merged, count, sizeof(topk_entry_t), topk_compare_key);
+    uint64_t* keys = SAFE_MALLOC((count ? count : 1) * sizeof(uint64_t));
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique == 0 || keys[unique - 1] != merged[i].key) {
+            keys[unique++] = merged[i].key;
+        }
+    }
+    topk_rebuild(dst, keys, unique);
+    free(keys);
+    free(merged);
+    return 0;
+}
+
+static inline size_t topk_serialized_size(const topk_t* t) {
+    return sizeof(sketch_header_t) + 4 * sizeof(uint32_t) + sizeof(uint64_t) +
+           (size_t)t->width * t->depth * sizeof(uint64_t) + t->heap_size * sizeof(uint64_t);
+}
+
+static inline size_t topk_serialize(const topk_t* t, void* buf, size_t cap) {
+    sketch_writer_t w = { (unsigned char*)buf, sizeof(sketch_header_t), cap };
+    sketch_put(&w, &t->k, sizeof(t->k));
+    sketch_put(&w, &t->width, sizeof(t->width));
+    sketch_put(&w, &t->depth, sizeof(t->depth));
+    sketch_put(&w, &t->heap_size, sizeof(t->heap_size));
+    sketch_put(&w, &t->total, sizeof(t->total));
+    sketch_put(&w, t->counters, (size_t)t->width * t->depth * sizeof(uint64_t));
+    for (uint32_t i = 0; i < t->heap_size; i++) {
+        sketch_put(&w, &t->heap[i].key, sizeof(uint64_t));
+    }
+    return sketch_finish_write(&w, SKETCH_TOPK);
+}
+
+static inline topk_t* topk_deserialize(const void* buf, size_t len) {
+    sketch_reader_t r;
+    uint32_t k, width, depth, heap_size;
+    uint64_t total;
+    if (!sketch_begin_read(&r, buf, len, SKETCH_TOPK)) {
+        return NULL;
+    }
+    sketch_get(&r, &k, sizeof(k));
+    sketch_get(&r, &width, sizeof(width));
+    sketch_get(&r, &depth, sizeof(depth));
+    sketch_get(&r, &heap_size, sizeof(heap_size));
+    sketch_get(&r, &total, sizeof(total));
+    if (r.failed || k == 0 || depth == 0 || width == 0 || (width & (width - 1)) || heap_size > k ||
+        depth > 64 ||
+        sketch_remaining(&r) / sizeof(uint64_t) < (size_t)width * depth + heap_size) {
+        return NULL;
+    }
+    /* k sizes the heap and index before anything is read, so an untrusted k
+     * may exceed the serialized heap by at most the serialized counter count;
+     * the allocation then stays proportional to len. */
+    if (k - heap_size > (size_t)width * depth) {
+        return NULL;
+    }
+    topk_t* t = topk_create(k, width, depth);
+    if (!t) {
+        return NULL;
+    }
+    t->total = total;
+    sketch_get(&r, t->counters, (size_t)width * depth * sizeof(uint64_t));
+    uint64_t* keys = SAFE_MALLOC((heap_size ? heap_size : 1) * sizeof(uint64_t));
+    sketch_get(&r, keys, heap_size * sizeof(uint64_t));
+    topk_rebuild(t, keys, heap_size);
+    free(keys);
+    return t;
+}
+
+/********************* KLL Quantiles ***************************/
+
+/**
+ * @brief One KLL compactor: items whose weight is 2^level.
+ */
+typedef struct {
+    double* items;
+    uint32_t size;
+    uint32_t capacity;
+} kll_level_t;
+
+/**
+ * @brief KLL sketch (Karnin, Lang, Liberty). Level capacities shrink by 2/3 per level below the top.
+ *
+ * A full level is sorted and every other item, starting at a random
+ * offset, moves up with double weight. Total weight always equals count.
+ */
+typedef struct {
+    uint32_t k;
+    uint32_t height;
+    uint64_t count;
+    double min;
+    double max;
+    kll_level_t* levels;
+    uint32_t level_slots;
+    size_t size;
+    size_t max_size;
+    uint64_t rng;
+} kll_t;
+
+static inline uint32_t kll_capacity(const kll_t* s, uint32_t level) {
+    double cap = ceil(s->k * pow(2.0 / 3.0, (double)(s->height - level - 1)));
+    return cap < 2 ? 2 : (uint32_t)cap + 1;
+}
+
+static inline void kll_grow(kll_t* s) {
+    if (s->height == s->level_slots) {
+        s->level_slots *= 2;
+        s->levels = realloc(s->levels, s->level_slots * sizeof(kll_level_t));
+        if (!s->levels) {
+            HANDLE_MEMORY_ERROR("KLL level allocation failed");
+        }
+    }
+    s->levels[s->height++] = (kll_level_t){ NULL, 0, 0 };
+    s->max_size = 0;
+    for (uint32_t h = 0; h < s->height; h++) {
+        s->max_size += kll_capacity(s, h);
+    }
+}
+
+static inline void kll_push(kll_level_t* level, double value) {
+    if (level->size == level->capacity) {
+        level->capacity = level->capacity ? level->capacity * 2 : 16;
+        level->items = realloc(level->items, level->capacity * sizeof(double));
+        if (!level->items) {
+            HANDLE_MEMORY_ERROR("KLL compactor allocation failed");
+        }
+    }
+    level->items[level->size++] = value;
+}
+
+/**
+ * @brief Creates a KLL quantile sketch. k = 200 gives ranks within about 1% using a few KB.
+ *
+ * Example usage:
+ * ```
+ * kll_t* latency = kll_create(200);
+ * ```
+ */
+static inline kll_t* kll_create(uint32_t k) {
+    if (k < 8) {
+        HANDLE_INVALID_ARGUMENT(k >= 8, "KLL k must be at least 8");
+        return NULL;
+    }
+    kll_t* s = SAFE_MALLOC(sizeof(kll_t));
+    s->k = k;
+    s->height = 0;
+    s->count = 0;
+    s->min = INFINITY;
+    s->max = -INFINITY;
+    s->level_slots = 8;
+    s->levels = SAFE_MALLOC(s->level_slots * sizeof(kll_level_t));
+    s->size = 0;
+    s->rng = 0x853c49e6748fea9bull ^ k;
+    kll_grow(s);
+    return s;
+}
+
+static inline void kll_destroy(kll_t* s) {
+    if (s) {
+        for (uint32_t h = 0; h < s->height; h++) {
+            SAFE_FREE(s->levels[h].items);
+        }
+        SAFE_FREE(s->levels);
+        free(s);
+    }
+}
+
+static inline int kll_compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Compacts the lowest level that is over capacity. */
+static inline void kll_compress(kll_t* s) {
+    for (uint32_t h = 0; h < s->height; h++) {
+        kll_level_t* level = &s->levels[h];
+        if (level->size < kll_capacity(s, h)) {
+            continue;
+        }
+        if (h + 1 == s->height) {
+            kll_grow(s);
+            level = &s->levels[h];
+        }
+        qsort(level->items, level->size, sizeof(double), kll_compare_doubles);
+        uint32_t pairs = level->size / 2;
+        s->rng ^= s->rng << 13;
+        s->rng ^= s->rng >> 7;
+        s->rng ^= s->rng << 17;
+        uint32_t offset = (uint32_t)(s->rng & 1);
+        for (uint32_t i = 0; i < pairs; i++) {
+            kll_push(&s->levels[h + 1], level->items[2 * i + offset]);
+        }
+        /* An odd item out (the largest) stays at this level. */
+        if (level->size & 1) {
+            level->items[0] = level->items[level->size - 1];
+            level->size = 1;
+        } else {
+            level->size = 0;
+        }
+        s->size -= pairs;
+        return;
+    }
+}
+
+static inline void kll_add(kll_t* s, double value) {
+    kll_push(&s->levels[0], value);
+    s->size++;
+    s->count++;
+    s->min = value < s->min ? value : s->min;
+    s->max = value > s->max ? value : s->max;
+    if (s->size >= s->max_size) {
+        kll_compress(s);
+    }
+}
+
+/**
+ * @brief Adds src's observations into dst; any two KLL sketches can be merged.
+ */
+static inline void kll_merge(kll_t* dst, const kll_t* src) {
+    while (dst->height < src->height) {
+        kll_grow(dst);
+    }
+    for (uint32_t h = 0; h < src->height; h++) {
+        for (uint32_t i = 0; i < src->levels[h].size; i++) {
+            kll_push(&dst->levels[h], src->levels[h].items[i]);
+        }
+        dst->size += src->levels[h].size;
+    }
+    dst->count += src->count;
+    dst->min = src->min < dst->min ? src->min : dst->min;
+    dst->max = src->max > dst->max ? src->max : dst->max;
+    while (dst->size >= dst->max_size) {
+        kll_compress(dst);
+    }
+}
+
+typedef struct {
+    double value;
+    uint64_t weight;
+} kll_weighted_t;
+
+static inline int kll_compare_weighted(const void* a, const void* b) {
+    return kll_compare_doubles(&((const kll_weighted_t*)a)->value, &((const kll_weighted_t*)b)->value);
+}
+
+/* All retained items with their weights, sorted by value. */
+static inline kll_weighted_t* kll_sorted(const kll_t* s, size_t* out_count) {
+    kll_weighted_t* all = SAFE_MALLOC((s->size ? s->size : 1) * sizeof(kll_weighted_t));
+    size_t n = 0;
+    for (uint32_t h = 0; h < s->height; h++) {
+        for (uint32_t i = 0; i < s->levels[h].size; i++) {
+            all[n++] = (kll_weighted_t){ s->levels[h].items[i], 1ull << h };
+        }
+    }
+    qsort(all, n, sizeof(kll_weighted_t), kll_compare_weighted);
+    *out_count = n;
+    return all;
+}
+
+/**
+ * @brief Returns an approximate q-quantile; q <= 0 and q >= 1 return the exact min and max.
+ *
+ * Example usage:
+ * ```
+ * double p99 = kll_quantile(latency, 0.99);
+ * ```
+ */
+static inline double kll_quantile(const kll_t* s, double q) {
+    if (s->count == 0) {
+        return NAN;
+    }
+    if (q <= 0) {
+        return s->min;
+    }
+    if (q >= 1) {
+        return s->max;
+    }
+    size_t n;
+    kll_weighted_t* all = kll_sorted(s, &n);
+    double target = q * (double)s->count;
+    double result = s->max;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < n; i++) {
+        seen += all[i].weight;
+        if ((double)seen >= target) {
+            result = all[i].value;
+            break;
+        }
+    }
+    free(all);
+    return result;
+}
+
+/**
+ * @brief Returns the approximate fraction of observations less than or equal to value.
+ */
+static inline double kll_rank(const kll_t* s, double value) {
+    if (s->count == 0) {
+        return NAN;
+    }
+    uint64_t below = 0;
+    for (uint32_t h = 0; h < s->height; h++) {
+        for (uint32_t i = 0; i < s->levels[h].size; i++) {
+            below += s->levels[h].items[i] <= value ? 1ull << h : 0;
+        }
+    }
+    return (double)below / (double)s->count;
+}
+
+static inline size_t kll_serialized_size(const kll_t* s) {
+    return sizeof(sketch_header_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(double) +
+           s->height * sizeof(uint32_t) + s->size * sizeof(double);
+}
+
+static inline size_t kll_serialize(const kll_t* s, void* buf, size_t cap) {
+    sketch_writer_t w = { (unsigned char*)buf, sizeof(sketch_header_t), cap };
+    sketch_put(&w, &s->k, sizeof(s->k));
+    sketch_put(&w, &s->height, sizeof(s->height));
+    sketch_put(&w, &s->count, sizeof(s->count));
+    sketch_put(&w, &s->min, sizeof(s->min));
+    sketch_put(&w, &s->max, sizeof(s->max));
+    for (uint32_t h = 0; h < s->height; h++) {
+        sketch_put(&w, &s->levels[h].size, sizeof(uint32_t));
+        sketch_put(&w, s->levels[h].items, s->levels[h].size * sizeof(double));
+    }
+    return sketch_finish_write(&w, SKETCH_KLL);
+}
+
+static inline kll_t* kll_deserialize(const void* buf, size_t len) {
+    sketch_reader_t r;
+    uint32_t k, height;
+    if (!sketch_begin_read(&r, buf, len, SKETCH_KLL)) {
+        return NULL;
+    }
+    sketch_get(&r, &k, sizeof(k));
+    sketch_get(&r, &height, sizeof(height));
+    if (r.failed || k < 8 || height == 0 || height > 64) {
+        return NULL;
+    }
+    kll_t* s = kll_create(k);
+    while (s->height < height) {
+        kll_grow(s);
+    }
+    sketch_get(&r, &s->count, sizeof(s->count));
+    sketch_get(&r, &s->min, sizeof(s->min));
+    sketch_get(&r, &s->max, sizeof(s->max));
+    for (uint32_t h = 0; h < height && !r.failed; h++) {
+        uint32_t size;
+        sketch_get(&r, &size, sizeof(size));
+        if (r.failed || sketch_remaining(&r) / sizeof(double) < size) {
+            r.failed = 1;
+            break;
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            double value;
+            sketch_get(&r, &value, sizeof(value));
+            kll_push(&s->levels[h], value);
+        }
+        s->size += size;
+    }
+    if (r.failed) {
+        kll_destroy(s);
+        return NULL;
+    }
+    while (s->size >= s->max_size) {
+        kll_compress(s);
+    }
+    return s;
+}
+
+/********************* Accumulator Lambdas ***************************/
+
+/**
+ * @brief One observation for the accumulator lambdas, plus the sketches to update (NULL = skip).
+ *
+ * key feeds the top-k and distinct-count sketches and value feeds the
+ * quantile sketch. weight is the top-k increment, where 0 counts as 1.
+ */
+typedef struct {
+    uint64_t key;
+    double value;
+    uint64_t weight;
+    topk_t* topk;
+    kll_t* quantiles;
+    hll_t* distinct;
+} sketch_input_t;
+
+static inline void* hll_accumulate(void* arg) {
+    sketch_input_t* in = (sketch_input_t*)arg;
+    if (in->distinct) {
+        hll_add(in->distinct, in->key);
+    }
+    return arg;
+}
+
+static inline void* topk_accumulate(void* arg) {
+    sketch_input_t* in = (sketch_input_t*)arg;
+    if (in->topk) {
+        topk_add(in->topk, in->key, in->weight ? in->weight : 1);
+    }
+    return arg;
+}
+
+static inline void* kll_accumulate(void* arg) {
+    sketch_input_t* in = (sketch_input_t*)arg;
+    if (in->quantiles) {
+        kll_add(in->quantiles, in->value);
+    }
+    return arg;
+}
+
+/**
+ * @brief Applies each accumulator lambda to input, in order.
+ *
+ * Example usage:
+ * ```
+ * SKETCH_ACCUMULATE(&in, topk_accumulate, hll_accumulate, kll_accumulate);
+ * ```
+ */
+#define SKETCH_ACCUMULATE(input, ...) \
+    do { \
+        lambda_t sketch_fns_[] = { __VA_ARGS__ }; \
+        for (size_t sketch_i_ = 0; sketch_i_ < sizeof(sketch_fns_) / sizeof(sketch_fns_[0]); sketch_i_++) { \
+            sketch_fns_[sketch_i_](input); \
+        } \
+    } while (0)
+
+
+#endif /* LAMBDA_SKETCH_H */
@@ -0,0 +1,705 @@
+#ifndef LAMBDA_SNAPSHOT_H
+#define LAMBDA_SNAPSHOT_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "lambda.h"
+#include "lambda_compress.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_snapshot.h
+
+/**
+ * Writing:
+ *
+ * snapshot_writer_create(path): Starts a snapshot; nothing is visible at path until commit.
+ * snapshot_write_array(writer, name, data, elem_size, count, align): Adds a section of fixed-size elements.
+ * snapshot_write_strings(writer, name, strings, count): Adds a string table.
+ * SNAPSHOT_WRITE_DYNAMIC_ARRAY(writer, name, arr): Adds the elements of a DYNAMIC_ARRAY.
+ * snapshot_writer_commit(writer): Writes the table of contents and renames the file into place.
+ */
+
+/**
+ * Reading:
+ *
+ * snapshot_open(path, flags): Validates and maps a snapshot with a single mmap.
+ * snapshot_find(snap, name): Section descriptor by name, NULL if absent.
+ * snapshot_array(snap, name, elem_size, &count): Read-only elements of an array section.
+ * snapshot_strings(snap, name, &table) / snapshot_string_at(&table, index, &len): String table access.
+ * SNAPSHOT_VIEW_DYNAMIC_ARRAY(snap, name, arr): Points a DYNAMIC_ARRAY at mapped elements (read-only).
+ * SNAPSHOT_COPY_DYNAMIC_ARRAY(snap, name, arr): Copies a section into an owned, growable DYNAMIC_ARRAY.
+ * snapshot_writable(snap, name): Makes a section writable in place; pages are copied on first write.
+ * snapshot_verify(snap): Checks the checksum of every section.
+ * snapshot_close(snap): Unmaps the snapshot.
+ */
+
+/**
+ * Offset-Based Pointers:
+ *
+ * snapshot_rel_set(rel, target) / snapshot_rel_get(rel): Self-relative pointers that survive mapping at any address.
+ */
+
+
+/**
+ * @file lambda_snapshot.h
+ * @brief Position-independent binary snapshots of container state, reloaded with one mmap.
+ *
+ * A snapshot is a header, a list of named sections and a table of
+ * contents. Every section starts on a page boundary, so once the file is
+ * mapped each section is a correctly aligned array that can be used in
+ * place: reloading multi-GB state costs one mmap plus the page faults of
+ * the data actually touched.
+ *
+ * Nothing inside a snapshot is an absolute address. Sections are found
+ * by offset, string tables store offsets, and structures with internal
+ * links use snapshot_rel_t, which stores the distance from the pointer
+ * to its target.
+ *
+ * snapshot_open() checks the magic, exact version, byte order, file size and
+ * the checksums of the header and table of contents; section checksums
+ * are checked with SNAPSHOT_VERIFY or snapshot_verify(), which read every
+ * byte. The mapping is private: snapshot_writable() (or SNAPSHOT_WRITABLE)
+ * lets the process modify sections in place, the kernel copies each page
+ * on its first write, and the file itself never changes.
+ *
+ * ```
+ * snapshot_writer_t* w = snapshot_writer_create("catalog.snap");
+ * SNAPSHOT_WRITE_DYNAMIC_ARRAY(w, "products", products);
+ * snapshot_write_strings(w, "names", names, name_count);
+ * snapshot_writer_commit(w);
+ *
+ * snapshot_t* snap = snapshot_open("catalog.snap", 0);
+ * DYNAMIC_ARRAY(product_t) view;
+ * SNAPSHOT_VIEW_DYNAMIC_ARRAY(snap, "products", view);
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+#define SNAPSHOT_MAGIC 0x504e534cu /* "LSNP" */
+#define SNAPSHOT_VERSION 1u
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_ALIGN 4096
+#define SNAPSHOT_NAME_MAX 48
+
+/** Open flag: map writable from the start (private copy-on-write). */
+#define SNAPSHOT_WRITABLE 0x1
+/** Open flag: fault every page in during snapshot_open(). */
+#define SNAPSHOT_POPULATE 0x2
+/** Open flag: check every section checksum during snapshot_open(). */
+#define SNAPSHOT_VERIFY 0x4
+
+typedef enum {
+    SNAPSHOT_ARRAY = 1,
+    SNAPSHOT_STRINGS = 2
+} snapshot_kind_t;
+
+/**
+ * @brief File header, at offset 0. header_checksum covers the header with that field zeroed.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t byte_order;
+    uint32_t section_count;
+    uint64_t file_size;
+    uint64_t toc_offset;
+    uint32_t toc_checksum;
+    uint32_t header_checksum;
+    uint64_t reserved[3];
+} snapshot_header_t;
+
+/**
+ * @brief Table of contents entry. offset is from the start of the file.
+ *
+ * ARRAY sections hold count elements of elem_size bytes. STRINGS sections
+ * hold count + 1 uint64_t offsets followed by the NUL-terminated strings;
+ * string i spans [offsets[i], offsets[i + 1] - 1) of the bytes after the
+ * offsets.
+ */
+typedef struct {
+    char name[SNAPSHOT_NAME_MAX];
+    uint32_t kind;
+    uint32_t elem_size;
+    uint64_t align;
+    uint64_t offset;
+    uint64_t count;
+    uint64_t bytes;
+    uint32_t checksum;
+    uint32_t reserved;
+} snapshot_section_t;
+
+typedef struct {
+    int fd;
+    char* path;
+    char* temp_path;
+    uint64_t offset;
+    snapshot_section_t* sections;
+    size_t count;
+    size_t capacity;
+    int failed;
+} snapshot_writer_t;
+
+typedef struct {
+    uint8_t* base;
+    size_t size;
+    int flags;
+    const snapshot_header_t* header;
+    const snapshot_section_t* sections;
+} snapshot_t;
+
+/**
+ * @brief A mapped string table.
+ */
+typedef struct {
+    const uint64_t* offsets;
+    const char* bytes;
+    size_t count;
+    size_t size;
+} snapshot_strings_t;
+
+/** Self-relative pointer: the distance from the field to its target, 0 for NULL. */
+typedef int64_t snapshot_rel_t;
+
+/********************* Offset-Based Pointers ***************************/
+
+/**
+ * @brief Points rel at target. Both must lie in the same section (or buffer) for the link to survive a reload.
+ *
+ * Example usage:
+ * ```
+ * typedef struct node { uint64_t value; snapshot_rel_t next; } node_t;
+ * snapshot_rel_set(&nodes[0].next, &nodes[1]);
+ * node_t* second = snapshot_rel_get(&nodes[0].next);
+ * ```
+ */
+static inline void snapshot_rel_set(snapshot_rel_t* rel, const void* target) {
+    *rel = target ? (snapshot_rel_t)((intptr_t)target - (intptr_t)rel) : 0;
+}
+
+static inline void* snapshot_rel_get(const snapshot_rel_t* rel) {
+    return *rel ? (void*)((intptr_t)rel + (intptr_t)*rel) : NULL;
+}
+
+/********************* Writing ***************************/
+
+static inline int snapshot_write_all(snapshot_writer_t* w, const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (length > 0) {
+        size_t chunk = length < (1u << 30) ? length : (1u << 30);
+        ssize_t n = write(w->fd, p, chunk);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Snapshot write failed");
+            w->failed = 1;
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+        w->offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static inline int snapshot_pad_to(snapshot_writer_t* w, uint64_t align) {
+    static const uint8_t zeros[SNAPSHOT_ALIGN];
+    uint64_t target = (w->offset + align - 1) & ~(align - 1);
+    while (w->offset < target) {
+        uint64_t gap = target - w->offset;
+        if (snapshot_write_all(w, zeros, gap < sizeof(zeros) ? (size_t)gap : sizeof(zeros)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Creates path.tmp for writing; snapshot_writer_commit() renames it to path. NULL if it cannot be created.
+ *
+ * Example usage:
+ * ```
+ * snapshot_writer_t* w = snapshot_writer_create("/var/lib/service/state.snap");
+ * ```
+ */
+static inline snapshot_writer_t* snapshot_writer_create(const char* path) {
+    snapshot_writer_t* w = SAFE_MALLOC(sizeof(snapshot_writer_t));
+    memset(w, 0, sizeof(snapshot_writer_t));
+    w->path = SAFE_STRDUP(path);
+    w->temp_path = SAFE_MALLOC(strlen(path) + 5);
+    sprintf(w->temp_path, "%s.tmp", path);
+    w->fd = open(w->temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        LOG_ERROR("Failed to create snapshot file");
+        free(w->path);
+        free(w->temp_path);
+        free(w);
+        return NULL;
+    }
+    /* The header is written last, once the table of contents is known. */
+    snapshot_header_t blank;
+    memset(&blank, 0, sizeof(blank));
+    snapshot_write_all(w, &blank, sizeof(blank));
+    return w;
+}
+
+static inline snapshot_section_t* snapshot_writer_add(snapshot_writer_t* w, const char* name, uint32_t kind) {
+    if (w->failed) {
+        return NULL;
+    }
+    if (strlen(name) >= SNAPSHOT_NAME_MAX) {
+        LOG_ERROR("Snapshot section name too long");
+        w->failed = 1;
+        return NULL;
+    }
+    for (size_t i = 0; i < w->count; i++) {
+        if (strcmp(w->sections[i].name, name) == 0) {
+            LOG_ERROR("Duplicate snapshot section name");
+            w->failed = 1;
+            return NULL;
+        }
+    }
+    if (w->count == w->capacity) {
+        w->capacity = w->capacity ? w->capacity * 2 : 16;
+        snapshot_section_t* grown = realloc(w->sections, w->capacity * sizeof(snapshot_section_t));
+        if (!grown) {
+            HANDLE_MEMORY_ERROR("Snapshot section table allocation failed");
+        }
+        w->sections = grown;
+    }
+    snapshot_section_t* section = &w->sections[w->count++];
+    memset(section, 0, sizeof(snapshot_section_t));
+    strcpy(section->name, name);
+    section->kind = kind;
+    return section;
+}
+
+/**
+ * @brief Adds count elements of elem_size bytes as section name. Returns 0, or -1 (and fails the commit).
+ *
+ * align is the element alignment (a power of two up to SNAPSHOT_ALIGN, 0
+ * for none); sections always start on a page boundary. The elements must be plain
+ * data: pointers inside them would not survive a reload.
+ *
+ * Example usage:
+ * ```
+ * snapshot_write_array(w, "prices", prices, sizeof(double), n, _Alignof(double));
+ * ```
+ */
+static inline int snapshot_write_array(snapshot_writer_t* w, const char* name, const void* data, size_t elem_size,
+                                       size_t count, size_t align) {
+    if ((align & (align - 1)) || align > SNAPSHOT_ALIGN) {
+        LOG_ERROR("Snapshot alignment must be a power of two no larger than a page");
+        w->failed = 1;
+        return -1;
+    }
+    if (elem_size == 0 || elem_size > UINT32_MAX) {
+        LOG_ERROR("Snapshot element size must be between 1 and 4 GB");
+        w->failed = 1;
+        return -1;
+    }
+    snapshot_section_t* section = snapshot_writer_add(w, name, SNAPSHOT_ARRAY);
+    if (!section || snapshot_pad_to(w, SNAPSHOT_ALIGN) != 0) {
+        return -1;
+    }
+    section->elem_size = (uint32_t)elem_size;
+    section->align = align ? align : 1;
+    section->offset = w->offset;
+    section->count = count;
+    section->bytes = (uint64_t)elem_size * count;
+    section->checksum = compress_checksum(data, section->bytes, 0);
+    return snapshot_write_all(w, data, section->bytes);
+}
+
+/**
+ * @brief Adds a string table; NULL entries are stored as empty strings. Returns 0 or -1.
+ *
+ * Example usage:
+ * ```
+ * snapshot_write_strings(w, "hosts", host_names, host_count);
+ * ```
+ */
+static inline int snapshot_write_strings(snapshot_writer_t* w, const char* name, const char* const* strings,
+                                         size_t count) {
+    size_t table = (count + 1) * sizeof(uint64_t);
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        bytes += (strings[i] ? strlen(strings[i]) : 0) + 1;
+    }
+    uint8_t* buffer = SAFE_MALLOC(table + bytes);
+    uint64_t* offsets = (uint64_t*)buffer;
+    char* text = (char*)buffer + table;
+    uint64_t at = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strings[i] ? strlen(strings[i]) : 0;
+        offsets[i] = at;
+        memcpy(text + at, strings[i] ? strings[i] : "", len + 1);
+        at += len + 1;
+    }
+    offsets[count] = at;
+    snapshot_section_t* section = snapshot_writer_add(w, name, SNAPSHOT_STRINGS);
+    int rc = -1;
+    if (section && snapshot_pad_to(w, SNAPSHOT_ALIGN) == 0) {
+        section->align = _Alignof(uint64_t);
+        section->offset = w->offset;
+        section->count = count;
+        section->bytes = table + bytes;
+        section->checksum = compress_checksum(buffer, section->bytes, 0);
+        rc = snapshot_write_all(w, buffer, section->bytes);
+    }
+    free(buffer);
+    return rc;
+}
+
+/**
+ * @brief Adds the elements of a DYNAMIC_ARRAY of plain structs, keeping their alignment.
+ */
+#define SNAPSHOT_WRITE_DYNAMIC_ARRAY(writer, name, arr) \
+    snapshot_write_array((writer), (name), (arr).array, sizeof(*(arr).array), (arr).size, \
+                         _Alignof(__typeof__(*(arr).array)))
+
+/**
+ * @brief Syncs the directory holding path, so a rename into it survives a crash.
+ */
+static inline int snapshot_sync_dir(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char* dir = SAFE_STRDUP(slash ? path : ".");
+    if (slash) {
+        dir[slash == path ? 1 : slash - path] = '\0';
+    }
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+/**
+ * @brief Writes the table of contents and header, syncs, and renames the file into place. Frees the writer.
+ *
+ * Returns 0 once the snapshot and the rename are durable. Returns -1 if
+ * any write failed; the temporary file is removed then and an existing
+ * snapshot at path is left untouched. If only the final directory sync
+ * fails, the new snapshot is in place but may not survive a crash, and
+ * -1 is returned as well.
+ */
+static inline int snapshot_writer_commit(snapshot_writer_t* w) {
+    int rc = -1;
+    if (!w->failed && snapshot_pad_to(w, 64) == 0) {
+        snapshot_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.magic = SNAPSHOT_MAGIC;
+        header.version = SNAPSHOT_VERSION;
+        header.header_size = sizeof(snapshot_header_t);
+        header.byte_order = SNAPSHOT_BYTE_ORDER;
+        header.section_count = (uint32_t)w->count;
+        header.toc_offset = w->offset;
+        header.toc_checksum = compress_checksum(w->sections, w->count * sizeof(snapshot_section_t), 0);
+        if (snapshot_write_all(w, w->sections, w->count * sizeof(snapshot_section_t)) == 0) {
+            header.file_size = w->offset;
+            header.header_checksum = compress_checksum(&header, sizeof(header), 0);
+            if (pwrite(w->fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fsync(w->fd) == 0) {
+                rc = 0;
+            } else {
+                LOG_ERROR("Snapshot header write failed");
+            }
+        }
+    }
+    if (close(w->fd) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(w->temp_path, w->path) != 0) {
+        LOG_ERROR("Failed to move snapshot into place");
+        rc = -1;
+    }
+    if (rc != 0) {
+        unlink(w->temp_path);
+    } else if (snapshot_sync_dir(w->path) != 0) {
+        LOG_ERROR("Failed to sync the snapshot directory");
+        rc = -1;
+    }
+    free(w->sections);
+    free(w->path);
+    free(w->temp_path);
+    free(w);
+    return rc;
+}
+
+/********************* Reading ***************************/
+
+static inline int snapshot_check_section(const snapshot_t* snap, const snapshot_section_t* s) {
+    return s->checksum == compress_checksum(snap->base + s->offset, s->bytes, 0);
+}
+
+/**
+ * @brief Maps path and validates it. Returns NULL (after logging why) if it is not a usable snapshot.
+ *
+ * flags: SNAPSHOT_WRITABLE, SNAPSHOT_POPULATE, SNAPSHOT_VERIFY. The cost of
+ * opening without SNAPSHOT_VERIFY or SNAPSHOT_POPULATE does not depend on
+ * the size of the snapshot.
+ *
+ * Example usage:
+ * ```
+ * snapshot_t* snap = snapshot_open("state.snap", 0);
+ * if (!snap) {
+ *     rebuild_from_source();
+ * }
+ * ```
+ */
+static inline snapshot_t* snapshot_open(const char* path, int flags) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open snapshot");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snapshot_header_t)) {
+        LOG_ERROR("Snapshot file too small");
+        close(fd);
+        return NULL;
+    }
+    int prot = PROT_READ | ((flags & SNAPSHOT_WRITABLE) ? PROT_WRITE : 0);
+    void* base = mmap(NULL, (size_t)st.st_size, prot, MAP_PRIVATE | ((flags & SNAPSHOT_POPULATE) ? MAP_POPULATE : 0),
+                      fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        LOG_ERROR("Failed to map snapshot");
+        return NULL;
+    }
+    snapshot_t* snap = SAFE_MALLOC(sizeof(snapshot_t));
+    snap->base = (uint8_t*)base;
+    snap->size = (size_t)st.st_size;
+    snap->flags = flags;
+    snap->header = (const snapshot_header_t*)base;
+    snap->sections = NULL;
+
+    const snapshot_header_t* h = snap->header;
+    snapshot_header_t copy = *h;
+    copy.header_checksum = 0;
+    const char* problem = NULL;
+    if (h->magic != SNAPSHOT_MAGIC) {
+        problem = "Not a snapshot file";
+    } else if (h->byte_order != SNAPSHOT_BYTE_ORDER) {
+        problem = "Snapshot written with a different byte order";
+    } else if (h->version != SNAPSHOT_VERSION || h->header_size != sizeof(snapshot_header_t)) {
+        problem = "Unsupported snapshot version";
+    } else if (compress_checksum(&copy, sizeof(copy), 0) != h->header_checksum) {
+        problem = "Snapshot header checksum mismatch";
+    } else if (h->file_size != snap->size) {
+        problem = "Snapshot file truncated or extended";
+    } else if (h->toc_offset > snap->size || h->section_count > (snap->size - h->toc_offset) / sizeof(snapshot_section_t) ||
+               h->toc_offset % 8 != 0) {
+        problem = "Snapshot table of contents out of bounds";
+    } else if (compress_checksum(snap->base + h->toc_offset, h->section_count * sizeof(snapshot_section_t), 0) !=
+               h->toc_checksum) {
+        problem = "Snapshot table of contents checksum mismatch";
+    } else {
+        snap->sections = (const snapshot_section_t*)(snap->base + h->toc_offset);
+        for (uint32_t i = 0; i < h->section_count && !problem; i++) {
+            const snapshot_section_t* s = &snap->sections[i];
+            if (s->offset > h->toc_offset || s->bytes > h->toc_offset - s->offset || s->align == 0 ||
+                (s->align & (s->align - 1)) || s->offset % s->align != 0 ||
+                memchr(s->name, '\0', SNAPSHOT_NAME_MAX) == NULL) {
+                problem = "Snapshot section out of bounds";
+            } else if (s->kind == SNAPSHOT_ARRAY &&
+                       (s->elem_size == 0 || s->count > s->bytes / s->elem_size ||
+                        s->bytes != s->count * (uint64_t)s->elem_size)) {
+                problem = "Snapshot array section size mismatch";
+            } else if (s->kind == SNAPSHOT_STRINGS &&
+                       (s->count >= s->bytes / sizeof(uint64_t) ||
+                        ((const uint64_t*)(snap->base + s->offset))[s->count] !=
+                            s->bytes - (s->count + 1) * sizeof(uint64_t))) {
+                problem = "Snapshot string table size mismatch";
+            } else if ((flags & SNAPSHOT_VERIFY) && !snapshot_check_section(snap, s)) {
+                problem = "Snapshot section checksum mismatch";
+            }
+        }
+    }
+    if (problem) {
+        LOG_ERROR(problem);
+        munmap(base, snap->size);
+        free(snap);
+        return NULL;
+    }
+    return snap;
+}
+
+/**
+ * @brief Checks every section against its checksum. Returns 0, or -1 if any section is corrupt.
+ */
+static inline int snapshot_verify(const snapshot_t* snap) {
+    for (uint32_t i = 0; i < snap->header->section_count; i++) {
+        if (!snapshot_check_section(snap, &snap->sections[i])) {
+            LOG_ERROR("Snapshot section checksum mismatch");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline const snapshot_section_t* snapshot_find(const snapshot_t* snap, const char* name) {
+    for (uint32_t i = 0; i < snap->header->section_count; i++) {
+        if (strcmp(snap->sections[i].name, name) == 0) {
+            return &snap->sections[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Elements of array section name, in place; NULL if it is missing or its element size differs.
+ *
+ * Example usage:
+ * ```
+ * size_t n;
+ * const double* prices = snapshot_array(snap, "prices", sizeof(double), &n);
+ * ```
+ */
+static inline const void* snapshot_array(const snapshot_t* snap, const char* name, size_t elem_size, size_t* count) {
+    const snapshot_section_t* s = snapshot_find(snap, name);
+    if (!s || s->kind != SNAPSHOT_ARRAY) {
+        LOG_ERROR("Snapshot array section not found");
+        return NULL;
+    }
+    if (s->elem_size != elem_size) {
+        LOG_ERROR("Snapshot element size differs from the reader's type");
+        return NULL;
+    }
+    if (count) {
+        *count = (size_t)s->count;
+    }
+    return snap->base + s->offset;
+}
+
+/**
+ * @brief Fills table with string section name. Returns 0, or -1 if there is no such string table.
+ */
+static inline int snapshot_strings(const snapshot_t* snap, const char* name, snapshot_strings_t* table) {
+    const snapshot_section_t* s = snapshot_find(snap, name);
+    if (!s || s->kind != SNAPSHOT_STRINGS) {
+        LOG_ERROR("Snapshot string section not found");
+        return -1;
+    }
+    table->offsets = (const uint64_t*)(snap->base + s->offset);
+    table->bytes = (const char*)(table->offsets + s->count + 1);
+    table->count = (size_t)s->count;
+    table->size = (size_t)(s->bytes - (s->count + 1) * sizeof(uint64_t));
+    return 0;
+}
+
+/**
+ * @brief String index of a table (NUL-terminated, in place); its length goes to *len when len is non-NULL.
+ *
+ * Returns NULL when index is out of range or the string's offsets are
+ * corrupt; only the last offset is checked by snapshot_open().
+ *
+ * Example usage:
+ * ```
+ * size_t len;
+ * const char* host = snapshot_string_at(&hosts, id, &len);
+ * ```
+ */
+static inline const char* snapshot_string_at(const snapshot_strings_t* table, size_t index, size_t* len) {
+    if (index >= table->count) {
+        return NULL;
+    }
+    uint64_t start = table->offsets[index];
+    uint64_t end = table->offsets[index + 1];
+    if (start >= end || end > table->size || table->bytes[end - 1] != '\0') {
+        LOG_ERROR("Snapshot string offsets corrupt");
+        return NULL;
+    }
+    if (len) {
+        *len = (size_t)(end - start - 1);
+    }
+    return table->bytes + start;
+}
+
+/**
+ * @brief Makes section name writable in this process and returns it; NULL if absent.
+ *
+ * Pages are copied on their first write, so changing a few elements of a
+ * large section costs a few pages. The file is not modified; write a new
+ * snapshot to keep the changes.
+ *
+ * Example usage:
+ * ```
+ * product_t* products = snapshot_writable(snap, "products");
+ * products[42].price = 9.99;
+ * ```
+ */
+static inline void* snapshot_writable(snapshot_t* snap, const char* name) {
+    const snapshot_section_t* s = snapshot_find(snap, name);
+    if (!s) {
+        LOG_ERROR("Snapshot section not found");
+        return NULL;
+    }
+    if (!(snap->flags & SNAPSHOT_WRITABLE) && s->bytes > 0) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        uintptr_t start = (uintptr_t)(snap->base + s->offset) & ~(uintptr_t)(page - 1);
+        uintptr_t end = (uintptr_t)(snap->base + s->offset + s->bytes);
+        if (mprotect((void*)start, end - start, PROT_READ | PROT_WRITE) != 0) {
+            LOG_ERROR("Failed to make snapshot section writable");
+            return NULL;
+        }
+    }
+    return snap->base + s->offset;
+}
+
+/**
+ * @brief Points a DYNAMIC_ARRAY at the mapped elements of section name; evaluates to 0, or -1 if unavailable.
+ *
+ * The view is read-only (see snapshot_writable()), must not be grown or
+ * freed, and is valid until snapshot_close().
+ */
+#define SNAPSHOT_VIEW_DYNAMIC_ARRAY(snap, name, arr) \
+    ({ \
+        size_t snapshot_count_ = 0; \
+        const void* snapshot_data_ = snapshot_array((snap), (name), sizeof(*(arr).array), &snapshot_count_); \
+        (arr).array = (__typeof__((arr).array))snapshot_data_; \
+        (arr).size = snapshot_data_ ? snapshot_count_ : 0; \
+        (arr).capacity = (arr).size; \
+        snapshot_data_ ? 0 : -1; \
+    })
+
+/**
+ * @brief Copies section name into a newly allocated DYNAMIC_ARRAY (free with FREE_DYNAMIC_ARRAY); 0 or -1.
+ */
+#define SNAPSHOT_COPY_DYNAMIC_ARRAY(snap, name, arr) \
+    ({ \
+        size_t snapshot_count_ = 0; \
+        const void* snapshot_data_ = snapshot_array((snap), (name), sizeof(*(arr).array), &snapshot_count_); \
+        INIT_DYNAMIC_ARRAY(arr); \
+        if (snapshot_data_ && snapshot_count_ > 0) { \
+            (arr).array = SAFE_MALLOC(snapshot_count_ * sizeof(*(arr).array)); \
+            memcpy((arr).array, snapshot_data_, snapshot_count_ * sizeof(*(arr).array)); \
+            (arr).size = (arr).capacity = snapshot_count_; \
+        } \
+        snapshot_data_ ? 0 : -1; \
+    })
+
+/**
+ * @brief Unmaps the snapshot; every view and writable section obtained from it becomes invalid.
+ */
+static inline void snapshot_close(snapshot_t* snap) {
+    if (!snap) {
+        return;
+    }
+    munmap(snap->base, snap->size);
+    free(snap);
+}
+
+
+#endif /* LAMBDA_SNAPSHOT_H */
@@ -0,0 +1,622 @@
+#ifndef LAMBDA_SORT_H
+#define LAMBDA_SORT_H
+
+#include "lambda_numa.h"
+#include <limits.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_sort.h
+
+/**
+ * Comparison Sorts:
+ *
+ * DEFINE_SORT(name, type, a, b, less): Generates sorts for `type` ordered by the expression `less`.
+ * name##_sort(array, n): Introsort with branchless block partitioning and a heapsort fallback.
+ * name##_stable_sort(array, n): Stable bottom-up merge sort.
+ * name##_parallel_sort(pool, array, n): Parallel sample sort on a numa_pool_t.
+ * name##_is_sorted(array, n): Returns 1 when the array is in order.
+ */
+
+/**
+ * Radix Sort:
+ *
+ * DEFINE_RADIX_SORT(name, type, key_type, x, key): Generates an LSD radix sort on an integer or float key.
+ * name##_radix_sort(array, n): Stable radix sort.
+ */
+
+/**
+ * Dynamic Arrays:
+ *
+ * SORT_DYNAMIC_ARRAY(name, arr): Sorts a DYNAMIC_ARRAY in place.
+ * STABLE_SORT_DYNAMIC_ARRAY(name, arr): Stable sort of a DYNAMIC_ARRAY.
+ * RADIX_SORT_DYNAMIC_ARRAY(name, arr): Radix sort of a DYNAMIC_ARRAY.
+ * PARALLEL_SORT_DYNAMIC_ARRAY(name, pool, arr): Parallel sort of a DYNAMIC_ARRAY.
+ */
+
+
+/**
+ * @file lambda_sort.h
+ * @brief Type-specialized sorts with the comparison inlined, in the spirit of the Lambda macro.
+ *
+ * qsort() calls its comparator through a pointer and moves elements with
+ * memcpy of a runtime size. DEFINE_SORT() instead stamps out sorts for
+ * one element type, with the comparison written as an expression over
+ * two elements named by the caller:
+ *
+ * ```
+ * DEFINE_SORT(by_price, order_t, x, y, x.price < y.price);
+ * by_price_sort(orders, count);
+ * ```
+ *
+ * The expression must be a strict weak ordering ("less than"). The
+ * generated parallel sort is a sample sort: it picks splitters from a
+ * sample, classifies and scatters blocks of the input in parallel, then
+ * sorts the buckets in parallel. Every splitter also gets an equality
+ * bucket, so inputs with heavy duplicates stay balanced and their
+ * equality buckets need no sorting at all.
+ */
+
+/********************* Tuning Parameters ***************************/
+
+#ifndef SORT_INSERTION_THRESHOLD
+#define SORT_INSERTION_THRESHOLD 16
+#endif
+
+/** Elements scanned per block by the branchless partition (offsets must fit in a byte). */
+#define SORT_BLOCK 64
+
+/** Inputs smaller than this are sorted on the calling thread. */
+#ifndef SORT_PARALLEL_MIN
+#define SORT_PARALLEL_MIN (1u << 16)
+#endif
+
+/** Sample elements drawn per splitter. */
+#define SORT_OVERSAMPLE 32
+
+/** Upper bound on splitters, so bucket ids fit in 16 bits. */
+#define SORT_MAX_SPLITTERS 1024
+
+/********************* Radix Keys ***************************/
+
+/**
+ * @brief Maps a key to an unsigned integer with the same order, using its low `bytes` bytes.
+ */
+static inline uint64_t sort_key_unsigned(uint64_t k, size_t bytes) {
+    (void)bytes;
+    return k;
+}
+
+static inline uint64_t sort_key_signed(int64_t k, size_t bytes) {
+    uint64_t mask = bytes >= 8 ? ~0ull : (1ull << (bytes * 8)) - 1;
+    return ((uint64_t)k ^ (1ull << (bytes * 8 - 1))) & mask;
+}
+
+/* Plain char is its own type, signed or not depending on the platform. */
+static inline uint64_t sort_key_char(char k, size_t bytes) {
+    return CHAR_MIN < 0 ? sort_key_signed((signed char)k, bytes) : sort_key_unsigned((unsigned char)k, bytes);
+}
+
+static inline uint64_t sort_key_float(float k, size_t bytes) {
+    uint32_t bits;
+    (void)bytes;
+    memcpy(&bits, &k, sizeof(bits));
+    return bits ^ ((bits >> 31) ? 0xFFFFFFFFu : 0x80000000u);
+}
+
+static inline uint64_t sort_key_double(double k, size_t bytes) {
+    uint64_t bits;
+    (void)bytes;
+    memcpy(&bits, &k, sizeof(bits));
+    return bits ^ ((bits >> 63) ? ~0ull : 1ull << 63);
+}
+
+#define SORT_RADIX_KEY(k) \
+    _Generic((k), \
+        float: sort_key_float, \
+        double: sort_key_double, \
+        char: sort_key_char, \
+        signed char: sort_key_signed, \
+        short: sort_key_signed, \
+        int: sort_key_signed, \
+        long: sort_key_signed, \
+        long long: sort_key_signed, \
+        default: sort_key_unsigned)((k), sizeof(k))
+
+/********************* Comparison Sorts ***************************/
+
+/**
+ * @brief Generates introsort, stable merge sort and parallel sample sort for one element type.
+ *
+ * @param name Prefix of the generated functions.
+ * @param type Element type.
+ * @param a, b Names the comparison uses for the two elements.
+ * @param less Expression that is true when a must come before b.
+ *
+ * Example usage:
+ * ```
+ * DEFINE_SORT(int_asc, int, a, b, a < b);
+ * DYNAMIC_ARRAY(int) numbers;
+ * ...
+ * SORT_DYNAMIC_ARRAY(int_asc, numbers);
+ * ```
+ */
+#define DEFINE_SORT(name, type, a, b, less) \
+    static inline int name##_less(type a, type b) { \
+        return (less); \
+    } \
+    \
+    static inline void name##_swap(type* x, type* y) { \
+        type t = *x; \
+        *x = *y; \
+        *y = t; \
+    } \
+    \
+    static inline void name##_insertion(type* arr, size_t n) { \
+        for (size_t i = 1; i < n; i++) { \
+            type v = arr[i]; \
+            size_t j = i; \
+            while (j > 0 && name##_less(v, arr[j - 1])) { \
+                arr[j] = arr[j - 1]; \
+                j--; \
+            } \
+            arr[j] = v; \
+        } \
+    } \
+    \
+    static inline void name##_sift(type* arr, size_t root, size_t n) { \
+        type v = arr[root]; \
+        size_t child; \
+        while ((child = 2 * root + 1) < n) { \
+            if (child + 1 < n && name##_less(arr[child], arr[child + 1])) { \
+                child++; \
+            } \
+            if (!name##_less(v, arr[child])) { \
+                break; \
+            } \
+            arr[root] = arr[child]; \
+            root = child; \
+        } \
+        arr[root] = v; \
+    } \
+    \
+    static inline void name##_heapsort(type* arr, size_t n) { \
+        for (size_t i = n / 2; i-- > 0;) { \
+            name##_sift(arr, i, n); \
+        } \
+        for (size_t i = n; i-- > 1;) { \
+            name##_swap(&arr[0], &arr[i]); \
+            name##_sift(arr, 0, i); \
+        } \
+    } \
+    \
+    /* Moves the median of arr[x], arr[y], arr[z] to arr[0]. */ \
+    static inline void name##_median_to_front(type* arr, size_t x, size_t y, size_t z) { \
+        size_t m; \
+        if (name##_less(arr[x], arr[y])) { \
+            m = name##_less(arr[y], arr[z]) ? y : name##_less(arr[x], arr[z]) ? z : x; \
+        } else { \
+            m = name##_less(arr[x], arr[z]) ? x : name##_less(arr[y], arr[z]) ? z : y; \
+        } \
+        name##_swap(&arr[0], &arr[m]); \
+    } \
+    \
+    static inline void name##_swap_offsets(type* base_l, type* base_r, const unsigned char* off_l, \
+                                           const unsigned char* off_r, size_t num, int use_swaps) { \
+        if (use_swaps) { \
+            for (size_t i = 0; i < num; i++) { \
+                name##_swap(base_l + off_l[i], base_r - off_r[i]); \
+            } \
+        } else if (num > 0) { \
+            type* l = base_l + off_l[0]; \
+            type* r = base_r - off_r[0]; \
+            type t = *l; \
+            *l = *r; \
+            for (size_t i = 1; i < num; i++) { \
+                l = base_l + off_l[i]; \
+                *r = *l; \
+                r = base_r - off_r[i]; \
+                *l = *r; \
+            } \
+            *r = t; \
+        } \
+    } \
+    \
+    /* \
+     * Partitions [begin, end) around *begin into < pivot and >= pivot and returns the pivot's \
+     * final position. Elements on the wrong side are found a block at a time and their offsets \
+     * recorded without branching on the comparison (BlockQuicksort). \
+     */ \
+    static inline type* name##_partition_right(type* begin, type* end) { \
+        type pivot = *begin; \
+        type* first = begin; \
+        type* last = end; \
+        while (name##_less(*++first, pivot)) { \
+        } \
+        if (first - 1 == begin) { \
+            while (first < last && !name##_less(*--last, pivot)) { \
+            } \
+        } else { \
+            while (!name##_less(*--last, pivot)) { \
+            } \
+        } \
+        if (first < last) { \
+            unsigned char off_l[SORT_BLOCK], off_r[SORT_BLOCK]; \
+            size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0; \
+            name##_swap(first, last); \
+            first++; \
+            type* base_l = first; \
+            type* base_r = last; \
+            while (first < last) { \
+                size_t unknown = (size_t)(last - first); \
+                size_t left_split = num_l == 0 ? (num_r == 0 ? unknown / 2 : unknown) : 0; \
+                size_t right_split = num_r == 0 ? unknown - left_split : 0; \
+                if (left_split > SORT_BLOCK) { \
+                    left_split = SORT_BLOCK; \
+                } \
+                if (right_split > SORT_BLOCK) { \
+                    right_split = SORT_BLOCK; \
+                } \
+                for (size_t i = 0; i < left_split; i++) { \
+                    off_l[num_l] = (unsigned char)i; \
+                    num_l += !name##_less(*first, pivot); \
+                    first++; \
+                } \
+                for (size_t i = 0; i < right_split;) { \
+                    off_r[num_r] = (unsigned char)++i; \
+                    num_r += name##_less(*--last, pivot); \
+                } \
+                size_t num = num_l < num_r ? num_l : num_r; \
+                name##_swap_offsets(base_l, base_r, off_l + start_l, off_r + start_r, num, num_l == num_r); \
+                num_l -= num; \
+                num_r -= num; \
+                start_l += num; \
+                start_r += num; \
+                if (num_l == 0) { \
+                    start_l = 0; \
+                    base_l = first; \
+                } \
+                if (num_r == 0) { \
+                    start_r = 0; \
+                    base_r = last; \
+                } \
+            } \
+            if (num_l) { \
+                while (num_l--) { \
+                    name##_swap(base_l + off_l[start_l + num_l], --last); \
+                } \
+                first = last; \
+            } \
+            if (num_r) { \
+                while (num_r--) { \
+                    name##_swap(base_r - off_r[start_r + num_r], first); \
+                    first++; \
+                } \
+            } \
+        } \
+        type* pivot_pos = first - 1; \
+        *begin = *pivot_pos; \
+        *pivot_pos = pivot; \
+        return pivot_pos; \
+    } \
+    \
+    /* Partitions into <= pivot and > pivot; used when the pivot equals the element before the range. */ \
+    static inline type* name##_partition_left(type* begin, type* end) { \
+        type pivot = *begin; \
+        type* first = begin; \
+        type* last = end; \
+        while (name##_less(pivot, *--last)) { \
+        } \
+        if (last + 1 == end) { \
+            while (first < last && !name##_less(pivot, *++first)) { \
+            } \
+        } else { \
+            while (!name##_less(pivot, *++first)) { \
+            } \
+        } \
+        while (first < last) { \
+            name##_swap(first, last); \
+            while (name##_less(pivot, *--last)) { \
+            } \
+            while (!name##_less(pivot, *++first)) { \
+            } \
+        } \
+        *begin = *last; \
+        *last = pivot; \
+        return last; \
+    } \
+    \
+    static inline void name##_introsort_loop(type* arr, size_t n, int depth, int leftmost) { \
+        while (n > SORT_INSERTION_THRESHOLD) { \
+            if (depth-- == 0) { \
+                name##_heapsort(arr, n); \
+                return; \
+            } \
+            name##_median_to_front(arr, 1, n / 2, n - 1); \
+            /* A pivot equal to its predecessor: everything <= pivot is already in place. */ \
+            if (!leftmost && !name##_less(arr[-1], arr[0])) { \
+                type* pivot = name##_partition_left(arr, arr + n); \
+                n -= (size_t)(pivot + 1 - arr); \
+                arr = pivot + 1; \
+                continue; \
+            } \
+            size_t cut = (size_t)(name##_partition_right(arr, arr + n) - arr); \
+            /* Recurse into the smaller side, loop on the larger one. */ \
+            if (cut < n - cut) { \
+                name##_introsort_loop(arr, cut, depth, leftmost); \
+                arr += cut + 1; \
+                n -= cut + 1; \
+                leftmost = 0; \
+            } else { \
+                name##_introsort_loop(arr + cut + 1, n - cut - 1, depth, 0); \
+                n = cut; \
+            } \
+        } \
+        name##_insertion(arr, n); \
+    } \
+    \
+    static inline void name##_sort(type* arr, size_t n) { \
+        int depth = 0; \
+        for (size_t m = n; m > 1; m >>= 1) { \
+            depth += 2; \
+        } \
+        name##_introsort_loop(arr, n, depth, 1); \
+    } \
+    \
+    static inline int name##_is_sorted(const type* arr, size_t n) { \
+        for (size_t i = 1; i < n; i++) { \
+            if (name##_less(arr[i], arr[i - 1])) { \
+                return 0; \
+            } \
+        } \
+        return 1; \
+    } \
+    \
+    static inline void name##_merge(const type* src, type* dst, size_t lo, size_t mid, size_t hi) { \
+        if (mid >= hi || !name##_less(src[mid], src[mid - 1])) { \
+            memcpy(dst + lo, src + lo, (hi - lo) * sizeof(type)); \
+            return; \
+        } \
+        size_t i = lo, j = mid, k = lo; \
+        while (i < mid && j < hi) { \
+            dst[k++] = name##_less(src[j], src[i]) ? src[j++] : src[i++]; \
+        } \
+        while (i < mid) { \
+            dst[k++] = src[i++]; \
+        } \
+        while (j < hi) { \
+            dst[k++] = src[j++]; \
+        } \
+    } \
+    \
+    static inline void name##_stable_sort(type* arr, size_t n) { \
+        const size_t run = 32; \
+        for (size_t lo = 0; lo < n; lo += run) { \
+            name##_insertion(arr + lo, n - lo < run ? n - lo : run); \
+        } \
+        if (n <= run) { \
+            return; \
+        } \
+        type* tmp = SAFE_MALLOC(n * sizeof(type)); \
+        type* src = arr; \
+        type* dst = tmp; \
+        for (size_t width = run; width < n; width *= 2) { \
+            for (size_t lo = 0; lo < n; lo += 2 * width) { \
+                size_t mid = lo + width < n ? lo + width : n; \
+                size_t hi = lo + 2 * width < n ? lo + 2 * width : n; \
+                name##_merge(src, dst, lo, mid, hi); \
+            } \
+            type* t = src; \
+            src = dst; \
+            dst = t; \
+        } \
+        if (src != arr) { \
+            memcpy(arr, src, n * sizeof(type)); \
+        } \
+        free(tmp); \
+    } \
+    \
+    typedef struct { \
+        type* arr; \
+        type* tmp; \
+        size_t n; \
+        uint16_t* oracle; \
+        type* splitters; \
+        size_t splitter_count; \
+        size_t buckets; \
+        size_t blocks; \
+        size_t* counts; \
+        size_t* bucket_start; \
+    } name##_psort_t; \
+    \
+    /* Bucket 2j holds values between splitters j-1 and j, bucket 2j+1 values equal to splitter j. */ \
+    static inline size_t name##_classify(const name##_psort_t* s, type v) { \
+        size_t lo = 0, hi = s->splitter_count; \
+        while (lo < hi) { \
+            size_t mid = (lo + hi) / 2; \
+            if (name##_less(s->splitters[mid], v)) { \
+                lo = mid + 1; \
+            } else { \
+                hi = mid; \
+            } \
+        } \
+        return 2 * lo + (lo < s->splitter_count && !name##_less(v, s->splitters[lo])); \
+    } \
+    \
+    static void name##_psort_count(size_t block, void* ctx) { \
+        name##_psort_t* s = (name##_psort_t*)ctx; \
+        size_t begin = block * s->n / s->blocks, end = (block + 1) * s->n / s->blocks; \
+        size_t* counts = s->counts + block * s->buckets; \
+        for (size_t i = begin; i < end; i++) { \
+            size_t bucket = name##_classify(s, s->arr[i]); \
+            s->oracle[i] = (uint16_t)bucket; \
+            counts[bucket]++; \
+        } \
+    } \
+    \
+    static void name##_psort_scatter(size_t block, void* ctx) { \
+        name##_psort_t* s = (name##_psort_t*)ctx; \
+        size_t begin = block * s->n / s->blocks, end = (block + 1) * s->n / s->blocks; \
+        size_t* offsets = s->counts + block * s->buckets; \
+        for (size_t i = begin; i < end; i++) { \
+            s->tmp[offsets[s->oracle[i]]++] = s->arr[i]; \
+        } \
+    } \
+    \
+    static void name##_psort_bucket(size_t bucket, void* ctx) { \
+        name##_psort_t* s = (name##_psort_t*)ctx; \
+        size_t begin = s->bucket_start[bucket], end = s->bucket_start[bucket + 1]; \
+        if (!(bucket & 1)) { \
+            name##_sort(s->tmp + begin, end - begin); \
+        } \
+        memcpy(s->arr + begin, s->tmp + begin, (end - begin) * sizeof(type)); \
+    } \
+    \
+    static inline void name##_parallel_sort(numa_pool_t* pool, type* arr, size_t n) { \
+        size_t workers = pool ? pool->worker_count : 1; \
+        if (workers < 2 || n < SORT_PARALLEL_MIN) { \
+            name##_sort(arr, n); \
+            return; \
+        } \
+        name##_psort_t s; \
+        memset(&s, 0, sizeof(s)); \
+        s.arr = arr; \
+        s.n = n; \
+        size_t wanted = workers * 8 - 1; \
+        if (wanted > SORT_MAX_SPLITTERS) { \
+            wanted = SORT_MAX_SPLITTERS; \
+        } \
+        \
+        size_t sample_size = wanted * SORT_OVERSAMPLE; \
+        type* sample = SAFE_MALLOC(sample_size * sizeof(type)); \
+        uint64_t seed = 0x9E3779B97F4A7C15ull ^ n; \
+        for (size_t i = 0; i < sample_size; i++) { \
+            seed ^= seed << 13; \
+            seed ^= seed >> 7; \
+            seed ^= seed << 17; \
+            sample[i] = arr[seed % n]; \
+        } \
+        name##_sort(sample, sample_size); \
+        s.splitters = SAFE_MALLOC(wanted * sizeof(type)); \
+        for (size_t i = 0; i < wanted; i++) { \
+            type v = sample[(i + 1) * SORT_OVERSAMPLE - 1]; \
+            if (s.splitter_count == 0 || name##_less(s.splitters[s.splitter_count - 1], v)) { \
+                s.splitters[s.splitter_count++] = v; \
+            } \
+        } \
+        free(sample); \
+        \
+        s.buckets = 2 * s.splitter_count + 1; \
+        s.blocks = workers * 4; \
+        s.tmp = SAFE_MALLOC(n * sizeof(type)); \
+        s.oracle = SAFE_MALLOC(n * sizeof(uint16_t)); \
+        s.counts = SAFE_MALLOC(s.blocks * s.buckets * sizeof(size_t)); \
+        memset(s.counts, 0, s.blocks * s.buckets * sizeof(size_t)); \
+        s.bucket_start = SAFE_MALLOC((s.buckets + 1) * sizeof(size_t)); \
+        numa_pool_run(pool, s.blocks, name##_psort_count, &s); \
+        \
+        /* Turn per-block counts into per-block write offsets, bucket-major. */ \
+        size_t offset = 0; \
+        for (size_t bucket = 0; bucket < s.buckets; bucket++) { \
+            s.bucket_start[bucket] = offset; \
+            for (size_t block = 0; block < s.blocks; block++) { \
+                size_t count = s.counts[block * s.buckets + bucket]; \
+                s.counts[block * s.buckets + bucket] = offset; \
+                offset += count; \
+            } \
+        } \
+        s.bucket_start[s.buckets] = offset; \
+        numa_pool_run(pool, s.blocks, name##_psort_scatter, &s); \
+        numa_pool_run(pool, s.buckets, name##_psort_bucket, &s); \
+        \
+        free(s.tmp); \
+        free(s.oracle); \
+        free(s.counts); \
+        free(s.bucket_start); \
+        free(s.splitters); \
+    }
+
+/********************* Radix Sort ***************************/
+
+/**
+ * @brief Generates a stable LSD radix sort over a key computed from each element.
+ *
+ * @param key_type Integer or floating-point type of the key; its size sets the number of passes.
+ * @param x Name the key expression uses for the element.
+ * @param key Expression computing the key of x.
+ *
+ * Digits are 8 bits wide, all histograms are built in a single pass, and
+ * passes in which every element has the same digit are skipped, so small
+ * key ranges cost fewer passes. Negative integers and floats are ordered
+ * correctly (floats by IEEE order, NaNs at the ends).
+ *
+ * Example usage:
+ * ```
+ * DEFINE_RADIX_SORT(by_id, order_t, uint32_t, o, o.id);
+ * by_id_radix_sort(orders, count);
+ * ```
+ */
+#define DEFINE_RADIX_SORT(name, type, key_type, x, key) \
+    static inline uint64_t name##_radix_key(type x) { \
+        key_type k = (key); \
+        return SORT_RADIX_KEY(k); \
+    } \
+    \
+    static inline void name##_radix_sort(type* arr, size_t n) { \
+        enum { BYTES = sizeof(key_type) }; \
+        size_t hist[BYTES][256]; \
+        if (n < 2) { \
+            return; \
+        } \
+        memset(hist, 0, sizeof(hist)); \
+        for (size_t i = 0; i < n; i++) { \
+            uint64_t k = name##_radix_key(arr[i]); \
+            for (int d = 0; d < BYTES; d++) { \
+                hist[d][(k >> (8 * d)) & 0xFF]++; \
+            } \
+        } \
+        type* tmp = SAFE_MALLOC(n * sizeof(type)); \
+        type* src = arr; \
+        type* dst = tmp; \
+        uint64_t first = name##_radix_key(arr[0]); \
+        for (int d = 0; d < BYTES; d++) { \
+            if (hist[d][(first >> (8 * d)) & 0xFF] == n) { \
+                continue; \
+            } \
+            size_t offset = 0; \
+            for (int v = 0; v < 256; v++) { \
+                size_t count = hist[d][v]; \
+                hist[d][v] = offset; \
+                offset += count; \
+            } \
+            for (size_t i = 0; i < n; i++) { \
+                dst[hist[d][(name##_radix_key(src[i]) >> (8 * d)) & 0xFF]++] = src[i]; \
+            } \
+            type* t = src; \
+            src = dst; \
+            dst = t; \
+        } \
+        if (src != arr) { \
+            memcpy(arr, src, n * sizeof(type)); \
+        } \
+        free(tmp); \
+    }
+
+/********************* Dynamic Arrays ***************************/
+
+/**
+ * @brief Sorts the elements of a DYNAMIC_ARRAY with sorts generated by DEFINE_SORT or DEFINE_RADIX_SORT.
+ *
+ * Example usage:
+ * ```
+ * DEFINE_SORT(int_asc, int, a, b, a < b);
+ * SORT_DYNAMIC_ARRAY(int_asc, numbers);
+ * PARALLEL_SORT_DYNAMIC_ARRAY(int_asc, pool, numbers);
+ * ```
+ */
+#define SORT_DYNAMIC_ARRAY(name, arr) name##_sort((arr).array, (arr).size)
+#define STABLE_SORT_DYNAMIC_ARRAY(name, arr) name##_stable_sort((arr).array, (arr).size)
+#define RADIX_SORT_DYNAMIC_ARRAY(name, arr) name##_radix_sort((arr).array, (arr).size)
+#define PARALLEL_SORT_DYNAMIC_ARRAY(name, pool, arr) name##_parallel_sort((pool), (arr).array, (arr).size)
+
+
+#endif /* LAMBDA_SORT_H */
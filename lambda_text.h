@@ -0,0 +1,610 @@
+#ifndef LAMBDA_TEXT_H
+#define LAMBDA_TEXT_H
+
+#include "lambda_isa.h"
+
+#define LAMBDA_TEXT_X86 LAMBDA_ISA_X86
+
+
+// summarized list of all of the macros and functions defined in the lambda_text.h
+
+/**
+ * Byte Sets:
+ *
+ * text_set_init(set, spec): Builds a byte set from a spec such as " \t,;" or "^a-zA-Z0-9_".
+ * text_set_contains(set, c): Returns 1 when the byte belongs to the set.
+ */
+
+/**
+ * Scanning Kernels:
+ *
+ * text_strlen(s): Length of a NUL-terminated string.
+ * text_find_set(buf, len, set) / text_find_byte(buf, len, c): Offset of the first matching byte, or len.
+ * text_count_set(buf, len, set) / text_count_byte(buf, len, c): Number of matching bytes.
+ * text_memmem(buf, len, needle, needle_len): First occurrence of a byte string, or NULL.
+ */
+
+/**
+ * Tokenizers:
+ *
+ * text_split(buf, len, set, flags, fn, ctx): Calls fn once per token between delimiter bytes.
+ * text_split_byte(buf, len, c, flags, fn, ctx): text_split with a single delimiter.
+ * text_lines(buf, len, fn, ctx): Calls fn once per line, without the line terminator.
+ * text_find_each(buf, len, needle, needle_len, fn, ctx): Calls fn once per non-overlapping occurrence.
+ */
+
+/**
+ * Dispatch:
+ *
+ * text_isa(): Instruction set selected for this CPU (TEXT_ISA_SCALAR, TEXT_ISA_SSE2 or TEXT_ISA_AVX2).
+ * text_set_isa(isa): Forces a lower instruction set for these kernels only (see lambda_isa.h).
+ * text_isa_name(isa): Printable name of an instruction set.
+ */
+
+
+/**
+ * @file lambda_text.h
+ * @brief SIMD text scanning kernels that hand tokens to lambdas without copying.
+ *
+ * Every kernel is built around one primitive: turn 64 input bytes into a
+ * 64-bit mask of the bytes that belong to a set. SSE2 computes it with
+ * four 16-byte compares per range in the set, AVX2 with two 32-byte
+ * ones, and the scalar fallback with a lookup table. Finding, counting
+ * and splitting then work on whole masks: count is a popcount, find a
+ * count of trailing zeros, and split walks the set bits.
+ *
+ * The kernels are generated once per instruction set with the matching
+ * target attribute. The best one the CPU supports is picked at first use,
+ * so the header needs no -mavx2.
+ *
+ * Tokens are passed to the lambda as a text_span_t pointing into the
+ * caller's buffer. A lambda that returns non-NULL stops the scan.
+ *
+ * ```
+ * Lambda(print_word, s,
+ *     text_span_t* word = (text_span_t*)s;
+ *     printf("%.*s\n", (int)word->len, word->ptr);
+ *     return NULL;
+ * );
+ * text_set_t blanks;
+ * text_set_init(&blanks, " \t\n");
+ * text_split(buf, len, &blanks, TEXT_SKIP_EMPTY, print_word, NULL);
+ * ```
+ */
+
+/********************* Type Definitions ***************************/
+
+/** Maximum number of ranges (single bytes count as one) in a byte set. */
+#define TEXT_SET_MAX 16
+
+/** text_split flag: do not report empty tokens between adjacent delimiters. */
+#define TEXT_SKIP_EMPTY 0x1
+
+typedef lambda_isa_t text_isa_t;
+#define TEXT_ISA_SCALAR LAMBDA_ISA_SCALAR
+#define TEXT_ISA_SSE2 LAMBDA_ISA_SSE2
+#define TEXT_ISA_AVX2 LAMBDA_ISA_AVX2
+
+/**
+ * @brief A set of bytes, stored as ranges for the SIMD kernels and as a table for the scalar one.
+ *
+ * Range bounds are kept pre-broadcast so the kernels load them instead of
+ * rebuilding the vectors for every block. They are read with unaligned
+ * loads, so a set may live anywhere, including inside malloc'd structs.
+ */
+typedef struct {
+    int count;
+    int negate;
+    uint8_t lo[TEXT_SET_MAX];
+    uint8_t hi[TEXT_SET_MAX];
+    uint8_t vlo[TEXT_SET_MAX][32];
+    uint8_t vspan[TEXT_SET_MAX][32];
+    uint8_t table[256];
+} text_set_t;
+
+/**
+ * @brief A token handed to a lambda: a view into the scanned buffer, not a copy.
+ */
+typedef struct {
+    const char* ptr;
+    size_t len;
+    size_t index;
+    void* ctx;
+} text_span_t;
+
+/********************* Byte Sets ***************************/
+
+static inline int text_set_add(text_set_t* set, uint8_t lo, uint8_t hi) {
+    if (set->count == TEXT_SET_MAX) {
+        return -1;
+    }
+    set->lo[set->count] = lo;
+    set->hi[set->count] = hi;
+    memset(set->vlo[set->count], lo, 32);
+    memset(set->vspan[set->count], hi - lo, 32);
+    set->count++;
+    for (int c = lo; c <= hi; c++) {
+        set->table[c] = 1;
+    }
+    return 0;
+}
+
+static inline uint8_t text_set_unescape(const char** spec) {
+    char c = *(*spec)++;
+    if (c == '\\' && **spec) {
+        c = *(*spec)++;
+        switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case '0': return '\0';
+        default: return (uint8_t)c;
+        }
+    }
+    return (uint8_t)c;
+}
+
+/**
+ * @brief Builds a byte set from a spec of bytes and ranges.
+ *
+ * "a-z" is a range, a leading '^' complements the set and a backslash
+ * escapes '-', '^', '\\' or introduces \n, \t, \r and \0. Returns 0, or
+ * -1 when the spec has more than TEXT_SET_MAX ranges.
+ *
+ * Example usage:
+ * ```
+ * text_set_t word_chars;
+ * text_set_init(&word_chars, "a-zA-Z0-9_");
+ * ```
+ */
+static inline int text_set_init(text_set_t* set, const char* spec) {
+    memset(set, 0, sizeof(*set));
+    if (*spec == '^') {
+        set->negate = 1;
+        spec++;
+    }
+    while (*spec) {
+        uint8_t lo = text_set_unescape(&spec);
+        uint8_t hi = lo;
+        if (spec[0] == '-' && spec[1]) {
+            spec++;
+            hi = text_set_unescape(&spec);
+            if (hi < lo) {
+                uint8_t t = lo;
+                lo = hi;
+                hi = t;
+            }
+        }
+        if (text_set_add(set, lo, hi) != 0) {
+            LOG_ERROR("Byte set has too many ranges");
+            return -1;
+        }
+    }
+    if (set->negate) {
+        for (int c = 0; c < 256; c++) {
+            set->table[c] = !set->table[c];
+        }
+    }
+    return 0;
+}
+
+static inline void text_set_byte(text_set_t* set, char c) {
+    memset(set, 0, sizeof(*set));
+    text_set_add(set, (uint8_t)c, (uint8_t)c);
+}
+
+static inline int text_set_contains(const text_set_t* set, char c) {
+    return set->table[(uint8_t)c];
+}
+
+/********************* Block Masks ***************************/
+
+/** Scalar: bit i is set when p[i] is in the set. */
+static inline uint64_t text_scalar_block(const char* p, const text_set_t* set) {
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i++) {
+        mask |= (uint64_t)set->table[(uint8_t)p[i]] << i;
+    }
+    return mask;
+}
+
+#if LAMBDA_TEXT_X86
+
+/* In-range test for unsigned bytes: (x - lo) <= (hi - lo) iff min(x - lo, hi - lo) == x - lo. */
+__attribute__((target("sse2"), always_inline))
+static inline uint64_t text_sse2_block(const char* p, const text_set_t* set) {
+    uint64_t mask = 0;
+    for (int q = 0; q < 4; q++) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(p + 16 * q));
+        __m128i hit = _mm_setzero_si128();
+        for (int r = 0; r < set->count; r++) {
+            __m128i lo = _mm_loadu_si128((const __m128i*)set->vlo[r]);
+            if (set->lo[r] == set->hi[r]) {
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(x, lo));
+            } else {
+                __m128i d = _mm_sub_epi8(x, lo);
+                __m128i span = _mm_loadu_si128((const __m128i*)set->vspan[r]);
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(d, span), d));
+            }
+        }
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hit) << (16 * q);
+    }
+    return set->negate ? ~mask : mask;
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline uint64_t text_avx2_block(const char* p, const text_set_t* set) {
+    __m256i x0 = _mm256_loadu_si256((const __m256i*)p);
+    __m256i x1 = _mm256_loadu_si256((const __m256i*)(p + 32));
+    __m256i h0 = _mm256_setzero_si256();
+    __m256i h1 = _mm256_setzero_si256();
+    for (int r = 0; r < set->count; r++) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)set->vlo[r]);
+        if (set->lo[r] == set->hi[r]) {
+            h0 = _mm256_or_si256(h0, _mm256_cmpeq_epi8(x0, lo));
+            h1 = _mm256_or_si256(h1, _mm256_cmpeq_epi8(x1, lo));
+        } else {
+            __m256i span = _mm256_loadu_si256((const __m256i*)set->vspan[r]);
+            __m256i d0 = _mm256_sub_epi8(x0, lo);
+            __m256i d1 = _mm256_sub_epi8(x1, lo);
+            h0 = _mm256_or_si256(h0, _mm256_cmpeq_epi8(_mm256_min_epu8(d0, span), d0));
+            h1 = _mm256_or_si256(h1, _mm256_cmpeq_epi8(_mm256_min_epu8(d1, span), d1));
+        }
+    }
+    uint64_t mask = (uint32_t)_mm256_movemask_epi8(h0) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(h1) << 32);
+    return set->negate ? ~mask : mask;
+}
+
+#endif
+
+/********************* Generic Kernels ***************************/
+
+/**
+ * @brief Generates find, count, split and memmem for one instruction set from its block mask.
+ *
+ * A final partial block is copied into a zeroed 64-byte buffer and its
+ * mask cut to the bytes that exist, so no kernel reads past the input.
+ */
+#define TEXT_DEFINE_KERNELS(isa, attr) \
+    attr __attribute__((always_inline)) static inline uint64_t text_##isa##_mask(const char* p, size_t n, const text_set_t* set) { \
+        if (n >= 64) { \
+            return text_##isa##_block(p, set); \
+        } \
+        char pad[64]; \
+        memset(pad, 0, sizeof(pad)); \
+        memcpy(pad, p, n); \
+        return text_##isa##_block(pad, set) & ((1ull << n) - 1); \
+    } \
+    \
+    attr static size_t text_##isa##_find(const char* buf, size_t len, const text_set_t* set) { \
+        for (size_t base = 0; base < len; base += 64) { \
+            uint64_t mask = text_##isa##_mask(buf + base, len - base, set); \
+            if (mask) { \
+                return base + (size_t)__builtin_ctzll(mask); \
+            } \
+        } \
+        return len; \
+    } \
+    \
+    attr static size_t text_##isa##_count(const char* buf, size_t len, const text_set_t* set) { \
+        size_t count = 0; \
+        for (size_t base = 0; base < len; base += 64) { \
+            count += (size_t)__builtin_popcountll(text_##isa##_mask(buf + base, len - base, set)); \
+        } \
+        return count; \
+    } \
+    \
+    attr static size_t text_##isa##_split(const char* buf, size_t len, const text_set_t* set, int flags, \
+                                         lambda_t fn, void* ctx) { \
+        text_span_t span = { NULL, 0, 0, ctx }; \
+        size_t start = 0; \
+        for (size_t base = 0; base < len; base += 64) { \
+            uint64_t mask = text_##isa##_mask(buf + base, len - base, set); \
+            while (mask) { \
+                size_t pos = base + (size_t)__builtin_ctzll(mask); \
+                mask &= mask - 1; \
+                if (pos > start || !(flags & TEXT_SKIP_EMPTY)) { \
+                    span.ptr = buf + start; \
+                    span.len = pos - start; \
+                    if (fn(&span)) { \
+                        return span.index + 1; \
+                    } \
+                    span.index++; \
+                } \
+                start = pos + 1; \
+            } \
+        } \
+        if (start < len || !(flags & TEXT_SKIP_EMPTY)) { \
+            span.ptr = buf + start; \
+            span.len = len - start; \
+            fn(&span); \
+            span.index++; \
+        } \
+        return span.index; \
+    } \
+    \
+    attr static const char* text_##isa##_memmem(const char* buf, size_t len, const char* needle, size_t n) { \
+        if (n == 0) { \
+            return buf; \
+        } \
+        if (n > len) { \
+            return NULL; \
+        } \
+        text_set_t first, last; \
+        text_set_byte(&first, needle[0]); \
+        text_set_byte(&last, needle[n - 1]); \
+        size_t positions = len - n + 1; \
+        for (size_t base = 0; base < positions; base += 64) { \
+            size_t avail = positions - base; \
+            uint64_t mask = text_##isa##_mask(buf + base, avail, &first) & \
+                            text_##isa##_mask(buf + base + n - 1, avail, &last); \
+            while (mask) { \
+                size_t pos = base + (size_t)__builtin_ctzll(mask); \
+                mask &= mask - 1; \
+                if (n <= 2 || memcmp(buf + pos + 1, needle + 1, n - 2) == 0) { \
+                    return buf + pos; \
+                } \
+            } \
+        } \
+        return NULL; \
+    }
+
+TEXT_DEFINE_KERNELS(scalar, )
+#if LAMBDA_TEXT_X86
+TEXT_DEFINE_KERNELS(sse2, __attribute__((target("sse2"))))
+TEXT_DEFINE_KERNELS(avx2, __attribute__((target("avx2"))))
+#endif
+
+/********************* String Length ***************************/
+
+#if LAMBDA_TEXT_X86
+
+/* Aligned loads never cross into an unmapped page, so reading before s or past the NUL is safe. */
+__attribute__((target("sse2"), no_sanitize_address))
+static size_t text_sse2_strlen(const char* s) {
+    const char* p = (const char*)((uintptr_t)s & ~(uintptr_t)15);
+    __m128i zero = _mm_setzero_si128();
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), zero));
+    mask >>= (uintptr_t)s & 15;
+    if (mask) {
+        return (size_t)__builtin_ctz(mask);
+    }
+    for (;;) {
+        p += 16;
+        mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), zero));
+        if (mask) {
+            return (size_t)(p - s) + (size_t)__builtin_ctz(mask);
+        }
+    }
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+static size_t text_avx2_strlen(const char* s) {
+    const char* p = (const char*)((uintptr_t)s & ~(uintptr_t)31);
+    __m256i zero = _mm256_setzero_si256();
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)p), zero));
+    mask >>= (uintptr_t)s & 31;
+    if (mask) {
+        return (size_t)__builtin_ctz(mask);
+    }
+    for (;;) {
+        p += 32;
+        mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)p), zero));
+        if (mask) {
+            return (size_t)(p - s) + (size_t)__builtin_ctz(mask);
+        }
+    }
+}
+
+#endif
+
+static size_t text_scalar_strlen(const char* s) {
+    return strlen(s);
+}
+
+/********************* Dispatch ***************************/
+
+typedef struct {
+    size_t (*strlen_fn)(const char* s);
+    size_t (*find)(const char* buf, size_t len, const text_set_t* set);
+    size_t (*count)(const char* buf, size_t len, const text_set_t* set);
+    size_t (*split)(const char* buf, size_t len, const text_set_t* set, int flags, lambda_t fn, void* ctx);
+    const char* (*memmem_fn)(const char* buf, size_t len, const char* needle, size_t n);
+} text_kernels_t;
+
+static const text_kernels_t text_kernel_table[] = {
+    { text_scalar_strlen, text_scalar_find, text_scalar_count, text_scalar_split, text_scalar_memmem },
+#if LAMBDA_TEXT_X86
+    { text_sse2_strlen, text_sse2_find, text_sse2_count, text_sse2_split, text_sse2_memmem },
+    { text_avx2_strlen, text_avx2_find, text_avx2_count, text_avx2_split, text_avx2_memmem },
+#endif
+};
+
+static _Atomic int text_selected_isa = LAMBDA_ISA_UNSELECTED;
+
+/**
+ * @brief Returns the instruction set the text kernels use, detecting it on first call.
+ */
+static inline text_isa_t text_isa(void) {
+    return lambda_isa_selected(&text_selected_isa);
+}
+
+/**
+ * @brief Selects the instruction set of the text kernels; see lambda_isa_select().
+ */
+static inline text_isa_t text_set_isa(text_isa_t isa) {
+    return lambda_isa_select(&text_selected_isa, isa);
+}
+
+static inline const char* text_isa_name(text_isa_t isa) {
+    return lambda_isa_name(isa);
+}
+
+static inline const text_kernels_t* text_kernels(void) {
+    return &text_kernel_table[text_isa()];
+}
+
+/********************* Public Kernels ***************************/
+
+/**
+ * @brief SIMD strlen.
+ *
+ * Example usage:
+ * ```
+ * size_t n = text_strlen("hello");
+ * ```
+ */
+static inline size_t text_strlen(const char* s) {
+    return text_kernels()->strlen_fn(s);
+}
+
+/**
+ * @brief Returns the offset of the first byte of buf that is in the set, or len.
+ *
+ * Example usage:
+ * ```
+ * size_t comma = text_find_set(line, len, &separators);
+ * ```
+ */
+static inline size_t text_find_set(const char* buf, size_t len, const text_set_t* set) {
+    return text_kernels()->find(buf, len, set);
+}
+
+static inline size_t text_find_byte(const char* buf, size_t len, char c) {
+    text_set_t set;
+    text_set_byte(&set, c);
+    return text_find_set(buf, len, &set);
+}
+
+/**
+ * @brief Counts the bytes of buf that are in the set.
+ *
+ * Example usage:
+ * ```
+ * text_set_t digits;
+ * text_set_init(&digits, "0-9");
+ * size_t n = text_count_set(buf, len, &digits);
+ * ```
+ */
+static inline size_t text_count_set(const char* buf, size_t len, const text_set_t* set) {
+    return text_kernels()->count(buf, len, set);
+}
+
+static inline size_t text_count_byte(const char* buf, size_t len, char c) {
+    text_set_t set;
+    text_set_byte(&set, c);
+    return text_count_set(buf, len, &set);
+}
+
+/**
+ * @brief Finds the first occurrence of needle in buf, like memmem().
+ *
+ * Candidates are positions where both the first and the last byte of the
+ * needle match, found 64 positions at a time; only those are compared in full.
+ *
+ * Example usage:
+ * ```
+ * const char* hit = text_memmem(buf, len, "ERROR", 5);
+ * ```
+ */
+static inline const char* text_memmem(const char* buf, size_t len, const char* needle, size_t needle_len) {
+    return text_kernels()->memmem_fn(buf, len, needle, needle_len);
+}
+
+/********************* Tokenizers ***************************/
+
+/**
+ * @brief Calls fn for every token of buf separated by bytes of the set and returns the token count.
+ *
+ * Adjacent delimiters produce empty tokens unless TEXT_SKIP_EMPTY is set.
+ * The span passed to fn points into buf and is only valid during the call.
+ * A non-NULL return from fn stops the scan.
+ *
+ * Example usage:
+ * ```
+ * text_set_t comma;
+ * text_set_init(&comma, ",");
+ * size_t fields = text_split(row, len, &comma, 0, store_field, &record);
+ * ```
+ */
+static inline size_t text_split(const char* buf, size_t len, const text_set_t* set, int flags,
+                                lambda_t fn, void* ctx) {
+    return text_kernels()->split(buf, len, set, flags, fn, ctx);
+}
+
+static inline size_t text_split_byte(const char* buf, size_t len, char c, int flags, lambda_t fn, void* ctx) {
+    text_set_t set;
+    text_set_byte(&set, c);
+    return text_split(buf, len, &set, flags, fn, ctx);
+}
+
+typedef struct {
+    lambda_t fn;
+    void* ctx;
+    size_t len;
+    const char* end;
+} text_lines_state_t;
+
+static inline void* text_line_trim(void* arg) {
+    text_span_t* span = (text_span_t*)arg;
+    text_lines_state_t* state = (text_lines_state_t*)span->ctx;
+    /* The segment after a final '\n' is not a line. */
+    if (span->ptr == state->end) {
+        return NULL;
+    }
+    text_span_t line = { span->ptr, span->len, span->index, state->ctx };
+    if (line.len && line.ptr[line.len - 1] == '\r') {
+        line.len--;
+    }
+    state->len++;
+    return state->fn(&line);
+}
+
+/**
+ * @brief Calls fn for every line of buf (without "\n" or "\r\n") and returns the line count.
+ *
+ * A final line without a terminator is included; nothing follows a final newline.
+ *
+ * Example usage:
+ * ```
+ * size_t lines = text_lines(file_data, file_size, parse_line, &stats);
+ * ```
+ */
+static inline size_t text_lines(const char* buf, size_t len, lambda_t fn, void* ctx) {
+    text_lines_state_t state = { fn, ctx, 0, buf + len };
+    text_set_t newline;
+    text_set_byte(&newline, '\n');
+    text_split(buf, len, &newline, 0, text_line_trim, &state);
+    return state.len;
+}
+
+/**
+ * @brief Calls fn for every non-overlapping occurrence of needle and returns how many were found.
+ *
+ * Example usage:
+ * ```
+ * size_t errors = text_find_each(log, len, "ERROR", 5, report, NULL);
+ * ```
+ */
+static inline size_t text_find_each(const char* buf, size_t len, const char* needle, size_t needle_len,
+                                    lambda_t fn, void* ctx) {
+    const text_kernels_t* k = text_kernels();
+    text_span_t span = { NULL, needle_len, 0, ctx };
+    const char* end = buf + len;
+    const char* hit;
+    if (needle_len == 0) {
+        return 0;
+    }
+    while ((hit = k->memmem_fn(buf, (size_t)(end - buf), needle, needle_len)) != NULL) {
+        span.ptr = hit;
+        if (fn(&span)) {
+            return span.index + 1;
+        }
+        span.index++;
+        buf = hit + needle_len;
+    }
+    return span.index;
+}
+
+
+#endif /* LAMBDA_TEXT_H */
@@ -0,0 +1,443 @@
+#ifndef LAMBDA_TIMER_H
+#define LAMBDA_TIMER_H
+
+#include "lambda.h"
+#include "lambda_lock.h"
+#include "lambda_event.h"
+#include <stdatomic.h>
+#include <time.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_timer.h
+
+/**
+ * Timer Wheel:
+ *
+ * timer_wheel_init(wheel, tick_ms): Initializes a hierarchical wheel with the given fine resolution.
+ * timer_wheel_schedule(wheel, entry, delay_ms, period_ms, fn, arg): Arms a timer; O(1), no allocation.
+ * timer_wheel_cancel(wheel, entry): Disarms a timer and waits out a running callback; O(1), no allocation.
+ * timer_wheel_advance(wheel, now_ms): Fires every timer due up to now_ms in batches.
+ * timer_wheel_attach(wheel, loop): Drives the wheel from an event loop tick.
+ * timer_wheel_start_thread(wheel) / timer_wheel_stop_thread(wheel): Drives the wheel from its own thread.
+ * timer_entry_pending(entry): Whether a timer is armed.
+ * timer_now_ms(): Monotonic clock in milliseconds.
+ */
+
+
+/**
+ * @file lambda_timer.h
+ * @brief Hierarchical timer wheel for delayed and periodic lambda execution.
+ *
+ * The wheel has TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots. Level
+ * 0 has one slot per tick (the fine resolution); each higher level covers
+ * TIMER_WHEEL_SLOTS times the span of the level below and is cascaded down
+ * as time reaches it. Timers further out than the top level wait on an
+ * overflow list.
+ *
+ * Timers are intrusive: the caller embeds a timer_entry_t in its own
+ * request structure, so schedule and cancel only relink pointers. The
+ * common request-timeout pattern (schedule, then cancel before it fires)
+ * never touches the allocator.
+ *
+ * A wheel is driven either by an event loop (timer_wheel_attach()), by a
+ * dedicated thread (timer_wheel_start_thread()), or by calling
+ * timer_wheel_advance() yourself. Only the thread mode takes a lock; the
+ * other modes expect every call to come from the driving thread.
+ *
+ * Once timer_wheel_cancel() returns, the wheel no longer touches the
+ * entry, so "cancel, then free" is safe. In thread mode that means cancel
+ * waits for a callback already running on the wheel thread: do not call
+ * it while holding a lock that the callback takes.
+ */
+
+/********************* Constants ***************************/
+
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4
+
+#define TIMER_IDLE 0
+#define TIMER_PENDING 1
+#define TIMER_FIRING 2
+
+/********************* Type Definitions ***************************/
+
+struct timer_wheel;
+
+/**
+ * @brief Intrusive timer. Zero-initialize it (or leave it idle) before first use.
+ *
+ * fn is called with arg when the timer fires; its return value is ignored.
+ */
+typedef struct timer_entry {
+    struct timer_entry* next;
+    struct timer_entry** pprev;
+    uint64_t expires;
+    uint64_t period;
+    lambda_t fn;
+    void* arg;
+    int state;
+} timer_entry_t;
+
+/**
+ * @brief Hierarchical timer wheel. Times are in ticks of tick_ms milliseconds.
+ */
+typedef struct timer_wheel {
+    uint64_t tick_ms;
+    uint64_t origin_ms;
+    uint64_t now_tick;
+    size_t count;
+    uint64_t fired;
+    timer_entry_t* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    timer_entry_t* overflow;
+    timer_entry_t* running;
+    pthread_t running_thread;
+    int cancel_waiters;
+    _Atomic uint32_t callback_done;
+    int threaded;
+    _Atomic int stop;
+    pthread_t thread;
+    adaptive_lock_t lock;
+    event_handler_t* loop_timer;
+} timer_wheel_t;
+
+/********************* Internal Helpers ***************************/
+
+/**
+ * @brief Returns the monotonic clock in milliseconds.
+ */
+static inline uint64_t timer_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static inline void timer_link(timer_entry_t** head, timer_entry_t* entry) {
+    entry->next = *head;
+    if (*head) {
+        (*head)->pprev = &entry->next;
+    }
+    *head = entry;
+    entry->pprev = head;
+}
+
+static inline void timer_unlink(timer_entry_t* entry) {
+    *entry->pprev = entry->next;
+    if (entry->next) {
+        entry->next->pprev = entry->pprev;
+    }
+    entry->next = NULL;
+    entry->pprev = NULL;
+}
+
+static inline void timer_place(timer_wheel_t* wheel, timer_entry_t* entry) {
+    uint64_t delta = entry->expires - wheel->now_tick;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (delta < ((uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1)))) {
+            size_t slot = (entry->expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+            timer_link(&wheel->slots[level][slot], entry);
+            return;
+        }
+    }
+    timer_link(&wheel->overflow, entry);
+}
+
+/** The current tick by the clock, which is ahead of now_tick when the wheel has not been advanced lately. */
+static inline uint64_t timer_clock_tick(timer_wheel_t* wheel) {
+    uint64_t tick = (timer_now_ms() - wheel->origin_ms) / wheel->tick_ms;
+    return tick > wheel->now_tick ? tick : wheel->now_tick;
+}
+
+static inline void timer_wheel_lock(timer_wheel_t* wheel) {
+    if (wheel->threaded) {
+        LOCK_AS(adaptive, &wheel->lock);
+    }
+}
+
+static inline void timer_wheel_unlock(timer_wheel_t* wheel) {
+    if (wheel->threaded) {
+        UNLOCK_AS(adaptive, &wheel->lock);
+    }
+}
+
+static inline void timer_cascade(timer_wheel_t* wheel, timer_entry_t** head) {
+    timer_entry_t* list = *head;
+    *head = NULL;
+    while (list) {
+        timer_entry_t* next = list->next;
+        list->next = NULL;
+        list->pprev = NULL;
+        timer_place(wheel, list);
+        list = next;
+    }
+}
+
+/********************* Timer Wheel ***************************/
+
+/**
+ * @brief Initializes a timer wheel.
+ *
+ * @param wheel The wheel to initialize.
+ * @param tick_ms The fine resolution in milliseconds (at least 1).
+ *
+ * Example usage:
+ * ```
+ * timer_wheel_t wheel;
+ * timer_wheel_init(&wheel, 1);
+ * ```
+ */
+static inline void timer_wheel_init(timer_wheel_t* wheel, uint64_t tick_ms) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->tick_ms = tick_ms ? tick_ms : 1;
+    wheel->origin_ms = timer_now_ms();
+    INIT_LOCK(adaptive, &wheel->lock);
+}
+
+/**
+ * @brief Returns whether a timer is armed (or firing and about to re-arm).
+ */
+static inline int timer_entry_pending(const timer_entry_t* entry) {
+    return entry->state != TIMER_IDLE;
+}
+
+/**
+ * @brief Arms a timer. Re-arming a pending timer moves it.
+ *
+ * The delay counts from the clock, not from the last tick the wheel
+ * processed, so a wheel that has sat idle does not fire the timer early.
+ *
+ * @param wheel The wheel.
+ * @param entry The caller-owned timer.
+ * @param delay_ms Delay before the first expiry, rounded up to whole ticks.
+ * @param period_ms Re-arm period after each expiry, 0 for one-shot.
+ * @param fn Lambda called with arg on expiry.
+ * @param arg Argument passed to fn.
+ *
+ * Example usage:
+ * ```
+ * Lambda(on_timeout, req, cancel_request(req); return NULL;);
+ * timer_wheel_schedule(&wheel, &req->timeout, 500, 0, on_timeout, req);
+ * ```
+ */
+static inline void timer_wheel_schedule(timer_wheel_t* wheel, timer_entry_t* entry, uint64_t delay_ms,
+                                        uint64_t period_ms, lambda_t fn, void* arg) {
+    uint64_t ticks = (delay_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    uint64_t period = (period_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    timer_wheel_lock(wheel);
+    uint64_t now = timer_clock_tick(wheel);
+    if (entry->pprev) {
+        timer_unlink(entry);
+        wheel->count--;
+    }
+    entry->fn = fn;
+    entry->arg = arg;
+    entry->period = period;
+    entry->expires = now + (ticks ? ticks : 1);
+    entry->state = TIMER_PENDING;
+    timer_place(wheel, entry);
+    wheel->count++;
+    timer_wheel_unlock(wheel);
+}
+
+/**
+ * @brief Disarms a timer. Safe on idle timers and from inside any timer callback.
+ *
+ * In thread mode, if the timer's callback is running on the wheel thread,
+ * waits for it to return; the entry may be freed as soon as this returns.
+ * Called from inside the timer's own callback, it returns without waiting.
+ *
+ * @return Returns 1 if the timer was armed or firing, 0 otherwise.
+ *
+ * Example usage:
+ * ```
+ * timer_wheel_cancel(&wheel, &req->timeout);
+ * ```
+ */
+static inline int timer_wheel_cancel(timer_wheel_t* wheel, timer_entry_t* entry) {
+    timer_wheel_lock(wheel);
+    int was_armed = entry->state != TIMER_IDLE;
+    if (entry->pprev) {
+        timer_unlink(entry);
+        wheel->count--;
+    }
+    entry->state = TIMER_IDLE;
+    while (wheel->threaded && wheel->running == entry && !pthread_equal(wheel->running_thread, pthread_self())) {
+        uint32_t seen = atomic_load(&wheel->callback_done);
+        wheel->cancel_waiters++;
+        timer_wheel_unlock(wheel);
+        lock_futex_wait(&wheel->callback_done, seen);
+        timer_wheel_lock(wheel);
+        wheel->cancel_waiters--;
+    }
+    timer_wheel_unlock(wheel);
+    return was_armed;
+}
+
+static inline void timer_wheel_tick(timer_wheel_t* wheel) {
+    wheel->now_tick++;
+    uint64_t now = wheel->now_tick;
+
+    if ((now & TIMER_WHEEL_MASK) == 0) {
+        int level = 1;
+        for (; level < TIMER_WHEEL_LEVELS; level++) {
+            size_t slot = (now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+            timer_cascade(wheel, &wheel->slots[level][slot]);
+            if (slot != 0) {
+                break;
+            }
+        }
+        if (level == TIMER_WHEEL_LEVELS) {
+            timer_cascade(wheel, &wheel->overflow);
+        }
+    }
+
+    // Detach the due slot first; callbacks may cancel or re-arm any timer,
+    // including ones still waiting in this batch.
+    timer_entry_t* batch = wheel->slots[0][now & TIMER_WHEEL_MASK];
+    wheel->slots[0][now & TIMER_WHEEL_MASK] = NULL;
+    if (batch) {
+        batch->pprev = &batch;
+    }
+    while (batch) {
+        timer_entry_t* entry = batch;
+        timer_unlink(entry);
+        wheel->count--;
+        wheel->fired++;
+        entry->state = TIMER_FIRING;
+        lambda_t fn = entry->fn;
+        void* arg = entry->arg;
+        wheel->running = entry;
+        wheel->running_thread = pthread_self();
+
+        timer_wheel_unlock(wheel);
+        fn(arg);
+        timer_wheel_lock(wheel);
+
+        if (entry->state == TIMER_FIRING) {
+            if (entry->period) {
+                entry->expires = wheel->now_tick + entry->period;
+                entry->state = TIMER_PENDING;
+                timer_place(wheel, entry);
+                wheel->count++;
+            } else {
+                entry->state = TIMER_IDLE;
+            }
+        }
+        wheel->running = NULL;
+        if (wheel->cancel_waiters) {
+            atomic_fetch_add(&wheel->callback_done, 1);
+            lock_futex_wake(&wheel->callback_done, INT32_MAX);
+        }
+    }
+}
+
+/**
+ * @brief Fires every timer due up to now_ms, one tick at a time.
+ *
+ * Ticks with no pending timers at all are skipped in one step.
+ *
+ * @param wheel The wheel.
+ * @param now_ms The current time from timer_now_ms().
+ * @return Returns the number of timers fired.
+ *
+ * Example usage:
+ * ```
+ * timer_wheel_advance(&wheel, timer_now_ms());
+ * ```
+ */
+static inline uint64_t timer_wheel_advance(timer_wheel_t* wheel, uint64_t now_ms) {
+    timer_wheel_lock(wheel);
+    uint64_t before = wheel->fired;
+    uint64_t target = (now_ms - wheel->origin_ms) / wheel->tick_ms;
+    while (wheel->now_tick < target) {
+        if (wheel->count == 0) {
+            wheel->now_tick = target;
+            break;
+        }
+        timer_wheel_tick(wheel);
+    }
+    uint64_t fired = wheel->fired - before;
+    timer_wheel_unlock(wheel);
+    return fired;
+}
+
+/********************* Drivers ***************************/
+
+static inline void* timer_wheel_loop_tick(void* arg) {
+    event_handler_t* handler = (event_handler_t*)arg;
+    timer_wheel_advance((timer_wheel_t*)handler->arg, timer_now_ms());
+    return NULL;
+}
+
+/**
+ * @brief Drives the wheel from an event loop with a periodic timerfd of tick_ms.
+ *
+ * Scheduling and cancelling must then happen on the loop thread (or be
+ * posted to it with event_loop_post()).
+ *
+ * @return event_handler_t* The tick handler; remove it to detach the wheel.
+ *
+ * Example usage:
+ * ```
+ * timer_wheel_attach(&wheel, loop);
+ * event_loop_run(loop);
+ * ```
+ */
+static inline event_handler_t* timer_wheel_attach(timer_wheel_t* wheel, event_loop_t* loop) {
+    wheel->loop_timer = event_loop_add_timer(loop, wheel->tick_ms, wheel->tick_ms,
+                                             timer_wheel_loop_tick, wheel);
+    return wheel->loop_timer;
+}
+
+static inline void* timer_wheel_thread_main(void* arg) {
+    timer_wheel_t* wheel = (timer_wheel_t*)arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!atomic_load_explicit(&wheel->stop, memory_order_relaxed)) {
+        next.tv_nsec += (long)wheel->tick_ms * 1000000L;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        timer_wheel_advance(wheel, timer_now_ms());
+    }
+    return NULL;
+}
+
+/**
+ * @brief Drives the wheel from a dedicated thread.
+ *
+ * Schedule and cancel become safe from any thread; callbacks run on the
+ * wheel thread without the wheel lock held.
+ *
+ * Example usage:
+ * ```
+ * timer_wheel_start_thread(&wheel);
+ * ```
+ */
+static inline void timer_wheel_start_thread(timer_wheel_t* wheel) {
+    wheel->threaded = 1;
+    atomic_store(&wheel->stop, 0);
+    if (pthread_create(&wheel->thread, NULL, timer_wheel_thread_main, wheel) != 0) {
+        HANDLE_ERROR("Failed to start timer wheel thread");
+    }
+}
+
+/**
+ * @brief Stops the wheel thread. Pending timers stay armed.
+ *
+ * Example usage:
+ * ```
+ * timer_wheel_stop_thread(&wheel);
+ * ```
+ */
+static inline void timer_wheel_stop_thread(timer_wheel_t* wheel) {
+    atomic_store(&wheel->stop, 1);
+    pthread_join(wheel->thread, NULL);
+    wheel->threaded = 0;
+}
+
+
+#endif /* LAMBDA_TIMER_H */
@@ -0,0 +1,1308 @@
+#ifndef LAMBDA_VM_H
+#define LAMBDA_VM_H
+
+#include "lambda.h"
+#include <ctype.h>
+#include <math.h>
+
+
+// summarized list of all of the macros and functions defined in the lambda_vm.h
+
+/**
+ * Runtime Lambda Expressions:
+ *
+ * vm_compile(src, param, param_type): Compiles an expression over one parameter to bytecode.
+ * vm_free(prog): Frees a compiled program.
+ * vm_eval(prog, arg): Evaluates a program for one argument.
+ * vm_eval_int(prog, x) / vm_eval_float(prog, x): Typed scalar evaluation.
+ * vm_eval_batch(prog, in, out, n): Evaluates a program over whole arrays.
+ * vm_as_lambda(prog): Returns a lambda_t that evaluates the program.
+ * vm_release_lambda(fn): Returns a lambda_t obtained from vm_as_lambda().
+ * vm_disassemble(prog, out): Prints the bytecode of a program.
+ * vm_last_error(): Message describing the last compile error on this thread.
+ */
+
+
+/**
+ * @file lambda_vm.h
+ * @brief Bytecode compiler and threaded-dispatch VM for runtime-defined lambda expressions.
+ *
+ * The Lambda macros fix a lambda body at compile time. vm_compile() accepts
+ * the same kind of body as a string at runtime:
+ *
+ * ```
+ * vm_program_t* add = vm_compile("x + 10", "x", VM_INT);
+ * vm_program_t* idle = vm_compile("s == 0 ? 1 : 0", "s", VM_INT);
+ * vm_program_t* host = vm_compile("starts(h, \"db\") && len(h) < 16", "h", VM_STR);
+ * ```
+ *
+ * Values are 64-bit integers, doubles or strings. The language has the C
+ * arithmetic, comparison, logical and conditional operators plus the
+ * functions abs, min, max, int, float, len, contains and starts. Integer
+ * arithmetic wraps and division or modulo by zero yields 0, so a program
+ * never traps. A NULL string argument reads as "". Nesting deeper than
+ * VM_MAX_DEPTH is rejected at compile time.
+ *
+ * Expressions are type checked, constant folded and compiled to a
+ * register bytecode of 4-byte instructions, with dedicated forms for an
+ * operation against a constant. The interpreter dispatches with computed
+ * gotos. vm_eval_batch() runs each instruction over a block of VM_BATCH
+ * values before moving to the next one, which amortizes dispatch over the
+ * whole block and lets the compiler vectorize the per-instruction loops.
+ *
+ * The float operations use <math.h>, so programs including this header
+ * must link with -lm.
+ */
+
+/********************* Type Definitions ***************************/
+
+/**
+ * @brief Value types of the expression language.
+ */
+typedef enum {
+    VM_INT,
+    VM_FLOAT,
+    VM_STR
+} vm_type_t;
+
+/**
+ * @brief One register or constant.
+ */
+typedef union {
+    int64_t i;
+    double f;
+    const char* s;
+} vm_value_t;
+
+/**
+ * @brief One instruction: opcode, destination and two operand registers (or a constant index).
+ */
+typedef struct {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+} vm_instr_t;
+
+/**
+ * @brief A compiled expression. Register 0 always holds the parameter.
+ */
+typedef struct {
+    vm_type_t param_type;
+    vm_type_t result_type;
+    vm_instr_t* code;
+    size_t code_len;
+    vm_value_t* consts;
+    vm_type_t* const_types;
+    size_t const_count;
+    int reg_count;
+    char** strings;
+    size_t string_count;
+} vm_program_t;
+
+#ifndef VM_BATCH
+#define VM_BATCH 256
+#endif
+
+#define VM_MAX_REGS 255
+#define VM_MAX_CONSTS 256
+
+/* Deepest nesting and syntax tree the recursive compiler accepts before failing. */
+#ifndef VM_MAX_DEPTH
+#define VM_MAX_DEPTH 256
+#endif
+
+/**
+ * @brief Opcode list. K forms take a constant index in the b field; SELECT
+ * is followed by an extension word whose a/b fields hold the two branches.
+ */
+#define VM_OPCODES(X) \
+    X(RET) X(LOADK) X(MOV) \
+    X(IADD) X(ISUB) X(IMUL) X(IDIV) X(IMOD) \
+    X(IADDK) X(ISUBK) X(IMULK) \
+    X(FADD) X(FSUB) X(FMUL) X(FDIV) \
+    X(FADDK) X(FSUBK) X(FMULK) X(FDIVK) \
+    X(INEG) X(FNEG) X(NOT) X(I2F) X(F2I) X(IABS) X(FABS) \
+    X(IMIN) X(IMAX) X(FMIN) X(FMAX) \
+    X(IEQ) X(INE) X(ILT) X(ILE) \
+    X(IEQK) X(INEK) X(ILTK) X(ILEK) X(IGTK) X(IGEK) \
+    X(FEQ) X(FNE) X(FLT) X(FLE) \
+    X(SEQ) X(SNE) X(SLT) X(SLE) \
+    X(AND) X(OR) X(SELECT) \
+    X(SLEN) X(SCONTAINS) X(SSTARTS)
+
+#define VM_ENUM_OP(name) VM_OP_##name,
+typedef enum { VM_OPCODES(VM_ENUM_OP) VM_OP_COUNT } vm_opcode_t;
+#undef VM_ENUM_OP
+
+/********************* Error Reporting ***************************/
+
+static __thread char vm_error_buffer[160];
+
+/**
+ * @brief Returns the message of the last compile error on the calling thread.
+ */
+static inline const char* vm_last_error(void) {
+    return vm_error_buffer;
+}
+
+/********************* Lexer ***************************/
+
+enum {
+    VM_TOK_END, VM_TOK_INT, VM_TOK_FLOAT, VM_TOK_STR, VM_TOK_IDENT,
+    VM_TOK_LPAREN, VM_TOK_RPAREN, VM_TOK_COMMA, VM_TOK_QUESTION, VM_TOK_COLON,
+    VM_TOK_PLUS, VM_TOK_MINUS, VM_TOK_STAR, VM_TOK_SLASH, VM_TOK_PERCENT,
+    VM_TOK_LT, VM_TOK_LE, VM_TOK_GT, VM_TOK_GE, VM_TOK_EQ, VM_TOK_NE,
+    VM_TOK_AND, VM_TOK_OR, VM_TOK_NOT, VM_TOK_ERROR
+};
+
+typedef struct {
+    const char* src;
+    const char* pos;
+    int tok;
+    const char* tok_start;
+    size_t tok_len;
+    vm_value_t value;
+    char* str;
+    int failed;
+} vm_parser_t;
+
+static inline void vm_fail(vm_parser_t* p, const char* msg) {
+    if (!p->failed) {
+        snprintf(vm_error_buffer, sizeof(vm_error_buffer), "%s at offset %ld",
+                 msg, (long)(p->tok_start - p->src));
+        p->failed = 1;
+    }
+}
+
+static inline void vm_next(vm_parser_t* p) {
+    const char* s = p->pos;
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    p->tok_start = s;
+    p->str = NULL;
+    if (!*s) {
+        p->tok = VM_TOK_END;
+        p->pos = s;
+        return;
+    }
+    if (isdigit((unsigned char)*s) || (*s == '.' && isdigit((unsigned char)s[1]))) {
+        char* end;
+        long long iv = strtoll(s, &end, 10);
+        if (*end == '.' || *end == 'e' || *end == 'E') {
+            p->value.f = strtod(s, &end);
+            p->tok = VM_TOK_FLOAT;
+        } else {
+            p->value.i = iv;
+            p->tok = VM_TOK_INT;
+        }
+        p->pos = end;
+        return;
+    }
+    if (isalpha((unsigned char)*s) || *s == '_') {
+        const char* start = s;
+        while (isalnum((unsigned char)*s) || *s == '_') {
+            s++;
+        }
+        p->tok = VM_TOK_IDENT;
+        p->tok_len = (size_t)(s - start);
+        p->pos = s;
+        return;
+    }
+    if (*s == '"') {
+        size_t cap = 16, len = 0;
+        char* buf = SAFE_MALLOC(cap);
+        s++;
+        while (*s && *s != '"') {
+            char c = *s++;
+            if (c == '\\' && *s) {
+                c = *s++;
+                c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+            }
+            if (len + 1 >= cap) {
+                cap *= 2;
+                char* grown = realloc(buf, cap);
+                if (!grown) {
+                    HANDLE_MEMORY_ERROR("Failed to grow string literal");
+                }
+                buf = grown;
+            }
+            buf[len++] = c;
+        }
+        buf[len] = '\0';
+        if (*s != '"') {
+            free(buf);
+            p->tok = VM_TOK_ERROR;
+            vm_fail(p, "unterminated string literal");
+            return;
+        }
+        p->str = buf;
+        p->tok = VM_TOK_STR;
+        p->pos = s + 1;
+        return;
+    }
+
+    p->pos = s + 1;
+    switch (*s) {
+    case '(': p->tok = VM_TOK_LPAREN; return;
+    case ')': p->tok = VM_TOK_RPAREN; return;
+    case ',': p->tok = VM_TOK_COMMA; return;
+    case '?': p->tok = VM_TOK_QUESTION; return;
+    case ':': p->tok = VM_TOK_COLON; return;
+    case '+': p->tok = VM_TOK_PLUS; return;
+    case '-': p->tok = VM_TOK_MINUS; return;
+    case '*': p->tok = VM_TOK_STAR; return;
+    case '/': p->tok = VM_TOK_SLASH; return;
+    case '%': p->tok = VM_TOK_PERCENT; return;
+    case '<':
+        if (s[1] == '=') { p->pos++; p->tok = VM_TOK_LE; } else { p->tok = VM_TOK_LT; }
+        return;
+    case '>':
+        if (s[1] == '=') { p->pos++; p->tok = VM_TOK_GE; } else { p->tok = VM_TOK_GT; }
+        return;
+    case '=':
+        if (s[1] == '=') { p->pos++; p->tok = VM_TOK_EQ; return; }
+        break;
+    case '!':
+        if (s[1] == '=') { p->pos++; p->tok = VM_TOK_NE; } else { p->tok = VM_TOK_NOT; }
+        return;
+    case '&':
+        if (s[1] == '&') { p->pos++; p->tok = VM_TOK_AND; return; }
+        break;
+    case '|':
+        if (s[1] == '|') { p->pos++; p->tok = VM_TOK_OR; return; }
+        break;
+    }
+    p->tok = VM_TOK_ERROR;
+    vm_fail(p, "unexpected character");
+}
+
+/********************* Syntax Tree ***************************/
+
+enum { VM_NODE_CONST, VM_NODE_PARAM, VM_NODE_OP };
+
+typedef struct vm_node {
+    int kind;
+    vm_type_t type;
+    int op;
+    vm_value_t value;
+    char* str;
+    int depth;
+    struct vm_node* kids[3];
+} vm_node_t;
+
+static inline vm_node_t* vm_node(int kind, vm_type_t type, int op) {
+    vm_node_t* node = SAFE_MALLOC(sizeof(vm_node_t));
+    memset(node, 0, sizeof(*node));
+    node->kind = kind;
+    node->type = type;
+    node->op = op;
+    return node;
+}
+
+static inline void vm_node_free(vm_node_t* node) {
+    if (!node) {
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        vm_node_free(node->kids[i]);
+    }
+    free(node->str);
+    free(node);
+}
+
+static inline vm_node_t* vm_op(int op, vm_type_t type, vm_node_t* a, vm_node_t* b, vm_node_t* c) {
+    vm_node_t* node = vm_node(VM_NODE_OP, type, op);
+    node->kids[0] = a;
+    node->kids[1] = b;
+    node->kids[2] = c;
+    for (int i = 0; i < 3; i++) {
+        if (node->kids[i] && node->kids[i]->depth >= node->depth) {
+            node->depth = node->kids[i]->depth + 1;
+        }
+    }
+    return node;
+}
+
+static inline vm_node_t* vm_to_float(vm_node_t* node) {
+    return node->type == VM_INT ? vm_op(VM_OP_I2F, VM_FLOAT, node, NULL, NULL) : node;
+}
+
+/** Converts a numeric node to a 0/1 truth value. */
+static inline vm_node_t* vm_to_bool(vm_parser_t* p, vm_node_t* node) {
+    if (node->type == VM_STR) {
+        vm_fail(p, "string used as a condition");
+        return node;
+    }
+    if (node->type == VM_FLOAT) {
+        vm_node_t* zero = vm_node(VM_NODE_CONST, VM_FLOAT, 0);
+        zero->value.f = 0.0;
+        return vm_op(VM_OP_FNE, VM_INT, node, zero, NULL);
+    }
+    return node;
+}
+
+/********************* Parser ***************************/
+
+typedef struct {
+    vm_parser_t lex;
+    const char* param;
+    vm_type_t param_type;
+    int depth;
+} vm_compiler_t;
+
+static inline vm_node_t* vm_parse_expr(vm_compiler_t* c, int min_prec);
+
+static inline int vm_expect(vm_compiler_t* c, int tok, const char* msg) {
+    if (c->lex.tok != tok) {
+        vm_fail(&c->lex, msg);
+        return 0;
+    }
+    vm_next(&c->lex);
+    return 1;
+}
+
+static inline int vm_ident_is(vm_compiler_t* c, const char* name) {
+    return strlen(name) == c->lex.tok_len && strncmp(c->lex.tok_start, name, c->lex.tok_len) == 0;
+}
+
+static inline vm_node_t* vm_parse_call(vm_compiler_t* c, const char* name) {
+    vm_node_t* args[2] = { NULL, NULL };
+    int argc = 0;
+    vm_next(&c->lex);
+    if (!vm_expect(c, VM_TOK_LPAREN, "expected '(' after function name")) {
+        return NULL;
+    }
+    while (c->lex.tok != VM_TOK_RPAREN && !c->lex.failed) {
+        vm_node_t* arg = vm_parse_expr(c, 1);
+        if (argc < 2) {
+            args[argc] = arg;
+        } else {
+            vm_node_free(arg);
+        }
+        argc++;
+        if (c->lex.tok != VM_TOK_COMMA) {
+            break;
+        }
+        vm_next(&c->lex);
+    }
+    vm_expect(c, VM_TOK_RPAREN, "expected ')' after arguments");
+
+    int unary = !strcmp(name, "abs") || !strcmp(name, "int") || !strcmp(name, "float") ||
+                !strcmp(name, "len");
+    if (c->lex.failed || argc != (unary ? 1 : 2) || !args[0] || (!unary && !args[1])) {
+        vm_fail(&c->lex, "wrong number of function arguments");
+        vm_node_free(args[0]);
+        vm_node_free(args[1]);
+        return NULL;
+    }
+    vm_node_t* a = args[0];
+    vm_node_t* b = args[1];
+    int numeric = a->type != VM_STR && (unary || b->type != VM_STR);
+    int strings = a->type == VM_STR && (unary || b->type == VM_STR);
+
+    if (!strcmp(name, "len") && strings) {
+        return vm_op(VM_OP_SLEN, VM_INT, a, NULL, NULL);
+    }
+    if (!strcmp(name, "contains") && strings) {
+        return vm_op(VM_OP_SCONTAINS, VM_INT, a, b, NULL);
+    }
+    if (!strcmp(name, "starts") && strings) {
+        return vm_op(VM_OP_SSTARTS, VM_INT, a, b, NULL);
+    }
+    if (!strcmp(name, "abs") && numeric) {
+        return vm_op(a->type == VM_INT ? VM_OP_IABS : VM_OP_FABS, a->type, a, NULL, NULL);
+    }
+    if (!strcmp(name, "int") && numeric) {
+        return a->type == VM_FLOAT ? vm_op(VM_OP_F2I, VM_INT, a, NULL, NULL) : a;
+    }
+    if (!strcmp(name, "float") && numeric) {
+        return vm_to_float(a);
+    }
+    if ((!strcmp(name, "min") || !strcmp(name, "max")) && numeric) {
+        int is_min = !strcmp(name, "min");
+        if (a->type == VM_INT && b->type == VM_INT) {
+            return vm_op(is_min ? VM_OP_IMIN : VM_OP_IMAX, VM_INT, a, b, NULL);
+        }
+        return vm_op(is_min ? VM_OP_FMIN : VM_OP_FMAX, VM_FLOAT, vm_to_float(a), vm_to_float(b), NULL);
+    }
+    vm_fail(&c->lex, "unknown function or wrong argument types");
+    vm_node_free(a);
+    vm_node_free(b);
+    return NULL;
+}
+
+static inline vm_node_t* vm_parse_primary(vm_compiler_t* c) {
+    vm_parser_t* p = &c->lex;
+    vm_node_t* node = NULL;
+    switch (p->tok) {
+    case VM_TOK_INT:
+        node = vm_node(VM_NODE_CONST, VM_INT, 0);
+        node->value = p->value;
+        vm_next(p);
+        return node;
+    case VM_TOK_FLOAT:
+        node = vm_node(VM_NODE_CONST, VM_FLOAT, 0);
+        node->value = p->value;
+        vm_next(p);
+        return node;
+    case VM_TOK_STR:
+        node = vm_node(VM_NODE_CONST, VM_STR, 0);
+        node->str = p->str;
+        node->value.s = node->str;
+        vm_next(p);
+        return node;
+    case VM_TOK_IDENT: {
+        if (vm_ident_is(c, c->param)) {
+            vm_next(p);
+            return vm_node(VM_NODE_PARAM, c->param_type, 0);
+        }
+        char name[16];
+        size_t len = p->tok_len < sizeof(name) - 1 ? p->tok_len : sizeof(name) - 1;
+        memcpy(name, p->tok_start, len);
+        name[len] = '\0';
+        return vm_parse_call(c, name);
+    }
+    case VM_TOK_LPAREN:
+        vm_next(p);
+        node = vm_parse_expr(c, 1);
+        if (!vm_expect(c, VM_TOK_RPAREN, "expected ')'")) {
+            vm_node_free(node);
+            return NULL;
+        }
+        return node;
+    case VM_TOK_MINUS:
+        vm_next(p);
+        node = vm_parse_expr(c, 8);
+        if (!node) {
+            return NULL;
+        }
+        if (node->type == VM_STR) {
+            vm_fail(p, "cannot negate a string");
+            vm_node_free(node);
+            return NULL;
+        }
+        return vm_op(node->type == VM_INT ? VM_OP_INEG : VM_OP_FNEG, node->type, node, NULL, NULL);
+    case VM_TOK_NOT:
+        vm_next(p);
+        node = vm_parse_expr(c, 8);
+        if (!node) {
+            return NULL;
+        }
+        return vm_op(VM_OP_NOT, VM_INT, vm_to_bool(p, node), NULL, NULL);
+    default:
+        vm_fail(p, "expected an expression");
+        return NULL;
+    }
+}
+
+static inline int vm_binary_prec(int tok) {
+    switch (tok) {
+    case VM_TOK_QUESTION: return 1;
+    case VM_TOK_OR: return 2;
+    case VM_TOK_AND: return 3;
+    case VM_TOK_EQ: case VM_TOK_NE: return 4;
+    case VM_TOK_LT: case VM_TOK_LE: case VM_TOK_GT: case VM_TOK_GE: return 5;
+    case VM_TOK_PLUS: case VM_TOK_MINUS: return 6;
+    case VM_TOK_STAR: case VM_TOK_SLASH: case VM_TOK_PERCENT: return 7;
+    default: return 0;
+    }
+}
+
+static inline vm_node_t* vm_make_binary(vm_compiler_t* c, int tok, vm_node_t* a, vm_node_t* b) {
+    vm_parser_t* p = &c->lex;
+    if (tok == VM_TOK_AND || tok == VM_TOK_OR) {
+        return vm_op(tok == VM_TOK_AND ? VM_OP_AND : VM_OP_OR, VM_INT,
+                     vm_to_bool(p, a), vm_to_bool(p, b), NULL);
+    }
+
+    int swap = tok == VM_TOK_GT || tok == VM_TOK_GE;
+    if (swap) {
+        vm_node_t* t = a;
+        a = b;
+        b = t;
+        tok = tok == VM_TOK_GT ? VM_TOK_LT : VM_TOK_LE;
+    }
+    int compare = tok >= VM_TOK_LT && tok <= VM_TOK_NE;
+
+    if (a->type == VM_STR || b->type == VM_STR) {
+        if (a->type != b->type || !compare) {
+            vm_fail(p, "invalid operands for a string operation");
+            return vm_op(VM_OP_SEQ, VM_INT, a, b, NULL);
+        }
+        int op = tok == VM_TOK_EQ ? VM_OP_SEQ : tok == VM_TOK_NE ? VM_OP_SNE :
+                 tok == VM_TOK_LT ? VM_OP_SLT : VM_OP_SLE;
+        return vm_op(op, VM_INT, a, b, NULL);
+    }
+
+    if (a->type == VM_INT && b->type == VM_INT) {
+        static const int int_ops[] = {
+            [VM_TOK_PLUS] = VM_OP_IADD, [VM_TOK_MINUS] = VM_OP_ISUB, [VM_TOK_STAR] = VM_OP_IMUL,
+            [VM_TOK_SLASH] = VM_OP_IDIV, [VM_TOK_PERCENT] = VM_OP_IMOD,
+            [VM_TOK_LT] = VM_OP_ILT, [VM_TOK_LE] = VM_OP_ILE,
+            [VM_TOK_EQ] = VM_OP_IEQ, [VM_TOK_NE] = VM_OP_INE,
+        };
+        return vm_op(int_ops[tok], VM_INT, a, b, NULL);
+    }
+
+    if (tok == VM_TOK_PERCENT) {
+        vm_fail(p, "'%' needs integer operands");
+    }
+    static const int float_ops[] = {
+        [VM_TOK_PLUS] = VM_OP_FADD, [VM_TOK_MINUS] = VM_OP_FSUB, [VM_TOK_STAR] = VM_OP_FMUL,
+        [VM_TOK_SLASH] = VM_OP_FDIV, [VM_TOK_PERCENT] = VM_OP_FDIV,
+        [VM_TOK_LT] = VM_OP_FLT, [VM_TOK_LE] = VM_OP_FLE,
+        [VM_TOK_EQ] = VM_OP_FEQ, [VM_TOK_NE] = VM_OP_FNE,
+    };
+    return vm_op(float_ops[tok], compare ? VM_INT : VM_FLOAT, vm_to_float(a), vm_to_float(b), NULL);
+}
+
+/**
+ * Parsing, folding, code generation and freeing all recurse over the tree,
+ * so both the parser's nesting and the depth of the tree it builds are
+ * capped at VM_MAX_DEPTH; deeper input is a compile error, not a stack overflow.
+ */
+static inline vm_node_t* vm_parse_expr(vm_compiler_t* c, int min_prec) {
+    vm_parser_t* p = &c->lex;
+    if (c->depth >= VM_MAX_DEPTH) {
+        vm_fail(p, "expression nested too deeply");
+        return NULL;
+    }
+    c->depth++;
+    vm_node_t* left = vm_parse_primary(c);
+    while (left && !p->failed) {
+        int tok = p->tok;
+        int prec = vm_binary_prec(tok);
+        if (prec == 0 || prec < min_prec) {
+            break;
+        }
+        vm_next(p);
+        if (tok == VM_TOK_QUESTION) {
+            vm_node_t* then = vm_parse_expr(c, 1);
+            vm_expect(c, VM_TOK_COLON, "expected ':' in conditional");
+            vm_node_t* other = vm_parse_expr(c, 1);
+            if (!then || !other || p->failed) {
+                vm_node_free(then);
+                vm_node_free(other);
+                break;
+            }
+            if (then->type != other->type) {
+                if (then->type == VM_STR || other->type == VM_STR) {
+                    vm_fail(p, "conditional branches have different types");
+                }
+                then = vm_to_float(then);
+                other = vm_to_float(other);
+            }
+            left = vm_op(VM_OP_SELECT, then->type, vm_to_bool(p, left), then, other);
+            if (left->depth > VM_MAX_DEPTH) {
+                vm_fail(p, "expression nested too deeply");
+            }
+            continue;
+        }
+        vm_node_t* right = vm_parse_expr(c, prec + 1);
+        if (!right) {
+            break;
+        }
+        left = vm_make_binary(c, tok, left, right);
+        if (left->depth > VM_MAX_DEPTH) {
+            vm_fail(p, "expression nested too deeply");
+        }
+    }
+    c->depth--;
+    if (p->failed) {
+        vm_node_free(left);
+        return NULL;
+    }
+    return left;
+}
+
+/********************* Code Generation ***************************/
+
+typedef struct {
+    vm_program_t* prog;
+    size_t code_cap;
+    int next_reg;
+    int failed;
+} vm_codegen_t;
+
+static inline void vm_emit(vm_codegen_t* g, int op, int dst, int a, int b) {
+    vm_program_t* prog = g->prog;
+    if (prog->code_len == g->code_cap) {
+        g->code_cap = g->code_cap ? g->code_cap * 2 : 16;
+        vm_instr_t* grown = realloc(prog->code, g->code_cap * sizeof(vm_instr_t));
+        if (!grown) {
+            HANDLE_MEMORY_ERROR("Failed to grow bytecode");
+        }
+        prog->code = grown;
+    }
+    vm_instr_t instr = { (uint8_t)op, (uint8_t)dst, (uint8_t)a, (uint8_t)b };
+    prog->code[prog->code_len++] = instr;
+}
+
+static inline int vm_add_const(vm_codegen_t* g, vm_node_t* node) {
+    vm_program_t* prog = g->prog;
+    for (size_t i = 0; i < prog->const_count; i++) {
+        if (prog->const_types[i] == node->type && prog->consts[i].i == node->value.i && node->type != VM_STR) {
+            return (int)i;
+        }
+    }
+    if (prog->const_count == VM_MAX_CONSTS) {
+        g->failed = 1;
+        return 0;
+    }
+    if (node->type == VM_STR) {
+        prog->strings = realloc(prog->strings, (prog->string_count + 1) * sizeof(char*));
+        if (!prog->strings) {
+            HANDLE_MEMORY_ERROR("Failed to grow string table");
+        }
+        prog->strings[prog->string_count++] = SAFE_STRDUP(node->value.s);
+        node->value.s = prog->strings[prog->string_count - 1];
+    }
+    prog->consts[prog->const_count] = node->value;
+    prog->const_types[prog->const_count] = node->type;
+    return (int)prog->const_count++;
+}
+
+static inline int vm_alloc_reg(vm_codegen_t* g) {
+    int reg = g->next_reg++;
+    if (reg >= VM_MAX_REGS) {
+        g->failed = 1;
+        return 0;
+    }
+    if (reg + 1 > g->prog->reg_count) {
+        g->prog->reg_count = reg + 1;
+    }
+    return reg;
+}
+
+static inline int vm_const_form(int op) {
+    switch (op) {
+    case VM_OP_IADD: return VM_OP_IADDK;
+    case VM_OP_ISUB: return VM_OP_ISUBK;
+    case VM_OP_IMUL: return VM_OP_IMULK;
+    case VM_OP_FADD: return VM_OP_FADDK;
+    case VM_OP_FSUB: return VM_OP_FSUBK;
+    case VM_OP_FMUL: return VM_OP_FMULK;
+    case VM_OP_FDIV: return VM_OP_FDIVK;
+    case VM_OP_IEQ: return VM_OP_IEQK;
+    case VM_OP_INE: return VM_OP_INEK;
+    case VM_OP_ILT: return VM_OP_ILTK;
+    case VM_OP_ILE: return VM_OP_ILEK;
+    default: return -1;
+    }
+}
+
+/** Constant on the left of a commutative or flippable comparison op. */
+static inline int vm_const_form_swapped(int op) {
+    switch (op) {
+    case VM_OP_IADD: return VM_OP_IADDK;
+    case VM_OP_IMUL: return VM_OP_IMULK;
+    case VM_OP_FADD: return VM_OP_FADDK;
+    case VM_OP_FMUL: return VM_OP_FMULK;
+    case VM_OP_IEQ: return VM_OP_IEQK;
+    case VM_OP_INE: return VM_OP_INEK;
+    case VM_OP_ILT: return VM_OP_IGTK;
+    case VM_OP_ILE: return VM_OP_IGEK;
+    default: return -1;
+    }
+}
+
+static inline int vm_gen(vm_codegen_t* g, vm_node_t* node) {
+    if (node->kind == VM_NODE_PARAM) {
+        return 0;
+    }
+    int saved = g->next_reg;
+    if (node->kind == VM_NODE_CONST) {
+        int k = vm_add_const(g, node);
+        int dst = vm_alloc_reg(g);
+        vm_emit(g, VM_OP_LOADK, dst, k, 0);
+        return dst;
+    }
+
+    vm_node_t** kids = node->kids;
+    if (node->op == VM_OP_SELECT) {
+        int rc = vm_gen(g, kids[0]);
+        int ra = vm_gen(g, kids[1]);
+        int rb = vm_gen(g, kids[2]);
+        g->next_reg = saved;
+        int dst = vm_alloc_reg(g);
+        vm_emit(g, VM_OP_SELECT, dst, rc, 0);
+        vm_emit(g, VM_OP_RET, 0, ra, rb);
+        return dst;
+    }
+
+    if (kids[1]) {
+        int kform = kids[1]->kind == VM_NODE_CONST ? vm_const_form(node->op) : -1;
+        int swapped = -1;
+        if (kform < 0 && kids[0]->kind == VM_NODE_CONST) {
+            swapped = vm_const_form_swapped(node->op);
+        }
+        if (kform >= 0 || swapped >= 0) {
+            vm_node_t* value = kform >= 0 ? kids[0] : kids[1];
+            vm_node_t* constant = kform >= 0 ? kids[1] : kids[0];
+            int ra = vm_gen(g, value);
+            int k = vm_add_const(g, constant);
+            g->next_reg = saved;
+            int dst = vm_alloc_reg(g);
+            vm_emit(g, kform >= 0 ? kform : swapped, dst, ra, k);
+            return dst;
+        }
+    }
+
+    int ra = vm_gen(g, kids[0]);
+    int rb = kids[1] ? vm_gen(g, kids[1]) : 0;
+    g->next_reg = saved;
+    int dst = vm_alloc_reg(g);
+    vm_emit(g, node->op, dst, ra, rb);
+    return dst;
+}
+
+static inline vm_program_t* vm_program_new(vm_type_t param_type) {
+    vm_program_t* prog = SAFE_MALLOC(sizeof(vm_program_t));
+    memset(prog, 0, sizeof(*prog));
+    prog->param_type = param_type;
+    prog->consts = SAFE_MALLOC(VM_MAX_CONSTS * sizeof(vm_value_t));
+    prog->const_types = SAFE_MALLOC(VM_MAX_CONSTS * sizeof(vm_type_t));
+    prog->reg_count = 1;
+    return prog;
+}
+
+/**
+ * @brief Frees a compiled program.
+ *
+ * Example usage:
+ * ```
+ * vm_free(prog);
+ * ```
+ */
+static inline void vm_free(vm_program_t* prog) {
+    if (!prog) {
+        return;
+    }
+    for (size_t i = 0; i < prog->string_count; i++) {
+        free(prog->strings[i]);
+    }
+    free(prog->strings);
+    free(prog->code);
+    free(prog->consts);
+    free(prog->const_types);
+    free(prog);
+}
+
+static inline vm_value_t vm_run(const vm_program_t* prog, vm_value_t arg);
+
+/**
+ * @brief Replaces every operator whose operands are all constants by its value.
+ *
+ * The subtree is compiled and run on the VM itself, so folding always
+ * agrees with runtime semantics.
+ */
+static inline void vm_fold(vm_node_t* node) {
+    if (node->kind != VM_NODE_OP) {
+        return;
+    }
+    int all_const = 1;
+    for (int i = 0; i < 3; i++) {
+        if (node->kids[i]) {
+            vm_fold(node->kids[i]);
+            all_const &= node->kids[i]->kind == VM_NODE_CONST;
+        }
+    }
+    if (!all_const) {
+        return;
+    }
+    vm_program_t* tmp = vm_program_new(VM_INT);
+    vm_codegen_t g = { tmp, 0, 1, 0 };
+    int reg = vm_gen(&g, node);
+    vm_emit(&g, VM_OP_RET, 0, reg, 0);
+    vm_value_t zero = { 0 };
+    vm_value_t value = vm_run(tmp, zero);
+    if (node->type == VM_STR) {
+        // The value points into tmp's string table, which is about to go away.
+        node->str = SAFE_STRDUP(value.s);
+        value.s = node->str;
+    }
+    vm_free(tmp);
+    for (int i = 0; i < 3; i++) {
+        vm_node_free(node->kids[i]);
+        node->kids[i] = NULL;
+    }
+    node->kind = VM_NODE_CONST;
+    node->value = value;
+}
+
+/**
+ * @brief Compiles an expression over one parameter.
+ *
+ * @param src The expression, e.g. "x + 10".
+ * @param param The parameter name used in the expression.
+ * @param param_type The type of the parameter.
+ * @return vm_program_t* The compiled program, or NULL (see vm_last_error()).
+ *
+ * Example usage:
+ * ```
+ * vm_program_t* prog = vm_compile("x * 3 + 1", "x", VM_INT);
+ * if (!prog) {
+ *     LOG_ERROR(vm_last_error());
+ * }
+ * ```
+ */
+static inline vm_program_t* vm_compile(const char* src, const char* param, vm_type_t param_type) {
+    vm_compiler_t c;
+    memset(&c, 0, sizeof(c));
+    c.lex.src = src;
+    c.lex.pos = src;
+    c.param = param;
+    c.param_type = param_type;
+    vm_error_buffer[0] = '\0';
+
+    vm_next(&c.lex);
+    vm_node_t* root = vm_parse_expr(&c, 1);
+    if (root && c.lex.tok != VM_TOK_END) {
+        vm_fail(&c.lex, "unexpected trailing input");
+    }
+    if (!root || c.lex.failed) {
+        vm_node_free(root);
+        free(c.lex.str);
+        return NULL;
+    }
+
+    vm_fold(root);
+    vm_program_t* prog = vm_program_new(param_type);
+    prog->result_type = root->type;
+    vm_codegen_t g = { prog, 0, 1, 0 };
+    int reg = vm_gen(&g, root);
+    vm_emit(&g, VM_OP_RET, 0, reg, 0);
+    vm_node_free(root);
+    if (g.failed) {
+        snprintf(vm_error_buffer, sizeof(vm_error_buffer), "expression too large");
+        vm_free(prog);
+        return NULL;
+    }
+    return prog;
+}
+
+/********************* Interpreter ***************************/
+
+static inline int64_t vm_idiv(int64_t a, int64_t b) {
+    if (b == 0) {
+        return 0;
+    }
+    if (b == -1) {
+        return (int64_t)(0 - (uint64_t)a);
+    }
+    return a / b;
+}
+
+static inline int64_t vm_imod(int64_t a, int64_t b) {
+    if (b == 0 || b == -1) {
+        return 0;
+    }
+    return a % b;
+}
+
+/** String operations read a NULL string argument as "". */
+static inline const char* vm_str(const char* s) {
+    return s ? s : "";
+}
+
+#define VM_IWRAP(a, op, b) ((int64_t)((uint64_t)(a) op (uint64_t)(b)))
+
+static inline vm_value_t vm_run(const vm_program_t* prog, vm_value_t arg) {
+#define VM_LABEL(name) &&vm_op_##name,
+    static void* const labels[] = { VM_OPCODES(VM_LABEL) };
+#undef VM_LABEL
+    vm_value_t r[VM_MAX_REGS + 1];
+    const vm_value_t* k = prog->consts;
+    const vm_instr_t* ip = prog->code;
+    r[0] = arg;
+
+#define DISPATCH() goto *labels[ip->op]
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+#define D r[ip->dst]
+#define A r[ip->a]
+#define B r[ip->b]
+#define K k[ip->b]
+
+    DISPATCH();
+vm_op_RET: return A;
+vm_op_LOADK: D = k[ip->a]; NEXT();
+vm_op_MOV: D = A; NEXT();
+vm_op_IADD: D.i = VM_IWRAP(A.i, +, B.i); NEXT();
+vm_op_ISUB: D.i = VM_IWRAP(A.i, -, B.i); NEXT();
+vm_op_IMUL: D.i = VM_IWRAP(A.i, *, B.i); NEXT();
+vm_op_IDIV: D.i = vm_idiv(A.i, B.i); NEXT();
+vm_op_IMOD: D.i = vm_imod(A.i, B.i); NEXT();
+vm_op_IADDK: D.i = VM_IWRAP(A.i, +, K.i); NEXT();
+vm_op_ISUBK: D.i = VM_IWRAP(A.i, -, K.i); NEXT();
+vm_op_IMULK: D.i = VM_IWRAP(A.i, *, K.i); NEXT();
+vm_op_FADD: D.f = A.f + B.f; NEXT();
+vm_op_FSUB: D.f = A.f - B.f; NEXT();
+vm_op_FMUL: D.f = A.f * B.f; NEXT();
+vm_op_FDIV: D.f = A.f / B.f; NEXT();
+vm_op_FADDK: D.f = A.f + K.f; NEXT();
+vm_op_FSUBK: D.f = A.f - K.f; NEXT();
+vm_op_FMULK: D.f = A.f * K.f; NEXT();
+vm_op_FDIVK: D.f = A.f / K.f; NEXT();
+vm_op_INEG: D.i = (int64_t)(0 - (uint64_t)A.i); NEXT();
+vm_op_FNEG: D.f = -A.f; NEXT();
+vm_op_NOT: D.i = A.i == 0; NEXT();
+vm_op_I2F: D.f = (double)A.i; NEXT();
+vm_op_F2I: D.i = (A.f != A.f) ? 0 : A.f >= 9.2233720368547758e18 ? INT64_MAX :
+                 A.f <= -9.2233720368547758e18 ? INT64_MIN : (int64_t)A.f; NEXT();
+vm_op_IABS: D.i = A.i < 0 ? (int64_t)(0 - (uint64_t)A.i) : A.i; NEXT();
+vm_op_FABS: D.f = fabs(A.f); NEXT();
+vm_op_IMIN: D.i = A.i < B.i ? A.i : B.i; NEXT();
+vm_op_IMAX: D.i = A.i > B.i ? A.i : B.i; NEXT();
+vm_op_FMIN: D.f = fmin(A.f, B.f); NEXT();
+vm_op_FMAX: D.f = fmax(A.f, B.f); NEXT();
+vm_op_IEQ: D.i = A.i == B.i; NEXT();
+vm_op_INE: D.i = A.i != B.i; NEXT();
+vm_op_ILT: D.i = A.i < B.i; NEXT();
+vm_op_ILE: D.i = A.i <= B.i; NEXT();
+vm_op_IEQK: D.i = A.i == K.i; NEXT();
+vm_op_INEK: D.i = A.i != K.i; NEXT();
+vm_op_ILTK: D.i = A.i < K.i; NEXT();
+vm_op_ILEK: D.i = A.i <= K.i; NEXT();
+vm_op_IGTK: D.i = A.i > K.i; NEXT();
+vm_op_IGEK: D.i = A.i >= K.i; NEXT();
+vm_op_FEQ: D.i = A.f == B.f; NEXT();
+vm_op_FNE: D.i = A.f != B.f; NEXT();
+vm_op_FLT: D.i = A.f < B.f; NEXT();
+vm_op_FLE: D.i = A.f <= B.f; NEXT();
+vm_op_SEQ: D.i = strcmp(vm_str(A.s), vm_str(B.s)) == 0; NEXT();
+vm_op_SNE: D.i = strcmp(vm_str(A.s), vm_str(B.s)) != 0; NEXT();
+vm_op_SLT: D.i = strcmp(vm_str(A.s), vm_str(B.s)) < 0; NEXT();
+vm_op_SLE: D.i = strcmp(vm_str(A.s), vm_str(B.s)) <= 0; NEXT();
+vm_op_AND: D.i = (A.i != 0) & (B.i != 0); NEXT();
+vm_op_OR: D.i = (A.i != 0) | (B.i != 0); NEXT();
+vm_op_SELECT: D = A.i ? r[ip[1].a] : r[ip[1].b]; ip++; NEXT();
+vm_op_SLEN: D.i = (int64_t)strlen(vm_str(A.s)); NEXT();
+vm_op_SCONTAINS: D.i = strstr(vm_str(A.s), vm_str(B.s)) != NULL; NEXT();
+vm_op_SSTARTS: D.i = strncmp(vm_str(A.s), vm_str(B.s), strlen(vm_str(B.s))) == 0; NEXT();
+
+#undef DISPATCH
+#undef NEXT
+#undef D
+#undef A
+#undef B
+#undef K
+}
+
+/**
+ * @brief Evaluates a program for one argument of its parameter type.
+ *
+ * Example usage:
+ * ```
+ * vm_value_t arg = { .i = 5 };
+ * int64_t result = vm_eval(prog, arg).i;
+ * ```
+ */
+static inline vm_value_t vm_eval(const vm_program_t* prog, vm_value_t arg) {
+    return vm_run(prog, arg);
+}
+
+/**
+ * @brief Evaluates a program with an integer argument, converting the result to an integer.
+ *
+ * Example usage:
+ * ```
+ * int64_t fifteen = vm_eval_int(prog, 5);
+ * ```
+ */
+static inline int64_t vm_eval_int(const vm_program_t* prog, int64_t x) {
+    vm_value_t arg;
+    if (prog->param_type == VM_FLOAT) {
+        arg.f = (double)x;
+    } else {
+        arg.i = x;
+    }
+    vm_value_t result = vm_run(prog, arg);
+    return prog->result_type == VM_FLOAT ? (int64_t)result.f : result.i;
+}
+
+/**
+ * @brief Evaluates a program with a float argument, converting the result to a double.
+ *
+ * Example usage:
+ * ```
+ * double y = vm_eval_float(prog, 2.5);
+ * ```
+ */
+static inline double vm_eval_float(const vm_program_t* prog, double x) {
+    vm_value_t arg;
+    if (prog->param_type == VM_INT) {
+        arg.i = (int64_t)x;
+    } else {
+        arg.f = x;
+    }
+    vm_value_t result = vm_run(prog, arg);
+    return prog->result_type == VM_INT ? (double)result.i : result.f;
+}
+
+/********************* Batch Interpreter ***************************/
+
+/**
+ * @brief Evaluates a program over n arguments, writing n results.
+ *
+ * Values are processed in blocks of VM_BATCH; each instruction runs over
+ * the whole block before the next one is dispatched. `in` and `out` hold
+ * values of the program's parameter and result types (int64_t, double or
+ * const char* arrays may be passed directly) and may be the same array.
+ *
+ * Example usage:
+ * ```
+ * int64_t values[1000], results[1000];
+ * vm_eval_batch(prog, (vm_value_t*)values, (vm_value_t*)results, 1000);
+ * ```
+ */
+static inline void vm_eval_batch(const vm_program_t* prog, const vm_value_t* in, vm_value_t* out, size_t n) {
+#define VM_LABEL(name) &&vm_batch_##name,
+    static void* const labels[] = { VM_OPCODES(VM_LABEL) };
+#undef VM_LABEL
+    size_t scratch_regs = (size_t)prog->reg_count;
+    vm_value_t* scratch = SAFE_MALLOC(scratch_regs * VM_BATCH * sizeof(vm_value_t));
+    vm_value_t* r[VM_MAX_REGS + 1];
+    const vm_value_t* k = prog->consts;
+    for (size_t i = 1; i < scratch_regs; i++) {
+        r[i] = scratch + i * VM_BATCH;
+    }
+
+    for (size_t base = 0; base < n; base += VM_BATCH) {
+        size_t m = n - base < VM_BATCH ? n - base : VM_BATCH;
+        const vm_instr_t* ip = prog->code;
+        r[0] = (vm_value_t*)(in + base);
+
+#define DISPATCH() goto *labels[ip->op]
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+#define LANES(stmt) do { \
+            vm_value_t* d_ = r[ip->dst]; \
+            const vm_value_t* a_ = r[ip->a]; \
+            for (size_t i = 0; i < m; i++) { stmt; } \
+        } while (0)
+#define LANES2(stmt) do { \
+            vm_value_t* d_ = r[ip->dst]; \
+            const vm_value_t* a_ = r[ip->a]; \
+            const vm_value_t* b_ = r[ip->b]; \
+            for (size_t i = 0; i < m; i++) { stmt; } \
+        } while (0)
+#define LANESK(stmt) do { \
+            vm_value_t* d_ = r[ip->dst]; \
+            const vm_value_t* a_ = r[ip->a]; \
+            const vm_value_t k_ = k[ip->b]; \
+            for (size_t i = 0; i < m; i++) { stmt; } \
+        } while (0)
+#define D d_[i]
+#define A a_[i]
+#define B b_[i]
+#define K k_
+
+        DISPATCH();
+vm_batch_RET:
+        if (r[ip->a] != out + base) {
+            memmove(out + base, r[ip->a], m * sizeof(vm_value_t));
+        }
+        continue;
+vm_batch_LOADK: {
+            vm_value_t value = k[ip->a];
+            vm_value_t* d = r[ip->dst];
+            for (size_t i = 0; i < m; i++) d[i] = value;
+            NEXT();
+        }
+vm_batch_MOV: LANES(D = A); NEXT();
+vm_batch_IADD: LANES2(D.i = VM_IWRAP(A.i, +, B.i)); NEXT();
+vm_batch_ISUB: LANES2(D.i = VM_IWRAP(A.i, -, B.i)); NEXT();
+vm_batch_IMUL: LANES2(D.i = VM_IWRAP(A.i, *, B.i)); NEXT();
+vm_batch_IDIV: LANES2(D.i = vm_idiv(A.i, B.i)); NEXT();
+vm_batch_IMOD: LANES2(D.i = vm_imod(A.i, B.i)); NEXT();
+vm_batch_IADDK: LANESK(D.i = VM_IWRAP(A.i, +, K.i)); NEXT();
+vm_batch_ISUBK: LANESK(D.i = VM_IWRAP(A.i, -, K.i)); NEXT();
+vm_batch_IMULK: LANESK(D.i = VM_IWRAP(A.i, *, K.i)); NEXT();
+vm_batch_FADD: LANES2(D.f = A.f + B.f); NEXT();
+vm_batch_FSUB: LANES2(D.f = A.f - B.f); NEXT();
+vm_batch_FMUL: LANES2(D.f = A.f * B.f); NEXT();
+vm_batch_FDIV: LANES2(D.f = A.f / B.f); NEXT();
+vm_batch_FADDK: LANESK(D.f = A.f + K.f); NEXT();
+vm_batch_FSUBK: LANESK(D.f = A.f - K.f); NEXT();
+vm_batch_FMULK: LANESK(D.f = A.f * K.f); NEXT();
+vm_batch_FDIVK: LANESK(D.f = A.f / K.f); NEXT();
+vm_batch_INEG: LANES(D.i = (int64_t)(0 - (uint64_t)A.i)); NEXT();
+vm_batch_FNEG: LANES(D.f = -A.f); NEXT();
+vm_batch_NOT: LANES(D.i = A.i == 0); NEXT();
+vm_batch_I2F: LANES(D.f = (double)A.i); NEXT();
+vm_batch_F2I: LANES(D.i = (A.f != A.f) ? 0 : A.f >= 9.2233720368547758e18 ? INT64_MAX :
+                          A.f <= -9.2233720368547758e18 ? INT64_MIN : (int64_t)A.f); NEXT();
+vm_batch_IABS: LANES(D.i = A.i < 0 ? (int64_t)(0 - (uint64_t)A.i) : A.i); NEXT();
+vm_batch_FABS: LANES(D.f = fabs(A.f)); NEXT();
+vm_batch_IMIN: LANES2(D.i = A.i < B.i ? A.i : B.i); NEXT();
+vm_batch_IMAX: LANES2(D.i = A.i > B.i ? A.i : B.i); NEXT();
+vm_batch_FMIN: LANES2(D.f = fmin(A.f, B.f)); NEXT();
+vm_batch_FMAX: LANES2(D.f = fmax(A.f, B.f)); NEXT();
+vm_batch_IEQ: LANES2(D.i = A.i == B.i); NEXT();
+vm_batch_INE: LANES2(D.i = A.i != B.i); NEXT();
+vm_batch_ILT: LANES2(D.i = A.i < B.i); NEXT();
+vm_batch_ILE: LANES2(D.i = A.i <= B.i); NEXT();
+vm_batch_IEQK: LANESK(D.i = A.i == K.i); NEXT();
+vm_batch_INEK: LANESK(D.i = A.i != K.i); NEXT();
+vm_batch_ILTK: LANESK(D.i = A.i < K.i); NEXT();
+vm_batch_ILEK: LANESK(D.i = A.i <= K.i); NEXT();
+vm_batch_IGTK: LANESK(D.i = A.i > K.i); NEXT();
+vm_batch_IGEK: LANESK(D.i = A.i >= K.i); NEXT();
+vm_batch_FEQ: LANES2(D.i = A.f == B.f); NEXT();
+vm_batch_FNE: LANES2(D.i = A.f != B.f); NEXT();
+vm_batch_FLT: LANES2(D.i = A.f < B.f); NEXT();
+vm_batch_FLE: LANES2(D.i = A.f <= B.f); NEXT();
+vm_batch_SEQ: LANES2(D.i = strcmp(vm_str(A.s), vm_str(B.s)) == 0); NEXT();
+vm_batch_SNE: LANES2(D.i = strcmp(vm_str(A.s), vm_str(B.s)) != 0); NEXT();
+vm_batch_SLT: LANES2(D.i = strcmp(vm_str(A.s), vm_str(B.s)) < 0); NEXT();
+vm_batch_SLE: LANES2(D.i = strcmp(vm_str(A.s), vm_str(B.s)) <= 0); NEXT();
+vm_batch_AND: LANES2(D.i = (A.i != 0) & (B.i != 0)); NEXT();
+vm_batch_OR: LANES2(D.i = (A.i != 0) | (B.i != 0)); NEXT();
+vm_batch_SELECT: {
+            vm_value_t* d = r[ip->dst];
+            const vm_value_t* c = r[ip->a];
+            const vm_value_t* t = r[ip[1].a];
+            const vm_value_t* e = r[ip[1].b];
+            for (size_t i = 0; i < m; i++) d[i] = c[i].i ? t[i] : e[i];
+            ip++;
+            NEXT();
+        }
+vm_batch_SLEN: LANES(D.i = (int64_t)strlen(vm_str(A.s))); NEXT();
+vm_batch_SCONTAINS: LANES2(D.i = strstr(vm_str(A.s), vm_str(B.s)) != NULL); NEXT();
+vm_batch_SSTARTS: LANES2(D.i = strncmp(vm_str(A.s), vm_str(B.s), strlen(vm_str(B.s))) == 0); NEXT();
+
+#undef DISPATCH
+#undef NEXT
+#undef LANES
+#undef LANES2
+#undef LANESK
+#undef D
+#undef A
+#undef B
+#undef K
+    }
+    free(scratch);
+}
+
+/********************* lambda_t Interface ***************************/
+
+#define VM_LAMBDA_SLOTS 32
+
+#define VM_LAMBDA_SLOT_LIST(X) \
+    X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+
+static const vm_program_t* vm_lambda_programs[VM_LAMBDA_SLOTS];
+static pthread_mutex_t vm_lambda_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Calls a program with a lambda_t style argument and boxes its result.
+ *
+ * Integers travel as intptr_t, strings as pointers and floats as the bit
+ * pattern of the pointer (64-bit targets only).
+ */
+static inline void* vm_call_boxed(const vm_program_t* prog, void* arg) {
+    vm_value_t in;
+    if (prog->param_type == VM_STR) {
+        in.s = (const char*)arg;
+    } else {
+        in.i = (int64_t)(intptr_t)arg;
+    }
+    vm_value_t result = vm_run(prog, in);
+    return prog->result_type == VM_STR ? (void*)result.s : (void*)(intptr_t)result.i;
+}
+
+#define VM_THUNK(n) \
+    static void* vm_thunk_##n(void* arg) { return vm_call_boxed(vm_lambda_programs[n], arg); }
+VM_LAMBDA_SLOT_LIST(VM_THUNK)
+#undef VM_THUNK
+
+#define VM_THUNK_REF(n) vm_thunk_##n,
+static const lambda_t vm_lambda_thunks[VM_LAMBDA_SLOTS] = { VM_LAMBDA_SLOT_LIST(VM_THUNK_REF) };
+#undef VM_THUNK_REF
+
+/**
+ * @brief Returns a plain lambda_t that evaluates the program.
+ *
+ * lambda_t carries no environment, so programs are bound to one of
+ * VM_LAMBDA_SLOTS static thunks. Returns NULL when every slot is taken.
+ *
+ * Example usage:
+ * ```
+ * lambda_t p;
+ * assign_lambda(p, vm_as_lambda(prog));
+ * int result = (intptr_t)p((void*)5);
+ * ```
+ */
+static inline lambda_t vm_as_lambda(const vm_program_t* prog) {
+    lambda_t fn = NULL;
+    LOCK_MUTEX(&vm_lambda_mutex);
+    for (int i = 0; i < VM_LAMBDA_SLOTS; i++) {
+        if (!vm_lambda_programs[i]) {
+            vm_lambda_programs[i] = prog;
+            fn = vm_lambda_thunks[i];
+            break;
+        }
+    }
+    UNLOCK_MUTEX(&vm_lambda_mutex);
+    if (!fn) {
+        LOG_WARNING("All VM lambda slots are in use");
+    }
+    return fn;
+}
+
+/**
+ * @brief Frees the thunk slot of a lambda returned by vm_as_lambda().
+ *
+ * Example usage:
+ * ```
+ * vm_release_lambda(p);
+ * vm_free(prog);
+ * ```
+ */
+static inline void vm_release_lambda(lambda_t fn) {
+    LOCK_MUTEX(&vm_lambda_mutex);
+    for (int i = 0; i < VM_LAMBDA_SLOTS; i++) {
+        if (vm_lambda_thunks[i] == fn) {
+            vm_lambda_programs[i] = NULL;
+        }
+    }
+    UNLOCK_MUTEX(&vm_lambda_mutex);
+}
+
+/********************* Debugging ***************************/
+
+/**
+ * @brief Prints the bytecode and constants of a program.
+ *
+ * Example usage:
+ * ```
+ * vm_disassemble(prog, stdout);
+ * ```
+ */
+static inline void vm_disassemble(const vm_program_t* prog, FILE* out) {
+#define VM_NAME(name) #name,
+    static const char* const names[] = { VM_OPCODES(VM_NAME) };
+#undef VM_NAME
+    for (size_t i = 0; i < prog->code_len; i++) {
+        const vm_instr_t* in = &prog->code[i];
+        fprintf(out, "%4zu  %-10s r%d, r%d, %d\n", i, names[in->op], in->dst, in->a, in->b);
+        if (in->op == VM_OP_SELECT) {
+            i++;
+            fprintf(out, "%4zu  %-10s r%d, r%d\n", i, "", prog->code[i].a, prog->code[i].b);
+        }
+    }
+    for (size_t i = 0; i < prog->const_count; i++) {
+        if (prog->const_types[i] == VM_INT) {
+            fprintf(out, "  k%zu = %lld\n", i, (long long)prog->consts[i].i);
+        } else if (prog->const_types[i] == VM_FLOAT) {
+            fprintf(out, "  k%zu = %g\n", i, prog->consts[i].f);
+        } else {
+            fprintf(out, "  k%zu = \"%s\"\n", i, prog->consts[i].s);
+        }
+    }
+}
+
+
+#endif /* LAMBDA_VM_H */
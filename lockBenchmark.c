@@ -0,0 +1,110 @@
+// increments a shared counter from several threads under each lock type; build with -DLOCK_PROFILING for the contention report
+
+#include "lambda_lock.h"
+
+/*
+ * With more THREADS than cores the ticket lock hands the lock to waiters that
+ * are not running, so expect it to fall orders of magnitude behind there.
+ */
+#ifndef THREADS
+#define THREADS 4
+#endif
+#ifndef ITERATIONS
+#define ITERATIONS (200u * 1000u)
+#endif
+
+/* One operation in READ_SHARE_OF_10 out of ten only reads the counter under the rw lock. */
+#define READ_SHARE_OF_10 9
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t counter;
+static atomic_ullong observed;
+
+DEFINE_LOCK(mutex, mutex_counter_lock);
+DEFINE_LOCK(adaptive, adaptive_counter_lock);
+DEFINE_LOCK(ticket, ticket_counter_lock);
+DEFINE_LOCK(rw, rw_counter_lock);
+
+/**
+ * Generates one worker per lock type. Only the type argument differs, which
+ * is the point of the typed lock macros.
+ */
+#define DEFINE_COUNTER_WORKER(type) \
+    static void* type##_worker(void* arg) { \
+        (void)arg; \
+        for (uint32_t i = 0; i < ITERATIONS; i++) { \
+            LOCK_AS(type, &type##_counter_lock); \
+            counter++; \
+            UNLOCK_AS(type, &type##_counter_lock); \
+        } \
+        return NULL; \
+    }
+
+DEFINE_COUNTER_WORKER(mutex)
+DEFINE_COUNTER_WORKER(adaptive)
+DEFINE_COUNTER_WORKER(ticket)
+DEFINE_COUNTER_WORKER(rw)
+
+static void* rw_mixed_worker(void* arg) {
+    (void)arg;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        if (i % 10 < READ_SHARE_OF_10) {
+            READ_LOCK(&rw_counter_lock);
+            seen += counter;
+            READ_UNLOCK(&rw_counter_lock);
+        } else {
+            LOCK_AS(rw, &rw_counter_lock);
+            counter++;
+            UNLOCK_AS(rw, &rw_counter_lock);
+        }
+    }
+    atomic_fetch_add(&observed, seen);
+    return NULL;
+}
+
+static void run(const char* name, void* (*worker)(void*), uint64_t expected) {
+    pthread_t threads[THREADS];
+    counter = 0;
+    double start = now_seconds();
+    for (int i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, worker, NULL);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    printf("%-16s %d threads: %6.1f ns per operation, %s\n", name, THREADS,
+           elapsed * 1e9 / ((double)ITERATIONS * THREADS), counter == expected ? "ok" : "MISMATCH");
+}
+
+int main() {
+    uint64_t all = (uint64_t)ITERATIONS * THREADS;
+    uint64_t writes = (uint64_t)(ITERATIONS / 10 * (10 - READ_SHARE_OF_10) +
+                                 (ITERATIONS % 10 > READ_SHARE_OF_10 ? ITERATIONS % 10 - READ_SHARE_OF_10 : 0)) *
+                      THREADS;
+
+    INIT_LOCK(mutex, &mutex_counter_lock);
+    INIT_LOCK(adaptive, &adaptive_counter_lock);
+    INIT_LOCK(ticket, &ticket_counter_lock);
+    INIT_LOCK(rw, &rw_counter_lock);
+
+    run("mutex:", mutex_worker, all);
+    run("adaptive:", adaptive_worker, all);
+    run("ticket:", ticket_worker, all);
+    run("rw exclusive:", rw_worker, all);
+    run("rw 90% reads:", rw_mixed_worker, writes);
+
+    lock_profile_report(stdout);
+
+    DESTROY_LOCK(mutex, &mutex_counter_lock);
+    DESTROY_LOCK(adaptive, &adaptive_counter_lock);
+    DESTROY_LOCK(ticket, &ticket_counter_lock);
+    DESTROY_LOCK(rw, &rw_counter_lock);
+    return 0;
+}
@@ -0,0 +1,178 @@
+// writes formatted records ("id,value\n") with fprintf and through the output sink, and checks both produce the same file
+
+#include "lambda_output.h"
+#include <sys/stat.h>
+#include <time.h>
+
+#ifndef RECORDS
+#define RECORDS 20000000u
+#endif
+
+#ifndef THREADS
+#define THREADS 4
+#endif
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    uint64_t id;
+    double value;
+} result_t;
+
+/* Formatting lambda for output_map(): one record per result. */
+Lambda(format_result, arg,
+    output_item_t* it = (output_item_t*)arg;
+    result_t* r = (result_t*)it->item;
+    output_u64(it->writer, r->id);
+    output_char(it->writer, ',');
+    output_double(it->writer, r->value, 2);
+    output_char(it->writer, '\n');
+    return NULL;
+);
+
+typedef struct {
+    output_sink_t* sink;
+    FILE* file;
+    result_t* results;
+    size_t count;
+} slice_t;
+
+static void* sink_slice(void* arg) {
+    slice_t* s = (slice_t*)arg;
+    output_writer_t* out = output_writer_create(s->sink);
+    output_map(out, s->results, sizeof(result_t), s->count, format_result);
+    output_writer_destroy(out);
+    return NULL;
+}
+
+static void* fprintf_slice(void* arg) {
+    slice_t* s = (slice_t*)arg;
+    for (size_t i = 0; i < s->count; i++) {
+        fprintf(s->file, "%lu,%.2f\n", (unsigned long)s->results[i].id, s->results[i].value);
+    }
+    return NULL;
+}
+
+static size_t file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static int same_file(const char* a, const char* b) {
+    FILE* fa = fopen(a, "rb");
+    FILE* fb = fopen(b, "rb");
+    int same = fa && fb;
+    static char ba[1 << 16], bb[1 << 16];
+    while (same) {
+        size_t na = fread(ba, 1, sizeof(ba), fa);
+        size_t nb = fread(bb, 1, sizeof(bb), fb);
+        same = na == nb && memcmp(ba, bb, na) == 0;
+        if (na == 0) {
+            break;
+        }
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+static void report(const char* label, double seconds, const char* path, const char* reference) {
+    size_t bytes = file_size(path);
+    printf("%-32s %6.2f s  %6.1f M records/s  %6.0f MB/s  %s\n", label, seconds, RECORDS / seconds / 1e6,
+           bytes / seconds / 1e6, reference ? (same_file(path, reference) ? "identical" : "DIFFERENT") : "");
+}
+
+static void run_sink(const char* label, const char* path, int flags, result_t* results, int threads,
+                     const char* reference) {
+    double start = now_seconds();
+    output_sink_t* sink = output_sink_open(path, flags, 0);
+    pthread_t workers[THREADS];
+    slice_t slices[THREADS];
+    size_t per = RECORDS / threads;
+    for (int t = 0; t < threads; t++) {
+        slices[t] = (slice_t){ sink, NULL, results + t * per, t + 1 == threads ? RECORDS - t * per : per };
+        pthread_create(&workers[t], NULL, sink_slice, &slices[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    int rc = output_sink_close(sink);
+    double seconds = now_seconds() - start;
+    /* With several writers the record order differs, so only the size is comparable. */
+    report(label, seconds, path, threads == 1 && rc == 0 ? reference : NULL);
+}
+
+int main(int argc, char* argv[]) {
+    const char* dir = argc > 1 ? argv[1] : "/tmp";
+    char reference[512], path[512];
+    snprintf(reference, sizeof(reference), "%s/output_bench_printf.txt", dir);
+    snprintf(path, sizeof(path), "%s/output_bench_sink.txt", dir);
+
+    result_t* results = SAFE_MALLOC(RECORDS * sizeof(result_t));
+    for (size_t i = 0; i < RECORDS; i++) {
+        results[i].id = i * 2654435761u % 1000000007u;
+        results[i].value = (double)(i % 400000) * 0.25;
+    }
+
+    /* Raw write bandwidth of the target, for the "limited by disk" comparison. */
+    size_t chunk = 8u << 20;
+    uint8_t* raw = SAFE_MALLOC(chunk);
+    memset(raw, '7', chunk);
+    double start = now_seconds();
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    size_t raw_bytes = 0;
+    while (fd >= 0 && raw_bytes < (size_t)RECORDS * 16) {
+        if (write(fd, raw, chunk) != (ssize_t)chunk) {
+            break;
+        }
+        raw_bytes += chunk;
+    }
+    if (fd >= 0) close(fd);
+    double seconds = now_seconds() - start;
+    printf("%-32s %6.2f s  %25.0f MB/s\n", "raw 8 MB writes", seconds, raw_bytes / seconds / 1e6);
+    free(raw);
+
+    start = now_seconds();
+    FILE* file = fopen(reference, "w");
+    if (!file) {
+        LOG_ERROR("Cannot create benchmark output");
+        return 1;
+    }
+    slice_t all = { NULL, file, results, RECORDS };
+    fprintf_slice(&all);
+    fclose(file);
+    report("fprintf, 1 thread", now_seconds() - start, reference, NULL);
+
+    run_sink("sink, background flush", path, 0, results, 1, reference);
+    run_sink("sink, synchronous", path, OUTPUT_SYNC, results, 1, reference);
+    run_sink("sink, O_DIRECT", path, OUTPUT_DIRECT, results, 1, reference);
+
+    /* Several threads sharing one FILE* serialize on its lock for every call. */
+    start = now_seconds();
+    file = fopen(reference, "w");
+    pthread_t workers[THREADS];
+    slice_t slices[THREADS];
+    size_t per = RECORDS / THREADS;
+    for (int t = 0; t < THREADS; t++) {
+        slices[t] = (slice_t){ NULL, file, results + t * per, t + 1 == THREADS ? RECORDS - t * per : per };
+        pthread_create(&workers[t], NULL, fprintf_slice, &slices[t]);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    fclose(file);
+    char label[64];
+    snprintf(label, sizeof(label), "fprintf, %d threads", THREADS);
+    report(label, now_seconds() - start, reference, NULL);
+    snprintf(label, sizeof(label), "sink, %d threads", THREADS);
+    run_sink(label, path, 0, results, THREADS, NULL);
+
+    unlink(reference);
+    unlink(path);
+    free(results);
+    return 0;
+}
@@ -0,0 +1,138 @@
+// shows use case of lambdas as pipeline stages (parse -> transform -> serialize on separate threads)
+
+#include "lambda_pipeline.h"
+
+#define RECORDS 200000
+
+typedef struct {
+    long id;
+    double value;
+    char line[48];
+} record_t;
+
+// Parse "id,value" into a record, dropping malformed lines
+Lambda(parse, text,
+    record_t* rec = SAFE_MALLOC(sizeof(record_t));
+    if (sscanf((const char*)text, "%ld,%lf", &rec->id, &rec->value) != 2) {
+        free(rec);
+        rec = NULL;
+    }
+    free(text);
+    return rec;
+);
+
+// Stateless and CPU heavy, so it runs on several workers
+Lambda(transform, r,
+    record_t* rec = (record_t*)r;
+    for (int i = 0; i < 200; i++) {
+        rec->value = rec->value * 0.999 + 1.0;
+    }
+    return rec;
+);
+
+Lambda(serialize, r,
+    record_t* rec = (record_t*)r;
+    snprintf(rec->line, sizeof(rec->line), "%ld:%.3f", rec->id, rec->value);
+    return rec;
+);
+
+// Producer thread: every thousandth line is malformed and gets dropped by parse
+Lambda(feed, ctx,
+    pipeline_t* pipe = (pipeline_t*)ctx;
+    for (long i = 0; i < RECORDS; i++) {
+        char* line = SAFE_MALLOC(32);
+        if (i % 1000 == 999) {
+            snprintf(line, 32, "bad line %ld", i);
+        } else {
+            snprintf(line, 32, "%ld,%ld.5", i, i % 100);
+        }
+        pipeline_push(pipe, line);
+    }
+    pipeline_close(pipe);
+    return NULL;
+);
+
+// Unordered lookup stage where one early item stalls its worker, as a slow remote call would
+Lambda(lookup, r,
+    record_t* rec = (record_t*)r;
+    if (rec->id == 1) {
+        usleep(300000);
+    }
+    return rec;
+);
+
+Lambda(feed_records, ctx,
+    pipeline_t* pipe = (pipeline_t*)ctx;
+    for (long i = 0; i < RECORDS; i++) {
+        record_t* rec = SAFE_MALLOC(sizeof(record_t));
+        rec->id = i;
+        rec->value = (double)(i % 100);
+        pipeline_push(pipe, rec);
+    }
+    pipeline_close(pipe);
+    return NULL;
+);
+
+// An ordered stage behind the stalled one holds results until item 1 arrives; the source waits meanwhile
+static void run_stalled(void) {
+    pipeline_t* p = pipeline_create(768, 64);
+    pipeline_add_stage(p, "lookup", lookup, 8, 0);
+    pipeline_add_stage(p, "transform", transform, 4, PIPELINE_ORDERED);
+    pipeline_start(p);
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, feed_records, p);
+
+    long count = 0, out_of_order = 0, last_id = -1;
+    void* results[64];
+    size_t n;
+    while ((n = pipeline_pop_batch(p, results, 64)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            record_t* rec = (record_t*)results[i];
+            out_of_order += rec->id != last_id + 1;
+            last_id = rec->id;
+            count++;
+            free(rec);
+        }
+    }
+    pthread_join(producer, NULL);
+
+    printf("\nwith a stalled upstream worker: records: %ld, out of order: %ld\n", count, out_of_order);
+    pipeline_report(p, stdout);
+    pipeline_destroy(p);
+}
+
+int main() {
+    pipeline_t* p = pipeline_create(1024, 64);
+    pipeline_add_stage(p, "parse", parse, 1, 0);
+    pipeline_add_stage(p, "transform", transform, 4, PIPELINE_ORDERED);
+    pipeline_add_stage(p, "serialize", serialize, 1, 0);
+    pipeline_start(p);
+
+    // Feed the pipeline from a separate thread so this one can consume results
+    pthread_t producer;
+    pthread_create(&producer, NULL, feed, p);
+
+    long count = 0, last_id = -1, out_of_order = 0;
+    void* results[64];
+    size_t n;
+    while ((n = pipeline_pop_batch(p, results, 64)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            record_t* rec = (record_t*)results[i];
+            out_of_order += rec->id < last_id;
+            last_id = rec->id;
+            if (count++ == 0) {
+                printf("first: %s\n", rec->line);
+            }
+            free(rec);
+        }
+    }
+    pthread_join(producer, NULL);
+
+    printf("records: %ld, out of order: %ld\n", count, out_of_order);
+    pipeline_report(p, stdout);
+    pipeline_destroy(p);
+
+    run_stalled();
+    return 0;
+}
@@ -0,0 +1,167 @@
+// runs a non-thread-safe legacy parser in worker processes, sharded by user, and survives a record that crashes it
+
+#include "lambda_shard.h"
+#include <time.h>
+
+#define RECORDS 1000000
+#define USERS 50000
+#define POISON_RECORD 123456
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Legacy code: strtok over a static buffer, so it can only ever run on one thread per process. */
+static uint64_t legacy_parse(const char* line, size_t length, uint32_t* user) {
+    static char copy[256];
+    memcpy(copy, line, length);
+    copy[length] = '\0';
+    uint64_t amount = 0;
+    for (char* field = strtok(copy, " "); field; field = strtok(NULL, " ")) {
+        if (strncmp(field, "user=", 5) == 0) {
+            *user = (uint32_t)strtoul(field + 5, NULL, 10);
+        } else if (strncmp(field, "amount=", 7) == 0) {
+            amount = strtoull(field + 7, NULL, 10);
+        } else if (strcmp(field, "action=corrupt") == 0) {
+            abort();
+        }
+    }
+    return amount;
+}
+
+/* Worker lambda: replies with (user, amount). */
+Lambda(parse_record, arg,
+    shard_task_t* task = (shard_task_t*)arg;
+    static uint64_t reply[2];
+    uint32_t user = 0;
+    reply[1] = legacy_parse((const char*)task->data, task->size, &user);
+    reply[0] = user;
+    task->result = reply;
+    task->result_size = sizeof(reply);
+    return NULL;
+);
+
+/* Worker lambda over a shard_alloc() buffer: the payload is read in place, never copied. */
+Lambda(checksum_blob, arg,
+    shard_task_t* task = (shard_task_t*)arg;
+    static uint64_t sum;
+    const uint64_t* words = (const uint64_t*)task->data;
+    sum = 0;
+    for (size_t i = 0; i < task->size / 8; i++) {
+        sum += words[i] ^ i;
+    }
+    task->result = &sum;
+    task->result_size = sizeof(sum);
+    return NULL;
+);
+
+typedef struct {
+    uint64_t totals[USERS];
+    size_t crashed;
+    uint64_t checksums;
+} results_t;
+
+Lambda(collect, arg,
+    shard_result_t* result = (shard_result_t*)arg;
+    results_t* out = (results_t*)result->ctx;
+    if (result->status == SHARD_CRASHED) {
+        printf("  a record of user %lu crashed its worker twice and was dropped\n", (unsigned long)result->key);
+        out->crashed++;
+    } else if (result->status == SHARD_OK && result->size == 16) {
+        const uint64_t* reply = (const uint64_t*)result->data;
+        out->totals[reply[0]] += reply[1];
+    } else if (result->status == SHARD_OK) {
+        out->checksums += *(const uint64_t*)result->data;
+    }
+    return NULL;
+);
+
+static int make_record(char* line, size_t i) {
+    uint32_t user = (uint32_t)((i * 2654435761u) % USERS);
+    if (i == POISON_RECORD) {
+        return snprintf(line, 128, "user=%u action=corrupt amount=1", user);
+    }
+    return snprintf(line, 128, "user=%u action=buy amount=%u item=%u", user, (unsigned)(i % 97), (unsigned)(i % 5003));
+}
+
+static double run(size_t workers, results_t* out) {
+    memset(out, 0, sizeof(*out));
+    shard_config_t config = { .workers = workers, .on_result = collect, .ctx = out };
+    shard_pool_t* pool = shard_pool_create(&config);
+    int parse = shard_register(pool, "parse_record", parse_record);
+    shard_pool_start(pool);
+    double start = now_seconds();
+    char line[128];
+    for (size_t i = 0; i < RECORDS; i++) {
+        int length = make_record(line, i);
+        /* Routing by user keeps each user's records on one worker, in order. */
+        shard_submit(pool, parse, (i * 2654435761u) % USERS, line, (size_t)length);
+    }
+    shard_drain(pool);
+    double seconds = now_seconds() - start;
+    printf("%zu workers: %.2f s, %.1f M records/s, %zu restarts\n", workers, seconds, RECORDS / seconds / 1e6,
+           pool->restarts);
+    shard_pool_destroy(pool);
+    return seconds;
+}
+
+int main() {
+    /* Reference: the legacy parser in this process, skipping the record that would kill it. */
+    uint64_t* expected = SAFE_MALLOC(USERS * sizeof(uint64_t));
+    memset(expected, 0, USERS * sizeof(uint64_t));
+    char line[128];
+    double start = now_seconds();
+    for (size_t i = 0; i < RECORDS; i++) {
+        int length = make_record(line, i);
+        uint32_t user = 0;
+        if (i != POISON_RECORD) {
+            uint64_t amount = legacy_parse(line, (size_t)length, &user);
+            expected[user] += amount;
+        }
+    }
+    printf("in process: %.2f s\n", now_seconds() - start);
+
+    results_t* out = SAFE_MALLOC(sizeof(results_t));
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (size_t workers = 1; workers <= (size_t)(online > 4 ? online : 4); workers *= 2) {
+        run(workers, out);
+        size_t wrong = 0;
+        for (size_t u = 0; u < USERS; u++) {
+            wrong += out->totals[u] != expected[u];
+        }
+        printf("  totals %s, %zu dropped\n", wrong ? "DIFFER" : "match", out->crashed);
+    }
+
+    /* Large payloads placed in the shared heap travel as an offset. */
+    memset(out, 0, sizeof(*out));
+    shard_config_t config = { .workers = 4, .heap_size = 256u << 20, .on_result = collect, .ctx = out };
+    shard_pool_t* pool = shard_pool_create(&config);
+    int checksum = shard_register(pool, "checksum_blob", checksum_blob);
+    shard_pool_start(pool);
+    size_t blob = 4u << 20;
+    uint64_t expected_sum = 0;
+    uint64_t** blobs = SAFE_MALLOC(64 * sizeof(uint64_t*));
+    for (size_t b = 0; b < 64; b++) {
+        blobs[b] = shard_alloc(pool, blob);
+        for (size_t i = 0; i < blob / 8; i++) {
+            blobs[b][i] = b * 1000003 + i * 7;
+            expected_sum += blobs[b][i] ^ i;
+        }
+    }
+    start = now_seconds();
+    for (size_t b = 0; b < 64; b++) {
+        shard_submit(pool, checksum, b, blobs[b], blob);
+    }
+    shard_drain(pool);
+    double seconds = now_seconds() - start;
+    printf("zero-copy: 64 x 4 MB blobs in %.3f s (%.0f MB/s), checksum %s\n", seconds, 64.0 * blob / seconds / 1e6,
+           out->checksums == expected_sum ? "ok" : "WRONG");
+    shard_pool_destroy(pool);
+
+    free(blobs);
+    free(out);
+    free(expected);
+    return 0;
+}
@@ -0,0 +1,99 @@
+// per-thread sketches over a request stream, merged in the parent and shipped through a serialized buffer
+
+#include "lambda_sketch.h"
+#include <pthread.h>
+
+#define THREADS 4
+#define REQUESTS_PER_THREAD 1000000
+
+typedef struct {
+    int id;
+    sketch_input_t sketches;
+} worker_t;
+
+/* A stand-in for a lambda whose outputs are being monitored: (user, latency) per request. */
+Lambda(next_request, arg,
+    uint64_t* state = (uint64_t*)arg;
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (void*)(uintptr_t)*state;
+);
+
+static void* worker_main(void* arg) {
+    worker_t* w = (worker_t*)arg;
+    uint64_t state = (uint64_t)w->id + 1;
+    for (int i = 0; i < REQUESTS_PER_THREAD; i++) {
+        uint64_t r = (uint64_t)(uintptr_t)next_request(&state);
+        double u = (double)(r >> 11) / (double)(1ull << 53);
+        w->sketches.key = (uint64_t)(1.0 / (u + 1e-6)) % 200000;   /* a few heavy users, a long tail */
+        w->sketches.value = 5.0 + 100.0 * u * u * u;               /* skewed latency in ms */
+        SKETCH_ACCUMULATE(&w->sketches, topk_accumulate, hll_accumulate, kll_accumulate);
+    }
+    return NULL;
+}
+
+int main() {
+    pthread_t threads[THREADS];
+    worker_t workers[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        memset(&workers[t], 0, sizeof(workers[t]));
+        workers[t].id = t;
+        workers[t].sketches.topk = topk_create(5, 1 << 14, 4);
+        workers[t].sketches.distinct = hll_create(14);
+        workers[t].sketches.quantiles = kll_create(200);
+        pthread_create(&threads[t], NULL, worker_main, &workers[t]);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    /* Merge per-thread sketches without any shared state during the run. */
+    sketch_input_t* total = &workers[0].sketches;
+    for (int t = 1; t < THREADS; t++) {
+        topk_merge(total->topk, workers[t].sketches.topk);
+        hll_merge(total->distinct, workers[t].sketches.distinct);
+        kll_merge(total->quantiles, workers[t].sketches.quantiles);
+    }
+
+    /* Ship the quantile sketch as bytes, as another process would receive it. */
+    size_t size = kll_serialized_size(total->quantiles);
+    void* wire = SAFE_MALLOC(size);
+    kll_serialize(total->quantiles, wire, size);
+    kll_t* received = kll_deserialize(wire, size);
+
+    printf("requests: %d, distinct users: ~%.0f\n", THREADS * REQUESTS_PER_THREAD, hll_estimate(total->distinct));
+    printf("latency p50 %.1f ms, p99 %.1f ms, p99.9 %.1f ms (%zu bytes on the wire)\n", kll_quantile(received, 0.5),
+           kll_quantile(received, 0.99), kll_quantile(received, 0.999), size);
+    topk_entry_t top[5];
+    size_t n = topk_list(total->topk, top, 5);
+    for (size_t i = 0; i < n; i++) {
+        printf("top user %llu: ~%llu requests\n", (unsigned long long)top[i].key, (unsigned long long)top[i].count);
+    }
+
+    /* Bytes from elsewhere can be cut short or damaged; they are rejected rather than read past. */
+    unsigned char* damaged = SAFE_MALLOC(size);
+    memcpy(damaged, wire, size);
+    kll_t* truncated = kll_deserialize(damaged, size / 2);
+    sketch_header_t header;
+    memcpy(&header, damaged, sizeof(header));
+    header.size = 4;
+    memcpy(damaged, &header, sizeof(header));
+    kll_t* short_size = kll_deserialize(damaged, size);
+    header.type = SKETCH_HLL;
+    memcpy(damaged, &header, sizeof(header));
+    hll_t* tiny = hll_deserialize(damaged, sizeof(header) + 4);
+    printf("truncated blob %s, bad size field %s, 20-byte blob %s\n", truncated ? "ACCEPTED" : "rejected",
+           short_size ? "ACCEPTED" : "rejected", tiny ? "ACCEPTED" : "rejected");
+    kll_destroy(truncated);
+    kll_destroy(short_size);
+    hll_destroy(tiny);
+    free(damaged);
+
+    SAFE_FREE(wire);
+    kll_destroy(received);
+    for (int t = 0; t < THREADS; t++) {
+        topk_destroy(workers[t].sketches.topk);
+        hll_destroy(workers[t].sketches.distinct);
+        kll_destroy(workers[t].sketches.quantiles);
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+// compares qsort with the specialized, radix and parallel sorts over a DYNAMIC_ARRAY of ints
+
+#include "lambda_sort.h"
+#include <time.h>
+
+#ifndef ELEMENTS
+#define ELEMENTS (16u * 1024u * 1024u)
+#endif
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+DEFINE_SORT(int_asc, int, a, b, a < b)
+DEFINE_RADIX_SORT(int_key, int, int, x, x)
+DEFINE_RADIX_SORT(char_key, char, char, x, x)
+
+int main() {
+    numa_pool_t* pool = numa_pool_create(0);
+    DYNAMIC_ARRAY(int) input, work, expected;
+    input.array = SAFE_MALLOC(ELEMENTS * sizeof(int));
+    work.array = SAFE_MALLOC(ELEMENTS * sizeof(int));
+    expected.array = SAFE_MALLOC(ELEMENTS * sizeof(int));
+    input.size = work.size = expected.size = ELEMENTS;
+
+    uint64_t seed = 42;
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        input.array[i] = (int)(seed >> 33) - (1 << 30);
+    }
+
+    memcpy(expected.array, input.array, ELEMENTS * sizeof(int));
+    double start = now_seconds();
+    qsort(expected.array, ELEMENTS, sizeof(int), compare_ints);
+    double baseline = now_seconds() - start;
+    printf("elements: %u, workers: %zu\n", ELEMENTS, pool->worker_count);
+    printf("qsort:         %.3f s\n", baseline);
+
+#define RUN(label, sort_stmt) \
+    do { \
+        memcpy(work.array, input.array, ELEMENTS * sizeof(int)); \
+        start = now_seconds(); \
+        sort_stmt; \
+        double elapsed = now_seconds() - start; \
+        printf("%-14s %.3f s  %5.1fx  %s\n", label ":", elapsed, baseline / elapsed, \
+               memcmp(work.array, expected.array, ELEMENTS * sizeof(int)) ? "MISMATCH" : "ok"); \
+    } while (0)
+
+    RUN("introsort", SORT_DYNAMIC_ARRAY(int_asc, work));
+    RUN("merge sort", STABLE_SORT_DYNAMIC_ARRAY(int_asc, work));
+    RUN("radix sort", RADIX_SORT_DYNAMIC_ARRAY(int_key, work));
+    RUN("parallel sort", PARALLEL_SORT_DYNAMIC_ARRAY(int_asc, pool, work));
+#undef RUN
+
+    /* Plain char keys sort by the platform's char signedness. */
+    char letters[] = { 5, -1, 127, 0, -128, 100, -3 };
+    char_key_radix_sort(letters, sizeof(letters));
+    int char_order = 1;
+    for (size_t i = 1; i < sizeof(letters); i++) {
+        char_order &= letters[i - 1] <= letters[i];
+    }
+    printf("char radix:    %s\n", char_order ? "ok" : "MISMATCH");
+
+    free(input.array);
+    free(work.array);
+    free(expected.array);
+    numa_pool_destroy(pool);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// tokenizes a generated text buffer with a byte-at-a-time loop and with the lambda_text.h kernels on every instruction set
+
+#include "lambda_text.h"
+#include <time.h>
+
+#ifndef TEXT_BYTES
+#define TEXT_BYTES (256u * 1024u * 1024u)
+#endif
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    size_t words;
+    size_t bytes;
+} word_stats_t;
+
+Lambda(count_word, arg,
+    text_span_t* word = (text_span_t*)arg;
+    word_stats_t* stats = (word_stats_t*)word->ctx;
+    stats->words++;
+    stats->bytes += word->len;
+    return NULL;
+);
+
+Lambda(count_line, arg,
+    (*(size_t*)((text_span_t*)arg)->ctx)++;
+    return NULL;
+);
+
+int main() {
+    static const char* const words[] = { "lambda", "map", "filter", "reduce", "x", "pipeline", "2024", "ERROR" };
+    char* text = SAFE_MALLOC(TEXT_BYTES);
+    uint64_t seed = 42;
+    size_t pos = 0;
+    while (pos < TEXT_BYTES) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        const char* w = words[(seed >> 33) % 8];
+        size_t n = strlen(w);
+        if (pos + n + 1 > TEXT_BYTES) {
+            break;
+        }
+        memcpy(text + pos, w, n);
+        pos += n;
+        text[pos++] = ((seed >> 40) % 12 == 0) ? '\n' : ((seed >> 44) % 3 ? ' ' : '\t');
+    }
+    size_t len = pos;
+
+    /* Byte-at-a-time reference: what strtok/strchr style loops do. */
+    double start = now_seconds();
+    word_stats_t expected = { 0, 0 };
+    size_t token = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        if (c == ' ' || c == '\t' || c == '\n') {
+            if (token) {
+                expected.words++;
+                expected.bytes += token;
+            }
+            token = 0;
+        } else {
+            token++;
+        }
+    }
+    if (token) {
+        expected.words++;
+        expected.bytes += token;
+    }
+    double baseline = now_seconds() - start;
+    printf("bytes: %zu, words: %zu\n", len, expected.words);
+    printf("byte loop:      %.3f s  %6.2f GB/s\n", baseline, len / baseline / 1e9);
+
+    text_set_t blanks;
+    text_set_init(&blanks, " \t\n");
+    text_isa_t best = text_set_isa(TEXT_ISA_AVX2);
+    for (int isa = TEXT_ISA_SCALAR; isa <= (int)best; isa++) {
+        text_set_isa((text_isa_t)isa);
+        printf("[%s]\n", text_isa_name((text_isa_t)isa));
+
+        word_stats_t stats = { 0, 0 };
+        start = now_seconds();
+        text_split(text, len, &blanks, TEXT_SKIP_EMPTY, count_word, &stats);
+        double elapsed = now_seconds() - start;
+        printf("  split words:  %.3f s  %6.2f GB/s  %5.1fx  %s\n", elapsed, len / elapsed / 1e9, baseline / elapsed,
+               stats.words == expected.words && stats.bytes == expected.bytes ? "ok" : "MISMATCH");
+
+        size_t lines = 0;
+        start = now_seconds();
+        text_lines(text, len, count_line, &lines);
+        elapsed = now_seconds() - start;
+        printf("  lines:        %.3f s  %6.2f GB/s  (%zu)\n", elapsed, len / elapsed / 1e9, lines);
+
+        start = now_seconds();
+        size_t blank_count = text_count_set(text, len, &blanks);
+        elapsed = now_seconds() - start;
+        printf("  count blanks: %.3f s  %6.2f GB/s  %s\n", elapsed, len / elapsed / 1e9,
+               blank_count == (size_t)text_count_byte(text, len, ' ') + text_count_byte(text, len, '\t') +
+                              text_count_byte(text, len, '\n') ? "ok" : "MISMATCH");
+
+        start = now_seconds();
+        const char* hit = text_memmem(text, len, "filter\nERROR\tlambdas", 20);
+        elapsed = now_seconds() - start;
+        printf("  memmem:       %.3f s  %6.2f GB/s  %s\n", elapsed, (hit ? (size_t)(hit - text) : len) / elapsed / 1e9,
+               hit == memmem(text, len, "filter\nERROR\tlambdas", 20) ? "ok" : "MISMATCH");
+    }
+
+    SAFE_FREE(text);
+    return 0;
+}
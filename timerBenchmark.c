@@ -0,0 +1,160 @@
+// keeps 1M request timeouts pending, re-arms and cancels them, and fires the rest, with a sorted list under a mutex and with the timer wheel
+
+#include "lambda_timer.h"
+#include <malloc.h>
+
+#ifndef PENDING
+#define PENDING (1000u * 1000u)
+#endif
+
+/* The sorted list degrades quadratically, so it only gets a fraction of the load. */
+#define LIST_PENDING 20000u
+#define MAX_TIMEOUT_MS 30000u
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct request {
+    timer_entry_t timeout;
+    /* Baseline links. */
+    struct request* prev;
+    struct request* next;
+    uint64_t deadline;
+} request_t;
+
+static uint64_t fired_count;
+
+Lambda(on_timeout, arg,
+    (void)arg;
+    fired_count++;
+    return NULL;
+);
+
+static uint64_t timeout_of(uint64_t i, uint64_t round) {
+    return ((i + round) * 2654435761u) % MAX_TIMEOUT_MS + 1;
+}
+
+/********************* Baseline: sorted list under a mutex ***************************/
+
+typedef struct {
+    request_t head;
+    pthread_mutex_t mutex;
+} sorted_list_t;
+
+static void list_schedule(sorted_list_t* list, request_t* req, uint64_t deadline) {
+    pthread_mutex_lock(&list->mutex);
+    req->deadline = deadline;
+    request_t* at = list->head.prev;
+    while (at != &list->head && at->deadline > deadline) {
+        at = at->prev;
+    }
+    req->prev = at;
+    req->next = at->next;
+    at->next->prev = req;
+    at->next = req;
+    pthread_mutex_unlock(&list->mutex);
+}
+
+static void list_cancel(sorted_list_t* list, request_t* req) {
+    pthread_mutex_lock(&list->mutex);
+    req->prev->next = req->next;
+    req->next->prev = req->prev;
+    pthread_mutex_unlock(&list->mutex);
+}
+
+static void list_expire(sorted_list_t* list, uint64_t now) {
+    pthread_mutex_lock(&list->mutex);
+    while (list->head.next != &list->head && list->head.next->deadline <= now) {
+        request_t* req = list->head.next;
+        list->head.next = req->next;
+        req->next->prev = &list->head;
+        on_timeout(req);
+    }
+    pthread_mutex_unlock(&list->mutex);
+}
+
+static void run_list(request_t* reqs, uint32_t count) {
+    sorted_list_t list;
+    list.head.prev = list.head.next = &list.head;
+    pthread_mutex_init(&list.mutex, NULL);
+    fired_count = 0;
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < count; i++) {
+        list_schedule(&list, &reqs[i], timeout_of(i, 0));
+    }
+    double schedule = now_seconds() - start;
+    start = now_seconds();
+    for (uint32_t i = 0; i < count; i++) {
+        list_cancel(&list, &reqs[i]);
+        list_schedule(&list, &reqs[i], 1000 + timeout_of(i, 1));
+    }
+    double rearm = now_seconds() - start;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % 10) {
+            list_cancel(&list, &reqs[i]);
+        }
+    }
+    start = now_seconds();
+    for (uint64_t ms = 0; ms <= 1000 + MAX_TIMEOUT_MS; ms++) {
+        list_expire(&list, ms);
+    }
+    double expire = now_seconds() - start;
+    printf("sorted list, %6u pending: schedule %8.0f ns, re-arm %8.0f ns, expire %6.1f ms, fired %llu\n", count,
+           schedule / count * 1e9, rearm / count * 1e9, expire * 1e3, (unsigned long long)fired_count);
+    pthread_mutex_destroy(&list.mutex);
+}
+
+/********************* Timer wheel ***************************/
+
+static void run_wheel(request_t* reqs, uint32_t count) {
+    timer_wheel_t wheel;
+    timer_wheel_init(&wheel, 1);
+    fired_count = 0;
+
+    double start = now_seconds();
+    for (uint32_t i = 0; i < count; i++) {
+        timer_wheel_schedule(&wheel, &reqs[i].timeout, timeout_of(i, 0), 0, on_timeout, &reqs[i]);
+    }
+    double schedule = now_seconds() - start;
+
+    /* Request churn: every request finishes in time and a new one takes its place. */
+    size_t heap_before = mallinfo2().uordblks;
+    start = now_seconds();
+    for (uint32_t i = 0; i < count; i++) {
+        timer_wheel_cancel(&wheel, &reqs[i].timeout);
+        timer_wheel_schedule(&wheel, &reqs[i].timeout, 1000 + timeout_of(i, 1), 0, on_timeout, &reqs[i]);
+    }
+    double rearm = now_seconds() - start;
+    size_t heap_growth = mallinfo2().uordblks - heap_before;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % 10) {
+            timer_wheel_cancel(&wheel, &reqs[i].timeout);
+        }
+    }
+    /* Manual driving: jump the clock past every deadline and fire the rest in batches. */
+    start = now_seconds();
+    timer_wheel_advance(&wheel, timer_now_ms() + 1000 + MAX_TIMEOUT_MS + 1);
+    double expire = now_seconds() - start;
+    printf("timer wheel, %7u pending: schedule %6.0f ns, re-arm %6.0f ns, expire %6.1f ms, fired %llu, "
+           "%zu bytes allocated by churn\n",
+           count, schedule / count * 1e9, rearm / count * 1e9, expire * 1e3, (unsigned long long)fired_count,
+           heap_growth);
+}
+
+int main() {
+    request_t* reqs = SAFE_MALLOC(PENDING * sizeof(request_t));
+    memset(reqs, 0, PENDING * sizeof(request_t));
+
+    run_list(reqs, LIST_PENDING / 4);
+    run_list(reqs, LIST_PENDING);
+    run_wheel(reqs, LIST_PENDING);
+    run_wheel(reqs, PENDING);
+
+    free(reqs);
+    return 0;
+}
@@ -0,0 +1,105 @@
+// compares compiled Lambdas with the bytecode VM, per call and batched, on integer, float and string expressions
+
+#include "lambda_vm.h"
+#include <time.h>
+
+#ifndef ELEMENTS
+#define ELEMENTS (4u * 1024u * 1024u)
+#endif
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char* hosts[] = { "db-primary", "db-replica-7", "web-1", "cache", "database-archive-host" };
+
+Lambda(int_native, x,
+    int64_t v = (int64_t)(intptr_t)x;
+    return (void*)(intptr_t)(v > 10 && v < 500 ? v * 3 + 7 : v % 13);
+);
+
+Lambda(float_native, x,
+    double v = *(const double*)x;
+    static double result;
+    result = fmax(v * 0.5 - 2.0, 0.0) / (v + 1.0);
+    return &result;
+);
+
+Lambda(str_native, x,
+    const char* h = (const char*)x;
+    return (void*)(intptr_t)(strncmp(h, "db", 2) == 0 && strlen(h) < 16);
+);
+
+static vm_value_t value_of(vm_type_t type, size_t i, double* floats) {
+    vm_value_t v;
+    if (type == VM_INT) {
+        v.i = (int64_t)(i % 1000);
+    } else if (type == VM_FLOAT) {
+        v.f = floats[i];
+    } else {
+        v.s = hosts[i % (sizeof(hosts) / sizeof(hosts[0]))];
+    }
+    return v;
+}
+
+static double sum_of(vm_type_t result_type, vm_value_t v) {
+    return result_type == VM_FLOAT ? v.f : (double)v.i;
+}
+
+static void run(const char* name, const char* expr, const char* param, vm_type_t type, lambda_t native) {
+    vm_value_t* in = SAFE_MALLOC(ELEMENTS * sizeof(vm_value_t));
+    vm_value_t* out = SAFE_MALLOC(ELEMENTS * sizeof(vm_value_t));
+    double* floats = SAFE_MALLOC(ELEMENTS * sizeof(double));
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        floats[i] = (double)(i % 977) * 0.25;
+    }
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        in[i] = value_of(type, i, floats);
+    }
+
+    vm_program_t* prog = vm_compile(expr, param, type);
+    if (!prog) {
+        LOG_ERROR(vm_last_error());
+        exit(1);
+    }
+
+    double sums[3] = { 0, 0, 0 };
+    double start = now_seconds();
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        void* r = type == VM_FLOAT ? native(&floats[i]) : native((void*)in[i].s);
+        sums[0] += type == VM_FLOAT ? *(double*)r : (double)(intptr_t)r;
+    }
+    double native_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        sums[1] += sum_of(prog->result_type, vm_eval(prog, in[i]));
+    }
+    double call_time = now_seconds() - start;
+
+    start = now_seconds();
+    vm_eval_batch(prog, in, out, ELEMENTS);
+    double batch_time = now_seconds() - start;
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        sums[2] += sum_of(prog->result_type, out[i]);
+    }
+
+    printf("%-7s native %5.2f ns, vm_eval %5.2f ns (%4.1fx), vm_eval_batch %5.2f ns (%4.1fx), %s\n", name,
+           native_time / ELEMENTS * 1e9, call_time / ELEMENTS * 1e9, call_time / native_time,
+           batch_time / ELEMENTS * 1e9, batch_time / native_time,
+           sums[0] == sums[1] && sums[1] == sums[2] ? "ok" : "MISMATCH");
+
+    vm_free(prog);
+    free(floats);
+    free(out);
+    free(in);
+}
+
+int main() {
+    run("int:", "x > 10 && x < 500 ? x * 3 + 7 : x % 13", "x", VM_INT, int_native);
+    run("float:", "max(x * 0.5 - 2.0, 0.0) / (x + 1.0)", "x", VM_FLOAT, float_native);
+    run("string:", "starts(h, \"db\") && len(h) < 16", "h", VM_STR, str_native);
+    return 0;
+}